@@ -24,7 +24,7 @@
 #define EXPORTtactionInterface  extern "C"  __declspec(dllimport)
 #endif
 #else
-#define  EXPORTtactionInterface extern "C"
+#define  EXPORTtactionInterface extern "C" __attribute__((visibility("default")))
 #endif
 
 
@@ -32,7 +32,13 @@
 
 /****************************************************************************
 *FUNCTION: LoadTActionDatabase
-*DESCRIPTION		Loads the TAction Database file "tactionFile"
+*DESCRIPTION		Loads the TAction Database file "tactionFile". The
+*					native Linux library compiles a SQLite database to a
+*					bundle in memory as it loads, which takes time with the
+*					size of the library; it also takes a bundle from
+*					tactionc. A native build without SQLite loads bundles
+*					only, and fails with
+*					ERROR_TM_DATABASE_FAILED_TO_OPEN on a database.
 *PARAMETERS
 *IN: char*			tactionFile - the filename of the sqlite database to load
 *
@@ -43,6 +49,22 @@
 EXPORTtactionInterface
 int LoadTActionDatabase(char * tactionFile);
 
+/****************************************************************************
+*FUNCTION: LoadTActionBundle
+*DESCRIPTION		Maps a TAction bundle compiled offline by tactionc. Only
+*					the header is checked, so loading takes the same time for
+*					any library size and every other TAction call is ready on
+*					return.
+*PARAMETERS
+*IN: const char*	bundleFile - the filename of the bundle to map
+*
+*RETURNS:
+*			on success:		Number of TActions Found
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int LoadTActionBundle(const char * bundleFile);
+
 /****************************************************************************
 *FUNCTION: IsDatabaseLoaded
 *DESCRIPTION		Determines if there is a database currently loaded
@@ -159,5 +181,113 @@ int PlayTAction(int boardID, int tacID, int tactorID, float gainScale, float fre
 EXPORTtactionInterface
 int PlayTActionToSegment(int boardID, int tacID, int tactorIDOffset,int controllerSegmentID, float gainScale, float freq1Scale, float freq2Scale, float timeScale);
 
+/****************************************************************************
+*STRUCT: TdkTActionCacheStats
+*DESCRIPTION		PlayTAction and PlayTActionToSegment keep the commands
+*					they generate in an LRU cache keyed by TAction, first
+*					tactor, time factor and the gain, freq1 and time scales
+*					rounded to the cache quantization step. Scales are applied
+*					after rounding, so a hit sends exactly what a miss would.
+*****************************************************************************/
+typedef struct TdkTActionCacheStats
+{
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+	unsigned long long uncacheable;	// sequences too long to keep
+	int entries;
+	int capacity;
+} TdkTActionCacheStats;
+
+/****************************************************************************
+*FUNCTION: SetTActionCacheCapacity
+*DESCRIPTION		Resizes the generated command cache (default 64 entries,
+*					0 disables it). Clears the cache.
+*PARAMETERS
+*IN: int			entries - maximum number of cached sequences
+*
+*RETURNS:
+*			on success:		0
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetTActionCacheCapacity(int entries);
+
+/****************************************************************************
+*FUNCTION: SetTActionCacheQuantization
+*DESCRIPTION		Sets the step scale factors are rounded to (default
+*					1/64). Clears the cache.
+*PARAMETERS
+*IN: float			step - quantization step, greater than 0
+*
+*RETURNS:
+*			on success:		0
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetTActionCacheQuantization(float step);
+
+/****************************************************************************
+*FUNCTION: GetTActionCacheStats
+*DESCRIPTION		Copies the generated command cache counters.
+*PARAMETERS
+*OUT: TdkTActionCacheStats* stats - filled on success
+*
+*RETURNS:
+*			on success:		0
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int GetTActionCacheStats(TdkTActionCacheStats* stats);
+
+/****************************************************************************
+*STRUCT: TdkStoredTActionStats
+*DESCRIPTION		A TAction played often enough through PlayTAction is
+*					uploaded into one of the controller's stored TAction slots
+*					in the background and, once the controller has
+*					acknowledged every command of the upload, played with a
+*					single PlayStoredTAction. Slots are shared out by play
+*					count, least recently used first among equals, and are
+*					uploaded again after reconnecting to the same port.
+*					Slots recorded with BeginStoreTAction are never touched.
+*****************************************************************************/
+typedef struct TdkStoredTActionStats
+{
+	unsigned long long storedPlays;		// plays sent as PlayStoredTAction
+	unsigned long long uploads;
+	unsigned long long uploadFailures;
+	unsigned long long evictions;
+	int slotsInUse;
+} TdkStoredTActionStats;
+
+/****************************************************************************
+*FUNCTION: SetStoredTActionSlots
+*DESCRIPTION		Sets how many stored TAction slots, counted down from the
+*					highest, PlayTAction may fill on its own (default all of
+*					them, 0 turns uploading off). Applies to every controller.
+*PARAMETERS
+*IN: int			count - 0 to TDK_MAX_STORED_TACTIONS
+*
+*RETURNS:
+*			on success:		0
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetStoredTActionSlots(int count);
+
+/****************************************************************************
+*FUNCTION: GetStoredTActionStats
+*DESCRIPTION		Copies the stored TAction slot counters of a controller.
+*PARAMETERS
+*IN: int			DeviceID - the device to query
+*OUT: TdkStoredTActionStats* stats - filled on success
+*
+*RETURNS:
+*			on success:		0
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int GetStoredTActionStats(int boardID, TdkStoredTActionStats* stats);
+
 #endif
 #endif
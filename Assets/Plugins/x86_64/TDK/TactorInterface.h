@@ -23,7 +23,7 @@
 		#define EXPORTtactionInterface  extern "C"  __declspec(dllimport)
 	#endif
 #else
-	#define  EXPORTtactionInterface extern "C"
+	#define  EXPORTtactionInterface extern "C" __attribute__((visibility("default")))
 #endif
 
 /****************************************************************************
@@ -81,6 +81,11 @@ int Connect(const char* name, int type, void* _callback);
 /****************************************************************************
 *FUNCTION: Discover
 *DESCRIPTION		Scan Available Ports on computer for Tactor Controller
+*					All candidate ports are probed at once. If the device
+*					last connected on this machine still answers, it is
+*					listed first (see SetDiscoveryCache); the rest are
+*					ordered by port name. Ports already connected by this
+*					process are not probed or listed.
 *PARAMETERS
 *IN: int			_type -	Type of Controllers to Scan For (bitfield,
 *							multiple types can be ORd together.)
@@ -95,6 +100,9 @@ int Discover(int type);
 /****************************************************************************
 *FUNCTION: DiscoverLimited
 *DESCRIPTION		Scan Available Ports on computer for Tactor Controller with alotted amount
+*					With an amount of 1, the device last connected on this
+*					machine is returned as soon as it answers, without
+*					waiting for the other ports.
 *PARAMETERS
 *IN: int			_type -	Type of Controllers to Scan For (bitfield,
 *									multiple types can be ORd together.)
@@ -107,6 +115,25 @@ int Discover(int type);
 EXPORTtactionInterface
 int DiscoverLimited(int type,int amount);
 
+/****************************************************************************
+*FUNCTION: SetDiscoveryCache
+*DESCRIPTION		Turns the last known good device on (the default) or off.
+*					While on, every successful Connect records the device in
+*					the user's cache directory and Discover probes it first,
+*					in the same pass as the other ports; DiscoverLimited
+*					with an amount of 1 stops there if it answers. While
+*					off, results are ordered by port name only.
+*
+*PARAMETERS
+*IN: bool			_enabled		- true to use and update the cache
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetDiscoveryCache(bool _enabled);
+
 /****************************************************************************
 *FUNCTION: GetDiscoveredDeviceName
 *DESCRIPTION		Scan Available Ports on computer for Tactor Controller
@@ -411,6 +438,8 @@ int UpdateTI();
 /****************************************************************************
 *FUNCTION: GetLastEAIError
 *DESCRIPTION		Returns EAI Error Code (See full list of error codes in EAI_ErrorCodes.h)
+*					The native Linux TactorInterface keeps one per thread: the
+*					error of the calling thread's last failed call.
 *
 *PARAMETERS
 *
@@ -512,4 +541,1062 @@ int PlayStoredTAction(int _deviceID, int _delay, int tacId);
 *****************************************************************************/
 EXPORTtactionInterface
 int SetFreqTimeDelay(int _deviceID, bool _delayOn);
+
+/****************************************************************************
+*FUNCTION: BeginBatch
+*DESCRIPTION		Starts collecting commands for the given device instead of
+*					sending them. Every command function called for the device
+*					is queued until CommitBatch.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device To apply Command
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int BeginBatch(int _deviceID);
+
+/****************************************************************************
+*FUNCTION: CommitBatch
+*DESCRIPTION		Hands every command collected since BeginBatch to the
+*					I/O thread as one unit. They leave in a single
+*					write, packed into as few action lists as the controller's
+*					receive buffer allows.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device To apply Command
+*
+*RETURNS:
+*			on success:		Number of commands queued
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int CommitBatch(int _deviceID);
+
+/****************************************************************************
+*STRUCT: TdkQueueStats
+*DESCRIPTION		Counters for a device's outgoing command queue. Command
+*					functions return once the command is queued; the I/O
+*					thread writes it to the port. Latencies are measured
+*					from queueing to the completed write.
+*****************************************************************************/
+typedef struct TdkQueueStats
+{
+	int depth;						// commands waiting right now
+	int maxDepth;					// deepest the queue has been
+	unsigned long long enqueued;	// commands accepted
+	unsigned long long written;		// commands written to the port
+	unsigned long long dropped;		// commands discarded (stale or write error)
+	unsigned long long writes;		// port writes issued
+	unsigned long long wireLatencyTotalUs;
+	unsigned int wireLatencyMaxUs;
+} TdkQueueStats;
+
+/****************************************************************************
+*FUNCTION: GetQueueStats
+*DESCRIPTION		Copies the command queue counters of a device.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device to query
+*OUT: TdkQueueStats* _stats			- Filled on success
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int GetQueueStats(int _deviceID, TdkQueueStats* _stats);
+
+/****************************************************************************
+*FUNCTION: SetMaxQueueLatency
+*DESCRIPTION		Bounds how long a command may wait in a device queue.
+*					Commands older than _ms when the I/O thread reaches them
+*					are dropped and UpdateTI reports ERROR_EAITIMEOUT. A
+*					value of 0 (the default) disables the bound.
+*
+*PARAMETERS
+*IN: int			_ms				- Maximum queueing delay in milliseconds
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetMaxQueueLatency(int _ms);
+
+/****************************************************************************
+*Asynchronous commands
+*DESCRIPTION		The *Async functions queue the same command as their
+*					synchronous counterpart and return a completion token
+*					(> 0). Once the controller answers the frame carrying the
+*					command, or the command fails, a TdkCompletion with that
+*					token can be taken from PollCompletion. Tokens are unique
+*					per device; match on deviceID and token together.
+*****************************************************************************/
+#define TDK_COMPLETION_ACK		0	// controller accepted the command
+#define TDK_COMPLETION_NAK		1	// detail holds the NAK reason byte
+#define TDK_COMPLETION_ERROR	2	// detail holds an EAI error code
+
+typedef struct TdkCompletion
+{
+	int deviceID;
+	int token;
+	int status;						// TDK_COMPLETION_*
+	int detail;
+	unsigned int roundTripUs;		// port write to reply
+} TdkCompletion;
+
+/****************************************************************************
+*FUNCTION: PulseAsync
+*DESCRIPTION		Pulse, reported through PollCompletion.
+*
+*RETURNS:
+*			on success:		Completion token (> 0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int PulseAsync(int deviceID, int _tacNum, int _msDuration, int _delay);
+
+/****************************************************************************
+*FUNCTION: ChangeGainAsync
+*DESCRIPTION		ChangeGain, reported through PollCompletion.
+*
+*RETURNS:
+*			on success:		Completion token (> 0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int ChangeGainAsync(int deviceID, int _tacNum, int gainval, int _delay);
+
+/****************************************************************************
+*FUNCTION: RampGainAsync
+*DESCRIPTION		RampGain, reported through PollCompletion.
+*
+*RETURNS:
+*			on success:		Completion token (> 0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int RampGainAsync(int deviceID, int _tacNum, int _gainStart, int _gainEnd,
+		int _duration, int _func, int _delay);
+
+/****************************************************************************
+*FUNCTION: PlayStoredTActionAsync
+*DESCRIPTION		PlayStoredTAction, reported through PollCompletion.
+*
+*RETURNS:
+*			on success:		Completion token (> 0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int PlayStoredTActionAsync(int _deviceID, int _delay, int tacId);
+
+/****************************************************************************
+*FUNCTION: PollCompletion
+*DESCRIPTION		Takes the oldest pending completion of any device.
+*					Completions are produced whether or not UpdateTI is
+*					called; up to 1024 are held, later ones are discarded
+*					and counted by GetDroppedCompletions. A caller that
+*					sees that count grow should stop waiting for tokens
+*					it has not been answered for.
+*
+*PARAMETERS
+*OUT: TdkCompletion* _completion	- Filled when one is available
+*
+*RETURNS:
+*			on success:		value(1) if _completion was filled, value(0) if none is pending
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int PollCompletion(TdkCompletion* _completion);
+
+/****************************************************************************
+*FUNCTION: GetDroppedCompletions
+*DESCRIPTION		Number of completions discarded since InitializeTI
+*					because PollCompletion had 1024 waiting. Their tokens
+*					are never reported.
+*
+*RETURNS:
+*			on success:		Number of completions discarded
+*****************************************************************************/
+EXPORTtactionInterface
+int GetDroppedCompletions();
+
+/****************************************************************************
+*FUNCTION: SetCompletionTimeout
+*DESCRIPTION		How long a written frame may wait for its ACK or NAK
+*					(default 1000 ms). When the oldest frame times out every
+*					command still awaiting a reply completes with
+*					ERROR_EAITIMEOUT, since later replies can no longer be
+*					matched reliably.
+*
+*PARAMETERS
+*IN: int			_ms				- Timeout in milliseconds (> 0)
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetCompletionTimeout(int _ms);
+
+/****************************************************************************
+*STRUCT: TdkShadowStats
+*DESCRIPTION		The library remembers the gain, frequency, signal source
+*					and tactor type last sent to each tactor and drops
+*					undelayed ChangeGain, ChangeFreq, ChangeSigSource and
+*					SetTactorType calls that would not change them. The
+*					cache is cleared on any NAK, timeout or dropped command,
+*					on Stop, on stored TAction playback and on reconnect.
+*****************************************************************************/
+typedef struct TdkShadowStats
+{
+	unsigned long long suppressed;		// commands not sent
+	unsigned long long bytesSaved;		// action bytes not sent
+	unsigned long long invalidations;	// times the cache was cleared
+} TdkShadowStats;
+
+/****************************************************************************
+*FUNCTION: GetShadowStats
+*DESCRIPTION		Copies the redundant command counters of a device.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device to query
+*OUT: TdkShadowStats* _stats		- Filled on success
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int GetShadowStats(int _deviceID, TdkShadowStats* _stats);
+
+/****************************************************************************
+*FUNCTION: SetShadowCache
+*DESCRIPTION		Turns suppression of redundant setting commands on (the
+*					default) or off for every device.
+*
+*PARAMETERS
+*IN: bool			_enabled		- true to suppress redundant commands
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetShadowCache(bool _enabled);
+
+/****************************************************************************
+*FUNCTION: BeginTimeline
+*DESCRIPTION		Starts recording a timeline for the given device. Every
+*					command function called for the device is recorded
+*					instead of sent, at the current timeline offset (see
+*					SetTimelineOffset) plus its own delay, until PlayTimeline.
+*					Async command functions fail while recording.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device To apply Command
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int BeginTimeline(int _deviceID);
+
+/****************************************************************************
+*FUNCTION: SetTimelineOffset
+*DESCRIPTION		Sets the offset from the start of the timeline at which
+*					the following commands are recorded. Offsets are not
+*					limited by the time factor and may be set in any order.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device To apply Command
+*IN: int			_msOffset		- Milliseconds from the timeline start
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetTimelineOffset(int _deviceID, int _msOffset);
+
+/****************************************************************************
+*FUNCTION: PlayTimeline
+*DESCRIPTION		Ends the recording and schedules it to start _delay ms
+*					from now, alongside any timeline already playing. Commands
+*					are sent ahead of time with action delays that make the
+*					controller run them on schedule; a command is sent once it
+*					is due within one action delay (255 time factor units, at
+*					most MAX_ACTION_DURATION) and while fewer timeline
+*					commands than the budget (see SetTimelineBudget) wait on
+*					the controller, so the action list never overflows.
+*					UpdateTI sends the rest; call it at least every few
+*					hundred ms. Stop cancels commands not yet sent.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device To apply Command
+*IN: int			_delay			- Milliseconds until the timeline starts
+*
+*RETURNS:
+*			on success:		Number of commands scheduled
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int PlayTimeline(int _deviceID, int _delay);
+
+/****************************************************************************
+*FUNCTION: CancelTimeline
+*DESCRIPTION		Drops every timeline command of the device not yet sent.
+*					Commands already on the controller still run; use Stop to
+*					clear them too.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device To apply Command
+*
+*RETURNS:
+*			on success:		Number of commands dropped
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int CancelTimeline(int _deviceID);
+
+/****************************************************************************
+*FUNCTION: SetTimelineBudget
+*DESCRIPTION		Sets how many timeline commands may wait on a controller's
+*					action list at once (default 24). The rest of the list is
+*					left to commands sent directly.
+*
+*PARAMETERS
+*IN: int			_actions		- Timeline commands per controller
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetTimelineBudget(int _actions);
+
+/****************************************************************************
+*STRUCT: TdkTimelineStats
+*DESCRIPTION		Timeline counters of a device. A command is late when it
+*					could only be sent after its due time, for example because
+*					UpdateTI was not called in time or the budget was used up.
+*****************************************************************************/
+typedef struct TdkTimelineStats
+{
+	unsigned long long scheduled;
+	unsigned long long sent;
+	unsigned long long late;
+	unsigned long long cancelled;
+	unsigned int maxLateUs;
+	int pending;		// scheduled, not yet sent
+	int onController;	// sent, not yet due
+} TdkTimelineStats;
+
+/****************************************************************************
+*FUNCTION: GetTimelineStats
+*DESCRIPTION		Copies the timeline counters of a device.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device to query
+*OUT: TdkTimelineStats* _stats		- Filled on success
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int GetTimelineStats(int _deviceID, TdkTimelineStats* _stats);
+
+/****************************************************************************
+*FUNCTION: SetControllerLimits
+*DESCRIPTION		Tells the library the sizes of a controller's action list,
+*					ramp list and per-packet bus slots (defaults 32, 8 and 16).
+*					The library follows how full each list is from the
+*					commands it has sent, their delays and their durations,
+*					and holds commands back until they fit instead of sending
+*					a packet the controller would NAK with 0x0E, 0x0D or 0x10.
+*					Held commands go out, coalesced, as soon as the lists
+*					drain. 0 leaves a limit unenforced.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device To apply Command
+*IN: int			_actionList		- Pending actions the controller holds
+*IN: int			_rampList		- Ramps the controller runs at once
+*IN: int			_busSlots		- Undelayed actions one packet may start
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetControllerLimits(int _deviceID, int _actionList, int _rampList, int _busSlots);
+
+/****************************************************************************
+*STRUCT: TdkCredits
+*DESCRIPTION		Room a controller is believed to have right now. actions
+*					and ramps count free list entries; busSlots is how many
+*					undelayed actions a single packet may start; held counts
+*					commands waiting for room.
+*****************************************************************************/
+typedef struct TdkCredits
+{
+	int actions;
+	int ramps;
+	int busSlots;
+	int held;
+} TdkCredits;
+
+/****************************************************************************
+*FUNCTION: GetAvailableCredits
+*DESCRIPTION		Copies the estimated free room of a device's lists.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device to query
+*OUT: TdkCredits*	_credits		- Filled on success
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int GetAvailableCredits(int _deviceID, TdkCredits* _credits);
+
+/****************************************************************************
+*FUNCTION: CreateDeviceGroup
+*DESCRIPTION		Creates a group of connected devices. The returned group
+*					ID may be passed as _deviceID to every command function
+*					except the *Async ones, to BeginBatch, CommitBatch, the
+*					timeline functions and SetControllerLimits; each applies
+*					to every member still connected. A batch collected on a
+*					group is broadcast by one CommitBatch, which returns the
+*					total number of commands queued.
+*
+*PARAMETERS
+*IN: const int*		_deviceIDs		- Devices in the group (returned from Connect)
+*IN: int			_count			- Number of entries in _deviceIDs, at most 256
+*
+*RETURNS:
+*			on success:		Group ID
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int CreateDeviceGroup(const int* _deviceIDs, int _count);
+
+/****************************************************************************
+*FUNCTION: DestroyDeviceGroup
+*DESCRIPTION		Releases a group ID. The devices stay connected.
+*
+*PARAMETERS
+*IN: int			_groupID		- Group ID returned from CreateDeviceGroup
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int DestroyDeviceGroup(int _groupID);
+
+#define TDK_STATS_OPCODES			256
+#define TDK_STATS_NAK_REASONS		32	// reasons >= 31 share the last entry
+#define TDK_STATS_LATENCY_BUCKETS	24
+
+/****************************************************************************
+*STRUCT: TdkStats
+*DESCRIPTION		Counters of a device since it connected. The library
+*					records them without locks, so a copy may lag the I/O
+*					thread by a few counts. Latency histograms count events
+*					per power of two: entry 0 is under 1 us, entry i is
+*					[2^(i-1), 2^i) us and the last entry is everything
+*					longer. queueLatencyUs runs from the command function
+*					returning to the write, ackLatencyUs from the write to
+*					the controller's ACK.
+*****************************************************************************/
+typedef struct TdkStats
+{
+	unsigned long long submitted;		// commands queued
+	unsigned long long written;			// commands written to the port
+	unsigned long long writes;			// port writes issued
+	unsigned long long bytesWritten;
+	unsigned long long acks;			// ACK frames received
+	unsigned long long naks;			// NAK frames received
+	unsigned long long timeouts;		// commands whose reply never came
+	unsigned long long naksByReason[TDK_STATS_NAK_REASONS];
+	unsigned long long submittedByOpcode[TDK_STATS_OPCODES];	// by TDK_COMMAND_*
+	unsigned long long writtenByOpcode[TDK_STATS_OPCODES];
+	unsigned int queueLatencyUs[TDK_STATS_LATENCY_BUCKETS];
+	unsigned int ackLatencyUs[TDK_STATS_LATENCY_BUCKETS];
+} TdkStats;
+
+/****************************************************************************
+*FUNCTION: GetTdkStats
+*DESCRIPTION		Copies the counters and latency histograms of a device.
+*					Does not allocate and is cheap enough to call every frame.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device to query
+*OUT: TdkStats*		_stats			- Filled on success
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int GetTdkStats(int _deviceID, TdkStats* _stats);
+
+/****************************************************************************
+*FUNCTION: StartWireTrace
+*DESCRIPTION		Records every frame written to or read from any device,
+*					with its CLOCK_MONOTONIC time and device ID, into a ring
+*					of fixed-size records in a memory-mapped file. Recording
+*					costs no system call per frame; once the ring is full
+*					the oldest records are overwritten. A trace already
+*					running is stopped first. Decode the file with tdktrace.
+*
+*PARAMETERS
+*IN: const char*	_path			- File to create or truncate
+*IN: int			_records		- Ring size in frames, 0 for 65536
+*									  (160 bytes each)
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int StartWireTrace(const char* _path, int _records);
+
+/****************************************************************************
+*FUNCTION: StopWireTrace
+*DESCRIPTION		Stops recording and closes the trace file. Does nothing
+*					if no trace is running.
+*
+*RETURNS:
+*			on success:		value(0)
+*****************************************************************************/
+EXPORTtactionInterface
+int StopWireTrace();
+
+#define TDK_CURVE_LINEAR			0x01	// same as TDK_LINEAR_RAMP
+#define TDK_CURVE_EASE_IN			0x02	// quadratic
+#define TDK_CURVE_EASE_OUT			0x03
+#define TDK_CURVE_EASE_IN_OUT		0x04	// smoothstep
+#define TDK_CURVE_EXPONENTIAL		0x05	// 2^(10t), scaled to reach the end value
+
+/****************************************************************************
+*FUNCTION: RampGainCurve
+*DESCRIPTION		Plays a gain envelope given as samples, joined by straight
+*					lines, as the fewest linear RampGain commands that stay
+*					within _maxError of it. Ramps are timed in time factor
+*					units and last MIN_ACTION_DURATION to
+*					MAX_ACTION_DURATION; all of them leave in one write, with
+*					their delays, so a smooth fade costs a few packets rather
+*					than a ChangeGain per frame. Every ramp must start within
+*					255 time factor units of _delay's; split longer envelopes
+*					across timeline offsets.
+*
+*PARAMETERS
+*IN: int			_deviceID	- Device To apply Command
+*IN: int			_tacNum		- Tactor Number For Command
+*IN: const int*		_values		- Gain samples (0-255)
+*IN: int			_count		- Number of samples, at least 2
+*IN: int			_msStep		- Time between samples (ms)
+*IN: int			_maxError	- Largest gain error allowed, at least 1
+*IN: int			_delay		- Delay before running the first ramp (ms)
+*
+*RETURNS:
+*			on success:		Number of ramps sent
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int RampGainCurve(int _deviceID, int _tacNum, const int* _values, int _count, int _msStep, int _maxError, int _delay);
+
+/****************************************************************************
+*FUNCTION: RampFreqCurve
+*DESCRIPTION		RampGainCurve for frequency: samples are frequencies
+*					(300-3550) and _maxError is in Hz.
+*
+*RETURNS:
+*			on success:		Number of ramps sent
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int RampFreqCurve(int _deviceID, int _tacNum, const int* _values, int _count, int _msStep, int _maxError, int _delay);
+
+/****************************************************************************
+*FUNCTION: RampGainEased
+*DESCRIPTION		RampGain along a TDK_CURVE_* shape instead of a straight
+*					line, sent as the fewest linear ramps within _maxError
+*					(see RampGainCurve).
+*
+*PARAMETERS
+*IN: int			_deviceID	- Device To apply Command
+*IN: int			_tacNum		- Tactor Number For Command
+*IN: int			_gainStart	- Start Gain Value (0-255)
+*IN: int			_gainEnd	- End Gain Value (0-255)
+*IN: int			_duration	- Duration of the envelope (ms)
+*IN: int			_curve		- TDK_CURVE_* shape
+*IN: int			_maxError	- Largest gain error allowed, at least 1
+*IN: int			_delay		- Delay before running the first ramp (ms)
+*
+*RETURNS:
+*			on success:		Number of ramps sent
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int RampGainEased(int _deviceID, int _tacNum, int _gainStart, int _gainEnd, int _duration, int _curve, int _maxError,
+		int _delay);
+
+/****************************************************************************
+*FUNCTION: RampFreqEased
+*DESCRIPTION		RampGainEased for frequency (300-3550); _maxError is in Hz.
+*
+*RETURNS:
+*			on success:		Number of ramps sent
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int RampFreqEased(int _deviceID, int _tacNum, int _freqStart, int _freqEnd, int _duration, int _curve, int _maxError,
+		int _delay);
+
+/****************************************************************************
+*FUNCTION: StreamGain
+*DESCRIPTION		Sets the gain a tactor should have now, for values driven
+*					continuously from game state. Each tactor's gain and
+*					frequency are channels holding only their newest value:
+*					the I/O thread sends the channels that changed, batched
+*					into one frame, once the previous streamed frame is
+*					answered and no more often than SetStreamRate allows.
+*					Values set faster than that replace each other instead
+*					of queuing behind a slow link. A value lost to a NAK or
+*					timeout is sent again unless a newer one is waiting.
+*					Streamed values ignore BeginBatch and timelines, and race
+*					with ChangeGain on the same tactor.
+*
+*PARAMETERS
+*IN: int			_deviceID	- Device or device group
+*IN: int			_tacNum		- Tactor Number For Command
+*IN: int			_gainVal	- Gain Value (0-255)
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int StreamGain(int _deviceID, int _tacNum, int _gainVal);
+
+/****************************************************************************
+*FUNCTION: StreamFreq
+*DESCRIPTION		StreamGain for frequency (300-3550).
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int StreamFreq(int _deviceID, int _tacNum, int _freqVal);
+
+/****************************************************************************
+*FUNCTION: SetStreamRate
+*DESCRIPTION		Caps how many frames of streamed values each device
+*					sends per second (default 60). 0 removes the cap, so a
+*					frame follows as soon as the previous one is answered.
+*
+*PARAMETERS
+*IN: int			_hz				- Frames per second per device
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetStreamRate(int _hz);
+
+/****************************************************************************
+*STRUCT: TdkStreamStats
+*DESCRIPTION		Streaming counters of a device. superseded counts values
+*					replaced by a newer one before they were sent.
+*****************************************************************************/
+typedef struct TdkStreamStats
+{
+	unsigned long long updates;
+	unsigned long long superseded;
+	unsigned long long sent;
+	unsigned long long resent;
+	unsigned long long flushes;
+} TdkStreamStats;
+
+/****************************************************************************
+*FUNCTION: GetStreamStats
+*DESCRIPTION		Copies the streaming counters of a device.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device to query
+*OUT: TdkStreamStats* _stats		- Filled on success
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int GetStreamStats(int _deviceID, TdkStreamStats* _stats);
+
+/****************************************************************************
+*FUNCTION: SetTactorFrame
+*DESCRIPTION		Sets the whole tactor array at once, for games that
+*					compute every tactor each frame. Each intensity is 0 for
+*					off or the gain (1-255) to run that tactor at. Only what
+*					changed since the last frame is sent, in one write: a
+*					gain change for each tactor that is on at a new gain,
+*					then one SetTactors mask if any tactor turned on or off.
+*					An unchanged frame sends nothing. Other commands that
+*					touch the same gains or on/off states make the next frame
+*					send them again, as do delayed frames and commands until
+*					they have run.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device or device group
+*IN: int			_delay			- Delay before running the frame (ms)
+*IN: const unsigned char* _intensities - One per tactor, from tactor 1
+*IN: int			_count			- Number of intensities (0-64); the
+*									  remaining tactors are off
+*
+*RETURNS:
+*			on success:		Number of commands sent
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetTactorFrame(int _deviceID, int _delay, const unsigned char* _intensities, int _count);
+
+/****************************************************************************
+*FUNCTION: SetTactorPosition
+*DESCRIPTION		Places a tactor on the body for RenderContacts. The
+*					tactor is found from the segment list the controller
+*					last reported, so ReadSegmentList must have been
+*					answered. Positions are in any body space units, the
+*					same as the contact points and the contact radius.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device or device group
+*IN: int			_segment		- Controller segment (0 based)
+*IN: int			_offset			- Tactor within the segment (1 based)
+*IN: float			_x, _y, _z		- Position of the tactor
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetTactorPosition(int _deviceID, int _segment, int _offset, float _x, float _y, float _z);
+
+/****************************************************************************
+*FUNCTION: ClearTactorPositions
+*DESCRIPTION		Removes every tactor placed with SetTactorPosition.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device or device group
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int ClearTactorPositions(int _deviceID);
+
+/****************************************************************************
+*FUNCTION: SetContactRadius
+*DESCRIPTION		Sets how far from a contact point tactors still feel it
+*					(default 0.1). Use about one and a half times the
+*					spacing of the tactors so a point between them is felt
+*					on both.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device or device group
+*IN: float			_radius			- Radius in body space units
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetContactRadius(int _deviceID, float _radius);
+
+/****************************************************************************
+*STRUCT: TdkContact
+*DESCRIPTION		A point touched on the body and the gain (0-255) it
+*					would have on a tactor right under it.
+*****************************************************************************/
+typedef struct TdkContact
+{
+	float x;
+	float y;
+	float z;
+	float intensity;
+} TdkContact;
+
+/****************************************************************************
+*FUNCTION: RenderContacts
+*DESCRIPTION		Renders all contact points of a frame onto the placed
+*					tactors and sends the result as SetTactorFrame does.
+*					Each contact is shared by the tactors within the contact
+*					radius, closer ones getting more, so a point between
+*					tactors is felt between them. Contacts add up by energy.
+*					Tactors no contact reaches are off.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device or device group
+*IN: int			_delay			- Delay before running the frame (ms)
+*IN: const TdkContact* _contacts	- Contact points of this frame
+*IN: int			_count			- Number of contact points
+*
+*RETURNS:
+*			on success:		Number of commands sent
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int RenderContacts(int _deviceID, int _delay, const TdkContact* _contacts, int _count);
+
+/****************************************************************************
+*FUNCTION: GetTdkTimeUs
+*DESCRIPTION		Returns the host clock the *At functions take their
+*					times on (CLOCK_MONOTONIC), in microseconds.
+*
+*RETURNS:
+*			Microseconds since an arbitrary start, never going back
+*****************************************************************************/
+EXPORTtactionInterface
+long long GetTdkTimeUs();
+
+/****************************************************************************
+*FUNCTION: PulseAt
+*DESCRIPTION		Pulse timed to start on the controller at host time
+*					_atUs (see GetTdkTimeUs). The estimated link latency
+*					(see GetClockSync) is taken off and the rest, worked out
+*					as the pulse is written, is sent as the action delay, so
+*					the pulse lands on time to within half a time factor
+*					unit plus the jitter however long it was queued. A time
+*					already passed pulses at once. Use PlayTimelineAt for
+*					anything further off than one action delay.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device or device group
+*IN: int			_tacNum			- Tactor to pulse
+*IN: int			_msDuration		- Duration of the pulse (ms)
+*IN: long long		_atUs			- Host time the pulse starts (us)
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int PulseAt(int _deviceID, int _tacNum, int _msDuration, long long _atUs);
+
+/****************************************************************************
+*FUNCTION: PlayTimelineAt
+*DESCRIPTION		PlayTimeline, starting the timeline at host time _atUs
+*					(see GetTdkTimeUs) on the controller: the estimated
+*					link latency of each device is taken off its start.
+*					Like PulseAt's, each command's delay is worked out as it
+*					is written.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device or device group
+*IN: long long		_atUs			- Host time the timeline starts (us)
+*
+*RETURNS:
+*			on success:		Number of commands scheduled
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int PlayTimelineAt(int _deviceID, long long _atUs);
+
+/****************************************************************************
+*FUNCTION: SetClockProbeInterval
+*DESCRIPTION		Sets how long a link may be idle before it is measured
+*					with an empty ActionWait (default 1000 ms). Busy links
+*					are measured by the replies to their own commands.
+*					0 stops the probes. A new interval applies from the next
+*					probe on.
+*
+*PARAMETERS
+*IN: int			_ms				- Idle time before a probe (ms)
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetClockProbeInterval(int _ms);
+
+/****************************************************************************
+*STRUCT: TdkClockSync
+*DESCRIPTION		Link timing of a device, from the round trips of the
+*					last 32 frames that had the link to themselves. The
+*					latency, host write to controller, is half the median
+*					round trip and the jitter half their interquartile
+*					range. All zero until the first reply.
+*****************************************************************************/
+typedef struct TdkClockSync
+{
+	unsigned long long samples;	// round trips measured since Connect
+	int latencyUs;
+	int jitterUs;
+	int minRoundTripUs;
+} TdkClockSync;
+
+/****************************************************************************
+*FUNCTION: GetClockSync
+*DESCRIPTION		Copies the link timing estimate of a device.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device to query
+*OUT: TdkClockSync* _sync			- Filled on success
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int GetClockSync(int _deviceID, TdkClockSync* _sync);
+
+/****************************************************************************
+*FUNCTION: SetTelemetryInterval
+*DESCRIPTION		Sets how often every device's battery level is read and a
+*					self test run in the background (defaults 5000 ms and
+*					0), 0 meaning never. Firmware and the segment list are
+*					read once after Connect. Queries are only sent while
+*					nothing else waits for the link, and a self test only
+*					after a second without writes. Their replies are decoded
+*					into GetTelemetry and do not reach the data callback.
+*
+*PARAMETERS
+*IN: int			_batteryMs		- Between battery readings (ms)
+*IN: int			_selfTestMs		- Between self tests (ms)
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetTelemetryInterval(int _batteryMs, int _selfTestMs);
+
+/****************************************************************************
+*STRUCT: TdkTelemetry
+*DESCRIPTION		The latest status replies of a device, from the
+*					background poller or from ReadBatteryLevel, ReadFW,
+*					TactorSelfTest and ReadSegmentList. While a self test
+*					runs other commands are held instead of being NAK'd
+*					(0x14), for up to 10 s.
+*****************************************************************************/
+typedef struct TdkTelemetry
+{
+	long long batteryUs;		// GetTdkTimeUs when it arrived, 0 until then
+	long long selfTestUs;		// GetTdkTimeUs when it reported, 0 until then
+	int battery;				// -1 until read
+	int selfTest;				// result byte, 0 passed; -1 until one reported
+	int selfTestRunning;
+	int segmentCount;			// -1 until read
+	int firmwareLength;			// bytes in firmware, 0 until read
+	unsigned int replies;		// status replies since Connect
+	unsigned char firmware[8];
+	unsigned char segmentSizes[16];
+} TdkTelemetry;
+
+/****************************************************************************
+*FUNCTION: GetTelemetry
+*DESCRIPTION		Copies the status of a device. Takes no lock and sends
+*					nothing, so it can be called every frame.
+*
+*PARAMETERS
+*IN: int			_deviceID		- Device to query
+*OUT: TdkTelemetry* _telemetry		- Filled on success
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int GetTelemetry(int _deviceID, TdkTelemetry* _telemetry);
+
+#define TDK_PRIORITY_HIGH			0	// hit feedback; never waits behind the others
+#define TDK_PRIORITY_NORMAL			1	// default
+#define TDK_PRIORITY_LOW			2	// ambient; timeline releases and uploads
+#define TDK_PRIORITY_CLASSES		3
+
+/****************************************************************************
+*FUNCTION: SetSendPriority
+*DESCRIPTION		Sets the priority class of every command the calling
+*					thread sends from now on, to any device. Each class has
+*					its own queue per device. The I/O thread writes high
+*					priority commands first, ahead of lower class commands
+*					still queued or held back for the controller's lists.
+*					Only the rest of a batch already partly written stays
+*					ahead. Timeline releases and stored TAction uploads are
+*					always TDK_PRIORITY_LOW.
+*
+*PARAMETERS
+*IN: int			_priority		- TDK_PRIORITY_*
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetSendPriority(int _priority);
+
+/****************************************************************************
+*FUNCTION: SetPriorityPreemption
+*DESCRIPTION		When enabled (default off), a high priority command that
+*					finds low priority commands still pending on the
+*					controller's lists is sent behind a Stop that clears
+*					them. The controller's Stop covers every tactor and
+*					every priority class, so it is only sent while those
+*					are all that may still be pending. A command of another
+*					class, or one sent with PulseAt or from a timeline,
+*					that may still be waiting or running leaves the high
+*					priority command to queue behind instead.
+*
+*PARAMETERS
+*IN: int			_enabled		- 1 to preempt, 0 to queue behind
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int SetPriorityPreemption(int _enabled);
+
+/****************************************************************************
+*STRUCT: TdkPriorityStats
+*DESCRIPTION		Counters of a device per priority class, since it
+*					connected. The histograms are binned like those of
+*					TdkStats. queueLatencyUs runs from the command function
+*					returning to the write, replyLatencyUs from the command
+*					function returning to the controller's ACK.
+*****************************************************************************/
+typedef struct TdkPriorityStats
+{
+	unsigned long long preemptions;		// Stops sent ahead of a high priority command
+	unsigned long long written[TDK_PRIORITY_CLASSES];
+	unsigned int queueLatencyUs[TDK_PRIORITY_CLASSES][TDK_STATS_LATENCY_BUCKETS];
+	unsigned int replyLatencyUs[TDK_PRIORITY_CLASSES][TDK_STATS_LATENCY_BUCKETS];
+} TdkPriorityStats;
+
+/****************************************************************************
+*FUNCTION: GetPriorityStats
+*DESCRIPTION		Copies the per class counters and latency histograms of a
+*					device.
+*
+*PARAMETERS
+*IN: int				_deviceID		- Device to query
+*OUT: TdkPriorityStats*	_stats			- Filled on success
+*
+*RETURNS:
+*			on success:		value(0)
+*			on failure:		value(-1) check GetLastEAIError() for Error Code
+*****************************************************************************/
+EXPORTtactionInterface
+int GetPriorityStats(int _deviceID, TdkPriorityStats* _stats);
 #endif
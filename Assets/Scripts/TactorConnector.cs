@@ -5,6 +5,7 @@ using Tdk;
 public class TactorConnector : MonoBehaviour
 {
     private int connectedBoardId = -1;
+    private bool batchingSupported = true; // Cleared when the loaded TactorInterface does not export BeginBatch (e.g. the prebuilt Windows DLL).
     [SerializeField] private int delay = 0; // Delay before vibration starts after command is received (e.g. delay can be different for each tactor)
     [SerializeField] private int pulseDuration = 250; // Duration of vibration when a pulse is sent
 
@@ -149,6 +150,25 @@ public class TactorConnector : MonoBehaviour
         }
     }
 
+    void BeginFeedbackBatch() // Queues the following commands natively so all tactors are updated by a single write
+    {
+        if (!batchingSupported) return;
+        try
+        {
+            CheckError(TdkInterface.BeginBatch(connectedBoardId));
+        }
+        catch (EntryPointNotFoundException)
+        {
+            batchingSupported = false;
+        }
+    }
+
+    void CommitFeedbackBatch() // Sends everything queued since BeginFeedbackBatch
+    {
+        if (!batchingSupported) return;
+        CheckError(TdkInterface.CommitBatch(connectedBoardId));
+    }
+
     void ApplySettingsToTactor(int tactorID, int gain, int frequency) // Applies gain and frequency settings to the specified tactor
     {
         Debug.Log($"[Tactor {tactorID}] Setting Gain: {gain}, Freq: {frequency}");
@@ -198,49 +218,73 @@ public class TactorConnector : MonoBehaviour
     public void TriggerGraspingStateFeedback()
     {
         // Change values here to match our intended tactile feedback
-        ApplySettingsToTactor(1, gain1, frequency1);
-        ApplySettingsToTactor(2, gain2, frequency2);
-        ApplySettingsToTactor(2, gain2, frequency3);
-        ApplySettingsToTactor(2, gain2, frequency4);
-        ApplySettingsToTactor(2, gain2, frequency5);
-
-        TdkInterface.Pulse(connectedBoardId, 1, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 2, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 3, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 4, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 5, 250, 0);
+        BeginFeedbackBatch();
+        try
+        {
+            ApplySettingsToTactor(1, gain1, frequency1);
+            ApplySettingsToTactor(2, gain2, frequency2);
+            ApplySettingsToTactor(2, gain2, frequency3);
+            ApplySettingsToTactor(2, gain2, frequency4);
+            ApplySettingsToTactor(2, gain2, frequency5);
+
+            TdkInterface.Pulse(connectedBoardId, 1, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 2, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 3, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 4, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 5, 250, 0);
+        }
+        finally
+        {
+            CommitFeedbackBatch(); // An open batch would refuse every later BeginBatch
+        }
     }
 
     public void TriggerPinchingStateFeedback()
     {
         // Change values here to match our intended tactile feedback
-        ApplySettingsToTactor(1, gain1, frequency1);
-        ApplySettingsToTactor(2, gain2, frequency2);
-        ApplySettingsToTactor(2, gain2, frequency3);
-        ApplySettingsToTactor(2, gain2, frequency4);
-        ApplySettingsToTactor(2, gain2, frequency5);
-
-        TdkInterface.Pulse(connectedBoardId, 1, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 2, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 3, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 4, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 5, 250, 0);
+        BeginFeedbackBatch();
+        try
+        {
+            ApplySettingsToTactor(1, gain1, frequency1);
+            ApplySettingsToTactor(2, gain2, frequency2);
+            ApplySettingsToTactor(2, gain2, frequency3);
+            ApplySettingsToTactor(2, gain2, frequency4);
+            ApplySettingsToTactor(2, gain2, frequency5);
+
+            TdkInterface.Pulse(connectedBoardId, 1, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 2, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 3, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 4, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 5, 250, 0);
+        }
+        finally
+        {
+            CommitFeedbackBatch(); // An open batch would refuse every later BeginBatch
+        }
     }
 
     public void TriggerDefaultStateFeedback()
     {
         // Change values here to match our intended tactile feedback
-        ApplySettingsToTactor(1, gain1, frequency1);
-        ApplySettingsToTactor(2, gain2, frequency2);
-        ApplySettingsToTactor(2, gain2, frequency3);
-        ApplySettingsToTactor(2, gain2, frequency4);
-        ApplySettingsToTactor(2, gain2, frequency5);
-
-        TdkInterface.Pulse(connectedBoardId, 1, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 2, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 3, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 4, 250, 0);
-        TdkInterface.Pulse(connectedBoardId, 5, 250, 0);
+        BeginFeedbackBatch();
+        try
+        {
+            ApplySettingsToTactor(1, gain1, frequency1);
+            ApplySettingsToTactor(2, gain2, frequency2);
+            ApplySettingsToTactor(2, gain2, frequency3);
+            ApplySettingsToTactor(2, gain2, frequency4);
+            ApplySettingsToTactor(2, gain2, frequency5);
+
+            TdkInterface.Pulse(connectedBoardId, 1, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 2, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 3, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 4, 250, 0);
+            TdkInterface.Pulse(connectedBoardId, 5, 250, 0);
+        }
+        finally
+        {
+            CommitFeedbackBatch(); // An open batch would refuse every later BeginBatch
+        }
     }
 
     // In case we need to trigger tactors based on some variable at runtime.
@@ -264,16 +308,24 @@ public class TactorConnector : MonoBehaviour
         pulseduration = Mathf.Clamp(pulseduration, 1, 1000);
         pulsedelay = Mathf.Clamp(pulsedelay, 0, 1000);
 
-        ApplySettingsToTactor(1, tactor1Gain, tactor1Freq);
-        ApplySettingsToTactor(2, tactor2Gain, tactor2Freq);
-        ApplySettingsToTactor(2, tactor3Gain, tactor3Freq);
-        ApplySettingsToTactor(2, tactor4Gain, tactor4Freq);
-        ApplySettingsToTactor(2, tactor5Gain, tactor5Freq);
-
-        TdkInterface.Pulse(connectedBoardId, 1, pulseduration, pulsedelay);
-        TdkInterface.Pulse(connectedBoardId, 2, pulseduration, pulsedelay);
-        TdkInterface.Pulse(connectedBoardId, 3, pulseduration, pulsedelay);
-        TdkInterface.Pulse(connectedBoardId, 4, pulseduration, pulsedelay);
-        TdkInterface.Pulse(connectedBoardId, 5, pulseduration, pulsedelay);
+        BeginFeedbackBatch();
+        try
+        {
+            ApplySettingsToTactor(1, tactor1Gain, tactor1Freq);
+            ApplySettingsToTactor(2, tactor2Gain, tactor2Freq);
+            ApplySettingsToTactor(2, tactor3Gain, tactor3Freq);
+            ApplySettingsToTactor(2, tactor4Gain, tactor4Freq);
+            ApplySettingsToTactor(2, tactor5Gain, tactor5Freq);
+
+            TdkInterface.Pulse(connectedBoardId, 1, pulseduration, pulsedelay);
+            TdkInterface.Pulse(connectedBoardId, 2, pulseduration, pulsedelay);
+            TdkInterface.Pulse(connectedBoardId, 3, pulseduration, pulsedelay);
+            TdkInterface.Pulse(connectedBoardId, 4, pulseduration, pulsedelay);
+            TdkInterface.Pulse(connectedBoardId, 5, pulseduration, pulsedelay);
+        }
+        finally
+        {
+            CommitFeedbackBatch(); // An open batch would refuse every later BeginBatch
+        }
     }
 }
@@ -4,6 +4,103 @@ using System;
 
 namespace Tdk
 {
+	// Mirrors TdkCompletion in TactorInterface.h (native Linux TactorInterface only).
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TdkCompletion
+	{
+		public int deviceID;
+		public int token;
+		public int status;
+		public int detail;
+		public uint roundTripUs;
+	}
+
+	// Mirrors TdkStats in TactorInterface.h (native Linux TactorInterface only).
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TdkStats
+	{
+		public ulong submitted;
+		public ulong written;
+		public ulong writes;
+		public ulong bytesWritten;
+		public ulong acks;
+		public ulong naks;
+		public ulong timeouts;
+		[MarshalAs(UnmanagedType.ByValArray, SizeConst = 32)]
+		public ulong[] naksByReason;
+		[MarshalAs(UnmanagedType.ByValArray, SizeConst = 256)]
+		public ulong[] submittedByOpcode;
+		[MarshalAs(UnmanagedType.ByValArray, SizeConst = 256)]
+		public ulong[] writtenByOpcode;
+		[MarshalAs(UnmanagedType.ByValArray, SizeConst = 24)]
+		public uint[] queueLatencyUs;
+		[MarshalAs(UnmanagedType.ByValArray, SizeConst = 24)]
+		public uint[] ackLatencyUs;
+	}
+
+	// Mirrors TdkStreamStats in TactorInterface.h (native Linux TactorInterface only).
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TdkStreamStats
+	{
+		public ulong updates;
+		public ulong superseded;
+		public ulong sent;
+		public ulong resent;
+		public ulong flushes;
+	}
+
+	// Mirrors TdkContact in TactorInterface.h (native Linux TactorInterface only).
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TdkContact
+	{
+		public float x;
+		public float y;
+		public float z;
+		public float intensity;
+	}
+
+	// Mirrors TdkClockSync in TactorInterface.h (native Linux TactorInterface only).
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TdkClockSync
+	{
+		public ulong samples;
+		public int latencyUs;
+		public int jitterUs;
+		public int minRoundTripUs;
+	}
+
+	// Mirrors TdkTelemetry in TactorInterface.h (native Linux TactorInterface only).
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TdkTelemetry
+	{
+		public long batteryUs;
+		public long selfTestUs;
+		public int battery;
+		public int selfTest;
+		public int selfTestRunning;
+		public int segmentCount;
+		public int firmwareLength;
+		public uint replies;
+		[MarshalAs(UnmanagedType.ByValArray, SizeConst = 8)]
+		public byte[] firmware;
+		[MarshalAs(UnmanagedType.ByValArray, SizeConst = 16)]
+		public byte[] segmentSizes;
+	}
+
+	// Mirrors TdkPriorityStats in TactorInterface.h (native Linux TactorInterface only).
+	// The histograms are flattened: entry [class * 24 + bucket].
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TdkPriorityStats
+	{
+		public ulong preemptions;
+		[MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+		public ulong[] written;
+		[MarshalAs(UnmanagedType.ByValArray, SizeConst = 72)]
+		public uint[] queueLatencyUs;
+		[MarshalAs(UnmanagedType.ByValArray, SizeConst = 72)]
+		public uint[] replyLatencyUs;
+	}
+
 #if UNITY_ANDROID
 	public static class TdkInterfacePinvoke
 #else
@@ -81,6 +178,10 @@ namespace Tdk
 		
 		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
 		public static extern int LoadTActionDatabase([MarshalAs(UnmanagedType.LPStr)] string file);
+
+		// Native Linux TactorInterface only: maps a bundle compiled by tactionc.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int LoadTActionBundle([MarshalAs(UnmanagedType.LPStr)] string file);
 		
 		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
 		public static extern IntPtr GetTActionName(int id);
@@ -105,7 +206,155 @@ namespace Tdk
 
 		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
 		public static extern int SetTactorType(int deviceID, int _delay, int tactor, int type);
-		
+
+		// Native Linux TactorInterface only: queue commands and send them in one write.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int BeginBatch(int deviceID);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int CommitBatch(int deviceID);
+
+		// Native Linux TactorInterface only: drop commands queued longer than ms (0 = never).
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetMaxQueueLatency(int ms);
+
+		// Native Linux TactorInterface only: commands that return a completion token.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int PulseAsync(int deviceID, int tacNum, int msDuration, int delay);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int RampGainAsync(int deviceID, int tacNum, int gainStart, int gainEnd, int duration, int func, int delay);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int PollCompletion(out TdkCompletion completion);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int GetDroppedCompletions();
+
+		// Native Linux TactorInterface only: record commands at offsets, then let the
+		// controller's action delays play them on time.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int BeginTimeline(int deviceID);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetTimelineOffset(int deviceID, int msOffset);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int PlayTimeline(int deviceID, int delay);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int CancelTimeline(int deviceID);
+
+		// Native Linux TactorInterface only: controller list sizes used to hold commands
+		// back instead of overflowing (0 = not enforced).
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetControllerLimits(int deviceID, int actionList, int rampList, int busSlots);
+
+		// Native Linux TactorInterface only: the returned ID addresses every member at once.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int CreateDeviceGroup(int[] deviceIDs, int count);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int DestroyDeviceGroup(int groupID);
+
+		// Native Linux TactorInterface only: whether Discover tries the last connected device first.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetDiscoveryCache(bool enabled);
+
+		// Native Linux TactorInterface only: per-device counters and latency histograms.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int GetTdkStats(int deviceID, out TdkStats stats);
+
+		// Native Linux TactorInterface only: binary trace of every frame, decoded by tdktrace.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int StartWireTrace([MarshalAs(UnmanagedType.LPStr)]string path, int records);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int StopWireTrace();
+
+		// Native Linux TactorInterface only: envelopes sent as the fewest linear ramps within
+		// maxError; the curves take TdkDefines.Curve values.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int RampGainCurve(int deviceID, int tacNum, int[] values, int count, int msStep, int maxError, int delay);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int RampFreqCurve(int deviceID, int tacNum, int[] values, int count, int msStep, int maxError, int delay);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int RampGainEased(int deviceID, int tacNum, int gainStart, int gainEnd, int duration, int curve, int maxError, int delay);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int RampFreqEased(int deviceID, int tacNum, int freqStart, int freqEnd, int duration, int curve, int maxError, int delay);
+
+		// Native Linux TactorInterface only: latest-value-wins gain and frequency channels,
+		// flushed at most SetStreamRate times a second.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int StreamGain(int deviceID, int tacNum, int gainVal);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int StreamFreq(int deviceID, int tacNum, int freqVal);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetStreamRate(int hz);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int GetStreamStats(int deviceID, out TdkStreamStats stats);
+
+		// Native Linux TactorInterface only: one intensity per tactor (0 = off); sends only
+		// the gains and on/off mask that changed since the last frame.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetTactorFrame(int deviceID, int delay, byte[] intensities, int count);
+
+		// Native Linux TactorInterface only: places a tactor for RenderContacts, which
+		// spreads each contact point over the tactors around it and sends the frame.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetTactorPosition(int deviceID, int segment, int offset, float x, float y, float z);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int ClearTactorPositions(int deviceID);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetContactRadius(int deviceID, float radius);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int RenderContacts(int deviceID, int delay, TdkContact[] contacts, int count);
+
+		// Native Linux TactorInterface only: commands timed in host microseconds
+		// (GetTdkTimeUs), less the link latency measured in the background.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern long GetTdkTimeUs();
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int PulseAt(int deviceID, int tacNum, int msDuration, long atUs);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int PlayTimelineAt(int deviceID, long atUs);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetClockProbeInterval(int ms);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int GetClockSync(int deviceID, out TdkClockSync sync);
+
+		// Native Linux TactorInterface only: battery, firmware, self test and segment
+		// list polled in the link's idle gaps; GetTelemetry takes no lock.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetTelemetryInterval(int batteryMs, int selfTestMs);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int GetTelemetry(int deviceID, out TdkTelemetry telemetry);
+
+		// Native Linux TactorInterface only: priority class of the calling thread's
+		// commands (TdkDefines.Priority), and optional Stop ahead of high priority ones.
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetSendPriority(int priority);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int SetPriorityPreemption(int enabled);
+
+		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
+		public static extern int GetPriorityStats(int deviceID, out TdkPriorityStats stats);
+
 		[DllImport("TactorInterface", CharSet = CharSet.Ansi, SetLastError = true)]
 		public static extern int WriteToBoard(int deviceID, byte[] data, int data_length);
 			
@@ -189,6 +438,24 @@ namespace Tdk
 		// pulled from EAI_Defines.h
 		public static readonly int RampLinear = 0x01;
 
+		// TDK_CURVE_* of TactorInterface.h (native Linux TactorInterface only)
+		public enum Curve
+		{
+			Linear = 0x01,
+			EaseIn = 0x02,
+			EaseOut = 0x03,
+			EaseInOut = 0x04,
+			Exponential = 0x05
+		}
+
+		// TDK_PRIORITY_* of TactorInterface.h (native Linux TactorInterface only)
+		public enum Priority
+		{
+			High = 0,
+			Normal = 1,
+			Low = 2
+		}
+
 		// pulled from EAI_Defines.h
 		public enum TactorTypes
 		{
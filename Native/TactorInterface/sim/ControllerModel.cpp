@@ -0,0 +1,408 @@
+#include "ControllerModel.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace tdk
+{
+
+namespace
+{
+
+const int kMilliampsPerActiveTactor = 40;
+
+bool HasTactorArg(uint8_t command)
+{
+	switch (command)
+	{
+	case TDK_COMMAND_PULSE:
+	case TDK_COMMAND_GAIN:
+	case TDK_COMMAND_FREQ:
+	case TDK_COMMAND_SETSIGSOURCE:
+	case TDK_COMMAND_SET_TACTOR_TYPE:
+	case TDK_COMMAND_RAMP:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool IsQuery(uint8_t command)
+{
+	return command == TDK_COMMAND_READFW || command == TDK_COMMAND_READ_BAT_DATA
+		|| command == TDK_COMMAND_GETSEGMENTLIST || command == TDK_COMMAND_READ_CURRENT;
+}
+
+int GetU16(const uint8_t* p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+int64_t UnitsToUs(int units, int timeFactor)
+{
+	return static_cast<int64_t>(units) * timeFactor * 1000;
+}
+
+} // namespace
+
+void ReplyBuffer::Append(uint8_t type, const uint8_t* payload, size_t length)
+{
+	uint8_t frame[kMaxFrameSize];
+	size_t size = EncodeFrame(type, payload, length, frame, sizeof(frame));
+	m_bytes.insert(m_bytes.end(), frame, frame + size);
+}
+
+ControllerModel::ControllerModel(const ControllerConfig& config)
+	: m_config(config)
+	, m_tactors(static_cast<size_t>(std::max(1, std::min(config.tactorCount, kMaxTactors))))
+	, m_recordingSlot(0)
+	, m_selfTestUntilUs(0)
+	, m_selfTestReported(true)
+{
+	m_config.tactorCount = static_cast<int>(m_tactors.size());
+	m_pending.reserve(static_cast<size_t>(m_config.actionListCapacity));
+	m_ramps.reserve(static_cast<size_t>(m_config.rampListCapacity));
+}
+
+void ControllerModel::Nak(uint8_t reason, ReplyBuffer& out)
+{
+	++m_stats.naks;
+	++m_stats.naksByReason[reason];
+	out.Append(kFrameTypeNak, &reason, 1);
+}
+
+void ControllerModel::HandleCorruptFrame(uint8_t reason, ReplyBuffer& out)
+{
+	++m_stats.framesReceived;
+	Nak(reason, out);
+}
+
+void ControllerModel::HandleFrame(uint8_t type, const uint8_t* payload, size_t length, int64_t nowUs, ReplyBuffer& out)
+{
+	++m_stats.framesReceived;
+	Advance(nowUs, out);
+
+	if (type != kFrameTypeActionList)
+		return Nak(kNakInvalidCommand, out);
+	if (length > kMaxPayload)
+		return Nak(kNakPacketTooLarge, out);
+	if (length < 1)
+		return Nak(kNakInsufficientData, out);
+
+	int timeFactor = payload[0];
+	if (timeFactor == 0)
+		return Nak(kNakInvalidData, out);
+
+	Action actions[kMaxPayload / 2];
+	size_t count = 0;
+	for (size_t offset = 1; offset < length; )
+	{
+		if (length - offset < 2)
+			return Nak(kNakInsufficientData, out);
+
+		Action& action = actions[count++];
+		action.delay = payload[offset];
+		action.command = payload[offset + 1];
+		int argLength = CommandArgLength(action.command);
+		if (argLength < 0)
+			return Nak(kNakInvalidCommand, out);
+		if (offset + 2 + static_cast<size_t>(argLength) > length)
+			return Nak(kNakInsufficientData, out);
+
+		action.argLength = static_cast<uint8_t>(argLength);
+		memcpy(action.args, payload + offset + 2, static_cast<size_t>(argLength));
+		offset += action.EncodedSize();
+	}
+
+	if (nowUs < m_selfTestUntilUs)
+		return Nak(kNakSelfTestRunning, out);
+	if (uint8_t reason = Validate(actions, count))
+		return Nak(reason, out);
+
+	++m_stats.acks;
+	out.Append(kFrameTypeAck, nullptr, 0);
+
+	int64_t offsetUs = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Action& action = actions[i];
+		if (m_recordingSlot != 0)
+		{
+			if (action.command == TDK_COMMAND_TACTION_END)
+				m_recordingSlot = 0;
+			else
+				m_stored[m_recordingSlot - 1].push_back(action);
+			continue;
+		}
+
+		int64_t dueUs = nowUs + offsetUs + UnitsToUs(action.delay, timeFactor);
+		switch (action.command)
+		{
+		case TDK_COMMAND_ACTION_WAIT:
+			offsetUs += UnitsToUs(action.delay + action.args[0], timeFactor);
+			break;
+		case TDK_COMMAND_TACTION_START:
+			m_recordingSlot = action.args[0];
+			m_stored[m_recordingSlot - 1].clear();
+			break;
+		case TDK_COMMAND_TACTION_END:
+			break;
+		case TDK_COMMAND_TACTION_PLAY:
+			for (const Action& stored : m_stored[action.args[0] - 1])
+				Schedule(stored, dueUs + UnitsToUs(stored.delay, timeFactor), timeFactor);
+			break;
+		default:
+			Schedule(action, dueUs, timeFactor);
+			break;
+		}
+	}
+
+	Advance(nowUs, out);
+}
+
+uint8_t ControllerModel::Validate(const Action* actions, size_t count) const
+{
+	size_t newActions = 0;
+	size_t newRamps = 0;
+	size_t immediate = 0;
+	size_t recorded = m_recordingSlot != 0 ? m_stored[m_recordingSlot - 1].size() : 0;
+	bool recording = m_recordingSlot != 0;
+	bool waited = false;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Action& action = actions[i];
+		const uint8_t* args = action.args;
+
+		if (HasTactorArg(action.command) && (args[0] < 1 || args[0] > m_config.tactorCount))
+			return kNakInvalidData;
+
+		switch (action.command)
+		{
+		case TDK_COMMAND_FREQ:
+			if (GetU16(args + 1) < MIN_ACTION_FREQUENCY || GetU16(args + 1) > kMaxFrequency)
+				return kNakInvalidData;
+			break;
+		case TDK_COMMAND_RAMP:
+			if (args[1] > kRampTargetFreq || args[7] != TDK_LINEAR_RAMP || args[6] == 0)
+				return kNakInvalidData;
+			break;
+		case TDK_COMMAND_PULSE:
+			if (args[1] == 0)
+				return kNakInvalidData;
+			break;
+		case TDK_COMMAND_TACTION_START:
+		case TDK_COMMAND_TACTION_PLAY:
+			if (args[0] < 1 || args[0] > TDK_MAX_STORED_TACTIONS)
+				return kNakInvalidData;
+			break;
+		}
+
+		if (recording)
+		{
+			if (action.command == TDK_COMMAND_TACTION_END)
+				recording = false;
+			else if (++recorded > TDK_MAX_STORED_TACTION_LENGTH)
+				return kNakActionListFull;
+			continue;
+		}
+
+		switch (action.command)
+		{
+		case TDK_COMMAND_TACTION_START:
+			recording = true;
+			recorded = 0;
+			break;
+		case TDK_COMMAND_TACTION_END:
+			break;
+		case TDK_COMMAND_ACTION_WAIT:
+			waited = true;
+			break;
+		case TDK_COMMAND_TACTION_PLAY:
+		{
+			const std::vector<Action>& stored = m_stored[args[0] - 1];
+			if (stored.empty())
+				return kNakInvalidData;
+			newActions += stored.size();
+			for (const Action& a : stored)
+				newRamps += a.command == TDK_COMMAND_RAMP ? 1 : 0;
+			break;
+		}
+		default:
+			++newActions;
+			if (action.command == TDK_COMMAND_RAMP)
+				++newRamps;
+			if (!waited && action.delay == 0)
+				++immediate;
+			break;
+		}
+	}
+
+	size_t pendingRamps = 0;
+	for (const Pending& pending : m_pending)
+		pendingRamps += pending.action.command == TDK_COMMAND_RAMP ? 1 : 0;
+
+	if (immediate > static_cast<size_t>(m_config.busSlots))
+		return kNakMasterPacketFull;
+	if (m_pending.size() + newActions > static_cast<size_t>(m_config.actionListCapacity))
+		return kNakActionListFull;
+	if (m_ramps.size() + pendingRamps + newRamps > static_cast<size_t>(m_config.rampListCapacity))
+		return kNakRampListFull;
+	return 0;
+}
+
+void ControllerModel::Schedule(const Action& action, int64_t dueUs, int timeFactor)
+{
+	Pending pending;
+	pending.dueUs = dueUs;
+	pending.timeFactor = timeFactor;
+	pending.action = action;
+	m_pending.push_back(pending);
+}
+
+void ControllerModel::Advance(int64_t nowUs, ReplyBuffer& out)
+{
+	for (;;)
+	{
+		auto next = std::min_element(m_pending.begin(), m_pending.end(),
+			[](const Pending& a, const Pending& b) { return a.dueUs < b.dueUs; });
+		if (next == m_pending.end() || next->dueUs > nowUs)
+			break;
+
+		Pending due = *next;
+		m_pending.erase(next);
+		Execute(due, out);
+	}
+
+	for (size_t i = 0; i < m_ramps.size(); )
+	{
+		const Ramp& ramp = m_ramps[i];
+		if (ramp.endUs > nowUs)
+		{
+			++i;
+			continue;
+		}
+
+		TactorState& tactor = m_tactors[ramp.tactor - 1];
+		(ramp.target == kRampTargetGain ? tactor.gain : tactor.freq) = ramp.end;
+		m_ramps.erase(m_ramps.begin() + static_cast<long>(i));
+	}
+
+	if (!m_selfTestReported && nowUs >= m_selfTestUntilUs)
+	{
+		uint8_t result[2] = { TDK_COMMAND_SELFTEST, 0x00 };
+		out.Append(kFrameTypeData, result, sizeof(result));
+		m_selfTestReported = true;
+	}
+}
+
+int64_t ControllerModel::NextDeadline() const
+{
+	int64_t next = -1;
+	auto consider = [&next](int64_t t) { if (next < 0 || t < next) next = t; };
+
+	for (const Pending& pending : m_pending)
+		consider(pending.dueUs);
+	for (const Ramp& ramp : m_ramps)
+		consider(ramp.endUs);
+	if (!m_selfTestReported)
+		consider(m_selfTestUntilUs);
+	return next;
+}
+
+void ControllerModel::Execute(const Pending& pending, ReplyBuffer& out)
+{
+	++m_stats.actionsExecuted;
+
+	const Action& action = pending.action;
+	const uint8_t* args = action.args;
+	TactorState* tactor = HasTactorArg(action.command) ? &m_tactors[args[0] - 1] : nullptr;
+
+	switch (action.command)
+	{
+	case TDK_COMMAND_STOP:
+		m_pending.clear();
+		m_ramps.clear();
+		for (TactorState& t : m_tactors)
+			t.activeUntilUs = 0;
+		break;
+	case TDK_COMMAND_PULSE:
+		tactor->activeUntilUs = pending.dueUs + UnitsToUs(args[1], pending.timeFactor);
+		break;
+	case TDK_COMMAND_GAIN:
+		tactor->gain = args[1];
+		break;
+	case TDK_COMMAND_FREQ:
+		tactor->freq = GetU16(args + 1);
+		break;
+	case TDK_COMMAND_SETSIGSOURCE:
+		tactor->sigSource = args[1];
+		break;
+	case TDK_COMMAND_SET_TACTOR_TYPE:
+		tactor->type = args[1];
+		break;
+	case TDK_COMMAND_RAMP:
+	{
+		Ramp ramp;
+		ramp.tactor = args[0];
+		ramp.target = args[1];
+		ramp.start = GetU16(args + 2);
+		ramp.end = GetU16(args + 4);
+		ramp.startUs = pending.dueUs;
+		ramp.endUs = pending.dueUs + UnitsToUs(args[6], pending.timeFactor);
+		(ramp.target == kRampTargetGain ? tactor->gain : tactor->freq) = ramp.start;
+		m_ramps.push_back(ramp);
+		break;
+	}
+	case TDK_COMMAND_SET_TACTORS:
+		for (int t = 0; t < m_config.tactorCount; ++t)
+		{
+			bool on = (args[t / 8] >> (t % 8)) & 1;
+			m_tactors[t].activeUntilUs = on ? INT64_MAX : 0;
+		}
+		break;
+	case TDK_COMMAND_SELFTEST:
+		m_selfTestUntilUs = pending.dueUs + static_cast<int64_t>(m_config.selfTestMs) * 1000;
+		m_selfTestReported = false;
+		break;
+	default:
+		if (IsQuery(action.command))
+		{
+			int active = 0;
+			for (const TactorState& t : m_tactors)
+				active += t.activeUntilUs > pending.dueUs ? 1 : 0;
+
+			uint8_t reply[8] = { action.command };
+			size_t length = 1;
+			switch (action.command)
+			{
+			case TDK_COMMAND_READFW:
+				memcpy(reply + 1, m_config.firmware, 3);
+				length = 4;
+				break;
+			case TDK_COMMAND_READ_BAT_DATA:
+				reply[1] = static_cast<uint8_t>(m_config.batteryLevel);
+				length = 2;
+				break;
+			case TDK_COMMAND_GETSEGMENTLIST:
+				reply[1] = 1;
+				reply[2] = static_cast<uint8_t>(m_config.tactorCount);
+				length = 3;
+				break;
+			case TDK_COMMAND_READ_CURRENT:
+			{
+				int milliamps = active * kMilliampsPerActiveTactor;
+				reply[1] = static_cast<uint8_t>(milliamps >> 8);
+				reply[2] = static_cast<uint8_t>(milliamps);
+				length = 3;
+				break;
+			}
+			}
+			out.Append(kFrameTypeData, reply, length);
+		}
+		break;
+	}
+}
+
+} // namespace tdk
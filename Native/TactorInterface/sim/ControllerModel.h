@@ -0,0 +1,117 @@
+/************************************************************************
+*                                                                       *
+*   ControllerModel.h -- behavioural model of an EAI tactor controller  *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_CONTROLLERMODEL_H_
+#define TDK_CONTROLLERMODEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Protocol.h"
+
+namespace tdk
+{
+
+struct ControllerConfig
+{
+	int tactorCount = 8;
+	int actionListCapacity = 32;	// pending actions before NAK 0x0E
+	int rampListCapacity = 8;		// concurrent ramps before NAK 0x0D
+	int busSlots = 16;				// actions one frame may start at once before NAK 0x10
+	int selfTestMs = 500;
+	int batteryLevel = 87;
+	uint8_t firmware[3] = { 1, 0, 0 };
+};
+
+struct TactorState
+{
+	int gain = 0;
+	int freq = 250;
+	int sigSource = TDK_SIG_SRC_PRIMARY;
+	int type = TDK_TACTOR_TYPE_C3;
+	int64_t activeUntilUs = 0;
+};
+
+struct ControllerStats
+{
+	uint64_t framesReceived = 0;
+	uint64_t actionsExecuted = 0;
+	uint64_t acks = 0;
+	uint64_t naks = 0;
+	uint64_t naksByReason[0x100] = {};
+};
+
+// Reply frames produced while handling input, drained by the link layer.
+class ReplyBuffer
+{
+public:
+	void Append(uint8_t type, const uint8_t* payload, size_t length);
+	const std::vector<uint8_t>& Bytes() const { return m_bytes; }
+	void Clear() { m_bytes.clear(); }
+
+private:
+	std::vector<uint8_t> m_bytes;
+};
+
+// Decodes action list frames, keeps per-tactor gain/frequency/ramp state and
+// answers with ACK, NAK or data frames the way the hardware does. Time is
+// passed in explicitly so the model is deterministic.
+class ControllerModel
+{
+public:
+	explicit ControllerModel(const ControllerConfig& config);
+
+	void HandleFrame(uint8_t type, const uint8_t* payload, size_t length, int64_t nowUs, ReplyBuffer& out);
+	void HandleCorruptFrame(uint8_t reason, ReplyBuffer& out);
+
+	// Runs every action due by nowUs and retires finished ramps.
+	void Advance(int64_t nowUs, ReplyBuffer& out);
+	// Earliest time Advance has work to do, or -1.
+	int64_t NextDeadline() const;
+
+	const TactorState& Tactor(int tactor) const { return m_tactors[tactor - 1]; }
+	const ControllerStats& Stats() const { return m_stats; }
+	size_t PendingActions() const { return m_pending.size(); }
+	size_t ActiveRamps() const { return m_ramps.size(); }
+
+private:
+	struct Pending
+	{
+		int64_t dueUs;
+		int timeFactor;
+		Action action;
+	};
+
+	struct Ramp
+	{
+		int tactor;
+		uint8_t target;
+		int start;
+		int end;
+		int64_t startUs;
+		int64_t endUs;
+	};
+
+	uint8_t Validate(const Action* actions, size_t count) const;
+	void Schedule(const Action& action, int64_t dueUs, int timeFactor);
+	void Execute(const Pending& pending, ReplyBuffer& out);
+	void Nak(uint8_t reason, ReplyBuffer& out);
+
+	ControllerConfig m_config;
+	ControllerStats m_stats;
+	std::vector<TactorState> m_tactors;
+	std::vector<Pending> m_pending;
+	std::vector<Ramp> m_ramps;
+	std::vector<Action> m_stored[TDK_MAX_STORED_TACTIONS];
+	int m_recordingSlot;
+	int64_t m_selfTestUntilUs;
+	bool m_selfTestReported;
+};
+
+} // namespace tdk
+
+#endif
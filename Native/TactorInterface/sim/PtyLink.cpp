@@ -0,0 +1,218 @@
+#include "PtyLink.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace tdk
+{
+
+namespace
+{
+
+const int kIdlePollMs = 100;
+
+} // namespace
+
+PtyLink::PtyLink(const ControllerConfig& controller, const LinkConfig& link)
+	: m_model(controller)
+	, m_link(link)
+	, m_outboundSent(0)
+	, m_rxFreeUs(0)
+	, m_txFreeUs(0)
+	, m_noise(0x2545F491u)
+	, m_corrupted(0)
+	, m_master(-1)
+	, m_slave(-1)
+{
+	m_slavePath[0] = '\0';
+}
+
+PtyLink::~PtyLink()
+{
+	if (m_slave >= 0)
+		close(m_slave);
+	if (m_master >= 0)
+		close(m_master);
+}
+
+int64_t PtyLink::NowUs()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+int PtyLink::Open()
+{
+	m_master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (m_master < 0)
+		return errno;
+	if (grantpt(m_master) != 0 || unlockpt(m_master) != 0)
+		return errno;
+	if (ptsname_r(m_master, m_slavePath, sizeof(m_slavePath)) != 0)
+		return errno;
+
+	// Holding the slave open keeps the master readable across host reconnects.
+	m_slave = open(m_slavePath, O_RDWR | O_NOCTTY);
+	if (m_slave < 0)
+		return errno;
+
+	termios tio;
+	tcgetattr(m_slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(m_slave, TCSANOW, &tio);
+
+	fcntl(m_master, F_SETFL, fcntl(m_master, F_GETFL) | O_NONBLOCK);
+	return 0;
+}
+
+int64_t PtyLink::WireTimeUs(size_t bytes) const
+{
+	if (m_link.baudRate <= 0)
+		return 0;
+	return static_cast<int64_t>(bytes) * 10 * 1000000 / m_link.baudRate;
+}
+
+void PtyLink::ReadInput(int64_t nowUs)
+{
+	uint8_t buffer[512];
+	for (;;)
+	{
+		ssize_t n = read(m_master, buffer, sizeof(buffer));
+		if (n <= 0)
+			return;
+
+		for (ssize_t i = 0; i < n; ++i)
+		{
+			FrameParser::Result result = m_parser.Push(buffer[i]);
+			if (result == FrameParser::kNeedMore)
+				continue;
+
+			Inbound frame;
+			frame.type = m_parser.Type();
+			frame.nakReason = 0;
+			if (result == FrameParser::kBadEtx)
+				frame.nakReason = kNakBadEtx;
+			else if (result == FrameParser::kBadChecksum)
+				frame.nakReason = kNakBadChecksum;
+			else
+				frame.payload.assign(m_parser.Payload(), m_parser.Payload() + m_parser.Length());
+
+			// The controller handles one frame at a time once it is fully clocked in.
+			int64_t start = std::max(m_rxFreeUs, nowUs);
+			frame.readyUs = start + WireTimeUs(m_parser.Length() + kFrameOverhead) + m_link.processingDelayUs;
+			m_rxFreeUs = frame.readyUs;
+			m_inbound.push_back(std::move(frame));
+		}
+	}
+}
+
+void PtyLink::ProcessDue(int64_t nowUs)
+{
+	while (!m_inbound.empty() && m_inbound.front().readyUs <= nowUs)
+	{
+		const Inbound& frame = m_inbound.front();
+		if (frame.nakReason != 0)
+			m_model.HandleCorruptFrame(frame.nakReason, m_replies);
+		else
+			m_model.HandleFrame(frame.type, frame.payload.data(), frame.payload.size(), frame.readyUs, m_replies);
+		m_inbound.pop_front();
+	}
+
+	m_model.Advance(nowUs, m_replies);
+	if (!m_replies.Bytes().empty())
+	{
+		Queue(m_replies.Bytes(), nowUs);
+		m_replies.Clear();
+	}
+}
+
+void PtyLink::Queue(const std::vector<uint8_t>& bytes, int64_t nowUs)
+{
+	Outbound out;
+	out.readyUs = std::max(m_txFreeUs, nowUs) + WireTimeUs(bytes.size());
+	out.bytes = bytes;
+	if (m_link.corruptOneIn > 0)
+	{
+		for (uint8_t& byte : out.bytes)
+		{
+			m_noise ^= m_noise << 13;
+			m_noise ^= m_noise >> 17;
+			m_noise ^= m_noise << 5;
+			if (m_noise % static_cast<uint32_t>(m_link.corruptOneIn) == 0)
+			{
+				byte ^= static_cast<uint8_t>(1u << (m_noise >> 29));
+				++m_corrupted;
+			}
+		}
+	}
+	m_txFreeUs = out.readyUs;
+	m_outbound.push_back(std::move(out));
+}
+
+void PtyLink::FlushOutput(int64_t nowUs)
+{
+	while (!m_outbound.empty() && m_outbound.front().readyUs <= nowUs)
+	{
+		const std::vector<uint8_t>& bytes = m_outbound.front().bytes;
+		ssize_t n = write(m_master, bytes.data() + m_outboundSent, bytes.size() - m_outboundSent);
+		if (n <= 0)
+			return;
+
+		m_outboundSent += static_cast<size_t>(n);
+		if (m_outboundSent < bytes.size())
+			return;
+
+		m_outboundSent = 0;
+		m_outbound.pop_front();
+	}
+}
+
+int PtyLink::NextTimeoutMs(int64_t nowUs) const
+{
+	int64_t next = -1;
+	auto consider = [&next](int64_t t) { if (t >= 0 && (next < 0 || t < next)) next = t; };
+
+	if (!m_inbound.empty())
+		consider(m_inbound.front().readyUs);
+	// Output that is already due waits on POLLOUT instead.
+	if (!m_outbound.empty() && m_outbound.front().readyUs > nowUs)
+		consider(m_outbound.front().readyUs);
+	consider(m_model.NextDeadline());
+
+	if (next < 0)
+		return kIdlePollMs;
+	if (next <= nowUs)
+		return 0;
+	return static_cast<int>(std::min<int64_t>((next - nowUs + 999) / 1000, kIdlePollMs));
+}
+
+void PtyLink::Run(const std::atomic<bool>& stop)
+{
+	while (!stop.load(std::memory_order_relaxed))
+	{
+		int64_t nowUs = NowUs();
+		pollfd pfd = { m_master, POLLIN, 0 };
+		if (!m_outbound.empty() && m_outbound.front().readyUs <= nowUs)
+			pfd.events |= POLLOUT;
+
+		if (poll(&pfd, 1, NextTimeoutMs(nowUs)) < 0 && errno != EINTR)
+			return;
+
+		nowUs = NowUs();
+		if (pfd.revents & POLLIN)
+			ReadInput(nowUs);
+		ProcessDue(nowUs);
+		FlushOutput(nowUs);
+	}
+}
+
+} // namespace tdk
@@ -0,0 +1,87 @@
+/************************************************************************
+*                                                                       *
+*   PtyLink.h -- serves a ControllerModel on a pseudo-terminal          *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_PTYLINK_H_
+#define TDK_PTYLINK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "ControllerModel.h"
+#include "FrameParser.h"
+
+namespace tdk
+{
+
+struct LinkConfig
+{
+	int baudRate = 115200;		// paces both directions at 10 bits per byte
+	int processingDelayUs = 200;	// time the controller spends on each frame
+	int corruptOneIn = 0;		// flips a bit in one reply byte in this many; 0 never
+};
+
+// Owns the pty master. The slave path is what the host passes to Connect.
+class PtyLink
+{
+public:
+	PtyLink(const ControllerConfig& controller, const LinkConfig& link);
+	~PtyLink();
+
+	// Returns 0, or errno on failure.
+	int Open();
+	const char* SlavePath() const { return m_slavePath; }
+
+	// Serves the controller until stop becomes true.
+	void Run(const std::atomic<bool>& stop);
+
+	const ControllerModel& Model() const { return m_model; }
+	uint64_t CorruptedBytes() const { return m_corrupted; }
+
+	static int64_t NowUs();
+
+private:
+	struct Inbound
+	{
+		int64_t readyUs;
+		uint8_t type;
+		uint8_t nakReason;
+		std::vector<uint8_t> payload;
+	};
+
+	struct Outbound
+	{
+		int64_t readyUs;
+		std::vector<uint8_t> bytes;
+	};
+
+	int64_t WireTimeUs(size_t bytes) const;
+	void ReadInput(int64_t nowUs);
+	void ProcessDue(int64_t nowUs);
+	void Queue(const std::vector<uint8_t>& bytes, int64_t nowUs);
+	void FlushOutput(int64_t nowUs);
+	int NextTimeoutMs(int64_t nowUs) const;
+
+	ControllerModel m_model;
+	LinkConfig m_link;
+	FrameParser m_parser;
+	ReplyBuffer m_replies;
+	std::deque<Inbound> m_inbound;
+	std::deque<Outbound> m_outbound;
+	size_t m_outboundSent;
+	int64_t m_rxFreeUs;
+	int64_t m_txFreeUs;
+	uint32_t m_noise;
+	uint64_t m_corrupted;
+	int m_master;
+	int m_slave;
+	char m_slavePath[64];
+};
+
+} // namespace tdk
+
+#endif
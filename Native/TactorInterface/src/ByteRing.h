@@ -0,0 +1,97 @@
+/************************************************************************
+*                                                                       *
+*   ByteRing.h -- single-producer single-consumer byte ring             *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_BYTERING_H_
+#define TDK_BYTERING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace tdk
+{
+
+// Lock-free byte FIFO between exactly one writer thread and one reader
+// thread. Indices grow without wrapping; Capacity must be a power of two.
+template <size_t Capacity>
+class ByteRing
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+	ByteRing()
+		: m_head(0)
+		, m_tail(0)
+	{
+	}
+
+	// Writer. Copies as much as fits and returns the byte count.
+	size_t Write(const uint8_t* data, size_t length)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		size_t head = m_head.load(std::memory_order_acquire);
+		size_t space = Capacity - (tail - head);
+		if (length > space)
+			length = space;
+
+		size_t offset = tail & (Capacity - 1);
+		size_t first = length < Capacity - offset ? length : Capacity - offset;
+		memcpy(m_data + offset, data, first);
+		memcpy(m_data, data + first, length - first);
+		m_tail.store(tail + length, std::memory_order_release);
+		return length;
+	}
+
+	// Reader. Copies up to capacity bytes out and returns the byte count.
+	size_t Read(uint8_t* out, size_t capacity)
+	{
+		size_t length = Peek(out, capacity);
+		Discard(length);
+		return length;
+	}
+
+	// Reader. Copies up to capacity bytes out, leaving them in the ring.
+	size_t Peek(uint8_t* out, size_t capacity) const
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		size_t tail = m_tail.load(std::memory_order_acquire);
+		size_t length = tail - head;
+		if (length > capacity)
+			length = capacity;
+
+		size_t offset = head & (Capacity - 1);
+		size_t first = length < Capacity - offset ? length : Capacity - offset;
+		memcpy(out, m_data + offset, first);
+		memcpy(out + first, m_data, length - first);
+		return length;
+	}
+
+	// Reader. Drops length bytes, at most what Peek returned.
+	void Discard(size_t length)
+	{
+		m_head.store(m_head.load(std::memory_order_relaxed) + length, std::memory_order_release);
+	}
+
+	size_t Size() const
+	{
+		return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+	}
+
+	void Clear()
+	{
+		m_head.store(m_tail.load(std::memory_order_acquire), std::memory_order_release);
+	}
+
+private:
+	alignas(64) std::atomic<size_t> m_head;
+	alignas(64) std::atomic<size_t> m_tail;
+	uint8_t m_data[Capacity];
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,25 @@
+/************************************************************************
+*                                                                       *
+*   Clock.h -- monotonic timestamps for latency accounting              *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_CLOCK_H_
+#define TDK_CLOCK_H_
+
+#include <cstdint>
+#include <ctime>
+
+namespace tdk
+{
+
+inline int64_t MonotonicNs()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,47 @@
+#include "ClockSync.h"
+
+#include <algorithm>
+
+namespace tdk
+{
+
+ClockSync::ClockSync()
+{
+	Reset();
+}
+
+void ClockSync::Reset()
+{
+	m_count = 0;
+	m_latencyNs.store(0, std::memory_order_relaxed);
+	m_jitterNs.store(0, std::memory_order_relaxed);
+	m_minRoundTripNs.store(0, std::memory_order_relaxed);
+	m_samples.store(0, std::memory_order_relaxed);
+}
+
+void ClockSync::Sample(int64_t roundTripNs)
+{
+	uint64_t samples = m_samples.load(std::memory_order_relaxed);
+	m_ring[samples % kClockSyncSamples] = roundTripNs;
+	m_count = std::min(m_count + 1, kClockSyncSamples);
+
+	// Small enough to sort on every sample.
+	int64_t sorted[kClockSyncSamples];
+	std::copy(m_ring, m_ring + m_count, sorted);
+	std::sort(sorted, sorted + m_count);
+
+	m_latencyNs.store(sorted[m_count / 2] / 2, std::memory_order_relaxed);
+	m_jitterNs.store((sorted[m_count * 3 / 4] - sorted[m_count / 4]) / 2, std::memory_order_relaxed);
+	m_minRoundTripNs.store(sorted[0], std::memory_order_relaxed);
+	m_samples.store(samples + 1, std::memory_order_release);
+}
+
+void ClockSync::Read(ClockSyncState& out) const
+{
+	out.samples = m_samples.load(std::memory_order_acquire);
+	out.latencyNs = m_latencyNs.load(std::memory_order_relaxed);
+	out.jitterNs = m_jitterNs.load(std::memory_order_relaxed);
+	out.minRoundTripNs = m_minRoundTripNs.load(std::memory_order_relaxed);
+}
+
+} // namespace tdk
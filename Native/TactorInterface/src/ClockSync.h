@@ -0,0 +1,61 @@
+/************************************************************************
+*                                                                       *
+*   ClockSync.h -- host to controller latency from reply round trips    *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_CLOCKSYNC_H_
+#define TDK_CLOCKSYNC_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace tdk
+{
+
+// Round trips the estimate is taken over.
+const size_t kClockSyncSamples = 32;
+// How long the link may idle before it is probed; see SetClockProbeInterval.
+const int kDefaultClockProbeMs = 1000;
+
+struct ClockSyncState
+{
+	int64_t latencyNs;		// estimated host write to controller receipt
+	int64_t jitterNs;
+	int64_t minRoundTripNs;
+	uint64_t samples;		// round trips measured since connecting
+};
+
+// Estimates how long a command takes from the host's write to the
+// controller from the write-to-ACK round trips of frames that had the link
+// to themselves. The latency is half the median of the last
+// kClockSyncSamples round trips: the minimum would be the link at its best,
+// which a command usually does not get. The jitter is half their
+// interquartile range. Only the I/O thread samples; any thread may read.
+class ClockSync
+{
+public:
+	ClockSync();
+
+	void Reset();
+
+	// I/O thread.
+	void Sample(int64_t roundTripNs);
+
+	int64_t LatencyNs() const { return m_latencyNs.load(std::memory_order_relaxed); }
+	void Read(ClockSyncState& out) const;
+
+private:
+	// Written by the I/O thread.
+	int64_t m_ring[kClockSyncSamples];
+	size_t m_count;
+	std::atomic<int64_t> m_latencyNs;
+	std::atomic<int64_t> m_jitterNs;
+	std::atomic<int64_t> m_minRoundTripNs;
+	std::atomic<uint64_t> m_samples;
+};
+
+} // namespace tdk
+
+#endif
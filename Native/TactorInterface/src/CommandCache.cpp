@@ -0,0 +1,193 @@
+#include "CommandCache.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace tdk
+{
+
+CommandCache::CommandCache()
+	: m_used(0)
+	, m_head(kNone)
+	, m_tail(kNone)
+	, m_quantum(kDefaultScaleQuantum)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+	SetCapacity(kDefaultCommandCacheCapacity);
+}
+
+void CommandCache::SetCapacity(size_t capacity)
+{
+	m_entries.assign(capacity, Entry());
+
+	// Keep the index at most half full so probes stay short.
+	size_t slots = 1;
+	while (slots < capacity * 2)
+		slots <<= 1;
+	m_index.assign(slots, kNone);
+
+	m_used = 0;
+	m_head = kNone;
+	m_tail = kNone;
+	m_stats.capacity = static_cast<int>(capacity);
+	m_stats.entries = 0;
+}
+
+void CommandCache::SetQuantum(float quantum)
+{
+	m_quantum = quantum;
+	Clear();
+}
+
+void CommandCache::Clear()
+{
+	m_index.assign(m_index.size(), kNone);
+	m_used = 0;
+	m_head = kNone;
+	m_tail = kNone;
+	m_stats.entries = 0;
+}
+
+int32_t CommandCache::Quantize(float scale) const
+{
+	return static_cast<int32_t>(lroundf(scale / m_quantum));
+}
+
+uint32_t CommandCache::Hash(const CommandKey& key)
+{
+	uint32_t hash = 2166136261u;
+	const int32_t fields[] = { key.tacId, key.baseTactor, key.gain, key.freq1, key.time, key.timeFactor };
+	for (int32_t field : fields)
+	{
+		hash ^= static_cast<uint32_t>(field);
+		hash *= 16777619u;
+		hash ^= hash >> 15;
+	}
+	return hash;
+}
+
+uint32_t CommandCache::Lookup(const CommandKey& key) const
+{
+	size_t mask = m_index.size() - 1;
+	for (size_t slot = Hash(key) & mask; m_index[slot] != kNone; slot = (slot + 1) & mask)
+	{
+		if (m_entries[m_index[slot]].key == key)
+			return m_index[slot];
+	}
+	return kNone;
+}
+
+void CommandCache::IndexInsert(uint32_t entry)
+{
+	size_t mask = m_index.size() - 1;
+	size_t slot = Hash(m_entries[entry].key) & mask;
+	while (m_index[slot] != kNone)
+		slot = (slot + 1) & mask;
+	m_index[slot] = entry;
+}
+
+// Linear probing deletion without tombstones: later members of the probe
+// run are shifted back into the gap when their home slot allows it.
+void CommandCache::IndexRemove(uint32_t entry)
+{
+	size_t mask = m_index.size() - 1;
+	size_t slot = Hash(m_entries[entry].key) & mask;
+	while (m_index[slot] != entry)
+		slot = (slot + 1) & mask;
+
+	size_t gap = slot;
+	for (size_t next = (gap + 1) & mask; m_index[next] != kNone; next = (next + 1) & mask)
+	{
+		size_t home = Hash(m_entries[m_index[next]].key) & mask;
+		bool movable = gap <= next ? (home <= gap || home > next) : (home <= gap && home > next);
+		if (movable)
+		{
+			m_index[gap] = m_index[next];
+			gap = next;
+		}
+	}
+	m_index[gap] = kNone;
+}
+
+void CommandCache::Unlink(uint32_t entry)
+{
+	Entry& e = m_entries[entry];
+	if (e.prev != kNone)
+		m_entries[e.prev].next = e.next;
+	else
+		m_head = e.next;
+	if (e.next != kNone)
+		m_entries[e.next].prev = e.prev;
+	else
+		m_tail = e.prev;
+}
+
+void CommandCache::PushFront(uint32_t entry)
+{
+	Entry& e = m_entries[entry];
+	e.prev = kNone;
+	e.next = m_head;
+	if (m_head != kNone)
+		m_entries[m_head].prev = entry;
+	m_head = entry;
+	if (m_tail == kNone)
+		m_tail = entry;
+}
+
+const Command* CommandCache::Find(const CommandKey& key, size_t& count)
+{
+	uint32_t entry = m_entries.empty() ? kNone : Lookup(key);
+	if (entry == kNone)
+	{
+		++m_stats.misses;
+		return nullptr;
+	}
+
+	++m_stats.hits;
+	if (entry != m_head)
+	{
+		Unlink(entry);
+		PushFront(entry);
+	}
+	count = m_entries[entry].count;
+	return m_entries[entry].commands;
+}
+
+void CommandCache::Insert(const CommandKey& key, const Command* commands, size_t count)
+{
+	if (m_entries.empty())
+		return;
+	if (count > kMaxCachedCommands)
+	{
+		++m_stats.uncacheable;
+		return;
+	}
+
+	uint32_t entry;
+	if (m_used < m_entries.size())
+	{
+		entry = static_cast<uint32_t>(m_used++);
+	}
+	else
+	{
+		entry = m_tail;
+		IndexRemove(entry);
+		Unlink(entry);
+		++m_stats.evictions;
+	}
+
+	Entry& e = m_entries[entry];
+	e.key = key;
+	e.count = static_cast<uint32_t>(count);
+	memcpy(e.commands, commands, count * sizeof(Command));
+	IndexInsert(entry);
+	PushFront(entry);
+	m_stats.entries = static_cast<int>(m_used);
+}
+
+CommandCacheStats CommandCache::Stats() const
+{
+	return m_stats;
+}
+
+} // namespace tdk
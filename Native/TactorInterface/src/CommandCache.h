@@ -0,0 +1,107 @@
+/************************************************************************
+*                                                                       *
+*   CommandCache.h -- LRU cache of encoded TAction command sequences    *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_COMMANDCACHE_H_
+#define TDK_COMMANDCACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Protocol.h"
+
+namespace tdk
+{
+
+const size_t kDefaultCommandCacheCapacity = 64;
+const size_t kMaxCachedCommands = 64;
+const float kDefaultScaleQuantum = 1.0f / 64;
+
+// Everything the encoded commands depend on. Scale factors are stored as
+// multiples of the cache quantum, so nearby scales share one entry and the
+// commands are encoded from the quantized values.
+struct CommandKey
+{
+	int32_t tacId;
+	int32_t baseTactor;
+	int32_t gain;
+	int32_t freq1;
+	int32_t time;
+	int32_t timeFactor;
+
+	bool operator==(const CommandKey& other) const
+	{
+		return tacId == other.tacId && baseTactor == other.baseTactor && gain == other.gain
+			&& freq1 == other.freq1 && time == other.time && timeFactor == other.timeFactor;
+	}
+};
+
+struct CommandCacheStats
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t uncacheable;
+	int entries;
+	int capacity;
+};
+
+// Fixed-size LRU: entries, their command storage and an open addressed
+// index are allocated by SetCapacity and reused, so lookups and inserts do
+// not touch the heap. Guarded by the TAction lock of TActionInterface.cpp.
+class CommandCache
+{
+public:
+	CommandCache();
+
+	void SetCapacity(size_t capacity);
+	// Step scale factors are rounded to; also clears the cache.
+	void SetQuantum(float quantum);
+	float Quantum() const { return m_quantum; }
+	void Clear();
+
+	int32_t Quantize(float scale) const;
+	float Dequantize(int32_t steps) const { return static_cast<float>(steps) * m_quantum; }
+
+	// Commands for key, or nullptr. A hit becomes most recently used.
+	const Command* Find(const CommandKey& key, size_t& count);
+	// Stores a copy of commands, evicting the least recently used entry.
+	// Sequences longer than kMaxCachedCommands are counted and not kept.
+	void Insert(const CommandKey& key, const Command* commands, size_t count);
+
+	CommandCacheStats Stats() const;
+
+private:
+	static constexpr uint32_t kNone = 0xFFFFFFFF;
+
+	struct Entry
+	{
+		CommandKey key;
+		uint32_t prev;
+		uint32_t next;
+		uint32_t count;
+		Command commands[kMaxCachedCommands];
+	};
+
+	static uint32_t Hash(const CommandKey& key);
+	uint32_t Lookup(const CommandKey& key) const;
+	void IndexRemove(uint32_t entry);
+	void IndexInsert(uint32_t entry);
+	void Unlink(uint32_t entry);
+	void PushFront(uint32_t entry);
+
+	std::vector<Entry> m_entries;
+	std::vector<uint32_t> m_index;
+	size_t m_used;
+	uint32_t m_head;
+	uint32_t m_tail;
+	float m_quantum;
+	CommandCacheStats m_stats;
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,70 @@
+/************************************************************************
+*                                                                       *
+*   Completion.h -- outcomes of commands sent with a completion token   *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_COMPLETION_H_
+#define TDK_COMPLETION_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "MpscQueue.h"
+
+namespace tdk
+{
+
+const size_t kCompletionQueueSize = 1024;
+
+enum CompletionStatus
+{
+	kCompletionAck = 0,
+	kCompletionNak = 1,
+	kCompletionError = 2,
+};
+
+// detail is the NAK reason byte for kCompletionNak and an EAI error code
+// (ERROR_EAITIMEOUT, ERROR_FAILED_TO_WRITE, ...) for kCompletionError.
+struct Completion
+{
+	int boardId;
+	int token;
+	int status;
+	int detail;
+	uint32_t roundTripUs;
+};
+
+// Every device I/O thread pushes here and the API thread polls. When the
+// queue is full the completion is discarded so an I/O thread never blocks
+// on a caller that stopped polling, and counted so the caller can tell its
+// tokens will not all be answered.
+class CompletionQueue
+{
+public:
+	CompletionQueue()
+		: m_dropped(0)
+	{
+	}
+
+	// Any thread.
+	void Push(const Completion& completion)
+	{
+		if (!m_queue.TryPush(completion))
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// The single consumer only.
+	bool TryPop(Completion& out) { return m_queue.TryPop(out); }
+
+	uint64_t Dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+	void ResetDropped() { m_dropped.store(0, std::memory_order_relaxed); }
+
+private:
+	MpscQueue<Completion, kCompletionQueueSize> m_queue;
+	std::atomic<uint64_t> m_dropped;
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,290 @@
+#include "CreditModel.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "SerialPort.h"
+
+namespace tdk
+{
+
+namespace
+{
+
+const int64_t kNsPerMs = 1000000;
+// Added to every estimated release time for the controller's own latency.
+const int64_t kCreditMarginNs = 2 * kNsPerMs;
+
+bool Within(int limit, size_t value)
+{
+	return limit <= 0 || value <= static_cast<size_t>(limit);
+}
+
+} // namespace
+
+int64_t CreditModel::WireNs(size_t bytes)
+{
+	// Ten bits per byte on the wire.
+	return static_cast<int64_t>(bytes) * 10 * 1000000000 / kDefaultBaudRate;
+}
+
+CreditModel::CreditModel()
+{
+	m_limits.actionList = kDefaultActionListSize;
+	m_limits.rampList = kDefaultRampListSize;
+	m_limits.busSlots = kDefaultBusSlots;
+	Reset();
+}
+
+void CreditModel::Reset()
+{
+	m_actionCount = 0;
+	m_rampCount = 0;
+	m_linkFreeNs = 0;
+	m_recordingSlot = 0;
+	memset(m_storedCount, 0, sizeof(m_storedCount));
+	m_chunkActionCount = 0;
+	m_chunkRampCount = 0;
+}
+
+size_t CreditModel::Admit(const Command* commands, size_t count, int64_t now, bool force, bool* chunkEnd)
+{
+	Retire(now);
+	if (m_linkFreeNs < now)
+		m_linkFreeNs = now;
+
+	size_t admitted = 0;
+	bool full = false;
+	while (admitted < count && !full)
+	{
+		// The controller checks each frame against what is still pending
+		// when the frame has arrived.
+		size_t bytes = kFrameOverhead + 1;
+		int64_t arrival = m_linkFreeNs + WireNs(bytes);
+		size_t actions = CountAfter(m_actionDue, m_actionCount, arrival);
+		size_t ramps = CountAfter(m_rampEnd, m_rampCount, arrival);
+		bool idle = actions == 0 && ramps == 0;
+
+		Cost total = { 0, 0, 0 };
+		bool waited = false;
+		int64_t waitNs = 0;
+		size_t start = admitted;
+		m_chunkActionCount = 0;
+		m_chunkRampCount = 0;
+
+		while (admitted < count)
+		{
+			const Command& command = commands[admitted];
+			Cost cost = Measure(command, waited);
+			bool fits = Within(m_limits.busSlots, total.immediate + cost.immediate)
+				&& Within(m_limits.actionList, actions + total.actions + cost.actions)
+				&& Within(m_limits.rampList, ramps + total.ramps + cost.ramps)
+				&& m_actionCount + m_chunkActionCount + cost.actions <= kMaxCreditEntries
+				&& m_rampCount + m_chunkRampCount + cost.ramps <= kMaxCreditEntries;
+			if (!fits)
+			{
+				if (admitted != start)
+					break;
+				if (!force && !idle)
+				{
+					full = true;
+					break;
+				}
+			}
+
+			total.actions += cost.actions;
+			total.ramps += cost.ramps;
+			total.immediate += cost.immediate;
+			bytes += command.action.EncodedSize();
+			bool recording = m_recordingSlot != 0;
+			Charge(command, waitNs);
+			if (!recording && command.action.command == TDK_COMMAND_ACTION_WAIT)
+			{
+				waited = true;
+				waitNs += (command.action.delay + command.action.args[0]) * command.timeFactor * kNsPerMs;
+			}
+			chunkEnd[admitted++] = false;
+			// The controller checks the next frame against the lists an
+			// undelayed Stop has emptied.
+			if (!recording && !waited && command.action.command == TDK_COMMAND_STOP && command.action.delay == 0)
+				break;
+		}
+		if (admitted == start)
+			break;
+
+		chunkEnd[admitted - 1] = true;
+		m_linkFreeNs += WireNs(bytes);
+		for (size_t i = 0; i < m_chunkActionCount; ++i)
+			Track(m_actionDue, m_actionCount, m_linkFreeNs + m_chunkActions[i] + kCreditMarginNs);
+		for (size_t i = 0; i < m_chunkRampCount; ++i)
+			Track(m_rampEnd, m_rampCount, m_linkFreeNs + m_chunkRamps[i] + kCreditMarginNs);
+	}
+	return admitted;
+}
+
+CreditModel::Cost CreditModel::Measure(const Command& command, bool waited) const
+{
+	Cost cost = { 0, 0, 0 };
+	if (m_recordingSlot != 0)
+		return cost;
+
+	const Action& action = command.action;
+	switch (action.command)
+	{
+	case TDK_COMMAND_TACTION_START:
+	case TDK_COMMAND_TACTION_END:
+	case TDK_COMMAND_ACTION_WAIT:
+		break;
+	case TDK_COMMAND_TACTION_PLAY:
+		if (action.args[0] >= 1 && action.args[0] <= TDK_MAX_STORED_TACTIONS)
+		{
+			int slot = action.args[0] - 1;
+			for (size_t i = 0; i < m_storedCount[slot]; ++i)
+			{
+				++cost.actions;
+				cost.ramps += m_stored[slot][i].rampUnits != 0 ? 1 : 0;
+			}
+		}
+		break;
+	default:
+		cost.actions = 1;
+		cost.ramps = action.command == TDK_COMMAND_RAMP ? 1 : 0;
+		cost.immediate = !waited && action.delay == 0 ? 1 : 0;
+		break;
+	}
+	return cost;
+}
+
+void CreditModel::Charge(const Command& command, int64_t offsetNs)
+{
+	const Action& action = command.action;
+	int64_t unitNs = command.timeFactor * kNsPerMs;
+	uint8_t rampUnits = action.command == TDK_COMMAND_RAMP ? action.args[6] : 0;
+
+	if (m_recordingSlot != 0)
+	{
+		size_t& length = m_storedCount[m_recordingSlot - 1];
+		if (action.command == TDK_COMMAND_TACTION_END)
+			m_recordingSlot = 0;
+		else if (length < TDK_MAX_STORED_TACTION_LENGTH)
+			m_stored[m_recordingSlot - 1][length++] = StoredAction{ action.delay, rampUnits };
+		return;
+	}
+
+	switch (action.command)
+	{
+	case TDK_COMMAND_TACTION_START:
+		if (action.args[0] >= 1 && action.args[0] <= TDK_MAX_STORED_TACTIONS)
+		{
+			m_recordingSlot = action.args[0];
+			m_storedCount[m_recordingSlot - 1] = 0;
+		}
+		break;
+	case TDK_COMMAND_TACTION_END:
+	case TDK_COMMAND_ACTION_WAIT:
+		break;
+	case TDK_COMMAND_TACTION_PLAY:
+		if (action.args[0] >= 1 && action.args[0] <= TDK_MAX_STORED_TACTIONS)
+		{
+			int slot = action.args[0] - 1;
+			for (size_t i = 0; i < m_storedCount[slot]; ++i)
+			{
+				const StoredAction& stored = m_stored[slot][i];
+				int64_t due = offsetNs + (action.delay + stored.delay) * unitNs;
+				if (due > 0)
+					m_chunkActions[m_chunkActionCount++] = due;
+				if (stored.rampUnits != 0)
+					m_chunkRamps[m_chunkRampCount++] = due + stored.rampUnits * unitNs;
+			}
+		}
+		break;
+	default:
+	{
+		int64_t due = offsetNs + action.delay * unitNs;
+		// An undelayed Stop empties both lists as the frame arrives.
+		if (action.command == TDK_COMMAND_STOP && due == 0)
+		{
+			m_actionCount = 0;
+			m_rampCount = 0;
+		}
+		if (due > 0)
+			m_chunkActions[m_chunkActionCount++] = due;
+		if (rampUnits != 0)
+			m_chunkRamps[m_chunkRampCount++] = due + rampUnits * unitNs;
+		break;
+	}
+	}
+}
+
+void CreditModel::Track(int64_t* entries, size_t& count, int64_t due)
+{
+	if (count < kMaxCreditEntries)
+		entries[count++] = due;
+}
+
+void CreditModel::Retire(int64_t now)
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < m_actionCount; ++i)
+	{
+		if (m_actionDue[i] > now)
+			m_actionDue[kept++] = m_actionDue[i];
+	}
+	m_actionCount = kept;
+
+	kept = 0;
+	for (size_t i = 0; i < m_rampCount; ++i)
+	{
+		if (m_rampEnd[i] > now)
+			m_rampEnd[kept++] = m_rampEnd[i];
+	}
+	m_rampCount = kept;
+}
+
+size_t CreditModel::CountAfter(const int64_t* entries, size_t count, int64_t t)
+{
+	size_t after = 0;
+	for (size_t i = 0; i < count; ++i)
+		after += entries[i] > t ? 1 : 0;
+	return after;
+}
+
+int64_t CreditModel::NextRelease() const
+{
+	int64_t next = -1;
+	for (size_t i = 0; i < m_actionCount; ++i)
+	{
+		if (next < 0 || m_actionDue[i] < next)
+			next = m_actionDue[i];
+	}
+	for (size_t i = 0; i < m_rampCount; ++i)
+	{
+		if (next < 0 || m_rampEnd[i] < next)
+			next = m_rampEnd[i];
+	}
+	return next;
+}
+
+int64_t CreditModel::LastRelease() const
+{
+	int64_t last = -1;
+	for (size_t i = 0; i < m_actionCount; ++i)
+		last = std::max(last, m_actionDue[i]);
+	for (size_t i = 0; i < m_rampCount; ++i)
+		last = std::max(last, m_rampEnd[i]);
+	return last;
+}
+
+int CreditModel::FreeActions(int64_t now) const
+{
+	int limit = m_limits.actionList > 0 ? m_limits.actionList : static_cast<int>(kMaxCreditEntries);
+	return limit - static_cast<int>(CountAfter(m_actionDue, m_actionCount, now));
+}
+
+int CreditModel::FreeRamps(int64_t now) const
+{
+	int limit = m_limits.rampList > 0 ? m_limits.rampList : static_cast<int>(kMaxCreditEntries);
+	return limit - static_cast<int>(CountAfter(m_rampEnd, m_rampCount, now));
+}
+
+} // namespace tdk
@@ -0,0 +1,113 @@
+/************************************************************************
+*                                                                       *
+*   CreditModel.h -- estimated occupancy of a controller's lists        *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_CREDITMODEL_H_
+#define TDK_CREDITMODEL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <EAI_Defines.h>
+
+#include "Protocol.h"
+
+namespace tdk
+{
+
+// Limits of the controller firmware; a frame that would exceed one is
+// NAK'd with kNakActionListFull, kNakRampListFull or kNakMasterPacketFull.
+const int kDefaultActionListSize = 32;
+const int kDefaultRampListSize = 8;
+const int kDefaultBusSlots = 16;
+// Upper bound on tracked list entries, whatever the limits are set to.
+const size_t kMaxCreditEntries = 256;
+
+struct CreditLimits
+{
+	int actionList;		// 0 = not enforced
+	int rampList;
+	int busSlots;
+};
+
+// Follows, from what the host sends, how full the controller's action and
+// ramp lists are: a delayed action holds an action list entry until it is
+// due, a ramp holds a ramp list entry until it ends, and undelayed actions
+// take bus slots in the frame that carries them. Times are estimated from
+// when each frame should finish arriving at kDefaultBaudRate, plus a
+// margin, so the model errs on the full side.
+//
+// Owned by the I/O thread.
+class CreditModel
+{
+public:
+	CreditModel();
+
+	// Nothing is known to be on the controller (new connection).
+	void Reset();
+	void SetLimits(const CreditLimits& limits) { m_limits = limits; }
+
+	// Plans writing commands at now. Returns how many, from the front, the
+	// controller can take without a list overflowing, and sets chunkEnd on
+	// the last command of each group that must start a new frame. The
+	// admitted commands are counted as sent. A command that would not fit
+	// even on an idle controller is admitted on its own, and force admits
+	// everything, so nothing is held forever.
+	size_t Admit(const Command* commands, size_t count, int64_t now, bool force, bool* chunkEnd);
+	// A frame was NAK'd: whatever it started recording did not start.
+	void Rejected() { m_recordingSlot = 0; }
+
+	// Earliest time an entry frees, or -1 if the lists are empty.
+	int64_t NextRelease() const;
+	// Time the last entry frees, or -1 if the lists are empty.
+	int64_t LastRelease() const;
+	// When everything admitted so far should have finished arriving.
+	int64_t LinkFreeNs() const { return m_linkFreeNs; }
+
+	// How long bytes take on the wire at kDefaultBaudRate.
+	static int64_t WireNs(size_t bytes);
+	int FreeActions(int64_t now) const;
+	int FreeRamps(int64_t now) const;
+
+private:
+	struct Cost
+	{
+		int actions;
+		int ramps;
+		int immediate;
+	};
+
+	struct StoredAction
+	{
+		uint8_t delay;
+		uint8_t rampUnits;	// 0 unless a ramp
+	};
+
+	void Retire(int64_t now);
+	Cost Measure(const Command& command, bool waited) const;
+	void Charge(const Command& command, int64_t offsetNs);
+	void Track(int64_t* entries, size_t& count, int64_t due);
+	static size_t CountAfter(const int64_t* entries, size_t count, int64_t t);
+
+	CreditLimits m_limits;
+	int64_t m_actionDue[kMaxCreditEntries];
+	size_t m_actionCount;
+	int64_t m_rampEnd[kMaxCreditEntries];
+	size_t m_rampCount;
+	int64_t m_linkFreeNs;
+	int m_recordingSlot;
+	StoredAction m_stored[TDK_MAX_STORED_TACTIONS][TDK_MAX_STORED_TACTION_LENGTH];
+	size_t m_storedCount[TDK_MAX_STORED_TACTIONS];
+
+	// Entries of the chunk being planned, relative to its arrival.
+	int64_t m_chunkActions[kMaxCreditEntries];
+	size_t m_chunkActionCount;
+	int64_t m_chunkRamps[kMaxCreditEntries];
+	size_t m_chunkRampCount;
+};
+
+} // namespace tdk
+
+#endif
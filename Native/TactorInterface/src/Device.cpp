@@ -0,0 +1,1640 @@
+#include "Device.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Clock.h"
+#include "EventLoop.h"
+#include "WireTrace.h"
+
+namespace tdk
+{
+
+namespace
+{
+
+const int kIdleWaitMs = 100;
+// How long the I/O thread waits for the rest of a batch that is still
+// being pushed before writing what it already has.
+const int kBatchWaitSpins = 1000;
+
+const int kDefaultReplyTimeoutMs = 1000;
+
+std::atomic<int64_t> g_maxQueueLatencyNs(0);
+std::atomic<int64_t> g_replyTimeoutNs(static_cast<int64_t>(kDefaultReplyTimeoutMs) * 1000000);
+std::atomic<bool> g_shadowCacheEnabled(true);
+std::atomic<int> g_storedSlotCount(TDK_MAX_STORED_TACTIONS);
+std::atomic<int> g_timelineBudget(kDefaultTimelineBudget);
+std::atomic<int64_t> g_streamIntervalNs(1000000000 / kDefaultStreamRateHz);
+std::atomic<int64_t> g_clockProbeIntervalNs(static_cast<int64_t>(kDefaultClockProbeMs) * 1000000);
+std::atomic<int64_t> g_batteryPollNs(static_cast<int64_t>(kDefaultBatteryPollMs) * 1000000);
+std::atomic<int64_t> g_selfTestPollNs(0);
+std::atomic<bool> g_preemptStop(false);
+thread_local uint8_t t_sendPriority = kPriorityNormal;
+
+// Marks the commands of a stored TAction upload; never handed out by
+// NextToken, and resolved into m_uploadAcks/m_uploadFailures instead of the
+// completion queue.
+const int kUploadToken = -1;
+// Streamed commands carry kStreamToken - channel, resolved into the
+// device's stream state.
+const int kStreamToken = -2;
+// Marks the ACTION_WAIT sent to measure an idle link.
+const int kProbeToken = kStreamToken - kStreamChannels;
+// Marks a status query sent by the telemetry poller.
+const int kTelemetryToken = kProbeToken - 1;
+// How long a self test may hold the link without reporting.
+const int64_t kSelfTestTimeoutNs = 10000000000;
+// Low priority commands are only written while the link holds less than
+// this of earlier writes, so a high priority command never waits long
+// behind them.
+const int64_t kLowBacklogNs = 5000000;
+// Action and ramp list entries low priority commands leave free for the
+// other classes.
+const int kLowReserveActions = 4;
+const int kLowReserveRamps = 1;
+// How long the link must stay quiet, after everything written should have
+// arrived, before replies missing since a damaged one are given up on.
+const int64_t kResyncQuietNs = 20000000;
+// m_measuredNs of a link not measured yet.
+const int64_t kNeverMeasured = INT64_MIN / 2;
+
+// Sets the delay that runs command leadNs after it reaches the controller,
+// to the nearest unit of its time factor and as far as a delay reaches.
+void Retime(Command& command, int64_t leadNs)
+{
+	int64_t unitNs = static_cast<int64_t>(command.timeFactor) * 1000000;
+	command.action.delay = leadNs > 0 ? static_cast<uint8_t>(std::min<int64_t>((leadNs + unitNs / 2) / unitNs, 0xFF)) : 0;
+}
+
+// How long after reaching the controller command may still be waiting or
+// running there, or -1 for a stored TAction, whose length is not known here.
+int64_t RunsForNs(const Command& command)
+{
+	const Action& action = command.action;
+	int64_t units = action.delay;
+	switch (action.command)
+	{
+	case TDK_COMMAND_TACTION_PLAY:
+		return -1;
+	case TDK_COMMAND_PULSE:
+		units += action.args[1];
+		break;
+	case TDK_COMMAND_RAMP:
+		units += action.args[6];
+		break;
+	default:
+		break;
+	}
+	return units * command.timeFactor * 1000000;
+}
+
+} // namespace
+
+void Device::SetMaxQueueLatencyMs(int ms)
+{
+	g_maxQueueLatencyNs.store(static_cast<int64_t>(ms) * 1000000, std::memory_order_relaxed);
+}
+
+void Device::SetReplyTimeoutMs(int ms)
+{
+	g_replyTimeoutNs.store(static_cast<int64_t>(ms) * 1000000, std::memory_order_relaxed);
+}
+
+void Device::SetShadowCacheEnabled(bool enabled)
+{
+	g_shadowCacheEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Device::SetStoredSlotCount(int count)
+{
+	g_storedSlotCount.store(count, std::memory_order_relaxed);
+}
+
+void Device::SetTimelineBudget(int actions)
+{
+	g_timelineBudget.store(actions, std::memory_order_relaxed);
+}
+
+void Device::SetStreamRate(int hz)
+{
+	g_streamIntervalNs.store(hz > 0 ? 1000000000 / hz : 0, std::memory_order_relaxed);
+}
+
+void Device::SetClockProbeIntervalMs(int ms)
+{
+	g_clockProbeIntervalNs.store(static_cast<int64_t>(ms) * 1000000, std::memory_order_relaxed);
+}
+
+void Device::SetTelemetryIntervalsMs(int batteryMs, int selfTestMs)
+{
+	g_batteryPollNs.store(static_cast<int64_t>(batteryMs) * 1000000, std::memory_order_relaxed);
+	g_selfTestPollNs.store(static_cast<int64_t>(selfTestMs) * 1000000, std::memory_order_relaxed);
+}
+
+void Device::SetSendPriority(uint8_t priority)
+{
+	t_sendPriority = priority;
+}
+
+void Device::SetPreemptStop(bool enabled)
+{
+	g_preemptStop.store(enabled, std::memory_order_relaxed);
+}
+
+Device::Device()
+	: m_id(-1)
+	, m_type(DEVICE_TYPE_UNKNOWN)
+	, m_open(false)
+	, m_callback(nullptr)
+	, m_completions(nullptr)
+	, m_loop(nullptr)
+	, m_wakePending(false)
+	, m_ioError(0)
+	, m_nextToken(1)
+	, m_shadowEpoch(0)
+	, m_uploadAcks(0)
+	, m_uploadFailures(0)
+	, m_limitActions(kDefaultActionListSize)
+	, m_limitRamps(kDefaultRampListSize)
+	, m_limitBusSlots(kDefaultBusSlots)
+	, m_creditActions(kDefaultActionListSize)
+	, m_creditRamps(kDefaultRampListSize)
+	, m_creditHeld(0)
+	, m_ioHeld(0)
+	, m_ioOpenClass(kPriorityClasses)
+	, m_ioBackgroundUntilNs(0)
+	, m_ioKeepUntilNs(0)
+	, m_ioPacedNs(0)
+	, m_ioShadowLandNs(0)
+	, m_ioBlocked(false)
+	, m_ioOutLength(0)
+	, m_ioOutSent(0)
+	, m_inFlightHead(0)
+	, m_inFlightTail(0)
+	, m_streamPending(0)
+	, m_streamDueNs(0)
+	, m_measuredNs(kNeverMeasured)
+	, m_ioLastWriteNs(0)
+	, m_selfTestUntilNs(0)
+	, m_resyncUntilNs(0)
+	, m_resyncFrames(0)
+	, m_resyncHeld(0)
+	, m_resyncCursor(0)
+	, m_replyStallNs(0)
+	, m_batchOpen(false)
+	, m_batchCount(0)
+	, m_shadowSeenEpoch(0)
+	, m_uploadSlot(0)
+	, m_uploadExpected(0)
+	, m_uploadAckBase(0)
+	, m_uploadFailureBase(0)
+	, m_frameSeenEpoch(0)
+	, m_enqueued(0)
+	, m_dequeued(0)
+	, m_maxDepth(0)
+	, m_written(0)
+	, m_dropped(0)
+	, m_writes(0)
+	, m_wireLatencyTotalUs(0)
+	, m_wireLatencyMaxUs(0)
+{
+	m_lastPort[0] = '\0';
+}
+
+Device::~Device()
+{
+	Close();
+}
+
+int Device::Open(int id, const char* name, int type, DataCallback callback, CompletionQueue* completions,
+	EventLoop* loop)
+{
+	if (!(type & DEVICE_TYPE_SERIAL))
+		return ERROR_NO_SUPPORTED_DRIVER;
+
+	if (int error = m_port.Open(name))
+		return error;
+
+	m_id = id;
+	m_type = DEVICE_TYPE_SERIAL;
+	m_callback = callback;
+	m_completions = completions;
+	m_ioError.store(0);
+	m_responses.Clear();
+	m_replyScanner.Reset();
+	m_inFlightHead = 0;
+	m_inFlightTail = 0;
+	m_ioHeld = 0;
+	m_ioOpenClass = kPriorityClasses;
+	m_ioBackgroundUntilNs = 0;
+	m_ioKeepUntilNs = 0;
+	m_ioPacedNs = 0;
+	m_ioShadowLandNs = 0;
+	m_ioBlocked = false;
+	m_ioOutLength = 0;
+	m_ioOutSent = 0;
+	m_credits.Reset();
+	PublishCredits(MonotonicNs());
+	m_shadow.TrackAll();
+	m_shadow.Invalidate();
+	m_shadow.ResetStats();
+	m_shadowSeenEpoch = m_shadowEpoch.load();
+	m_telemetry.Reset();
+	m_poller.Reset(MonotonicNs());
+	m_ioLastWriteNs = MonotonicNs();
+	m_selfTestUntilNs = 0;
+	m_resyncUntilNs = 0;
+	m_frame.Reset();
+	m_frameSeenEpoch = m_shadowEpoch.load();
+	m_renderer.Reset();
+	m_stream.Reset();
+	m_streamPending = 0;
+	m_streamDueNs = 0;
+	// Measure the new link straight away.
+	m_clock.Reset();
+	m_measuredNs = kNeverMeasured;
+
+	// The same controller again: its slots are empty now, but what was
+	// stored is still worth storing.
+	if (strcmp(m_lastPort, m_port.Name()) == 0)
+		m_storedSlots.Reconnected();
+	else
+		m_storedSlots.Reset();
+	memcpy(m_lastPort, m_port.Name(), sizeof(m_lastPort));
+	m_uploadSlot = 0;
+	m_timeline.Clear();
+	m_enqueued.store(0);
+	m_dequeued.store(0);
+	m_maxDepth.store(0);
+	m_written.store(0);
+	m_dropped.store(0);
+	m_writes.store(0);
+	m_wireLatencyTotalUs.store(0);
+	m_wireLatencyMaxUs.store(0);
+	m_stats.Reset();
+
+	m_wakePending.store(false);
+	m_loop = loop;
+	if (int error = m_loop->Attach(this))
+	{
+		m_port.Close();
+		m_loop = nullptr;
+		return error;
+	}
+	m_open.store(true, std::memory_order_release);
+	return 0;
+}
+
+void Device::Close()
+{
+	if (!IsOpen())
+		return;
+
+	m_loop->Detach(this);
+	m_loop = nullptr;
+	FailInFlight(ERROR_CONNECTION);
+
+	m_port.Close();
+	m_open.store(false, std::memory_order_release);
+	m_id = -1;
+	m_type = DEVICE_TYPE_UNKNOWN;
+	m_callback = nullptr;
+	m_completions = nullptr;
+	m_batchOpen = false;
+	m_batchCount = 0;
+}
+
+bool Device::Enqueue(const Command& command, int token, bool more, uint8_t priority, int64_t dueNs)
+{
+	QueuedCommand queued;
+	queued.command = command;
+	queued.enqueueNs = MonotonicNs();
+	queued.dueNs = dueNs;
+	queued.token = token;
+	queued.priority = priority;
+	queued.more = more;
+	if (!m_queues[priority].TryPush(queued))
+		return false;
+
+	m_stats.Submitted(command.action.command);
+	uint64_t enqueued = m_enqueued.fetch_add(1, std::memory_order_relaxed) + 1;
+	int depth = static_cast<int>(enqueued - m_dequeued.load(std::memory_order_relaxed));
+	int maxDepth = m_maxDepth.load(std::memory_order_relaxed);
+	while (depth > maxDepth && !m_maxDepth.compare_exchange_weak(maxDepth, depth, std::memory_order_relaxed))
+	{
+	}
+	return true;
+}
+
+bool Device::HasRoom(uint8_t priority, size_t count) const
+{
+	// Only API calls holding this device push, and the one consumer only
+	// makes room, though a pop it is part way through still holds a cell.
+	return m_queues[priority].Size() + count + 1 <= kCommandQueueSize;
+}
+
+size_t Device::QueuedCount() const
+{
+	size_t count = 0;
+	for (const MpscQueue<QueuedCommand, kCommandQueueSize>& queue : m_queues)
+		count += queue.Size();
+	return count;
+}
+
+bool Device::PopQueued(QueuedCommand& slot, bool lowerClasses)
+{
+	if (m_queues[kPriorityHigh].TryPop(slot))
+		return true;
+	if (!lowerClasses)
+		return false;
+	for (int priority = kPriorityHigh + 1; priority < kPriorityClasses; ++priority)
+	{
+		if (m_queues[priority].TryPop(slot))
+			return true;
+	}
+	return false;
+}
+
+void Device::Wake()
+{
+	// Already pending: the loop has yet to take the earlier wake, and will
+	// find this push when it does.
+	if (!m_wakePending.exchange(true, std::memory_order_acq_rel))
+		m_loop->Wake();
+}
+
+int Device::NextToken()
+{
+	// Tokens are positive so -1 stays free for errors at the C API.
+	for (;;)
+	{
+		int token = m_nextToken.fetch_add(1, std::memory_order_relaxed) & 0x7FFFFFFF;
+		if (token != 0)
+			return token;
+	}
+}
+
+bool Device::Suppress(const Action& action, uint8_t timeFactor, int64_t now)
+{
+	if (!g_shadowCacheEnabled.load(std::memory_order_relaxed))
+		return false;
+
+	uint32_t epoch = m_shadowEpoch.load(std::memory_order_acquire);
+	if (epoch != m_shadowSeenEpoch)
+	{
+		m_shadow.Invalidate();
+		m_shadowSeenEpoch = epoch;
+	}
+	return m_shadow.Filter(action, timeFactor, now);
+}
+
+int Device::Send(const Action& action, uint8_t timeFactor, int token, int64_t dueNs)
+{
+	int64_t now = MonotonicNs();
+	m_frame.Observe(action, timeFactor, now);
+	if (m_timeline.Recording())
+	{
+		// Nothing is sent yet, so there is nothing to complete.
+		if (token != 0)
+			return ERROR_BADPARAMETER;
+		return m_timeline.Record(action, timeFactor);
+	}
+	if (action.command == TDK_COMMAND_STOP)
+	{
+		m_timeline.Cancel();
+		m_timeline.Flushed();
+	}
+
+	if (Suppress(action, timeFactor, now))
+	{
+		Resolve(token, kCompletionAck, 0, now, now);
+		return 0;
+	}
+
+	Command command;
+	command.action = action;
+	command.timeFactor = timeFactor;
+
+	if (m_batchOpen)
+	{
+		if (m_batchCount == kMaxBatchCommands)
+		{
+			m_shadow.Invalidate();
+			return ERROR_TM_MAX_ACTION_LIMIT_REACHED;
+		}
+
+		if (action.command == TDK_COMMAND_TACTION_START)
+			m_storedSlots.Claim(action.args[0]);
+		m_batchTokens[m_batchCount] = token;
+		m_batchDue[m_batchCount] = dueNs;
+		m_batch[m_batchCount++] = command;
+		return 0;
+	}
+
+	if (!Enqueue(command, token, false, t_sendPriority, dueNs))
+	{
+		m_shadow.Invalidate();
+		return ERROR_TM_MAX_ACTION_LIMIT_REACHED;
+	}
+	if (action.command == TDK_COMMAND_TACTION_START)
+		m_storedSlots.Claim(action.args[0]);
+	Wake();
+	return 0;
+}
+
+int Device::SendSequence(const Command* commands, size_t count)
+{
+	if (m_batchOpen || m_timeline.Recording())
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (int error = Send(commands[i].action, commands[i].timeFactor))
+				return error;
+		}
+		return 0;
+	}
+	return QueueSequence(commands, count, t_sendPriority);
+}
+
+int Device::QueueSequence(const Command* commands, size_t count, uint8_t priority, const int64_t* dueNs)
+{
+	if (!HasRoom(priority, count))
+	{
+		m_shadow.Invalidate();
+		return ERROR_TM_MAX_ACTION_LIMIT_REACHED;
+	}
+
+	// Each command is held back until the next one is known, so the last
+	// one queued can close the sequence.
+	size_t held = count;
+	int64_t now = MonotonicNs();
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_frame.Observe(commands[i].action, commands[i].timeFactor, now);
+		if (Suppress(commands[i].action, commands[i].timeFactor, now))
+			continue;
+		if (held != count)
+			Enqueue(commands[held], 0, true, priority, dueNs != nullptr ? dueNs[held] : 0);
+		held = i;
+	}
+	if (held != count)
+		Enqueue(commands[held], 0, false, priority, dueNs != nullptr ? dueNs[held] : 0);
+	Wake();
+	return 0;
+}
+
+int Device::PlaySequence(const CommandKey& key, const Command* commands, size_t count)
+{
+	m_storedSlots.SetSlotCount(g_storedSlotCount.load(std::memory_order_relaxed));
+	PollUpload();
+
+	// A recorded stored play could outlive its slot.
+	if (m_timeline.Recording())
+		return SendSequence(commands, count);
+
+	if (int slot = m_storedSlots.Find(key))
+	{
+		Action action;
+		MakeStoredTAction(action, TDK_COMMAND_TACTION_PLAY, slot, 0, key.timeFactor);
+		return Send(action, static_cast<uint8_t>(key.timeFactor));
+	}
+
+	if (int error = SendSequence(commands, count))
+		return error;
+
+	// Never upload from inside an application batch: the recording would
+	// be split around whatever else the batch holds.
+	if (!m_batchOpen && m_uploadSlot == 0)
+	{
+		if (int slot = m_storedSlots.Observe(key, commands, count))
+			StartUpload(slot);
+	}
+	return 0;
+}
+
+void Device::StartUpload(int slot)
+{
+	size_t count = 0;
+	const Command* commands = m_storedSlots.Commands(slot, count);
+	uint8_t timeFactor = count != 0 ? commands[0].timeFactor : kDefaultTimeFactor;
+
+	// The whole recording must be queued or none of it, or the controller
+	// would keep recording whatever is sent next.
+	size_t total = count + 2;
+	if (!HasRoom(kPriorityLow, total))
+	{
+		m_storedSlots.UploadFinished(slot, false);
+		return;
+	}
+
+	MakeStoredTAction(m_upload[0].action, TDK_COMMAND_TACTION_START, slot, 0, timeFactor);
+	m_upload[0].timeFactor = timeFactor;
+	memcpy(m_upload + 1, commands, count * sizeof(Command));
+	MakeSimple(m_upload[total - 1].action, TDK_COMMAND_TACTION_END, 0, timeFactor);
+	m_upload[total - 1].timeFactor = timeFactor;
+
+	m_uploadSlot = slot;
+	m_uploadExpected = static_cast<uint32_t>(total);
+	m_uploadAckBase = m_uploadAcks.load(std::memory_order_acquire);
+	m_uploadFailureBase = m_uploadFailures.load(std::memory_order_acquire);
+	for (size_t i = 0; i < total; ++i)
+		Enqueue(m_upload[i], kUploadToken, i + 1 < total, kPriorityLow);
+	Wake();
+}
+
+void Device::PollUpload()
+{
+	if (m_uploadSlot == 0)
+	{
+		if (!m_batchOpen)
+		{
+			if (int slot = m_storedSlots.TakeReupload())
+				StartUpload(slot);
+		}
+		return;
+	}
+
+	uint32_t failures = m_uploadFailures.load(std::memory_order_acquire) - m_uploadFailureBase;
+	uint32_t acks = m_uploadAcks.load(std::memory_order_acquire) - m_uploadAckBase;
+	if (failures == 0 && acks < m_uploadExpected)
+		return;
+
+	if (failures != 0)
+	{
+		// Part of the recording was refused; make sure the controller is
+		// not left recording.
+		Action end;
+		MakeSimple(end, TDK_COMMAND_TACTION_END, 0, kDefaultTimeFactor);
+		Enqueue(Command{ end, static_cast<uint8_t>(kDefaultTimeFactor) }, 0, false, kPriorityLow);
+		Wake();
+	}
+	m_storedSlots.UploadFinished(m_uploadSlot, failures == 0);
+	m_uploadSlot = 0;
+}
+
+int Device::SegmentBase(int segment, int offset) const
+{
+	TelemetrySnapshot telemetry;
+	m_telemetry.Read(telemetry);
+	if (telemetry.segmentCount < 0 || segment < 0 || segment >= telemetry.segmentCount)
+		return -ERROR_TM_TACTION_MISSING_CONNECTED_SEGEMENT;
+
+	int base = 1;
+	for (int i = 0; i < segment; ++i)
+		base += telemetry.segmentSizes[i];
+	if (offset < 1 || offset > telemetry.segmentSizes[segment])
+		return -ERROR_TM_INVALID_PARAM;
+	return base + offset - 1;
+}
+
+int Device::Stream(const Action& action)
+{
+	int tactor = action.args[0];
+	uint8_t target = action.command == TDK_COMMAND_FREQ ? kRampTargetFreq : kRampTargetGain;
+	int value = target == kRampTargetFreq ? (action.args[1] << 8) | action.args[2] : action.args[1];
+
+	m_shadow.Untrack(tactor, target);
+	// Streamed values are never delayed.
+	m_frame.Observe(action, kDefaultTimeFactor, 0);
+	if (m_stream.Set(target, tactor, value))
+		Wake();
+	return 0;
+}
+
+void Device::PumpStream(int64_t now)
+{
+	// One streamed flush on the link at a time, and none while other
+	// commands wait for room: values that pile up behind a slow link are
+	// replaced in their channels instead of queuing. Low priority commands
+	// waiting for the link do not hold streams up.
+	if (m_streamPending != 0 || !OnlyLowHeld() || m_ioOutSent < m_ioOutLength || now < m_streamDueNs
+		|| !m_stream.Dirty())
+		return;
+
+	// More undelayed actions than the controller has bus slots would be
+	// held for a later frame, and could be stale by then.
+	size_t room = kMaxInFlight - (m_inFlightTail - m_inFlightHead);
+	size_t capacity = std::min(room, kMaxBatchCommands - m_ioHeld);
+	int busSlots = m_limitBusSlots.load(std::memory_order_relaxed);
+	if (busSlots > 0)
+		capacity = std::min(capacity, static_cast<size_t>(busSlots));
+
+	size_t count = m_stream.Take(m_streamOut, m_streamChannels, capacity, kDefaultTimeFactor);
+	for (size_t i = 0; i < count; ++i)
+	{
+		// Flush sends held commands first, ahead of the queue, and normal
+		// priority ahead of low.
+		QueuedCommand& slot = m_ioCommands[m_ioHeld + i];
+		slot.command = m_streamOut[i];
+		slot.enqueueNs = now;
+		slot.dueNs = 0;
+		slot.token = kStreamToken - m_streamChannels[i];
+		slot.priority = kPriorityNormal;
+		slot.more = false;
+		m_stats.Submitted(slot.command.action.command);
+	}
+	m_ioHeld += count;
+	m_streamPending = count;
+	m_streamDueNs = now + g_streamIntervalNs.load(std::memory_order_relaxed);
+}
+
+bool Device::OnlyLowHeld() const
+{
+	for (size_t i = 0; i < m_ioHeld; ++i)
+	{
+		if (m_ioCommands[i].priority != kPriorityLow)
+			return false;
+	}
+	return m_ioHeld == 0 || !m_ioCommands[m_ioHeld - 1].more;
+}
+
+void Device::PumpProbe(int64_t now)
+{
+	// Only a link with nothing else on it gives a clean round trip; one
+	// that stays busy is measured by its own commands instead.
+	int64_t interval = g_clockProbeIntervalNs.load(std::memory_order_relaxed);
+	if (interval <= 0 || now < m_measuredNs + interval || m_inFlightHead != m_inFlightTail || m_ioHeld != 0
+		|| m_ioOutSent < m_ioOutLength)
+		return;
+
+	// The shortest wait the controller accepts; it delays nothing else.
+	QueuedCommand& slot = m_ioCommands[0];
+	MakeActionWait(slot.command.action, 0, 0, kDefaultTimeFactor);
+	slot.command.timeFactor = kDefaultTimeFactor;
+	slot.enqueueNs = now;
+	slot.dueNs = 0;
+	slot.token = kProbeToken;
+	slot.priority = kPriorityInternal;
+	slot.more = false;
+	m_stats.Submitted(TDK_COMMAND_ACTION_WAIT);
+	m_ioHeld = 1;
+	m_measuredNs = now;
+}
+
+void Device::PumpTelemetry(int64_t now)
+{
+	// Status queries only fill idle gaps, one at a time, and never hold up
+	// a command that is already waiting.
+	if (m_selfTestUntilNs != 0 || m_inFlightHead != m_inFlightTail || m_ioHeld != 0 || m_ioOutSent < m_ioOutLength
+		|| QueuedCount() != 0)
+		return;
+
+	uint8_t command = m_poller.Due(now, g_batteryPollNs.load(std::memory_order_relaxed),
+		g_selfTestPollNs.load(std::memory_order_relaxed), m_ioLastWriteNs);
+	if (command == 0)
+		return;
+
+	QueuedCommand& slot = m_ioCommands[0];
+	MakeSimple(slot.command.action, command, 0, kDefaultTimeFactor);
+	slot.command.timeFactor = kDefaultTimeFactor;
+	slot.enqueueNs = now;
+	slot.dueNs = 0;
+	slot.token = kTelemetryToken;
+	slot.priority = kPriorityInternal;
+	slot.more = false;
+	m_stats.Submitted(command);
+	m_ioHeld = 1;
+	m_poller.Sent(command, now);
+}
+
+void Device::EndSelfTest()
+{
+	m_selfTestUntilNs = 0;
+	m_telemetry.SetSelfTestRunning(false);
+}
+
+int Device::SendFrame(const uint8_t* intensities, int msDelay, int timeFactor)
+{
+	// Whatever may not have reached the controller leaves the frame state
+	// as unknown as the shadow's.
+	uint32_t epoch = m_shadowEpoch.load(std::memory_order_acquire);
+	if (epoch != m_frameSeenEpoch)
+	{
+		m_frame.Reset();
+		m_frameSeenEpoch = epoch;
+	}
+
+	int count = m_frame.Diff(intensities, msDelay, timeFactor, MonotonicNs(), m_frameOut);
+	if (count <= 0)
+		return count;
+	if (int error = SendSequence(m_frameOut, static_cast<size_t>(count)))
+	{
+		m_frame.Reset();
+		return -error;
+	}
+	m_frame.Commit();
+	return count;
+}
+
+int Device::PlaceTactor(int segment, int offset, float x, float y, float z)
+{
+	int tactor = SegmentBase(segment, offset);
+	if (tactor < 0)
+		return -tactor;
+	if (tactor > kMaxTactors)
+		return ERROR_TM_INVALID_PARAM;
+
+	m_renderer.Place(tactor, x, y, z);
+	return 0;
+}
+
+int Device::RenderContacts(const Contact* contacts, size_t count, int msDelay, int timeFactor)
+{
+	m_renderer.Render(contacts, count, m_rendered);
+	return SendFrame(m_rendered, msDelay, timeFactor);
+}
+
+int Device::BeginBatch()
+{
+	if (m_batchOpen || m_timeline.Recording())
+		return ERROR_BADPARAMETER;
+
+	m_batchOpen = true;
+	m_batchCount = 0;
+	return 0;
+}
+
+int Device::CommitBatch()
+{
+	if (!m_batchOpen)
+		return -ERROR_BADPARAMETER;
+
+	size_t count = m_batchCount;
+	m_batchOpen = false;
+	m_batchCount = 0;
+
+	// A batch that does not fit is refused whole, and its tokens fail.
+	if (!HasRoom(t_sendPriority, count))
+	{
+		int64_t now = MonotonicNs();
+		for (size_t i = 0; i < count; ++i)
+			Resolve(m_batchTokens[i], kCompletionError, ERROR_TM_MAX_ACTION_LIMIT_REACHED, now, now);
+		m_shadow.Invalidate();
+		return -ERROR_TM_MAX_ACTION_LIMIT_REACHED;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+		Enqueue(m_batch[i], m_batchTokens[i], i + 1 < count, t_sendPriority, m_batchDue[i]);
+	Wake();
+	return static_cast<int>(count);
+}
+
+int Device::BeginTimeline()
+{
+	if (m_batchOpen)
+		return ERROR_BADPARAMETER;
+	return m_timeline.Begin();
+}
+
+int Device::SetTimelineOffset(int ms)
+{
+	return m_timeline.SetOffset(ms);
+}
+
+int Device::PlayTimeline(int delayMs)
+{
+	if (delayMs < 0)
+		return -ERROR_BADPARAMETER;
+
+	int count = 0;
+	if (int error = m_timeline.Commit(MonotonicNs() + static_cast<int64_t>(delayMs) * 1000000, count))
+		return -error;
+	if (count > 0)
+		PumpTimeline();
+	return count;
+}
+
+int Device::PlayTimelineAt(int64_t atNs)
+{
+	int count = 0;
+	if (int error = m_timeline.Commit(atNs - m_clock.LatencyNs(), count))
+		return -error;
+	if (count > 0)
+		PumpTimeline();
+	return count;
+}
+
+int Device::SendAt(const Action& action, uint8_t timeFactor, int64_t atNs)
+{
+	int64_t unitNs = static_cast<int64_t>(timeFactor) * 1000000;
+	int64_t horizonNs = std::min<int64_t>(0xFF * unitNs, static_cast<int64_t>(MAX_ACTION_DURATION) * 1000000);
+	int64_t leadNs = atNs - m_clock.LatencyNs() - MonotonicNs();
+	if (leadNs > horizonNs)
+		return ERROR_BADPARAMETER;
+
+	// The delay is only a first guess, for the shadow and frame state: the
+	// I/O thread sets it again from dueNs once it knows when it writes.
+	Command timed = { action, timeFactor };
+	Retime(timed, leadNs);
+	return Send(timed.action, timeFactor, 0, atNs - m_clock.LatencyNs());
+}
+
+int Device::CancelTimeline()
+{
+	return m_timeline.Cancel();
+}
+
+void Device::PumpTimeline()
+{
+	// Released commands must leave as they are; a batch would hold them.
+	if (m_batchOpen)
+		return;
+
+	m_timeline.SetBudget(g_timelineBudget.load(std::memory_order_relaxed));
+	for (;;)
+	{
+		size_t room = kCommandQueueSize - std::min(m_queues[kPriorityLow].Size(), kCommandQueueSize);
+		size_t capacity = std::min(room, kMaxBatchCommands);
+		size_t count = m_timeline.Take(MonotonicNs(), m_timelineOut, m_timelineDue, capacity);
+		if (count == 0)
+			break;
+		// Released ahead of time, so they can give way to anything else;
+		// the I/O thread makes up for the wait.
+		QueueSequence(m_timelineOut, count, kPriorityLow, m_timelineDue);
+		if (count < capacity)
+			break;
+	}
+}
+
+int Device::Update()
+{
+	PollUpload();
+	PumpTimeline();
+
+	// The ring holds whole frames only; each call gets as many as fit.
+	for (;;)
+	{
+		size_t n = m_responses.Peek(m_rxBuffer, sizeof(m_rxBuffer));
+		size_t whole = 0;
+		while (whole + 3 <= n && whole + m_rxBuffer[whole + 2] + kFrameOverhead <= n)
+			whole += m_rxBuffer[whole + 2] + kFrameOverhead;
+		if (whole == 0)
+			break;
+		m_responses.Discard(whole);
+		if (m_callback != nullptr)
+			m_callback(m_id, m_rxBuffer, static_cast<int>(whole));
+	}
+	return m_ioError.exchange(0, std::memory_order_acq_rel);
+}
+
+void Device::GetQueueStats(QueueStats& out) const
+{
+	uint64_t enqueued = m_enqueued.load(std::memory_order_relaxed);
+	uint64_t dequeued = m_dequeued.load(std::memory_order_relaxed);
+	out.depth = static_cast<int>(enqueued > dequeued ? enqueued - dequeued : 0);
+	out.maxDepth = m_maxDepth.load(std::memory_order_relaxed);
+	out.enqueued = enqueued;
+	out.written = m_written.load(std::memory_order_relaxed);
+	out.dropped = m_dropped.load(std::memory_order_relaxed);
+	out.writes = m_writes.load(std::memory_order_relaxed);
+	out.wireLatencyTotalUs = m_wireLatencyTotalUs.load(std::memory_order_relaxed);
+	out.wireLatencyMaxUs = m_wireLatencyMaxUs.load(std::memory_order_relaxed);
+}
+
+void Device::SetCreditLimits(const CreditLimits& limits)
+{
+	m_limitActions.store(limits.actionList, std::memory_order_relaxed);
+	m_limitRamps.store(limits.rampList, std::memory_order_relaxed);
+	m_limitBusSlots.store(limits.busSlots, std::memory_order_relaxed);
+	Wake();
+}
+
+void Device::GetCredits(CreditState& out) const
+{
+	out.actions = m_creditActions.load(std::memory_order_relaxed);
+	out.ramps = m_creditRamps.load(std::memory_order_relaxed);
+	out.busSlots = m_limitBusSlots.load(std::memory_order_relaxed);
+	out.held = m_creditHeld.load(std::memory_order_relaxed);
+}
+
+void Device::PublishCredits(int64_t now)
+{
+	m_creditActions.store(m_credits.FreeActions(now), std::memory_order_relaxed);
+	m_creditRamps.store(m_credits.FreeRamps(now), std::memory_order_relaxed);
+	m_creditHeld.store(static_cast<int>(m_ioHeld), std::memory_order_relaxed);
+}
+
+void Device::ReportError(int error)
+{
+	int none = 0;
+	m_ioError.compare_exchange_strong(none, error, std::memory_order_acq_rel);
+}
+
+void Device::Service()
+{
+	if (int error = ReadReplies())
+		ReportError(error);
+	int64_t start = MonotonicNs();
+	PumpStream(start);
+	PumpTelemetry(start);
+	PumpProbe(start);
+	if (int error = Flush(false))
+		ReportError(error);
+	int64_t now = MonotonicNs();
+	ExpireInFlight(now);
+	PublishCredits(now);
+	// A delayed command or ramp that went out later than the ShadowCache
+	// allowed for has now run; whatever was cached since may be stale.
+	if (m_ioShadowLandNs != 0 && now >= m_ioShadowLandNs)
+	{
+		m_ioShadowLandNs = 0;
+		m_shadowEpoch.fetch_add(1, std::memory_order_release);
+	}
+}
+
+void Device::FinishIo()
+{
+	// Closing: send whatever is queued or held and let the controller judge
+	// it. With every in-flight slot taken this waits for replies, or for
+	// them to time out.
+	for (;;)
+	{
+		if (int error = Flush(true))
+			ReportError(error);
+		if (int error = ReadReplies())
+			ReportError(error);
+		int64_t now = MonotonicNs();
+		ExpireInFlight(now);
+		PublishCredits(now);
+		if (QueuedCount() == 0 && m_ioHeld == 0)
+			return;
+
+		int64_t deadline = IoDeadline();
+		int64_t remainingMs = deadline < 0 ? kIdleWaitMs : (deadline - now) / 1000000 + 1;
+		m_port.WaitReadable(static_cast<int>(std::min<int64_t>(std::max<int64_t>(remainingMs, 0), kIdleWaitMs)));
+	}
+}
+
+int64_t Device::IoDeadline() const
+{
+	// Wake for the oldest reply deadline and for the next list entry the
+	// controller frees, so held commands go out and credits stay current.
+	int64_t deadline = m_credits.NextRelease();
+	if (m_inFlightHead != m_inFlightTail)
+	{
+		int64_t reply = m_inFlight[m_inFlightHead % kMaxInFlight].sentNs + g_replyTimeoutNs.load(std::memory_order_relaxed);
+		if (deadline < 0 || reply < deadline)
+			deadline = reply;
+	}
+	// Streamed values waiting out the rate cap.
+	if (m_streamPending == 0 && OnlyLowHeld() && m_ioOutSent == m_ioOutLength && m_stream.Dirty()
+		&& (deadline < 0 || m_streamDueNs < deadline))
+		deadline = m_streamDueNs;
+	// Low priority commands waiting for the link to drain.
+	if (m_ioPacedNs != 0 && (deadline < 0 || m_ioPacedNs < deadline))
+		deadline = m_ioPacedNs;
+	if (m_ioShadowLandNs != 0 && (deadline < 0 || m_ioShadowLandNs < deadline))
+		deadline = m_ioShadowLandNs;
+	if (m_resyncUntilNs != 0 && (deadline < 0 || m_resyncUntilNs < deadline))
+		deadline = m_resyncUntilNs;
+	if (m_replyScanner.Buffered() != 0 && (deadline < 0 || m_replyStallNs < deadline))
+		deadline = m_replyStallNs;
+	// The next probe of an idle link.
+	if (m_selfTestUntilNs != 0)
+	{
+		if (deadline < 0 || m_selfTestUntilNs < deadline)
+			deadline = m_selfTestUntilNs;
+		return deadline;
+	}
+	if (m_inFlightHead != m_inFlightTail || m_ioHeld != 0 || m_ioOutSent < m_ioOutLength)
+		return deadline;
+	int64_t probeInterval = g_clockProbeIntervalNs.load(std::memory_order_relaxed);
+	if (probeInterval > 0)
+	{
+		int64_t probe = std::max<int64_t>(m_measuredNs + probeInterval, 0);
+		if (deadline < 0 || probe < deadline)
+			deadline = probe;
+	}
+	// The next status query.
+	int64_t query = m_poller.NextDue(g_batteryPollNs.load(std::memory_order_relaxed),
+		g_selfTestPollNs.load(std::memory_order_relaxed), m_ioLastWriteNs);
+	if (query >= 0 && (deadline < 0 || query < deadline))
+		deadline = query;
+	return deadline;
+}
+
+int Device::WritePending(bool force)
+{
+	const uint8_t* data = m_ioFrames + m_ioOutSent;
+	size_t length = m_ioOutLength - m_ioOutSent;
+	int error = 0;
+	if (force)
+	{
+		error = m_port.Write(data, length);
+		m_ioOutSent = m_ioOutLength;
+	}
+	else
+	{
+		long n = m_port.WriteSome(data, length);
+		if (n < 0)
+			error = static_cast<int>(-n);
+		else
+			m_ioOutSent += static_cast<size_t>(n);
+	}
+
+	if (error != 0 || m_ioOutSent == m_ioOutLength)
+	{
+		m_ioOutLength = 0;
+		m_ioOutSent = 0;
+	}
+	return error;
+}
+
+int Device::Flush(bool force)
+{
+	// The rest of the last write leaves before anything new is packed; the
+	// loop calls again once the port is writable.
+	if (m_ioOutSent < m_ioOutLength)
+	{
+		if (int error = WritePending(force))
+		{
+			m_shadowEpoch.fetch_add(1, std::memory_order_release);
+			return error;
+		}
+		if (m_ioOutSent < m_ioOutLength)
+			return 0;
+	}
+
+	// New frames would have their replies mixed up with the ones awaited.
+	if (m_resyncUntilNs != 0 && !force)
+		return 0;
+
+	// Anything written while a self test runs would be NAK'd (0x14).
+	if (m_selfTestUntilNs != 0 && !force)
+	{
+		if (MonotonicNs() < m_selfTestUntilNs)
+			return 0;
+		EndSelfTest();
+	}
+
+	int result = 0;
+	CreditLimits limits;
+	limits.actionList = m_limitActions.load(std::memory_order_relaxed);
+	limits.rampList = m_limitRamps.load(std::memory_order_relaxed);
+	limits.busSlots = m_limitBusSlots.load(std::memory_order_relaxed);
+	m_credits.SetLimits(limits);
+	m_ioBlocked = false;
+	m_ioPacedNs = 0;
+
+	for (;;)
+	{
+		int64_t bound = g_maxQueueLatencyNs.load(std::memory_order_relaxed);
+		int64_t now = MonotonicNs();
+		size_t room = kMaxInFlight - (m_inFlightTail - m_inFlightHead);
+		size_t limit = room < kMaxBatchCommands ? room : kMaxBatchCommands;
+		size_t held = m_ioHeld;
+		size_t count = held;
+		// A probe's wait would delay whatever shared its action list, so it
+		// leaves in a write of its own, as do status queries.
+		if (count != 0 && (m_ioCommands[count - 1].token == kProbeToken || m_ioCommands[count - 1].token == kTelemetryToken))
+			limit = count;
+		int spins = 0;
+
+		while (count < limit)
+		{
+			// The rest of a batch comes from its own queue ahead of anything
+			// else; lower classes leave room for high priority commands.
+			QueuedCommand& slot = m_ioCommands[count];
+			uint8_t open = count > 0 ? (m_ioCommands[count - 1].more ? m_ioCommands[count - 1].priority : kPriorityClasses)
+				: m_ioOpenClass;
+			if (!(open < kPriorityClasses && m_queues[open].TryPop(slot)))
+			{
+				if (count > 0 && open < kPriorityClasses && spins++ < kBatchWaitSpins)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				if (!PopQueued(slot, count + kPriorityReserve < limit))
+					break;
+			}
+
+			m_dequeued.fetch_add(1, std::memory_order_relaxed);
+			if (bound > 0 && now - slot.enqueueNs > bound)
+			{
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+				m_shadowEpoch.fetch_add(1, std::memory_order_release);
+				Resolve(slot.token, kCompletionError, ERROR_EAITIMEOUT, now, now);
+				result = ERROR_EAITIMEOUT;
+				continue;
+			}
+			++count;
+		}
+
+		if (count == 0)
+			return result;
+
+		// The rest of a partly written batch leads.
+		size_t pinned = 0;
+		while (m_ioOpenClass < kPriorityClasses && pinned < count && m_ioCommands[pinned].priority == m_ioOpenClass)
+		{
+			if (!m_ioCommands[pinned++].more)
+				break;
+		}
+		if (count > held && pinned == 0 && Preempt(held, count, limit, now))
+			pinned = 1;
+		OrderHeld(pinned, count);
+
+		// Timed commands get the delay that still runs them on time once
+		// they are through the link behind what is already on it.
+		size_t cut = count;
+		int64_t arriveNs = std::max(now, m_credits.LinkFreeNs());
+		for (size_t i = 0; i < count; ++i)
+		{
+			QueuedCommand& queued = m_ioCommands[i];
+			arriveNs += CreditModel::WireNs(queued.command.action.EncodedSize());
+			if (queued.dueNs != 0)
+				Retime(queued.command, queued.dueNs - arriveNs);
+			m_ioPacked[i] = queued.command;
+			// Nothing may follow a self test until it reports.
+			if (cut == count && m_ioPacked[i].action.command == TDK_COMMAND_SELFTEST)
+				cut = i + 1;
+		}
+		// Low priority commands, ordered last, wait for the link to drain and
+		// never take the last list entries.
+		size_t end = std::min(cut, limit);
+		size_t low = pinned;
+		while (low < end && m_ioCommands[low].priority != kPriorityLow)
+			++low;
+		if (!force)
+			end = Pace(low, end, now);
+		size_t admitted = m_credits.Admit(m_ioPacked, low, now, force, m_ioChunkEnd);
+		if (admitted == low && low < end)
+		{
+			CreditLimits reduced = limits;
+			if (limits.actionList > 0)
+				reduced.actionList = std::max(limits.actionList - kLowReserveActions, 1);
+			if (limits.rampList > 0)
+				reduced.rampList = std::max(limits.rampList - kLowReserveRamps, 1);
+			m_credits.SetLimits(reduced);
+			admitted += m_credits.Admit(m_ioPacked + low, end - low, now, force, m_ioChunkEnd + low);
+			m_credits.SetLimits(limits);
+		}
+
+		// Each chunk starts a new frame, checked by the controller on its own.
+		size_t length = 0;
+		for (size_t first = 0; first < admitted; )
+		{
+			size_t last = first;
+			while (!m_ioChunkEnd[last])
+				++last;
+			size_t frameCount = 0;
+			length += PackActionLists(m_ioPacked + first, last + 1 - first, m_ioFrames + length,
+				sizeof(m_ioFrames) - length, frameCount, m_ioLastInFrame + first);
+			first = last + 1;
+		}
+
+		m_ioOutLength = admitted != 0 ? length : 0;
+		m_ioOutSent = 0;
+		int error = admitted != 0 ? WritePending(force) : 0;
+		now = MonotonicNs();
+		if (error != 0)
+		{
+			m_dropped.fetch_add(admitted, std::memory_order_relaxed);
+			m_shadowEpoch.fetch_add(1, std::memory_order_release);
+			for (size_t i = 0; i < admitted; ++i)
+				Resolve(m_ioCommands[i].token, kCompletionError, error, now, now);
+			result = error;
+		}
+		else if (admitted != 0)
+		{
+			m_written.fetch_add(admitted, std::memory_order_relaxed);
+			m_writes.fetch_add(1, std::memory_order_relaxed);
+			m_stats.Wrote(length);
+			WireTrace::Instance().RecordFrames(m_id, kTraceOut, m_ioFrames, length);
+			bool timed = m_inFlightHead == m_inFlightTail && m_ioOutLength == 0 && m_ioLastInFrame[0];
+			bool background = false;
+			m_ioLastWriteNs = now;
+			for (size_t i = 0; i < admitted; ++i)
+			{
+				const QueuedCommand& written = m_ioCommands[i];
+				m_stats.Written(written.command.action.command, written.priority, now - written.enqueueNs);
+				if (written.command.action.command == TDK_COMMAND_STOP && written.command.action.delay == 0)
+				{
+					m_ioBackgroundUntilNs = 0;
+					m_ioKeepUntilNs = 0;
+					background = false;
+				}
+				else if (written.priority == kPriorityLow && written.dueNs == 0)
+					background = true;
+				else
+				{
+					// Anything else a Stop would cut short is left to run.
+					int64_t runsNs = RunsForNs(written.command);
+					if (runsNs < 0)
+						m_ioKeepUntilNs = std::max(m_ioKeepUntilNs, m_credits.LastRelease());
+					else if (runsNs != 0)
+						m_ioKeepUntilNs = std::max(m_ioKeepUntilNs, std::max(now, m_credits.LinkFreeNs()) + runsNs);
+				}
+				// The ShadowCache counted from submission, or from when a
+				// timed command was due, less the delay it went with.
+				int64_t settleNs = ShadowCache::SettleNs(written.command.action, written.command.timeFactor);
+				if (settleNs != 0)
+				{
+					int64_t landNs = std::max(now, m_credits.LinkFreeNs()) + settleNs;
+					int64_t plannedNs = written.dueNs != 0
+						? written.dueNs - static_cast<int64_t>(written.command.action.delay) * written.command.timeFactor * 1000000
+						: written.enqueueNs;
+					if (landNs > plannedNs + settleNs + kShadowTransitNs)
+						m_ioShadowLandNs = std::max(m_ioShadowLandNs, landNs);
+				}
+				uint32_t latencyUs = static_cast<uint32_t>((now - m_ioCommands[i].enqueueNs) / 1000);
+				m_wireLatencyTotalUs.fetch_add(latencyUs, std::memory_order_relaxed);
+				if (latencyUs > m_wireLatencyMaxUs.load(std::memory_order_relaxed))
+					m_wireLatencyMaxUs.store(latencyUs, std::memory_order_relaxed);
+
+				InFlightCommand& entry = m_inFlight[m_inFlightTail++ % kMaxInFlight];
+				entry.sentNs = now;
+				entry.enqueueNs = m_ioCommands[i].enqueueNs;
+				entry.token = m_ioCommands[i].token;
+				entry.command = m_ioCommands[i].command.action.command;
+				entry.priority = m_ioCommands[i].priority;
+				entry.lastInFrame = m_ioLastInFrame[i];
+				entry.timed = timed && i == 0;
+				if (entry.command == TDK_COMMAND_SELFTEST)
+				{
+					const Command& selfTest = m_ioCommands[i].command;
+					m_selfTestUntilNs = now + static_cast<int64_t>(selfTest.action.delay) * selfTest.timeFactor * 1000000
+						+ kSelfTestTimeoutNs;
+					m_telemetry.SetSelfTestRunning(true);
+				}
+			}
+			if (background)
+				m_ioBackgroundUntilNs = std::max(m_ioBackgroundUntilNs, m_credits.LastRelease());
+		}
+
+		if (admitted != 0)
+			m_ioOpenClass = m_ioCommands[admitted - 1].more ? m_ioCommands[admitted - 1].priority : kPriorityClasses;
+		m_ioHeld = count - admitted;
+		if (m_ioHeld != 0)
+		{
+			memmove(m_ioCommands, m_ioCommands + admitted, m_ioHeld * sizeof(QueuedCommand));
+			m_ioBlocked = true;
+			return result;
+		}
+		if (m_ioOutSent < m_ioOutLength || (m_selfTestUntilNs != 0 && !force))
+			return result;
+	}
+}
+
+void Device::OrderHeld(size_t first, size_t count)
+{
+	// A batch at a time, in class order and in arrival order within a
+	// class. An unfinished batch stays last so its rest can follow it.
+	size_t end = count;
+	while (end > first && m_ioCommands[end - 1].more)
+		--end;
+
+	// The library's own commands lead.
+	size_t ordered = 0;
+	for (int rank = 0; rank <= kPriorityClasses; ++rank)
+	{
+		int priority = rank == 0 ? kPriorityInternal : rank - 1;
+		for (size_t start = first; start < end; )
+		{
+			size_t last = start;
+			while (m_ioCommands[last].more)
+				++last;
+			if (m_ioCommands[start].priority == priority)
+			{
+				memcpy(m_ioOrdered + ordered, m_ioCommands + start, (last + 1 - start) * sizeof(QueuedCommand));
+				ordered += last + 1 - start;
+			}
+			start = last + 1;
+		}
+	}
+	memcpy(m_ioCommands + first, m_ioOrdered, ordered * sizeof(QueuedCommand));
+}
+
+bool Device::Preempt(size_t held, size_t& count, size_t limit, int64_t now)
+{
+	// A high priority command just taken, with low priority commands still
+	// on the controller's lists, goes out behind a Stop that clears them.
+	// The controller's Stop covers every tactor and every class, so it is
+	// only sent while nothing else written, nor a timed low priority
+	// command, can still be waiting or running there.
+	if (!g_preemptStop.load(std::memory_order_relaxed) || count >= limit || now >= m_ioBackgroundUntilNs
+		|| now < m_ioKeepUntilNs)
+		return false;
+	// One Stop waiting ahead is enough.
+	if (held != 0 && m_ioCommands[0].priority == kPriorityInternal)
+		return false;
+
+	bool urgent = false;
+	for (size_t i = held; i < count && !urgent; ++i)
+		urgent = m_ioCommands[i].priority == kPriorityHigh;
+	if (!urgent)
+		return false;
+
+	memmove(m_ioCommands + 1, m_ioCommands, count * sizeof(QueuedCommand));
+	QueuedCommand& stop = m_ioCommands[0];
+	MakeSimple(stop.command.action, TDK_COMMAND_STOP, 0, kDefaultTimeFactor);
+	stop.command.timeFactor = kDefaultTimeFactor;
+	stop.enqueueNs = now;
+	stop.dueNs = 0;
+	stop.token = 0;
+	stop.priority = kPriorityInternal;
+	stop.more = false;
+	++count;
+	m_stats.Submitted(TDK_COMMAND_STOP);
+	m_stats.Preempted();
+	m_shadowEpoch.fetch_add(1, std::memory_order_release);
+	return true;
+}
+
+size_t Device::Pace(size_t first, size_t count, int64_t now)
+{
+	int64_t backlogNs = m_credits.LinkFreeNs() - now;
+	for (size_t i = first; i < count; ++i)
+	{
+		if (backlogNs >= kLowBacklogNs)
+		{
+			m_ioPacedNs = now + backlogNs - kLowBacklogNs;
+			return i;
+		}
+		backlogNs += CreditModel::WireNs(m_ioPacked[i].action.EncodedSize());
+	}
+	return count;
+}
+
+int Device::ReadReplies()
+{
+	int result = 0;
+	for (;;)
+	{
+		size_t capacity;
+		uint8_t* space = m_replyScanner.WriteSpace(capacity);
+		long n = m_port.Read(space, capacity);
+		if (n < 0)
+			return static_cast<int>(-n);
+		if (n == 0)
+			return result;
+		m_replyScanner.Wrote(static_cast<size_t>(n));
+
+		int64_t now = MonotonicNs();
+		if (m_resyncUntilNs != 0)
+			BeginResync(now);
+		if (int error = ScanReplies(now))
+		{
+			if (result == 0)
+				result = error;
+		}
+		m_replyStallNs = now + kResyncQuietNs;
+	}
+}
+
+// Handles every reply read so far.
+int Device::ScanReplies(int64_t now)
+{
+	int result = 0;
+	ReplyScanner::Frame frame;
+	for (;;)
+	{
+		uint64_t skipped = m_replyScanner.Skipped();
+		ReplyScanner::Result scanned = m_replyScanner.Next(frame);
+		// Anything but a whole frame can only be a damaged reply, which may
+		// have been an ACK or NAK.
+		if (m_replyScanner.Skipped() != skipped)
+		{
+			BeginResync(now);
+			if (result == 0)
+				result = ERROR_TM_FAILED_PACKET_PARSE;
+		}
+		if (scanned == ReplyScanner::kNeedMore)
+			return result;
+		if (scanned == ReplyScanner::kFrame && !HandleReply(frame, now) && result == 0)
+			result = ERROR_PARTIALREAD;
+	}
+}
+
+// Part of a frame read long ago with nothing since: its header is damaged,
+// and any replies behind it are found by looking past its STX.
+void Device::ExpireStall(int64_t now)
+{
+	if (m_replyScanner.Buffered() == 0 || now < m_replyStallNs)
+		return;
+
+	while (m_replyScanner.Abandon())
+	{
+		BeginResync(now);
+		if (int error = ScanReplies(now))
+			ReportError(error);
+	}
+	ReportError(ERROR_TM_FAILED_PACKET_PARSE);
+}
+
+// Acts on one intact reply and queues it for the data callback. Returns
+// false if the callback ring had no room for it.
+bool Device::HandleReply(const ReplyScanner::Frame& frame, int64_t now)
+{
+	WireTrace::Instance().Record(m_id, kTraceIn, frame.bytes, frame.size);
+
+	// Replies to the library's own probes and status queries are kept from
+	// the data callback.
+	bool internal = false;
+	if (frame.type == kFrameTypeData)
+		internal = HandleData(frame.payload, frame.length, now);
+	else
+	{
+		uint8_t reason = frame.type == kFrameTypeNak ? frame.payload[0] : 0;
+		size_t answered = m_resyncUntilNs != 0 ? m_resyncCursor : m_inFlightHead;
+		if (answered != m_inFlightTail)
+		{
+			int token = m_inFlight[answered % kMaxInFlight].token;
+			internal = token == kProbeToken || token == kTelemetryToken;
+		}
+
+		if (m_resyncUntilNs == 0)
+			ApplyReply(frame.type, reason, now);
+		else
+		{
+			HeldReply& held = m_resyncReplies[m_resyncHeld++];
+			held.receivedNs = now;
+			held.type = frame.type;
+			held.reason = reason;
+			while (m_resyncCursor != m_inFlightTail)
+			{
+				if (m_inFlight[m_resyncCursor++ % kMaxInFlight].lastInFrame)
+					break;
+			}
+			// Every frame has its reply, so none went missing.
+			if (m_resyncHeld == m_resyncFrames)
+				EndResync();
+		}
+	}
+
+	if (internal)
+		return true;
+	// Only whole frames go to the callback; the API thread only ever frees
+	// room, so the check cannot go stale.
+	if (kResponseRingSize - m_responses.Size() < frame.size)
+		return false;
+	m_responses.Write(frame.bytes, frame.size);
+	return true;
+}
+
+// Resolves the oldest frame in flight with an ACK or NAK received at now.
+void Device::ApplyReply(uint8_t type, uint8_t reason, int64_t now)
+{
+	if (type == kFrameTypeAck)
+	{
+		if (m_inFlightHead != m_inFlightTail)
+		{
+			const InFlightCommand& head = m_inFlight[m_inFlightHead % kMaxInFlight];
+			int64_t roundTripNs = now - head.sentNs;
+			m_stats.Acked(roundTripNs);
+			if (head.timed)
+			{
+				m_clock.Sample(roundTripNs);
+				m_measuredNs = head.sentNs + roundTripNs;
+			}
+		}
+		ResolveFrame(kCompletionAck, 0);
+		return;
+	}
+
+	// kNakBadEtx and kNakBadChecksum mean the controller got the frame
+	// damaged and dropped it; its own parser resynchronises on the next STX,
+	// so the frame fails like any other NAK'd one.
+	m_shadowEpoch.fetch_add(1, std::memory_order_release);
+	m_credits.Rejected();
+	m_stats.Naked(reason);
+	ResolveFrame(kCompletionNak, reason);
+}
+
+// Without sequence numbers a lost ACK or NAK would shift every later reply
+// onto the wrong frame. Called for a damaged reply and for each read while
+// resynchronising, which pushes the quiet deadline out.
+void Device::BeginResync(int64_t now)
+{
+	if (m_resyncUntilNs == 0)
+	{
+		if (m_inFlightHead == m_inFlightTail)
+			return;
+		m_resyncFrames = 0;
+		for (size_t i = m_inFlightHead; i != m_inFlightTail; ++i)
+			m_resyncFrames += m_inFlight[i % kMaxInFlight].lastInFrame;
+		m_resyncHeld = 0;
+		m_resyncCursor = m_inFlightHead;
+	}
+	m_resyncUntilNs = std::max(now, m_credits.LinkFreeNs()) + kResyncQuietNs;
+}
+
+void Device::EndResync()
+{
+	m_resyncUntilNs = 0;
+	if (m_resyncHeld == m_resyncFrames)
+	{
+		for (size_t i = 0; i < m_resyncHeld; ++i)
+			ApplyReply(m_resyncReplies[i].type, m_resyncReplies[i].reason, m_resyncReplies[i].receivedNs);
+		return;
+	}
+
+	// Some reply was lost and there is no telling which, so no frame then in
+	// flight has a known outcome.
+	m_shadowEpoch.fetch_add(1, std::memory_order_release);
+	for (size_t i = 0; i < m_resyncFrames && m_inFlightHead != m_inFlightTail; ++i)
+		ResolveFrame(kCompletionError, ERROR_TM_FAILED_PACKET_PARSE);
+}
+
+// Status replies are recorded whoever asked for them. Returns true for the
+// answer to the poller's own query, which the data callback does not see.
+bool Device::HandleData(const uint8_t* payload, size_t length, int64_t now)
+{
+	if (!m_telemetry.Record(payload, length, now))
+		return false;
+
+	if (payload[0] == TDK_COMMAND_SELFTEST)
+		m_selfTestUntilNs = 0;
+	return m_poller.Answered(payload[0], now);
+}
+
+void Device::Resolve(int token, int status, int detail, int64_t sentNs, int64_t now)
+{
+	if (token == kUploadToken)
+	{
+		if (status == kCompletionAck)
+			m_uploadAcks.fetch_add(1, std::memory_order_release);
+		else
+			m_uploadFailures.fetch_add(1, std::memory_order_release);
+		return;
+	}
+	if (token == kProbeToken)
+		return;
+	if (token == kTelemetryToken)
+	{
+		if (status != kCompletionAck)
+			m_poller.Failed();
+		return;
+	}
+	if (token <= kStreamToken)
+	{
+		--m_streamPending;
+		if (status != kCompletionAck)
+			m_stream.Retry(kStreamToken - token);
+		return;
+	}
+	if (token == 0 || m_completions == nullptr)
+		return;
+
+	Completion completion;
+	completion.boardId = m_id;
+	completion.token = token;
+	completion.status = status;
+	completion.detail = detail;
+	completion.roundTripUs = static_cast<uint32_t>((now - sentNs) / 1000);
+	m_completions->Push(completion);
+}
+
+void Device::ResolveFrame(int status, int detail)
+{
+	int64_t now = MonotonicNs();
+	while (m_inFlightHead != m_inFlightTail)
+	{
+		const InFlightCommand& entry = m_inFlight[m_inFlightHead++ % kMaxInFlight];
+		if (entry.command == TDK_COMMAND_SELFTEST && status != kCompletionAck)
+			EndSelfTest();
+		if (status == kCompletionAck)
+			m_stats.Replied(entry.priority, now - entry.enqueueNs);
+		Resolve(entry.token, status, detail, entry.sentNs, now);
+		if (entry.lastInFrame)
+			return;
+	}
+}
+
+void Device::ExpireInFlight(int64_t now)
+{
+	ExpireStall(now);
+	if (m_resyncUntilNs != 0 && now >= m_resyncUntilNs)
+		EndResync();
+	if (m_inFlightHead == m_inFlightTail)
+		return;
+
+	// Without sequence numbers a lost reply shifts every later match, so
+	// once the oldest frame times out nothing still in flight can be trusted.
+	int64_t timeout = g_replyTimeoutNs.load(std::memory_order_relaxed);
+	if (now - m_inFlight[m_inFlightHead % kMaxInFlight].sentNs > timeout)
+	{
+		m_stats.TimedOut(m_inFlightTail - m_inFlightHead);
+		FailInFlight(ERROR_EAITIMEOUT);
+	}
+}
+
+void Device::FailInFlight(int error)
+{
+	if (m_inFlightHead != m_inFlightTail)
+		m_shadowEpoch.fetch_add(1, std::memory_order_release);
+
+	int64_t now = MonotonicNs();
+	while (m_inFlightHead != m_inFlightTail)
+	{
+		const InFlightCommand& entry = m_inFlight[m_inFlightHead++ % kMaxInFlight];
+		if (entry.command == TDK_COMMAND_SELFTEST)
+			EndSelfTest();
+		Resolve(entry.token, kCompletionError, error, entry.sentNs, now);
+	}
+	m_replyScanner.Reset();
+	m_resyncUntilNs = 0;
+}
+
+} // namespace tdk
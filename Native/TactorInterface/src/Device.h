@@ -0,0 +1,459 @@
+/************************************************************************
+*                                                                       *
+*   Device.h -- one connected tactor controller                         *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_DEVICE_H_
+#define TDK_DEVICE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "ByteRing.h"
+#include "ClockSync.h"
+#include "Completion.h"
+#include "CreditModel.h"
+#include "DeviceStats.h"
+#include "MpscQueue.h"
+#include "Protocol.h"
+#include "ReplyScanner.h"
+#include "SerialPort.h"
+#include "ShadowCache.h"
+#include "SpatialRenderer.h"
+#include "StoredSlots.h"
+#include "StreamChannels.h"
+#include "TactorFrame.h"
+#include "Telemetry.h"
+#include "Timeline.h"
+
+#ifdef WIN32
+	#define TDK_CALLBACK __stdcall
+#else
+	#define TDK_CALLBACK
+#endif
+
+namespace tdk
+{
+
+class EventLoop;
+
+// Signature of the response callback handed to Connect (see
+// TdkDefines.DataCallbackDelegate).
+typedef void (TDK_CALLBACK *DataCallback)(int boardId, unsigned char* data, int size);
+
+const size_t kRxBufferSize = 512;
+static_assert(kRxBufferSize >= kMaxFrameSize, "a data callback must hold a whole frame");
+const size_t kMaxBatchCommands = 64;
+const size_t kCommandQueueSize = 256;
+const size_t kResponseRingSize = 4096;
+// Commands written but not yet answered by an ACK or NAK.
+const size_t kMaxInFlight = 1024;
+// Priority classes, most urgent first. Each has a queue of its own.
+const uint8_t kPriorityHigh = 0;
+const uint8_t kPriorityNormal = 1;
+const uint8_t kPriorityLow = 2;
+// Commands the library sends itself, which no class counts.
+const uint8_t kPriorityInternal = kPriorityClasses;
+// Room the I/O thread keeps for high priority commands however many others
+// wait for credits.
+const size_t kPriorityReserve = 8;
+
+// A command waiting for the I/O thread. more is set on every command of a
+// batch except the last so the batch leaves in one write. token is 0 unless
+// the caller asked for a completion. A command timed to a host time carries
+// it in dueNs, link latency already taken off, and its delay is worked out
+// again as it is written; otherwise dueNs is 0 and the delay stands.
+struct QueuedCommand
+{
+	Command command;
+	int64_t enqueueNs;
+	int64_t dueNs;
+	int token;
+	uint8_t priority;
+	bool more;
+};
+
+// A written command awaiting the reply to its frame. The controller answers
+// each frame with exactly one ACK or NAK, in order, so replies are matched
+// to frames first-in first-out.
+struct InFlightCommand
+{
+	int64_t sentNs;
+	int64_t enqueueNs;
+	int token;
+	uint8_t command;
+	uint8_t priority;
+	bool lastInFrame;
+	// The first frame of a write made with nothing else in flight, holding
+	// a single command: its round trip measures the link alone.
+	bool timed;
+};
+
+// An ACK or NAK that arrived while replies were being resynchronised.
+struct HeldReply
+{
+	int64_t receivedNs;
+	uint8_t type;
+	uint8_t reason;
+};
+
+struct QueueStats
+{
+	int depth;
+	int maxDepth;
+	uint64_t enqueued;
+	uint64_t written;
+	uint64_t dropped;
+	uint64_t writes;
+	uint64_t wireLatencyTotalUs;
+	uint32_t wireLatencyMaxUs;
+};
+
+// Room the I/O thread believes the controller has, as of its last pass.
+struct CreditState
+{
+	int actions;
+	int ramps;
+	int busSlots;
+	int held;		// commands waiting for room
+};
+
+// Command functions only validate, encode and push onto a lock-free queue;
+// the I/O thread of the EventLoop the device is attached to drains the
+// queue, coalesces whatever is waiting into as few frames as possible and
+// owns every read and write on the port. Replies and I/O errors are handed
+// back to the API thread through Update. The API side of a device is used
+// by one thread at a time, under its own ApiLock.
+//
+// Each priority class has its own queue. The I/O thread takes the high
+// queue first and writes what it took ahead of anything of a lower class
+// still held for credits; only the rest of a batch already partly written
+// stays in front. Low priority commands are only written while little else
+// is on the wire, and leave the last list entries to the other classes.
+class Device
+{
+public:
+	Device();
+	~Device();
+
+	// completions receives the outcome of every command sent with a token;
+	// loop serves the port until Close.
+	int Open(int id, const char* name, int type, DataCallback callback, CompletionQueue* completions,
+		EventLoop* loop);
+	// Flushes anything still queued, detaches from the loop and closes the
+	// port.
+	void Close();
+	bool IsOpen() const { return m_open.load(std::memory_order_acquire); }
+	// Held around every API call on this device (see DeviceGuard), so calls
+	// on different devices never wait for each other. Recursive so data
+	// callbacks run by Update may call back into the API.
+	std::recursive_mutex& ApiLock() { return m_apiLock; }
+
+	int Id() const { return m_id; }
+	int Type() const { return m_type; }
+	// Resolved path of the port last opened; only Open, under the
+	// DeviceManager table lock, changes it.
+	const char* PortName() const { return m_lastPort; }
+
+	// Queues a single action, or adds it to the open batch. A non-zero token
+	// from NextToken is reported through the completion queue. A non-zero
+	// dueNs times the action as QueuedCommand describes.
+	int Send(const Action& action, uint8_t timeFactor, int token = 0, int64_t dueNs = 0);
+	// Queues commands so they leave in one write, or adds them to the open
+	// batch.
+	int SendSequence(const Command* commands, size_t count);
+	int NextToken();
+	// The class of every command the calling thread sends from now on, to
+	// any device. Timeline releases and stored TAction uploads are always
+	// kPriorityLow.
+	static void SetSendPriority(uint8_t priority);
+	// Whether a high priority command that finds low priority commands
+	// still pending on the controller's lists is preceded by a Stop.
+	static void SetPreemptStop(bool enabled);
+
+	// Plays a generated TAction sequence. Sequences played often are
+	// uploaded into a stored TAction slot in the background and, once the
+	// controller has acknowledged the upload, replayed with PlayStoredTAction.
+	int PlaySequence(const CommandKey& key, const Command* commands, size_t count);
+	const StoredSlotStats& GetStoredSlotStats() const { return m_storedSlots.Stats(); }
+	// How many slots, counted down from TDK_MAX_STORED_TACTIONS, the
+	// automatic upload may use. 0 turns it off.
+	static void SetStoredSlotCount(int count);
+
+	// Sends only what changed since the last frame (see TactorFrame), in
+	// one write or into the open batch or timeline. Returns the number of
+	// commands sent, or -error.
+	int SendFrame(const uint8_t* intensities, int msDelay, int timeFactor);
+
+	// Contact rendering (see SpatialRenderer). PlaceTactor takes the tactor
+	// at offset of a controller segment. RenderContacts sends the rendered
+	// intensities as a frame and returns the number of commands sent, or
+	// -error.
+	int PlaceTactor(int segment, int offset, float x, float y, float z);
+	void ClearTactorPlaces() { m_renderer.Clear(); }
+	void SetContactRadius(float radius) { m_renderer.SetRadius(radius); }
+	int RenderContacts(const Contact* contacts, size_t count, int msDelay, int timeFactor);
+
+	// First tactor of a controller segment, from the last segment list the
+	// controller reported (see ReadSegmentList), or -error.
+	int SegmentBase(int segment, int offset) const;
+
+	// The controller's latest status replies (see Telemetry). The I/O thread
+	// asks for them itself when the link is idle; the replies to its own
+	// queries are kept from the data callback.
+	void GetTelemetry(TelemetrySnapshot& out) const { m_telemetry.Read(out); }
+	// How often the battery level is read and a self test run, 0 never.
+	static void SetTelemetryIntervalsMs(int batteryMs, int selfTestMs);
+
+	// While a batch is open Send only collects. CommitBatch queues the
+	// collected commands so the I/O thread writes them at once; it returns
+	// the number of commands queued, or -error.
+	int BeginBatch();
+	int CommitBatch();
+	bool BatchOpen() const { return m_batchOpen; }
+
+	// While a timeline is being recorded Send only collects, at the current
+	// offset plus the command's own delay. PlayTimeline starts the recording
+	// delayMs from now and returns the number of commands scheduled, or
+	// -error; Update releases them ahead of time (see Timeline). A Stop
+	// cancels whatever has not been released.
+	int BeginTimeline();
+	int SetTimelineOffset(int ms);
+	int PlayTimeline(int delayMs);
+	int CancelTimeline();
+	const TimelineStats& GetTimelineStats() const { return m_timeline.Stats(); }
+	// Timeline commands allowed on the controller's action list at once.
+	static void SetTimelineBudget(int actions);
+
+	// Makes the GAIN or FREQ in action the newest target of its stream
+	// channel instead of queuing it (see StreamChannels). The I/O thread
+	// sends waiting channels once the previous streamed frame is answered
+	// and, at most, once per stream interval, so values set faster than the
+	// link drains replace each other rather than queue.
+	int Stream(const Action& action);
+	void GetStreamStats(StreamStats& out) const { m_stream.Read(out); }
+	// Cap on streamed frames per second per device; 0 removes the cap.
+	static void SetStreamRate(int hz);
+
+	// Sends action so the controller runs it at host time atNs (see
+	// MonotonicNs): the action delay is what remains once the estimated
+	// link latency (see ClockSync) is taken off, rounded to the time
+	// factor, as of when it is written. An action already due goes out
+	// undelayed; one further off than an action delay can reach fails with
+	// ERROR_BADPARAMETER.
+	int SendAt(const Action& action, uint8_t timeFactor, int64_t atNs);
+	// PlayTimeline, starting the recording at host time atNs less the
+	// estimated link latency. Released commands are timed like SendAt's.
+	int PlayTimelineAt(int64_t atNs);
+	void GetClockSync(ClockSyncState& out) const { m_clock.Read(out); }
+	// How long the link may be idle before the I/O thread sends an empty
+	// ACTION_WAIT to measure it; 0 leaves only the replies to commands.
+	static void SetClockProbeIntervalMs(int ms);
+
+	// API thread: forwards replies to the data callback and returns the
+	// oldest unreported I/O error, or 0.
+	int Update();
+
+	void GetQueueStats(QueueStats& out) const;
+	void GetStats(StatsSnapshot& out) const { m_stats.Read(out); }
+	// The controller's list sizes, used by the I/O thread to hold commands
+	// back rather than have a frame NAK'd (see CreditModel).
+	void SetCreditLimits(const CreditLimits& limits);
+	void GetCredits(CreditState& out) const;
+	const ShadowStats& GetShadowStats() const { return m_shadow.Stats(); }
+
+	// Commands older than this when the I/O thread reaches them are dropped
+	// and reported as ERROR_EAITIMEOUT. 0 disables the bound.
+	static void SetMaxQueueLatencyMs(int ms);
+	// How long a written frame may wait for its ACK or NAK.
+	static void SetReplyTimeoutMs(int ms);
+	// Whether Send drops commands the ShadowCache finds redundant.
+	static void SetShadowCacheEnabled(bool enabled);
+
+	// EventLoop side; called on the loop thread or under the loop's lock.
+	int PortFd() const { return m_port.Fd(); }
+	// True once per Wake.
+	bool TakeWake() { return m_wakePending.exchange(false, std::memory_order_acq_rel); }
+	// Reads replies, writes what is queued and expires overdue frames.
+	void Service();
+	// Writes everything still queued, waiting as needed; used on Detach.
+	void FinishIo();
+	// Next time Service has work without being woken, or -1.
+	int64_t IoDeadline() const;
+	// Part of the last write is still waiting for the port.
+	bool WantsWrite() const { return m_ioOutSent < m_ioOutLength; }
+
+private:
+	bool Enqueue(const Command& command, int token, bool more, uint8_t priority, int64_t dueNs = 0);
+	// True if count commands of priority can all be queued. Every command of
+	// a batch must be, or the I/O thread waits for the rest of it forever.
+	bool HasRoom(uint8_t priority, size_t count) const;
+	size_t QueuedCount() const;
+	bool PopQueued(QueuedCommand& slot, bool lowerClasses);
+	void OrderHeld(size_t first, size_t count);
+	bool Preempt(size_t held, size_t& count, size_t limit, int64_t now);
+	size_t Pace(size_t first, size_t count, int64_t now);
+	bool Suppress(const Action& action, uint8_t timeFactor, int64_t now);
+	int QueueSequence(const Command* commands, size_t count, uint8_t priority, const int64_t* dueNs = nullptr);
+	void PumpTimeline();
+	void PumpStream(int64_t now);
+	bool OnlyLowHeld() const;
+	void PumpProbe(int64_t now);
+	void PumpTelemetry(int64_t now);
+	void EndSelfTest();
+	void Wake();
+	int Flush(bool force);
+	int WritePending(bool force);
+	int ReadReplies();
+	int ScanReplies(int64_t now);
+	void ExpireStall(int64_t now);
+	bool HandleReply(const ReplyScanner::Frame& frame, int64_t now);
+	void ApplyReply(uint8_t type, uint8_t reason, int64_t now);
+	void BeginResync(int64_t now);
+	void EndResync();
+	void ReportError(int error);
+	bool HandleData(const uint8_t* payload, size_t length, int64_t now);
+	void StartUpload(int slot);
+	void PollUpload();
+	void Resolve(int token, int status, int detail, int64_t sentNs, int64_t now);
+	void ResolveFrame(int status, int detail);
+	void ExpireInFlight(int64_t now);
+	void FailInFlight(int error);
+	void PublishCredits(int64_t now);
+
+	int m_id;
+	int m_type;
+	std::atomic<bool> m_open;
+	std::recursive_mutex m_apiLock;
+	DataCallback m_callback;
+	CompletionQueue* m_completions;
+	SerialPort m_port;
+	EventLoop* m_loop;
+	std::atomic<bool> m_wakePending;
+	std::atomic<int> m_ioError;
+	std::atomic<int> m_nextToken;
+	// Bumped by the I/O thread whenever the device may not have applied
+	// what was sent (NAK, timeout, dropped command).
+	std::atomic<uint32_t> m_shadowEpoch;
+	// Outcomes of commands carrying kUploadToken, counted by the I/O thread.
+	std::atomic<uint32_t> m_uploadAcks;
+	std::atomic<uint32_t> m_uploadFailures;
+	// Set by the API thread, read by the I/O thread.
+	std::atomic<int> m_limitActions;
+	std::atomic<int> m_limitRamps;
+	std::atomic<int> m_limitBusSlots;
+	// Published by the I/O thread.
+	std::atomic<int> m_creditActions;
+	std::atomic<int> m_creditRamps;
+	std::atomic<int> m_creditHeld;
+	StreamChannels m_stream;
+	// Written by the I/O thread.
+	Telemetry m_telemetry;
+	// Sampled by the I/O thread.
+	ClockSync m_clock;
+
+	// Owned by the I/O thread.
+	MpscQueue<QueuedCommand, kCommandQueueSize> m_queues[kPriorityClasses];
+	QueuedCommand m_ioCommands[kMaxBatchCommands];
+	QueuedCommand m_ioOrdered[kMaxBatchCommands];
+	Command m_ioPacked[kMaxBatchCommands];
+	uint8_t m_ioFrames[PackedSizeBound(kMaxBatchCommands)];
+	bool m_ioLastInFrame[kMaxBatchCommands];
+	bool m_ioChunkEnd[kMaxBatchCommands];
+	// m_ioCommands[0, m_ioHeld) were popped but are waiting for credits.
+	size_t m_ioHeld;
+	// Class of the batch whose start was written but not its end, or
+	// kPriorityClasses: the rest of it leaves before anything else.
+	uint8_t m_ioOpenClass;
+	// Low priority commands written may still be on the controller's lists
+	// until then.
+	int64_t m_ioBackgroundUntilNs;
+	// Commands a Stop must not clear, of a higher class or timed, may still
+	// be waiting or running on the controller until then.
+	int64_t m_ioKeepUntilNs;
+	// Low priority commands are held for the link until then; 0 when none
+	// are.
+	int64_t m_ioPacedNs;
+	// A delayed command or ramp written after the time the ShadowCache
+	// allowed for runs until then; 0 when none does.
+	int64_t m_ioShadowLandNs;
+	bool m_ioBlocked;
+	// m_ioFrames[m_ioOutSent, m_ioOutLength) is still to be written.
+	size_t m_ioOutLength;
+	size_t m_ioOutSent;
+	CreditModel m_credits;
+	ReplyScanner m_replyScanner;
+	ByteRing<kResponseRingSize> m_responses;
+	InFlightCommand m_inFlight[kMaxInFlight];
+	size_t m_inFlightHead;
+	size_t m_inFlightTail;
+	// Streamed commands taken but not yet answered, and when the next
+	// flush may be taken.
+	size_t m_streamPending;
+	int64_t m_streamDueNs;
+	Command m_streamOut[kMaxBatchCommands];
+	int m_streamChannels[kMaxBatchCommands];
+	// When the link was last measured or probed; the next probe is due an
+	// interval later.
+	int64_t m_measuredNs;
+	TelemetryPoller m_poller;
+	int64_t m_ioLastWriteNs;
+	// Nothing is written until a running self test reports or this passes;
+	// 0 when none runs.
+	int64_t m_selfTestUntilNs;
+	// After a damaged reply nothing new is written until every frame then
+	// in flight has its reply or the link stays quiet until this passes; 0
+	// when replies are in step. Replies are held meanwhile and only matched
+	// to frames once none turned out to be missing.
+	int64_t m_resyncUntilNs;
+	size_t m_resyncFrames;
+	size_t m_resyncHeld;
+	// First in-flight entry of the frame the next held reply answers.
+	size_t m_resyncCursor;
+	HeldReply m_resyncReplies[kMaxInFlight];
+	// When part of a frame still buffered counts as damaged.
+	int64_t m_replyStallNs;
+
+	// Owned by the API thread.
+	uint8_t m_rxBuffer[kRxBufferSize];
+	bool m_batchOpen;
+	size_t m_batchCount;
+	Command m_batch[kMaxBatchCommands];
+	int m_batchTokens[kMaxBatchCommands];
+	int64_t m_batchDue[kMaxBatchCommands];
+	ShadowCache m_shadow;
+	uint32_t m_shadowSeenEpoch;
+	StoredSlotManager m_storedSlots;
+	char m_lastPort[kMaxPortName];
+	int m_uploadSlot;
+	uint32_t m_uploadExpected;
+	uint32_t m_uploadAckBase;
+	uint32_t m_uploadFailureBase;
+	Command m_upload[TDK_MAX_STORED_TACTION_LENGTH + 2];
+	Timeline m_timeline;
+	Command m_timelineOut[kMaxBatchCommands];
+	int64_t m_timelineDue[kMaxBatchCommands];
+	TactorFrame m_frame;
+	uint32_t m_frameSeenEpoch;
+	Command m_frameOut[kMaxFrameCommands];
+	SpatialRenderer m_renderer;
+	uint8_t m_rendered[kMaxTactors];
+
+	std::atomic<uint64_t> m_enqueued;
+	std::atomic<uint64_t> m_dequeued;
+	std::atomic<int> m_maxDepth;
+	std::atomic<uint64_t> m_written;
+	std::atomic<uint64_t> m_dropped;
+	std::atomic<uint64_t> m_writes;
+	std::atomic<uint64_t> m_wireLatencyTotalUs;
+	std::atomic<uint32_t> m_wireLatencyMaxUs;
+	DeviceStats m_stats;
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,475 @@
+#include "DeviceManager.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace tdk
+{
+
+DeviceManager& DeviceManager::Instance()
+{
+	static DeviceManager instance;
+	return instance;
+}
+
+DeviceManager::DeviceManager()
+	: m_initialized(false)
+	, m_timeFactor(kDefaultTimeFactor)
+	, m_deviceCount(0)
+{
+	for (int group = 0; group < kMaxDeviceGroups; ++group)
+	{
+		m_groupSize[group] = 0;
+		m_groupUsed[group] = false;
+	}
+}
+
+int DeviceManager::Initialize()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+	if (!IsInitialized())
+		m_completions.ResetDropped();
+	m_initialized.store(true, std::memory_order_release);
+	return 0;
+}
+
+int DeviceManager::Shutdown()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+	if (!IsInitialized())
+		return ERROR_NOINIT;
+
+	CloseAll();
+	for (int group = 0; group < kMaxDeviceGroups; ++group)
+	{
+		m_groupSize[group] = 0;
+		m_groupUsed[group] = false;
+	}
+	m_initialized.store(false, std::memory_order_release);
+	return 0;
+}
+
+int DeviceManager::Connect(const char* name, int type, DataCallback callback)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+	if (!IsInitialized())
+		return -ERROR_TM_NOT_INITIALIZED;
+
+	int count = m_deviceCount.load(std::memory_order_relaxed);
+	int id = 0;
+	while (id < count && m_devices[id]->IsOpen())
+		++id;
+	if (id == kMaxControllers)
+		return -ERROR_TM_MAX_CONTROLLER_LIMIT_REACHED;
+	if (id == count)
+	{
+		m_devices[id].reset(new Device());
+		m_deviceCount.store(count + 1, std::memory_order_release);
+	}
+
+	// A thread that looked the slot up before it was closed may still hold
+	// it; it finds the device closed once it gets the lock.
+	Device& device = *m_devices[id];
+	std::lock_guard<std::recursive_mutex> deviceGuard(device.ApiLock());
+	if (int error = device.Open(id, name, type, callback, &m_completions, &m_loop))
+		return -error;
+	return id;
+}
+
+int DeviceManager::Close(int boardId)
+{
+	DeviceGuard device(*this, boardId);
+	if (!device)
+		return ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	device->Close();
+	return 0;
+}
+
+int DeviceManager::CloseAll()
+{
+	int count = m_deviceCount.load(std::memory_order_acquire);
+	for (int id = 0; id < count; ++id)
+	{
+		DeviceGuard device(*this, id);
+		if (device)
+			device->Close();
+	}
+	return 0;
+}
+
+int DeviceManager::Send(int boardId, const Action& action)
+{
+	uint8_t timeFactor = static_cast<uint8_t>(TimeFactor());
+	return ForEachTarget(boardId, [&](Device& device) { return device.Send(action, timeFactor); });
+}
+
+int DeviceManager::SendAt(int boardId, const Action& action, int64_t atNs)
+{
+	uint8_t timeFactor = static_cast<uint8_t>(TimeFactor());
+	return ForEachTarget(boardId, [&](Device& device) { return device.SendAt(action, timeFactor, atNs); });
+}
+
+int DeviceManager::SendSequence(int boardId, const Command* commands, size_t count)
+{
+	return ForEachTarget(boardId, [&](Device& device) { return device.SendSequence(commands, count); });
+}
+
+int DeviceManager::SendFrame(int boardId, const uint8_t* intensities, int msDelay)
+{
+	int timeFactor = TimeFactor();
+	int sent = 0;
+	int error = ForEachTarget(boardId, [&](Device& device)
+	{
+		int count = device.SendFrame(intensities, msDelay, timeFactor);
+		if (count < 0)
+			return -count;
+		sent += count;
+		return 0;
+	});
+	return error != 0 ? -error : sent;
+}
+
+int DeviceManager::PlaceTactor(int boardId, int segment, int offset, float x, float y, float z)
+{
+	return ForEachTarget(boardId, [&](Device& device) { return device.PlaceTactor(segment, offset, x, y, z); });
+}
+
+int DeviceManager::ClearTactorPlaces(int boardId)
+{
+	return ForEachTarget(boardId, [&](Device& device)
+	{
+		device.ClearTactorPlaces();
+		return 0;
+	});
+}
+
+int DeviceManager::SetContactRadius(int boardId, float radius)
+{
+	return ForEachTarget(boardId, [&](Device& device)
+	{
+		device.SetContactRadius(radius);
+		return 0;
+	});
+}
+
+int DeviceManager::RenderContacts(int boardId, const Contact* contacts, size_t count, int msDelay)
+{
+	int timeFactor = TimeFactor();
+	int sent = 0;
+	int error = ForEachTarget(boardId, [&](Device& device)
+	{
+		int result = device.RenderContacts(contacts, count, msDelay, timeFactor);
+		if (result < 0)
+			return -result;
+		sent += result;
+		return 0;
+	});
+	return error != 0 ? -error : sent;
+}
+
+int DeviceManager::Stream(int boardId, const Action& action)
+{
+	return ForEachTarget(boardId, [&](Device& device) { return device.Stream(action); });
+}
+
+int DeviceManager::SendAsync(int boardId, const Action& action)
+{
+	DeviceGuard device(*this, boardId);
+	if (!device)
+		return -ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	int token = device->NextToken();
+	if (int error = device->Send(action, static_cast<uint8_t>(TimeFactor()), token))
+		return -error;
+	return token;
+}
+
+bool DeviceManager::PollCompletion(Completion& out)
+{
+	std::lock_guard<std::mutex> guard(m_pollLock);
+	return m_completions.TryPop(out);
+}
+
+int DeviceManager::BeginBatch(int boardId)
+{
+	return ForEachTarget(boardId, [](Device& device) { return device.BeginBatch(); });
+}
+
+int DeviceManager::CommitBatch(int boardId)
+{
+	int queued = 0;
+	int error = ForEachTarget(boardId, [&](Device& device)
+	{
+		int count = device.CommitBatch();
+		if (count < 0)
+			return -count;
+		queued += count;
+		return 0;
+	});
+	return error != 0 ? -error : queued;
+}
+
+int DeviceManager::CreateGroup(const int* boardIds, int count)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+	if (!IsInitialized())
+		return -ERROR_TM_NOT_INITIALIZED;
+	if (boardIds == nullptr || count <= 0 || count > kMaxGroupMembers)
+		return -ERROR_BADPARAMETER;
+
+	for (int i = 0; i < count; ++i)
+	{
+		Device* device = Slot(boardIds[i]);
+		if (device == nullptr || !device->IsOpen())
+			return -ERROR_TM_CONTROLLER_NOT_FOUND;
+	}
+
+	for (int group = 0; group < kMaxDeviceGroups; ++group)
+	{
+		if (m_groupUsed[group])
+			continue;
+
+		// A board listed twice would be sent everything twice.
+		int* members = m_groups[group];
+		std::copy(boardIds, boardIds + count, members);
+		std::sort(members, members + count);
+		m_groupSize[group] = static_cast<int>(std::unique(members, members + count) - members);
+		m_groupUsed[group] = true;
+		return kFirstGroupId + group;
+	}
+	return -ERROR_TM_MAX_CONTROLLER_LIMIT_REACHED;
+}
+
+int DeviceManager::DestroyGroup(int groupId)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+	int group = groupId - kFirstGroupId;
+	if (group < 0 || group >= kMaxDeviceGroups || !m_groupUsed[group])
+		return ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	m_groupSize[group] = 0;
+	m_groupUsed[group] = false;
+	return 0;
+}
+
+int DeviceManager::BeginTimeline(int boardId)
+{
+	return ForEachTarget(boardId, [](Device& device) { return device.BeginTimeline(); });
+}
+
+int DeviceManager::SetTimelineOffset(int boardId, int ms)
+{
+	return ForEachTarget(boardId, [ms](Device& device) { return device.SetTimelineOffset(ms); });
+}
+
+int DeviceManager::PlayTimeline(int boardId, int delayMs)
+{
+	int scheduled = 0;
+	int error = ForEachTarget(boardId, [&](Device& device)
+	{
+		int count = device.PlayTimeline(delayMs);
+		if (count < 0)
+			return -count;
+		scheduled += count;
+		return 0;
+	});
+	return error != 0 ? -error : scheduled;
+}
+
+int DeviceManager::PlayTimelineAt(int boardId, int64_t atNs)
+{
+	int scheduled = 0;
+	int error = ForEachTarget(boardId, [&](Device& device)
+	{
+		int count = device.PlayTimelineAt(atNs);
+		if (count < 0)
+			return -count;
+		scheduled += count;
+		return 0;
+	});
+	return error != 0 ? -error : scheduled;
+}
+
+int DeviceManager::CancelTimeline(int boardId)
+{
+	int cancelled = 0;
+	int error = ForEachTarget(boardId, [&](Device& device)
+	{
+		int count = device.CancelTimeline();
+		if (count < 0)
+			return -count;
+		cancelled += count;
+		return 0;
+	});
+	return error != 0 ? -error : cancelled;
+}
+
+int DeviceManager::Update()
+{
+	if (!IsInitialized())
+		return ERROR_NOINIT;
+
+	int result = 0;
+	int count = m_deviceCount.load(std::memory_order_acquire);
+	for (int id = 0; id < count; ++id)
+	{
+		DeviceGuard device(*this, id);
+		if (!device)
+			continue;
+
+		int error = device->Update();
+		if (error != 0 && result == 0)
+			result = error;
+	}
+	return result;
+}
+
+int DeviceManager::GetQueueStats(int boardId, QueueStats& out)
+{
+	DeviceGuard device(*this, boardId);
+	if (!device)
+		return ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	device->GetQueueStats(out);
+	return 0;
+}
+
+int DeviceManager::GetStats(int boardId, StatsSnapshot& out)
+{
+	DeviceGuard device(*this, boardId);
+	if (!device)
+		return ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	device->GetStats(out);
+	return 0;
+}
+
+int DeviceManager::GetShadowStats(int boardId, ShadowStats& out)
+{
+	DeviceGuard device(*this, boardId);
+	if (!device)
+		return ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	out = device->GetShadowStats();
+	return 0;
+}
+
+int DeviceManager::GetTimelineStats(int boardId, TimelineStats& out)
+{
+	DeviceGuard device(*this, boardId);
+	if (!device)
+		return ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	out = device->GetTimelineStats();
+	return 0;
+}
+
+int DeviceManager::GetStreamStats(int boardId, StreamStats& out)
+{
+	DeviceGuard device(*this, boardId);
+	if (!device)
+		return ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	device->GetStreamStats(out);
+	return 0;
+}
+
+int DeviceManager::GetClockSync(int boardId, ClockSyncState& out)
+{
+	DeviceGuard device(*this, boardId);
+	if (!device)
+		return ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	device->GetClockSync(out);
+	return 0;
+}
+
+int DeviceManager::GetTelemetry(int boardId, TelemetrySnapshot& out)
+{
+	// Devices are never freed, and the snapshot is read without the
+	// device's lock, so polling it every frame never waits on a command.
+	Device* device = Slot(boardId);
+	if (device == nullptr || !device->IsOpen())
+		return ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	device->GetTelemetry(out);
+	return 0;
+}
+
+int DeviceManager::SetCreditLimits(int boardId, const CreditLimits& limits)
+{
+	return ForEachTarget(boardId, [&](Device& device)
+	{
+		device.SetCreditLimits(limits);
+		return 0;
+	});
+}
+
+int DeviceManager::GetCredits(int boardId, CreditState& out)
+{
+	DeviceGuard device(*this, boardId);
+	if (!device)
+		return ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	device->GetCredits(out);
+	return 0;
+}
+
+int DeviceManager::SetTimeFactor(int value)
+{
+	if (value < 1 || value > 0xFF)
+		return ERROR_BADPARAMETER;
+
+	m_timeFactor.store(value, std::memory_order_relaxed);
+	return 0;
+}
+
+Device* DeviceManager::Slot(int boardId)
+{
+	if (boardId < 0 || boardId >= m_deviceCount.load(std::memory_order_acquire))
+		return nullptr;
+	return m_devices[boardId].get();
+}
+
+bool DeviceManager::IsPortOpen(const char* path)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+	int count = m_deviceCount.load(std::memory_order_acquire);
+	for (int id = 0; id < count; ++id)
+	{
+		const Device& device = *m_devices[id];
+		if (device.IsOpen() && strcmp(device.PortName(), path) == 0)
+			return true;
+	}
+	return false;
+}
+
+bool DeviceManager::GroupMembers(int groupId, int* out, int& count)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_lock);
+	int group = groupId - kFirstGroupId;
+	if (group < 0 || group >= kMaxDeviceGroups || !m_groupUsed[group])
+		return false;
+
+	count = m_groupSize[group];
+	std::copy(m_groups[group], m_groups[group] + count, out);
+	return true;
+}
+
+DeviceGuard::DeviceGuard(DeviceManager& manager, int boardId)
+	: m_device(nullptr)
+{
+	Device* device = manager.Slot(boardId);
+	if (device == nullptr)
+		return;
+
+	// Close may have run between the lookup and the lock.
+	m_lock = std::unique_lock<std::recursive_mutex>(device->ApiLock());
+	if (device->IsOpen())
+		m_device = device;
+	else
+		m_lock.unlock();
+}
+
+} // namespace tdk
@@ -0,0 +1,198 @@
+/************************************************************************
+*                                                                       *
+*   DeviceManager.h -- table of connected controllers and TDK state     *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_DEVICEMANAGER_H_
+#define TDK_DEVICEMANAGER_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "Device.h"
+#include "EventLoop.h"
+
+namespace tdk
+{
+
+// Board IDs are below kMaxControllers and group IDs from kFirstGroupId, so
+// every command function can take either.
+const int kMaxControllers = 4096;
+const int kFirstGroupId = kMaxControllers;
+const int kMaxDeviceGroups = 64;
+// A group's members are copied to the stack for each command sent to it.
+const int kMaxGroupMembers = 256;
+
+class DeviceGuard;
+
+// Owns every Device slot. Board IDs handed out by Connect are slot indices;
+// slots are allocated as controllers connect and reused after Close, and
+// never freed, so a board ID is looked up without a lock. Every open device
+// is served by the one EventLoop.
+//
+// Calls on a device hold only that device's ApiLock (see DeviceGuard), so
+// threads driving different boards never block each other. The table lock
+// is taken by Connect, Shutdown and the group functions only.
+//
+// A device group names a set of boards: Send, the batch and timeline
+// functions and SetCreditLimits given a group ID apply to each open member
+// in turn, so a batch collected on a group is broadcast by one CommitBatch.
+class DeviceManager
+{
+public:
+	static DeviceManager& Instance();
+
+	int Initialize();
+	int Shutdown();
+	bool IsInitialized() const { return m_initialized.load(std::memory_order_acquire); }
+
+	// Returns the new board ID, or -error.
+	int Connect(const char* name, int type, DataCallback callback);
+	int Close(int boardId);
+	int CloseAll();
+
+	int Send(int boardId, const Action& action);
+	// Sends action to run at host time atNs on each board (see
+	// Device::SendAt).
+	int SendAt(int boardId, const Action& action, int64_t atNs);
+	// Queues commands to leave in one write (see Device::SendSequence).
+	int SendSequence(int boardId, const Command* commands, size_t count);
+	// Returns the number of commands sent, or -error (see Device::SendFrame).
+	int SendFrame(int boardId, const uint8_t* intensities, int msDelay);
+	int PlaceTactor(int boardId, int segment, int offset, float x, float y, float z);
+	int ClearTactorPlaces(int boardId);
+	int SetContactRadius(int boardId, float radius);
+	// Returns the number of commands sent, or -error (see
+	// Device::RenderContacts).
+	int RenderContacts(int boardId, const Contact* contacts, size_t count, int msDelay);
+	// Sets a stream channel's target (see Device::Stream).
+	int Stream(int boardId, const Action& action);
+	// Returns a completion token, or -error.
+	int SendAsync(int boardId, const Action& action);
+	// Takes the oldest completion of any board; false when there is none.
+	bool PollCompletion(Completion& out);
+	// Completions discarded on a full queue since Initialize.
+	uint64_t DroppedCompletions() const { return m_completions.Dropped(); }
+	int BeginBatch(int boardId);
+	// Returns the number of commands queued, or -error.
+	int CommitBatch(int boardId);
+	// Returns the new group ID, or -error.
+	int CreateGroup(const int* boardIds, int count);
+	int DestroyGroup(int groupId);
+	int BeginTimeline(int boardId);
+	int SetTimelineOffset(int boardId, int ms);
+	// Return the number of commands scheduled or cancelled, or -error.
+	int PlayTimeline(int boardId, int delayMs);
+	int PlayTimelineAt(int boardId, int64_t atNs);
+	int CancelTimeline(int boardId);
+	int Update();
+	int GetQueueStats(int boardId, QueueStats& out);
+	int GetStats(int boardId, StatsSnapshot& out);
+	int GetShadowStats(int boardId, ShadowStats& out);
+	int GetTimelineStats(int boardId, TimelineStats& out);
+	int GetStreamStats(int boardId, StreamStats& out);
+	int GetClockSync(int boardId, ClockSyncState& out);
+	// Takes no lock (see Telemetry).
+	int GetTelemetry(int boardId, TelemetrySnapshot& out);
+	int SetCreditLimits(int boardId, const CreditLimits& limits);
+	int GetCredits(int boardId, CreditState& out);
+
+	int TimeFactor() const { return m_timeFactor.load(std::memory_order_relaxed); }
+	int SetTimeFactor(int value);
+
+	// Whether an open device uses the port at the resolved path. Takes the
+	// table lock.
+	bool IsPortOpen(const char* path);
+
+	// The table lock. Also guards the Discovery results.
+	std::recursive_mutex& Lock() { return m_lock; }
+
+private:
+	friend class DeviceGuard;
+
+	DeviceManager();
+
+	// The device in slot boardId, open or not; nullptr for a board ID no
+	// Connect has handed out.
+	Device* Slot(int boardId);
+	// Copies the members of groupId, at most kMaxGroupMembers; false when
+	// it names no group.
+	bool GroupMembers(int groupId, int* out, int& count);
+
+	// Calls fn on the device boardId names, or on each open member of the
+	// group it names, holding one device at a time. Returns the first
+	// nonzero result, or ERROR_TM_CONTROLLER_NOT_FOUND when boardId names
+	// neither.
+	template <typename Fn>
+	int ForEachTarget(int boardId, Fn fn);
+
+	std::recursive_mutex m_lock;
+	std::atomic<bool> m_initialized;
+	std::atomic<int> m_timeFactor;
+	// Declared before the devices so it outlives them.
+	EventLoop m_loop;
+	// Slots [0, m_deviceCount) are allocated; published by the count.
+	std::unique_ptr<Device> m_devices[kMaxControllers];
+	std::atomic<int> m_deviceCount;
+	int m_groups[kMaxDeviceGroups][kMaxGroupMembers];
+	int m_groupSize[kMaxDeviceGroups];
+	bool m_groupUsed[kMaxDeviceGroups];
+	// The completion queue has a single consumer.
+	std::mutex m_pollLock;
+	CompletionQueue m_completions;
+};
+
+// Holds the ApiLock of an open device for the calling thread. Converts to
+// false, holding nothing, when boardId names no open device.
+class DeviceGuard
+{
+public:
+	DeviceGuard(DeviceManager& manager, int boardId);
+
+	DeviceGuard(const DeviceGuard&) = delete;
+	DeviceGuard& operator=(const DeviceGuard&) = delete;
+
+	explicit operator bool() const { return m_device != nullptr; }
+	Device* operator->() const { return m_device; }
+	Device& operator*() const { return *m_device; }
+
+private:
+	std::unique_lock<std::recursive_mutex> m_lock;
+	Device* m_device;
+};
+
+template <typename Fn>
+int DeviceManager::ForEachTarget(int boardId, Fn fn)
+{
+	if (boardId < kFirstGroupId)
+	{
+		DeviceGuard device(*this, boardId);
+		if (!device)
+			return ERROR_TM_CONTROLLER_NOT_FOUND;
+		return fn(*device);
+	}
+
+	// Members are taken one at a time, never under the table lock.
+	int members[kMaxGroupMembers];
+	int count = 0;
+	if (!GroupMembers(boardId, members, count))
+		return ERROR_TM_CONTROLLER_NOT_FOUND;
+
+	int result = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		DeviceGuard device(*this, members[i]);
+		if (!device)
+			continue;
+		int error = fn(*device);
+		if (error != 0 && result == 0)
+			result = error;
+	}
+	return result;
+}
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,174 @@
+#include "DeviceStats.h"
+
+namespace tdk
+{
+
+namespace
+{
+
+std::atomic<unsigned> g_nextShard(0);
+
+// Fixed for the life of the thread, so a thread always counts into the
+// same cache lines.
+unsigned ThreadShard()
+{
+	thread_local unsigned shard = g_nextShard.fetch_add(1, std::memory_order_relaxed) % kStatsShards;
+	return shard;
+}
+
+} // namespace
+
+DeviceStats::DeviceStats()
+{
+	Reset();
+}
+
+void DeviceStats::Reset()
+{
+	for (Shard& shard : m_shards)
+	{
+		for (std::atomic<uint64_t>& counter : shard.submitted)
+			counter.store(0, std::memory_order_relaxed);
+	}
+	m_writes.store(0, std::memory_order_relaxed);
+	m_bytesWritten.store(0, std::memory_order_relaxed);
+	m_acks.store(0, std::memory_order_relaxed);
+	m_timeouts.store(0, std::memory_order_relaxed);
+	for (std::atomic<uint64_t>& counter : m_naksByReason)
+		counter.store(0, std::memory_order_relaxed);
+	for (std::atomic<uint64_t>& counter : m_writtenByOpcode)
+		counter.store(0, std::memory_order_relaxed);
+	for (int i = 0; i < kLatencyBuckets; ++i)
+	{
+		m_queueLatency[i].store(0, std::memory_order_relaxed);
+		m_ackLatency[i].store(0, std::memory_order_relaxed);
+	}
+	m_preemptions.store(0, std::memory_order_relaxed);
+	for (int c = 0; c < kPriorityClasses; ++c)
+	{
+		m_writtenByClass[c].store(0, std::memory_order_relaxed);
+		for (int i = 0; i < kLatencyBuckets; ++i)
+		{
+			m_classQueueLatency[c][i].store(0, std::memory_order_relaxed);
+			m_classReplyLatency[c][i].store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+void DeviceStats::Add(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void DeviceStats::Add(std::atomic<uint32_t>& counter, uint32_t amount)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+int DeviceStats::Bucket(int64_t latencyNs)
+{
+	uint64_t us = latencyNs > 0 ? static_cast<uint64_t>(latencyNs) / 1000 : 0;
+	int bucket = 0;
+	while (us != 0 && bucket < kLatencyBuckets - 1)
+	{
+		us >>= 1;
+		++bucket;
+	}
+	return bucket;
+}
+
+void DeviceStats::Submitted(uint8_t opcode)
+{
+	// Threads sharing a shard may race, so this one is a real increment.
+	m_shards[ThreadShard()].submitted[opcode].fetch_add(1, std::memory_order_relaxed);
+}
+
+void DeviceStats::Written(uint8_t opcode, uint8_t priority, int64_t queuedNs)
+{
+	int bucket = Bucket(queuedNs);
+	Add(m_writtenByOpcode[opcode], 1);
+	Add(m_queueLatency[bucket], 1);
+	if (priority < kPriorityClasses)
+	{
+		Add(m_writtenByClass[priority], 1);
+		Add(m_classQueueLatency[priority][bucket], 1);
+	}
+}
+
+void DeviceStats::Wrote(size_t bytes)
+{
+	Add(m_writes, 1);
+	Add(m_bytesWritten, bytes);
+}
+
+void DeviceStats::Acked(int64_t latencyNs)
+{
+	Add(m_acks, 1);
+	Add(m_ackLatency[Bucket(latencyNs)], 1);
+}
+
+void DeviceStats::Replied(uint8_t priority, int64_t latencyNs)
+{
+	if (priority < kPriorityClasses)
+		Add(m_classReplyLatency[priority][Bucket(latencyNs)], 1);
+}
+
+void DeviceStats::Preempted()
+{
+	Add(m_preemptions, 1);
+}
+
+void DeviceStats::Naked(uint8_t reason)
+{
+	Add(m_naksByReason[reason < kStatsNakReasons ? reason : kStatsNakReasons - 1], 1);
+}
+
+void DeviceStats::TimedOut(size_t commands)
+{
+	Add(m_timeouts, commands);
+}
+
+void DeviceStats::Read(StatsSnapshot& out) const
+{
+	out.submitted = 0;
+	out.written = 0;
+	for (int op = 0; op < kStatsOpcodes; ++op)
+	{
+		uint64_t submitted = 0;
+		for (const Shard& shard : m_shards)
+			submitted += shard.submitted[op].load(std::memory_order_relaxed);
+		out.submittedByOpcode[op] = submitted;
+		out.submitted += submitted;
+
+		out.writtenByOpcode[op] = m_writtenByOpcode[op].load(std::memory_order_relaxed);
+		out.written += out.writtenByOpcode[op];
+	}
+
+	out.writes = m_writes.load(std::memory_order_relaxed);
+	out.bytesWritten = m_bytesWritten.load(std::memory_order_relaxed);
+	out.acks = m_acks.load(std::memory_order_relaxed);
+	out.timeouts = m_timeouts.load(std::memory_order_relaxed);
+	out.naks = 0;
+	for (int i = 0; i < kStatsNakReasons; ++i)
+	{
+		out.naksByReason[i] = m_naksByReason[i].load(std::memory_order_relaxed);
+		out.naks += out.naksByReason[i];
+	}
+	for (int i = 0; i < kLatencyBuckets; ++i)
+	{
+		out.queueLatencyUs[i] = m_queueLatency[i].load(std::memory_order_relaxed);
+		out.ackLatencyUs[i] = m_ackLatency[i].load(std::memory_order_relaxed);
+	}
+	out.preemptions = m_preemptions.load(std::memory_order_relaxed);
+	for (int c = 0; c < kPriorityClasses; ++c)
+	{
+		out.writtenByClass[c] = m_writtenByClass[c].load(std::memory_order_relaxed);
+		for (int i = 0; i < kLatencyBuckets; ++i)
+		{
+			out.classQueueLatencyUs[c][i] = m_classQueueLatency[c][i].load(std::memory_order_relaxed);
+			out.classReplyLatencyUs[c][i] = m_classReplyLatency[c][i].load(std::memory_order_relaxed);
+		}
+	}
+}
+
+} // namespace tdk
@@ -0,0 +1,105 @@
+/************************************************************************
+*                                                                       *
+*   DeviceStats.h -- lock-free counters and latency histograms          *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_DEVICESTATS_H_
+#define TDK_DEVICESTATS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace tdk
+{
+
+const int kStatsOpcodes = 256;
+// NAK reasons at or above the last entry share it.
+const int kStatsNakReasons = 32;
+// Bucket 0 counts latencies under 1 us, bucket i those in
+// [2^(i-1), 2^i) us; the last bucket holds everything longer.
+const int kLatencyBuckets = 24;
+// API threads spread their counts over this many shards.
+const int kStatsShards = 4;
+// Command priority classes, counted apart (see Device::SetSendPriority).
+const int kPriorityClasses = 3;
+
+struct StatsSnapshot
+{
+	uint64_t submitted;
+	uint64_t written;
+	uint64_t writes;
+	uint64_t bytesWritten;
+	uint64_t acks;
+	uint64_t naks;
+	uint64_t timeouts;
+	uint64_t naksByReason[kStatsNakReasons];
+	uint64_t submittedByOpcode[kStatsOpcodes];
+	uint64_t writtenByOpcode[kStatsOpcodes];
+	uint32_t queueLatencyUs[kLatencyBuckets];	// enqueue to write
+	uint32_t ackLatencyUs[kLatencyBuckets];		// write to ACK
+	uint64_t preemptions;
+	uint64_t writtenByClass[kPriorityClasses];
+	uint32_t classQueueLatencyUs[kPriorityClasses][kLatencyBuckets];	// enqueue to write
+	uint32_t classReplyLatencyUs[kPriorityClasses][kLatencyBuckets];	// enqueue to ACK
+};
+
+// Counters of one device. Nothing here takes a lock or does a read-modify-
+// write the I/O thread could contend on: API threads count into the shard
+// their thread was given, and every other counter has a single writer, the
+// I/O thread, which updates it with a plain load and store. Read sums the
+// shards, so a snapshot may be a few counts behind but never tears a value.
+class DeviceStats
+{
+public:
+	DeviceStats();
+
+	// Only while no thread is counting (the device is closed).
+	void Reset();
+
+	// Any API thread.
+	void Submitted(uint8_t opcode);
+
+	// I/O thread only.
+	// priority is kPriorityClasses for the library's own commands, which
+	// no class counts.
+	void Written(uint8_t opcode, uint8_t priority, int64_t queuedNs);
+	void Wrote(size_t bytes);
+	void Acked(int64_t latencyNs);
+	void Replied(uint8_t priority, int64_t latencyNs);
+	void Preempted();
+	void Naked(uint8_t reason);
+	void TimedOut(size_t commands);
+
+	void Read(StatsSnapshot& out) const;
+
+private:
+	struct alignas(64) Shard
+	{
+		std::atomic<uint64_t> submitted[kStatsOpcodes];
+	};
+
+	static void Add(std::atomic<uint64_t>& counter, uint64_t amount);
+	static void Add(std::atomic<uint32_t>& counter, uint32_t amount);
+	static int Bucket(int64_t latencyNs);
+
+	Shard m_shards[kStatsShards];
+
+	alignas(64) std::atomic<uint64_t> m_writes;
+	std::atomic<uint64_t> m_bytesWritten;
+	std::atomic<uint64_t> m_acks;
+	std::atomic<uint64_t> m_timeouts;
+	std::atomic<uint64_t> m_naksByReason[kStatsNakReasons];
+	std::atomic<uint64_t> m_writtenByOpcode[kStatsOpcodes];
+	std::atomic<uint32_t> m_queueLatency[kLatencyBuckets];
+	std::atomic<uint32_t> m_ackLatency[kLatencyBuckets];
+	std::atomic<uint64_t> m_preemptions;
+	std::atomic<uint64_t> m_writtenByClass[kPriorityClasses];
+	std::atomic<uint32_t> m_classQueueLatency[kPriorityClasses][kLatencyBuckets];
+	std::atomic<uint32_t> m_classReplyLatency[kPriorityClasses][kLatencyBuckets];
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,368 @@
+#include "Discovery.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Clock.h"
+#include "DeviceManager.h"
+#include "Protocol.h"
+
+namespace tdk
+{
+
+namespace
+{
+
+// Every family is driven by the serial driver, so that is the type
+// reported; the flags only select which families are scanned.
+struct PortFamily
+{
+	const char* prefix;
+	int types;
+};
+
+const PortFamily kPortFamilies[] =
+{
+	{ "ttyUSB", DEVICE_TYPE_SERIAL },
+	{ "ttyACM", DEVICE_TYPE_SERIAL },
+	{ "rfcomm", DEVICE_TYPE_SERIAL | DEVICE_TYPE_ANDROIDBLUETOOTH },
+};
+
+enum ProbeState
+{
+	kProbeDone,
+	kProbeWaiting
+};
+
+const char* const kCacheFilePrefix = "last-device-";
+
+std::atomic<bool> g_cacheEnabled(true);
+
+// Shorter names first so ttyUSB2 sorts before ttyUSB10.
+bool PortOrder(const char* a, const char* b)
+{
+	size_t la = strlen(a);
+	size_t lb = strlen(b);
+	return la != lb ? la < lb : strcmp(a, b) < 0;
+}
+
+// The cache directory may be shared between machines (NFS homes), so the
+// file name carries the host name.
+bool CachePath(char* out, size_t capacity, bool create)
+{
+	char dir[256];
+	const char* xdg = getenv("XDG_CACHE_HOME");
+	const char* home = getenv("HOME");
+	int written;
+	if (xdg != nullptr && xdg[0] == '/')
+		written = snprintf(dir, sizeof(dir), "%s", xdg);
+	else if (home != nullptr && home[0] == '/')
+		written = snprintf(dir, sizeof(dir), "%s/.cache", home);
+	else
+		return false;
+	if (written <= 0 || static_cast<size_t>(written) >= sizeof(dir))
+		return false;
+
+	if (create && mkdir(dir, 0700) != 0 && errno != EEXIST)
+		return false;
+	size_t length = strlen(dir);
+	if (snprintf(dir + length, sizeof(dir) - length, "/tdk") >= static_cast<int>(sizeof(dir) - length))
+		return false;
+	if (create && mkdir(dir, 0700) != 0 && errno != EEXIST)
+		return false;
+
+	char host[64];
+	if (gethostname(host, sizeof(host)) != 0)
+		strcpy(host, "localhost");
+	host[sizeof(host) - 1] = '\0';
+
+	written = snprintf(out, capacity, "%s/%s%s", dir, kCacheFilePrefix, host);
+	return written > 0 && static_cast<size_t>(written) < capacity;
+}
+
+} // namespace
+
+Discovery& Discovery::Instance()
+{
+	static Discovery instance;
+	return instance;
+}
+
+Discovery::Discovery()
+	: m_count(0)
+	, m_lastLoaded(false)
+{
+	m_last.name[0] = '\0';
+	m_last.type = DEVICE_TYPE_UNKNOWN;
+}
+
+void Discovery::SetCacheEnabled(bool enabled)
+{
+	g_cacheEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+const DiscoveredDevice* Discovery::Get(int index) const
+{
+	if (index < 0 || index >= m_count)
+		return nullptr;
+	return &m_devices[index];
+}
+
+int Discovery::ListCandidates(int typeMask, Candidate* out, int capacity) const
+{
+	DIR* dir = opendir("/dev");
+	if (dir == nullptr)
+		return 0;
+
+	int count = 0;
+	while (dirent* entry = readdir(dir))
+	{
+		if (count >= capacity)
+			break;
+
+		for (const PortFamily& family : kPortFamilies)
+		{
+			if (!(family.types & typeMask) || strncmp(entry->d_name, family.prefix, strlen(family.prefix)) != 0)
+				continue;
+
+			if (SerialPort::ResolveName(entry->d_name, out[count].path, kMaxPortName))
+				++count;
+			break;
+		}
+	}
+	closedir(dir);
+
+	std::sort(out, out + count, [](const Candidate& a, const Candidate& b)
+	{
+		return PortOrder(a.path, b.path);
+	});
+	return count;
+}
+
+void Discovery::ProbeAll(const Candidate* candidates, int count, int limit, int timeoutMs, bool* answered)
+{
+	Action action;
+	MakeSimple(action, TDK_COMMAND_READFW, 0, kDefaultTimeFactor);
+	uint8_t frame[kMaxFrameSize];
+	ActionListWriter writer(frame, sizeof(frame));
+	writer.Begin(kDefaultTimeFactor);
+	writer.Append(action);
+	size_t length = writer.Finish();
+
+	for (int i = 0; i < count; ++i)
+	{
+		answered[i] = false;
+		PendingProbe& probe = m_probes[i];
+		probe.state = kProbeDone;
+		if (probe.port.Open(candidates[i].path) != 0)
+			continue;
+		if (probe.port.WriteSome(frame, length) != static_cast<long>(length))
+		{
+			probe.port.Close();
+			continue;
+		}
+		probe.parser.Reset();
+		probe.deadlineNs = MonotonicNs() + static_cast<int64_t>(timeoutMs) * 1000000;
+		probe.state = kProbeWaiting;
+	}
+
+	pollfd fds[kMaxProbeCandidates];
+	int fdProbe[kMaxProbeCandidates];
+	for (;;)
+	{
+		// Done once the answers that make up the first limit results, in
+		// candidate order, can no longer change.
+		bool settled = true;
+		int hits = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			if (m_probes[i].state == kProbeWaiting)
+			{
+				settled = false;
+				break;
+			}
+			if (answered[i] && ++hits == limit)
+				break;
+		}
+		if (settled)
+			break;
+
+		int64_t now = MonotonicNs();
+		int64_t next = -1;
+		int fdCount = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			PendingProbe& probe = m_probes[i];
+			if (probe.state != kProbeWaiting)
+				continue;
+			if (probe.deadlineNs <= now)
+			{
+				probe.port.Close();
+				probe.state = kProbeDone;
+				continue;
+			}
+			fds[fdCount].fd = probe.port.Fd();
+			fds[fdCount].events = POLLIN;
+			fds[fdCount].revents = 0;
+			fdProbe[fdCount++] = i;
+			if (next < 0 || probe.deadlineNs < next)
+				next = probe.deadlineNs;
+		}
+		if (fdCount == 0)
+			continue;
+
+		int ready = poll(fds, fdCount, static_cast<int>((next - now) / 1000000 + 1));
+		if (ready <= 0)
+			continue;
+
+		for (int f = 0; f < fdCount; ++f)
+		{
+			if (fds[f].revents == 0)
+				continue;
+
+			int i = fdProbe[f];
+			PendingProbe& probe = m_probes[i];
+			uint8_t reply[kMaxFrameSize];
+			long n = probe.port.Read(reply, sizeof(reply));
+			for (long b = 0; b < n && !answered[i]; ++b)
+				answered[i] = probe.parser.Push(reply[b]) == FrameParser::kFrame;
+			if (answered[i] || n < 0 || (fds[f].revents & (POLLERR | POLLHUP)))
+			{
+				probe.port.Close();
+				probe.state = kProbeDone;
+			}
+		}
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (m_probes[i].state == kProbeWaiting)
+			m_probes[i].port.Close();
+		m_probes[i].state = kProbeDone;
+	}
+}
+
+int Discovery::Run(int typeMask, int limit)
+{
+	m_count = 0;
+	if (limit <= 0 || limit > kMaxDiscovered)
+		limit = kMaxDiscovered;
+
+	int scanned = 0;
+	for (const PortFamily& family : kPortFamilies)
+		scanned |= family.types;
+	if (!(typeMask & scanned))
+		return 0;
+
+	// The last known good device goes first in the one probe pass, so it
+	// leads the results, and a caller after a single device has its answer
+	// as soon as that device gives one. Ports this process already has open
+	// are left alone: a ReadFW there would take the device's replies.
+	DeviceManager& manager = DeviceManager::Instance();
+	DiscoveredDevice last;
+	bool cached = LoadLastKnownGood(last) && (last.type & typeMask) && !manager.IsPortOpen(last.name);
+	Candidate candidates[kMaxProbeCandidates];
+	int candidateCount = 0;
+	if (cached)
+		memcpy(candidates[candidateCount++].path, last.name, sizeof(candidates[0].path));
+
+	Candidate listed[kMaxProbeCandidates];
+	int listedCount = ListCandidates(typeMask, listed, kMaxProbeCandidates);
+	for (int i = 0; i < listedCount && candidateCount < kMaxProbeCandidates; ++i)
+	{
+		if ((cached && strcmp(listed[i].path, last.name) == 0) || manager.IsPortOpen(listed[i].path))
+			continue;
+		candidates[candidateCount++] = listed[i];
+	}
+
+	bool answered[kMaxProbeCandidates];
+	ProbeAll(candidates, candidateCount, limit, kProbeTimeoutMs, answered);
+
+	for (int i = 0; i < candidateCount && m_count < limit; ++i)
+	{
+		if (!answered[i])
+			continue;
+
+		DiscoveredDevice& found = m_devices[m_count++];
+		memcpy(found.name, candidates[i].path, sizeof(found.name));
+		found.type = cached && i == 0 ? last.type : DEVICE_TYPE_SERIAL;
+	}
+	return m_count;
+}
+
+bool Discovery::LoadLastKnownGood(DiscoveredDevice& out)
+{
+	if (!g_cacheEnabled.load(std::memory_order_relaxed))
+		return false;
+
+	if (!m_lastLoaded)
+	{
+		m_lastLoaded = true;
+		char path[512];
+		FILE* file = CachePath(path, sizeof(path), false) ? fopen(path, "r") : nullptr;
+		if (file != nullptr)
+		{
+			char line[kMaxPortName + 16];
+			char* name = nullptr;
+			long type = 0;
+			if (fgets(line, sizeof(line), file) != nullptr)
+			{
+				type = strtol(line, &name, 10);
+				while (*name == ' ')
+					++name;
+				name[strcspn(name, "\r\n")] = '\0';
+			}
+			fclose(file);
+			if (name != nullptr && SerialPort::ResolveName(name, m_last.name, sizeof(m_last.name)))
+				m_last.type = static_cast<int>(type);
+		}
+	}
+
+	if (m_last.name[0] == '\0' || m_last.type == DEVICE_TYPE_UNKNOWN)
+		return false;
+	out = m_last;
+	return true;
+}
+
+void Discovery::Remember(const char* name, int type)
+{
+	if (!g_cacheEnabled.load(std::memory_order_relaxed))
+		return;
+
+	DiscoveredDevice device;
+	if (!SerialPort::ResolveName(name, device.name, sizeof(device.name)))
+		return;
+	device.type = type;
+
+	// Connecting to the same controller every launch writes nothing.
+	DiscoveredDevice last;
+	if (LoadLastKnownGood(last) && last.type == type && strcmp(last.name, device.name) == 0)
+		return;
+
+	char path[512];
+	char temporary[520];
+	if (!CachePath(path, sizeof(path), true))
+		return;
+	snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+
+	FILE* file = fopen(temporary, "w");
+	if (file == nullptr)
+		return;
+	bool written = fprintf(file, "%d %s\n", type, device.name) > 0;
+	written = fclose(file) == 0 && written;
+	if (written && rename(temporary, path) == 0)
+		m_last = device;
+	else
+		unlink(temporary);
+}
+
+} // namespace tdk
@@ -0,0 +1,94 @@
+/************************************************************************
+*                                                                       *
+*   Discovery.h -- scanning the machine for tactor controllers          *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_DISCOVERY_H_
+#define TDK_DISCOVERY_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "FrameParser.h"
+#include "SerialPort.h"
+
+namespace tdk
+{
+
+const int kMaxDiscovered = 16;
+const int kMaxProbeCandidates = 64;
+const int kProbeTimeoutMs = 250;
+
+struct DiscoveredDevice
+{
+	char name[kMaxPortName];
+	int type;
+};
+
+// Results of the last Discover call. Guarded by the DeviceManager table lock.
+//
+// Every candidate port is probed at once: ReadFW goes out on all of them
+// and a single poll collects the answers, each port giving up
+// kProbeTimeoutMs after its own write. A scan therefore takes about one
+// probe timeout however many ports there are, and stops earlier once the
+// first limit ports in name order have answered, so results keep a stable
+// order.
+//
+// The last device Connect succeeded with is remembered per machine in the
+// user's cache directory. Run puts it first in the same pass, so if it
+// answers it leads the results, and is all of them as soon as it answers
+// when limit is 1; a cached device that is gone costs nothing extra. Ports
+// an open Device already uses are never probed.
+class Discovery
+{
+public:
+	static Discovery& Instance();
+
+	// Probes candidate ports of the requested DEVICE_TYPE_* flags, stopping
+	// after limit hits. Returns the number found, or -error.
+	int Run(int typeMask, int limit);
+
+	int Count() const { return m_count; }
+	const DiscoveredDevice* Get(int index) const;
+
+	// Records a device that connected as the last known good one.
+	void Remember(const char* name, int type);
+
+	// Whether Run tries the last known good device first and Remember
+	// persists it. On by default.
+	static void SetCacheEnabled(bool enabled);
+
+private:
+	struct Candidate
+	{
+		char path[kMaxPortName];
+	};
+
+	struct PendingProbe
+	{
+		SerialPort port;
+		FrameParser parser;
+		int64_t deadlineNs;
+		int state;
+	};
+
+	Discovery();
+
+	int ListCandidates(int typeMask, Candidate* out, int capacity) const;
+	// Probes candidates concurrently; sets answered[i] for each that did.
+	// Returns once every port is decided, or once the first limit
+	// candidates to answer, in order, are known.
+	void ProbeAll(const Candidate* candidates, int count, int limit, int timeoutMs, bool* answered);
+	bool LoadLastKnownGood(DiscoveredDevice& out);
+
+	int m_count;
+	DiscoveredDevice m_devices[kMaxDiscovered];
+	PendingProbe m_probes[kMaxProbeCandidates];
+	bool m_lastLoaded;
+	DiscoveredDevice m_last;
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,24 @@
+#include "ErrorState.h"
+
+namespace tdk
+{
+
+namespace
+{
+
+// Each thread sees only the errors of its own calls.
+thread_local int g_lastError = 0;
+
+} // namespace
+
+int LastError()
+{
+	return g_lastError;
+}
+
+void SetLastError(int error)
+{
+	g_lastError = error;
+}
+
+} // namespace tdk
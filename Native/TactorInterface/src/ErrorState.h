@@ -0,0 +1,30 @@
+/************************************************************************
+*                                                                       *
+*   ErrorState.h -- per thread GetLastEAIError/SetLastEAIError state    *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_ERRORSTATE_H_
+#define TDK_ERRORSTATE_H_
+
+namespace tdk
+{
+
+int LastError();
+void SetLastError(int error);
+
+// Entry points finish with this: 0 passes through, anything else is
+// recorded as the last EAI error and reported as -1.
+inline int Complete(int error)
+{
+	if (error != 0)
+	{
+		SetLastError(error);
+		return -1;
+	}
+	return 0;
+}
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,216 @@
+#include "EventLoop.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <EAI_Defines.h>
+
+#include "Clock.h"
+#include "Device.h"
+
+namespace tdk
+{
+
+namespace
+{
+
+const int kMaxEvents = 64;
+
+} // namespace
+
+EventLoop::EventLoop()
+	: m_epollFd(-1)
+	, m_wakeFd(-1)
+	, m_stop(false)
+	, m_sleeping(false)
+	, m_woken(false)
+{
+}
+
+EventLoop::~EventLoop()
+{
+	if (m_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_stop = true;
+		}
+		Wake();
+		m_thread.join();
+	}
+	if (m_wakeFd >= 0)
+		close(m_wakeFd);
+	if (m_epollFd >= 0)
+		close(m_epollFd);
+}
+
+int EventLoop::Attach(Device* device)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	if (m_epollFd < 0)
+	{
+		m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+		m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		epoll_event wake = {};
+		wake.events = EPOLLIN;
+		wake.data.ptr = nullptr;
+		if (m_epollFd < 0 || m_wakeFd < 0 || epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &wake) != 0)
+		{
+			if (m_wakeFd >= 0)
+				close(m_wakeFd);
+			if (m_epollFd >= 0)
+				close(m_epollFd);
+			m_wakeFd = -1;
+			m_epollFd = -1;
+			return ERROR_INTERNALERROR;
+		}
+	}
+
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.ptr = device;
+	if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, device->PortFd(), &event) != 0)
+		return ERROR_INTERNALERROR;
+
+	Entry entry;
+	entry.device = device;
+	entry.ready = true;
+	entry.writeInterest = false;
+	m_devices.push_back(entry);
+
+	if (!m_thread.joinable())
+	{
+		m_stop = false;
+		m_thread = std::thread(&EventLoop::Run, this);
+	}
+	return 0;
+}
+
+void EventLoop::Detach(Device* device)
+{
+	std::thread finished;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		auto entry = std::find_if(m_devices.begin(), m_devices.end(),
+			[device](const Entry& e) { return e.device == device; });
+		if (entry == m_devices.end())
+			return;
+
+		epoll_ctl(m_epollFd, EPOLL_CTL_DEL, device->PortFd(), nullptr);
+		m_devices.erase(entry);
+
+		if (m_devices.empty())
+		{
+			m_stop = true;
+			finished = std::move(m_thread);
+		}
+	}
+
+	// The loop no longer touches the device, so its last flush, which may
+	// wait up to a reply timeout, holds up no other board.
+	device->FinishIo();
+	if (finished.joinable())
+	{
+		Wake();
+		finished.join();
+	}
+}
+
+void EventLoop::Wake()
+{
+	// Pairs with the fence in Run so a wake is never missed by a loop that
+	// is about to sleep.
+	m_woken.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_sleeping.load(std::memory_order_relaxed))
+	{
+		uint64_t one = 1;
+		ssize_t ignored = write(m_wakeFd, &one, sizeof(one));
+		(void)ignored;
+	}
+}
+
+void EventLoop::Run()
+{
+	epoll_event events[kMaxEvents];
+	for (;;)
+	{
+		int timeoutMs = -1;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			if (m_stop)
+				return;
+
+			int64_t next = -1;
+			for (const Entry& entry : m_devices)
+			{
+				int64_t deadline = entry.device->IoDeadline();
+				if (deadline >= 0 && (next < 0 || deadline < next))
+					next = deadline;
+			}
+			if (next >= 0)
+			{
+				int64_t remainingMs = (next - MonotonicNs()) / 1000000 + 1;
+				timeoutMs = remainingMs < 0 ? 0 : static_cast<int>(std::min<int64_t>(remainingMs, 60000));
+			}
+		}
+
+		m_sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_woken.load(std::memory_order_relaxed))
+			timeoutMs = 0;
+		int count = epoll_wait(m_epollFd, events, kMaxEvents, timeoutMs);
+		m_sleeping.store(false, std::memory_order_relaxed);
+		m_woken.store(false, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		for (int i = 0; i < count; ++i)
+		{
+			if (events[i].data.ptr == nullptr)
+			{
+				uint64_t value;
+				ssize_t ignored = read(m_wakeFd, &value, sizeof(value));
+				(void)ignored;
+				continue;
+			}
+
+			// The device may have been detached since the wait returned.
+			Device* device = static_cast<Device*>(events[i].data.ptr);
+			for (Entry& entry : m_devices)
+			{
+				if (entry.device == device)
+					entry.ready = true;
+			}
+		}
+
+		int64_t now = MonotonicNs();
+		for (Entry& entry : m_devices)
+		{
+			Device* device = entry.device;
+			bool woken = device->TakeWake();
+			int64_t deadline = device->IoDeadline();
+			if (!woken && !entry.ready && (deadline < 0 || deadline > now))
+				continue;
+
+			entry.ready = false;
+			device->Service();
+
+			bool wantsWrite = device->WantsWrite();
+			if (wantsWrite != entry.writeInterest)
+			{
+				epoll_event event = {};
+				event.events = EPOLLIN;
+				if (wantsWrite)
+					event.events |= EPOLLOUT;
+				event.data.ptr = device;
+				epoll_ctl(m_epollFd, EPOLL_CTL_MOD, device->PortFd(), &event);
+				entry.writeInterest = wantsWrite;
+			}
+		}
+	}
+}
+
+} // namespace tdk
@@ -0,0 +1,69 @@
+/************************************************************************
+*                                                                       *
+*   EventLoop.h -- one epoll thread serving every connected controller  *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_EVENTLOOP_H_
+#define TDK_EVENTLOOP_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tdk
+{
+
+class Device;
+
+// Drives the port of every attached Device from a single thread. A device
+// is serviced when its port is readable (or writable while output is
+// pending), when Wake marked it after a push, or when the deadline it
+// reports has passed, so the cost of a pass grows with the devices that
+// have work rather than with those connected. The thread runs while at
+// least one device is attached.
+class EventLoop
+{
+public:
+	EventLoop();
+	~EventLoop();
+
+	EventLoop(const EventLoop&) = delete;
+	EventLoop& operator=(const EventLoop&) = delete;
+
+	// Returns 0 or an EAI error code.
+	int Attach(Device* device);
+	// Stops serving device; it is given a last forced flush on the calling
+	// thread before this returns, while the loop goes on serving the rest.
+	void Detach(Device* device);
+
+	// Called by Device::Wake after it marked itself pending.
+	void Wake();
+
+private:
+	struct Entry
+	{
+		Device* device;
+		bool ready;			// port reported readable or writable
+		bool writeInterest;	// EPOLLOUT registered
+	};
+
+	void Run();
+
+	// Guards m_devices and every Device's I/O state against Attach/Detach
+	// while the loop services them; not held while waiting.
+	std::mutex m_lock;
+	std::vector<Entry> m_devices;
+	int m_epollFd;
+	int m_wakeFd;
+	std::thread m_thread;
+	bool m_stop;
+	std::atomic<bool> m_sleeping;
+	std::atomic<bool> m_woken;
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,67 @@
+#include "FrameParser.h"
+
+namespace tdk
+{
+
+FrameParser::FrameParser()
+{
+	Reset();
+}
+
+void FrameParser::Reset()
+{
+	m_state = kWaitStx;
+	m_type = 0;
+	m_length = 0;
+	m_received = 0;
+	m_checksum = 0;
+}
+
+FrameParser::Result FrameParser::Push(uint8_t byte)
+{
+	switch (m_state)
+	{
+	case kWaitStx:
+		if (byte == kFrameStx)
+			m_state = kWaitType;
+		return kNeedMore;
+
+	case kWaitType:
+		m_type = byte;
+		m_state = kWaitLength;
+		return kNeedMore;
+
+	case kWaitLength:
+		m_length = byte;
+		m_received = 0;
+		m_state = m_length > 0 ? kWaitPayload : kWaitChecksum;
+		return kNeedMore;
+
+	case kWaitPayload:
+		m_payload[m_received++] = byte;
+		if (m_received == m_length)
+			m_state = kWaitChecksum;
+		return kNeedMore;
+
+	case kWaitChecksum:
+		m_checksum = byte;
+		m_state = kWaitEtx;
+		return kNeedMore;
+
+	case kWaitEtx:
+		m_state = kWaitStx;
+		if (byte != kFrameEtx)
+		{
+			// A lost ETX usually means the next frame already started.
+			if (byte == kFrameStx)
+				m_state = kWaitType;
+			return kBadEtx;
+		}
+		if (m_checksum != Checksum(m_type, m_payload, m_length))
+			return kBadChecksum;
+		return kFrame;
+	}
+	return kNeedMore;
+}
+
+} // namespace tdk
@@ -0,0 +1,62 @@
+/************************************************************************
+*                                                                       *
+*   FrameParser.h -- incremental decoder for framed packets             *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_FRAMEPARSER_H_
+#define TDK_FRAMEPARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Protocol.h"
+
+namespace tdk
+{
+
+// Consumes a byte stream one byte at a time and reports each frame once its
+// ETX arrives. Bytes outside a frame are skipped until the next STX.
+class FrameParser
+{
+public:
+	enum Result
+	{
+		kNeedMore,
+		kFrame,
+		kBadEtx,
+		kBadChecksum
+	};
+
+	FrameParser();
+
+	Result Push(uint8_t byte);
+	void Reset();
+
+	// Valid after Push returned kFrame.
+	uint8_t Type() const { return m_type; }
+	const uint8_t* Payload() const { return m_payload; }
+	size_t Length() const { return m_length; }
+
+private:
+	enum State
+	{
+		kWaitStx,
+		kWaitType,
+		kWaitLength,
+		kWaitPayload,
+		kWaitChecksum,
+		kWaitEtx
+	};
+
+	State m_state;
+	uint8_t m_type;
+	size_t m_length;
+	size_t m_received;
+	uint8_t m_checksum;
+	uint8_t m_payload[0xFF];
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,106 @@
+/************************************************************************
+*                                                                       *
+*   MpscQueue.h -- bounded lock-free multi-producer queue               *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_MPSCQUEUE_H_
+#define TDK_MPSCQUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace tdk
+{
+
+// Fixed-capacity ring after Dmitry Vyukov's bounded MPMC queue, restricted
+// to a single consumer. Each cell carries a sequence number that tells
+// producers and the consumer whose turn it is, so neither side ever blocks
+// and nothing is allocated after construction.
+template <typename T, size_t Capacity>
+class MpscQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+	MpscQueue()
+		: m_head(0)
+		, m_tail(0)
+	{
+		for (size_t i = 0; i < Capacity; ++i)
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	// Any thread. Returns false when the queue is full.
+	bool TryPush(const T& value)
+	{
+		size_t pos = m_tail.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = m_cells[pos & (Capacity - 1)];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+			if (diff == 0)
+			{
+				if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					cell.value = value;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Consumer thread only.
+	bool TryPop(T& out)
+	{
+		size_t pos = m_head.load(std::memory_order_relaxed);
+		Cell& cell = m_cells[pos & (Capacity - 1)];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1) < 0)
+			return false;
+
+		out = cell.value;
+		cell.sequence.store(pos + Capacity, std::memory_order_release);
+		m_head.store(pos + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Approximate from any thread other than the consumer.
+	size_t Size() const
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		size_t head = m_head.load(std::memory_order_relaxed);
+		return tail >= head ? tail - head : 0;
+	}
+
+	static constexpr size_t kCapacity = Capacity;
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	alignas(64) std::atomic<size_t> m_head;
+	alignas(64) std::atomic<size_t> m_tail;
+	alignas(64) Cell m_cells[Capacity];
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,327 @@
+#include "Protocol.h"
+
+#include <cstring>
+
+namespace tdk
+{
+
+int CommandArgLength(uint8_t command)
+{
+	switch (command)
+	{
+	case TDK_COMMAND_STOP:
+	case TDK_COMMAND_SELFTEST:
+	case TDK_COMMAND_READ_BAT_DATA:
+	case TDK_COMMAND_READFW:
+	case TDK_COMMAND_READ_CURRENT:
+	case TDK_COMMAND_GETSEGMENTLIST:
+	case TDK_COMMAND_TACTION_END:
+		return 0;
+	case TDK_COMMAND_TACTION_PLAY:
+	case TDK_COMMAND_TACTION_START:
+	case TDK_COMMAND_ACTION_WAIT:
+	case TDK_COMMAND_SET_FREQ_TIME_DELAY:
+		return 1;
+	case TDK_COMMAND_PULSE:
+	case TDK_COMMAND_GAIN:
+	case TDK_COMMAND_SETSIGSOURCE:
+	case TDK_COMMAND_SET_TACTOR_TYPE:
+		return 2;
+	case TDK_COMMAND_FREQ:
+		return 3;
+	case TDK_COMMAND_RAMP:
+	case TDK_COMMAND_SET_TACTORS:
+		return 8;
+	default:
+		return -1;
+	}
+}
+
+const char* CommandName(uint8_t command)
+{
+	switch (command)
+	{
+	case TDK_COMMAND_STOP: return "STOP";
+	case TDK_COMMAND_PULSE: return "PULSE";
+	case TDK_COMMAND_FREQ: return "FREQ";
+	case TDK_COMMAND_SETSIGSOURCE: return "SETSIGSOURCE";
+	case TDK_COMMAND_TACTION_PLAY: return "TACTION_PLAY";
+	case TDK_COMMAND_TACTION_START: return "TACTION_START";
+	case TDK_COMMAND_TACTION_END: return "TACTION_END";
+	case TDK_COMMAND_ACTION_WAIT: return "ACTION_WAIT";
+	case TDK_COMMAND_GAIN: return "GAIN";
+	case TDK_COMMAND_RAMP: return "RAMP";
+	case TDK_COMMAND_SELFTEST: return "SELFTEST";
+	case TDK_COMMAND_SET_TACTOR_TYPE: return "SET_TACTOR_TYPE";
+	case TDK_COMMAND_READ_BAT_DATA: return "READ_BAT_DATA";
+	case TDK_COMMAND_READFW: return "READFW";
+	case TDK_COMMAND_GETSEGMENTLIST: return "GETSEGMENTLIST";
+	case TDK_COMMAND_READ_CURRENT: return "READ_CURRENT";
+	case TDK_COMMAND_SET_TACTORS: return "SET_TACTORS";
+	case TDK_COMMAND_SET_FREQ_TIME_DELAY: return "SET_FREQ_TIME_DELAY";
+	default: return nullptr;
+	}
+}
+
+uint8_t Checksum(uint8_t type, const uint8_t* payload, size_t length)
+{
+	uint8_t sum = type ^ static_cast<uint8_t>(length);
+	for (size_t i = 0; i < length; ++i)
+		sum ^= payload[i];
+	return sum;
+}
+
+ActionListWriter::ActionListWriter(uint8_t* buffer, size_t capacity)
+	: m_buffer(buffer)
+	, m_capacity(capacity < kMaxFrameSize ? capacity : kMaxFrameSize)
+	, m_length(0)
+{
+}
+
+void ActionListWriter::Begin(uint8_t timeFactor)
+{
+	m_buffer[3] = timeFactor;
+	m_length = 1;
+}
+
+bool ActionListWriter::Append(const Action& action)
+{
+	size_t size = action.EncodedSize();
+	if (m_length + size > kMaxPayload || 3 + m_length + size + 2 > m_capacity)
+		return false;
+
+	uint8_t* p = m_buffer + 3 + m_length;
+	p[0] = action.delay;
+	p[1] = action.command;
+	memcpy(p + 2, action.args, action.argLength);
+	m_length += size;
+	return true;
+}
+
+size_t ActionListWriter::Finish()
+{
+	m_buffer[0] = kFrameStx;
+	m_buffer[1] = kFrameTypeActionList;
+	m_buffer[2] = static_cast<uint8_t>(m_length);
+	m_buffer[3 + m_length] = Checksum(kFrameTypeActionList, m_buffer + 3, m_length);
+	m_buffer[4 + m_length] = kFrameEtx;
+	return m_length + kFrameOverhead;
+}
+
+size_t EncodeFrame(uint8_t type, const uint8_t* payload, size_t length, uint8_t* out, size_t capacity)
+{
+	if (length > 0xFF || length + kFrameOverhead > capacity)
+		return 0;
+
+	out[0] = kFrameStx;
+	out[1] = type;
+	out[2] = static_cast<uint8_t>(length);
+	if (length > 0)
+		memcpy(out + 3, payload, length);
+	out[3 + length] = Checksum(type, payload, length);
+	out[4 + length] = kFrameEtx;
+	return length + kFrameOverhead;
+}
+
+size_t PackActionLists(const Command* commands, size_t count, uint8_t* out, size_t capacity, size_t& frameCount,
+	bool* lastInFrame)
+{
+	size_t used = 0;
+	frameCount = 0;
+
+	size_t i = 0;
+	while (i < count)
+	{
+		if (capacity - used < kFrameOverhead + 1)
+			return 0;
+
+		size_t first = i;
+		ActionListWriter writer(out + used, capacity - used);
+		writer.Begin(commands[i].timeFactor);
+		if (!writer.Append(commands[i].action))
+			return 0;
+
+		uint8_t timeFactor = commands[i].timeFactor;
+		for (++i; i < count && commands[i].timeFactor == timeFactor; ++i)
+		{
+			if (!writer.Append(commands[i].action))
+				break;
+		}
+
+		used += writer.Finish();
+		++frameCount;
+		if (lastInFrame != nullptr)
+		{
+			for (size_t j = first; j < i; ++j)
+				lastInFrame[j] = (j + 1 == i);
+		}
+	}
+	return used;
+}
+
+namespace
+{
+
+// Times travel as a single byte counting time factor units.
+int EncodeTime(int ms, int timeFactor, bool isDuration, uint8_t& out)
+{
+	if (ms < 0 || timeFactor <= 0)
+		return ERROR_BADPARAMETER;
+
+	int units = (ms + timeFactor / 2) / timeFactor;
+	if (isDuration && units == 0)
+		units = 1;
+	if (units > 0xFF)
+		return ERROR_BADPARAMETER;
+
+	out = static_cast<uint8_t>(units);
+	return 0;
+}
+
+bool ValidTactor(int tactor)
+{
+	return tactor >= 1 && tactor <= kMaxTactors;
+}
+
+int Begin(Action& out, uint8_t command, int msDelay, int timeFactor)
+{
+	out.command = command;
+	out.argLength = static_cast<uint8_t>(CommandArgLength(command));
+	return EncodeTime(msDelay, timeFactor, false, out.delay);
+}
+
+void PutU16(uint8_t* p, int value)
+{
+	p[0] = static_cast<uint8_t>((value >> 8) & 0xFF);
+	p[1] = static_cast<uint8_t>(value & 0xFF);
+}
+
+} // namespace
+
+int MakePulse(Action& out, int tactor, int msDuration, int msDelay, int timeFactor)
+{
+	if (!ValidTactor(tactor))
+		return ERROR_BADPARAMETER;
+	if (int error = Begin(out, TDK_COMMAND_PULSE, msDelay, timeFactor))
+		return error;
+
+	out.args[0] = static_cast<uint8_t>(tactor);
+	return EncodeTime(msDuration, timeFactor, true, out.args[1]);
+}
+
+int MakeActionWait(Action& out, int msDuration, int msDelay, int timeFactor)
+{
+	if (int error = Begin(out, TDK_COMMAND_ACTION_WAIT, msDelay, timeFactor))
+		return error;
+
+	return EncodeTime(msDuration, timeFactor, true, out.args[0]);
+}
+
+int MakeGain(Action& out, int tactor, int gain, int msDelay, int timeFactor)
+{
+	if (!ValidTactor(tactor) || gain < 0 || gain > MAX_ACTION_GAIN)
+		return ERROR_BADPARAMETER;
+	if (int error = Begin(out, TDK_COMMAND_GAIN, msDelay, timeFactor))
+		return error;
+
+	out.args[0] = static_cast<uint8_t>(tactor);
+	out.args[1] = static_cast<uint8_t>(gain);
+	return 0;
+}
+
+int MakeFreq(Action& out, int tactor, int freq, int msDelay, int timeFactor)
+{
+	if (!ValidTactor(tactor) || freq < MIN_ACTION_FREQUENCY || freq > kMaxFrequency)
+		return ERROR_BADPARAMETER;
+	if (int error = Begin(out, TDK_COMMAND_FREQ, msDelay, timeFactor))
+		return error;
+
+	out.args[0] = static_cast<uint8_t>(tactor);
+	PutU16(out.args + 1, freq);
+	return 0;
+}
+
+int MakeRamp(Action& out, uint8_t target, int tactor, int start, int end, int msDuration, int func, int msDelay, int timeFactor)
+{
+	if (!ValidTactor(tactor) || func != TDK_LINEAR_RAMP)
+		return ERROR_BADPARAMETER;
+
+	int low = target == kRampTargetGain ? 0 : MIN_ACTION_FREQUENCY;
+	int high = target == kRampTargetGain ? MAX_ACTION_GAIN : kMaxFrequency;
+	if (start < low || start > high || end < low || end > high)
+		return ERROR_BADPARAMETER;
+	if (int error = Begin(out, TDK_COMMAND_RAMP, msDelay, timeFactor))
+		return error;
+
+	out.args[0] = static_cast<uint8_t>(tactor);
+	out.args[1] = target;
+	PutU16(out.args + 2, start);
+	PutU16(out.args + 4, end);
+	out.args[7] = static_cast<uint8_t>(func);
+	return EncodeTime(msDuration, timeFactor, true, out.args[6]);
+}
+
+int MakeSigSource(Action& out, int tactor, int type, int msDelay, int timeFactor)
+{
+	if (!ValidTactor(tactor) || type <= 0 || type > TDK_SIG_SRC_PRIMARY_MOD_NOISE)
+		return ERROR_BADPARAMETER;
+	if (int error = Begin(out, TDK_COMMAND_SETSIGSOURCE, msDelay, timeFactor))
+		return error;
+
+	out.args[0] = static_cast<uint8_t>(tactor);
+	out.args[1] = static_cast<uint8_t>(type);
+	return 0;
+}
+
+int MakeSetTactors(Action& out, const unsigned char* states, int msDelay, int timeFactor)
+{
+	if (states == nullptr)
+		return ERROR_BADPARAMETER;
+	if (int error = Begin(out, TDK_COMMAND_SET_TACTORS, msDelay, timeFactor))
+		return error;
+
+	memcpy(out.args, states, kTactorStateBytes);
+	return 0;
+}
+
+int MakeSetTactorType(Action& out, int tactor, int type, int msDelay, int timeFactor)
+{
+	if (!ValidTactor(tactor))
+		return ERROR_BADPARAMETER;
+	if (type != TDK_TACTOR_TYPE_C3 && type != TDK_TACTOR_TYPE_C2 && type != TDK_TACTOR_TYPE_EMS && type != TDK_TACTOR_TYPE_EMR)
+		return ERROR_BADPARAMETER;
+	if (int error = Begin(out, TDK_COMMAND_SET_TACTOR_TYPE, msDelay, timeFactor))
+		return error;
+
+	out.args[0] = static_cast<uint8_t>(tactor);
+	out.args[1] = static_cast<uint8_t>(type);
+	return 0;
+}
+
+int MakeStoredTAction(Action& out, uint8_t command, int slot, int msDelay, int timeFactor)
+{
+	if (slot < 1 || slot > TDK_MAX_STORED_TACTIONS)
+		return ERROR_BADPARAMETER;
+	if (int error = Begin(out, command, msDelay, timeFactor))
+		return error;
+
+	out.args[0] = static_cast<uint8_t>(slot);
+	return 0;
+}
+
+int MakeSimple(Action& out, uint8_t command, int msDelay, int timeFactor)
+{
+	if (CommandArgLength(command) != 0)
+		return ERROR_BADPARAMETER;
+
+	return Begin(out, command, msDelay, timeFactor);
+}
+
+int MakeFreqTimeDelay(Action& out, bool delayOn)
+{
+	Begin(out, TDK_COMMAND_SET_FREQ_TIME_DELAY, 0, kDefaultTimeFactor);
+	out.args[0] = delayOn ? 1 : 0;
+	return 0;
+}
+
+} // namespace tdk
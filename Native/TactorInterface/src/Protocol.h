@@ -0,0 +1,148 @@
+/************************************************************************
+*                                                                       *
+*   Protocol.h -- wire format spoken with the EAI tactor controllers    *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_PROTOCOL_H_
+#define TDK_PROTOCOL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <EAI_Defines.h>
+
+namespace tdk
+{
+
+// Every packet on the link, in either direction, is framed as
+//
+//     STX | type | length | payload[length] | checksum | ETX
+//
+// where checksum is the XOR of type, length and every payload byte.
+const uint8_t kFrameStx = 0x02;
+const uint8_t kFrameEtx = 0x03;
+const size_t kFrameOverhead = 5;
+
+// Frame types. Action lists go host -> controller, everything else comes back.
+const uint8_t kFrameTypeActionList = 0xC8;	// payload: time factor, then actions
+const uint8_t kFrameTypeAck = 0x06;			// payload: empty
+const uint8_t kFrameTypeNak = 0x15;			// payload: reason byte
+const uint8_t kFrameTypeData = 0xC9;		// payload: command byte, then reply data
+
+// Size of the controller receive buffer. Bigger payloads are NAK'd with
+// kNakPacketTooLarge.
+const size_t kMaxPayload = 128;
+const size_t kMaxFrameSize = kMaxPayload + kFrameOverhead;
+
+// NAK reasons, as decoded by TdkDefines.NakReasonToString on the C# side.
+const uint8_t kNakBadEtx = 0x01;
+const uint8_t kNakBadChecksum = 0x02;
+const uint8_t kNakInsufficientData = 0x03;
+const uint8_t kNakInvalidCommand = 0x04;
+const uint8_t kNakInvalidData = 0x05;
+const uint8_t kNakRampListFull = 0x0D;
+const uint8_t kNakActionListFull = 0x0E;
+const uint8_t kNakInternalError = 0x0F;
+const uint8_t kNakMasterPacketFull = 0x10;
+const uint8_t kNakPacketTooLarge = 0x13;
+const uint8_t kNakSelfTestRunning = 0x14;
+
+// Argument selector of TDK_COMMAND_RAMP.
+const uint8_t kRampTargetGain = 0x00;
+const uint8_t kRampTargetFreq = 0x01;
+
+const int kMaxTactors = 64;
+const int kTactorStateBytes = kMaxTactors / 8;
+const int kDefaultTimeFactor = 10;
+// TactorInterface.h documents 300-3550, one step above MAX_ACTION_FREQUENCY.
+const int kMaxFrequency = 3550;
+
+const size_t kMaxActionArgs = 8;
+
+// One entry of an action list: the delay (in time factor units) before the
+// controller runs it, the TDK_COMMAND_* opcode and its arguments.
+struct Action
+{
+	uint8_t delay;
+	uint8_t command;
+	uint8_t argLength;
+	uint8_t args[kMaxActionArgs];
+
+	size_t EncodedSize() const { return 2 + argLength; }
+};
+
+// An action together with the time factor its delay and durations were
+// scaled by; the factor is sent once per action list.
+struct Command
+{
+	Action action;
+	uint8_t timeFactor;
+};
+
+// Number of argument bytes that follow a TDK_COMMAND_* opcode, or -1 when
+// the opcode is unknown.
+int CommandArgLength(uint8_t command);
+
+// The TDK_COMMAND_* name of an opcode without its prefix ("PULSE"), or
+// nullptr when the opcode is unknown.
+const char* CommandName(uint8_t command);
+
+uint8_t Checksum(uint8_t type, const uint8_t* payload, size_t length);
+
+// Builds an action list frame in a caller-owned buffer. Nothing is
+// allocated; Append refuses actions once the payload would outgrow
+// kMaxPayload.
+class ActionListWriter
+{
+public:
+	ActionListWriter(uint8_t* buffer, size_t capacity);
+
+	void Begin(uint8_t timeFactor);
+	bool Append(const Action& action);
+	size_t Finish();
+
+	size_t PayloadSize() const { return m_length; }
+	bool Empty() const { return m_length <= 1; }
+
+private:
+	uint8_t* m_buffer;
+	size_t m_capacity;
+	size_t m_length;
+};
+
+// Encode a single frame of the given type. Returns the frame size, or 0 if
+// it does not fit in capacity.
+size_t EncodeFrame(uint8_t type, const uint8_t* payload, size_t length, uint8_t* out, size_t capacity);
+
+// Packs commands, in order, into back-to-back action list frames holding as
+// many actions as kMaxPayload allows. A new frame starts when the time factor
+// changes. Returns the bytes written (0 if out is too small) and sets
+// frameCount. If lastInFrame is given, lastInFrame[i] is set for the final
+// command of each frame.
+size_t PackActionLists(const Command* commands, size_t count, uint8_t* out, size_t capacity, size_t& frameCount,
+	bool* lastInFrame = nullptr);
+
+// Worst case output size of PackActionLists for count commands.
+constexpr size_t PackedSizeBound(size_t count)
+{
+	return count * (2 + kMaxActionArgs + kFrameOverhead + 1);
+}
+
+// Builders for each command. They validate the arguments against the limits
+// in EAI_Defines.h, scale times by timeFactor and return 0 or an EAI error code.
+int MakePulse(Action& out, int tactor, int msDuration, int msDelay, int timeFactor);
+int MakeActionWait(Action& out, int msDuration, int msDelay, int timeFactor);
+int MakeGain(Action& out, int tactor, int gain, int msDelay, int timeFactor);
+int MakeFreq(Action& out, int tactor, int freq, int msDelay, int timeFactor);
+int MakeRamp(Action& out, uint8_t target, int tactor, int start, int end, int msDuration, int func, int msDelay, int timeFactor);
+int MakeSigSource(Action& out, int tactor, int type, int msDelay, int timeFactor);
+int MakeSetTactors(Action& out, const unsigned char* states, int msDelay, int timeFactor);
+int MakeSetTactorType(Action& out, int tactor, int type, int msDelay, int timeFactor);
+int MakeStoredTAction(Action& out, uint8_t command, int slot, int msDelay, int timeFactor);
+int MakeSimple(Action& out, uint8_t command, int msDelay, int timeFactor);
+int MakeFreqTimeDelay(Action& out, bool delayOn);
+
+} // namespace tdk
+
+#endif
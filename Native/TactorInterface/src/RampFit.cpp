@@ -0,0 +1,214 @@
+#include "RampFit.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace tdk
+{
+
+namespace
+{
+
+// Ternary search steps over the slope; (2/3)^60 of the initial range is far
+// below one gain or frequency step per unit.
+const int kSlopeIterations = 60;
+
+// How far the best intercept for lines of the given slope misses: the
+// largest lower bound on the intercept minus the smallest upper bound, from
+// every point being within tolerance and both ends within [low, high]. The
+// lower bounds are maxima and the upper bounds minima of linear functions
+// of the slope, so the gap is convex in it. intercept is the middle of the
+// allowed range, or the best compromise when there is none.
+double Gap(const double* points, int length, double tolerance, int low, int high, double slope, double& intercept)
+{
+	double lowest = points[0];
+	double highest = points[0];
+	for (int k = 1; k <= length; ++k)
+	{
+		double residual = points[k] - slope * k;
+		lowest = std::min(lowest, residual);
+		highest = std::max(highest, residual);
+	}
+
+	double lower = std::max({ highest - tolerance, static_cast<double>(low), low - slope * length });
+	double upper = std::min({ lowest + tolerance, static_cast<double>(high), high - slope * length });
+	intercept = (lower + upper) / 2;
+	return lower - upper;
+}
+
+// Finds the ramp over points[0..length] that misses them least in the worst
+// case. Returns true as soon as one is within tolerance of every point. The
+// best slope lies between the steepest fall and rise the value range allows.
+bool FitLine(const double* points, int length, double tolerance, int low, int high, double& intercept,
+	double& slope)
+{
+	double range = static_cast<double>(high - low) / length;
+	double from = -range;
+	double to = range;
+	for (int i = 0; i < kSlopeIterations; ++i)
+	{
+		double left = from + (to - from) / 3;
+		double right = to - (to - from) / 3;
+		double leftIntercept = 0;
+		double rightIntercept = 0;
+		double leftGap = Gap(points, length, tolerance, low, high, left, leftIntercept);
+		double rightGap = Gap(points, length, tolerance, low, high, right, rightIntercept);
+		if (leftGap <= 0 || rightGap <= 0)
+		{
+			bool useLeft = leftGap <= rightGap;
+			slope = useLeft ? left : right;
+			intercept = useLeft ? leftIntercept : rightIntercept;
+			return true;
+		}
+		if (leftGap < rightGap)
+			to = right;
+		else
+			from = left;
+	}
+
+	slope = (from + to) / 2;
+	return Gap(points, length, tolerance, low, high, slope, intercept) <= 0;
+}
+
+bool Fits(const double* points, int length, double tolerance, int low, int high)
+{
+	double intercept = 0;
+	double slope = 0;
+	return FitLine(points, length, tolerance, low, high, intercept, slope);
+}
+
+// Longest ramp from points[0] within tolerance, at most longest units, or 0
+// when even minUnits is not. Probes double until one fails, then bisects.
+int LongestFit(const double* points, int minUnits, int longest, double tolerance, int low, int high)
+{
+	int good = 0;
+	int bad = longest + 1;
+	for (int probe = minUnits;; probe *= 2)
+	{
+		probe = std::min(probe, longest);
+		if (!Fits(points, probe, tolerance, low, high))
+		{
+			bad = probe;
+			break;
+		}
+		good = probe;
+		if (probe == longest)
+			break;
+	}
+	if (good == 0)
+		return 0;
+
+	while (bad - good > 1)
+	{
+		int mid = good + (bad - good) / 2;
+		if (Fits(points, mid, tolerance, low, high))
+			good = mid;
+		else
+			bad = mid;
+	}
+	return good;
+}
+
+int Round(double value, int low, int high)
+{
+	return std::min(high, std::max(low, static_cast<int>(std::lround(value))));
+}
+
+} // namespace
+
+int SampleCurve(int curve, int start, int end, int units, double* points)
+{
+	if (units <= 0 || units > kMaxEnvelopeUnits)
+		return ERROR_BADPARAMETER;
+
+	for (int u = 0; u <= units; ++u)
+	{
+		double t = static_cast<double>(u) / units;
+		double shape = 0;
+		switch (curve)
+		{
+		case kCurveLinear:
+			shape = t;
+			break;
+		case kCurveEaseIn:
+			shape = t * t;
+			break;
+		case kCurveEaseOut:
+			shape = t * (2 - t);
+			break;
+		case kCurveEaseInOut:
+			shape = t * t * (3 - 2 * t);
+			break;
+		case kCurveExponential:
+			shape = (std::exp2(10 * t) - 1) / 1023;
+			break;
+		default:
+			return ERROR_BADPARAMETER;
+		}
+		points[u] = start + (end - start) * shape;
+	}
+	return 0;
+}
+
+int ResampleValues(const int* values, int count, int msStep, int timeFactor, double* points)
+{
+	if (values == nullptr || count < 2 || msStep <= 0 || timeFactor <= 0)
+		return -ERROR_BADPARAMETER;
+
+	long long totalMs = static_cast<long long>(count - 1) * msStep;
+	long long units = (totalMs + timeFactor / 2) / timeFactor;
+	if (units <= 0 || units > kMaxEnvelopeUnits)
+		return -ERROR_BADPARAMETER;
+
+	for (int u = 0; u <= units; ++u)
+	{
+		double position = std::min(static_cast<double>(u) * timeFactor, static_cast<double>(totalMs)) / msStep;
+		int index = std::min(static_cast<int>(position), count - 2);
+		double fraction = position - index;
+		points[u] = values[index] + (values[index + 1] - values[index]) * fraction;
+	}
+	return static_cast<int>(units);
+}
+
+int FitRamps(const double* points, int units, double maxError, int minUnits, int maxUnits, int low, int high,
+	RampSegment* out, int capacity)
+{
+	if (points == nullptr || units < minUnits || units > kMaxEnvelopeUnits || minUnits <= 0
+		|| maxUnits < 2 * minUnits || maxError < 0.5 || low > high)
+		return -ERROR_BADPARAMETER;
+
+	// Rounding each end to an integer moves the ramp by up to half a step.
+	double tolerance = maxError - 0.5;
+	int count = 0;
+	int position = 0;
+	while (position < units)
+	{
+		if (count == capacity)
+			return -ERROR_TM_MAX_ACTION_LIMIT_REACHED;
+
+		int remaining = units - position;
+		int longest = std::min(maxUnits, remaining);
+		int length = LongestFit(points + position, minUnits, longest, tolerance, low, high);
+		if (length == 0)
+			length = minUnits;
+		// Never leave a tail shorter than a ramp may be: shorten this ramp
+		// (which keeps it within the bound) so the last one is minUnits, or
+		// take the tail along when there is not room for two.
+		if (remaining - length > 0 && remaining - length < minUnits)
+			length = remaining >= 2 * minUnits ? remaining - minUnits : remaining;
+
+		double intercept = 0;
+		double slope = 0;
+		FitLine(points + position, length, tolerance, low, high, intercept, slope);
+
+		RampSegment& segment = out[count++];
+		segment.offset = position;
+		segment.units = length;
+		segment.start = Round(intercept, low, high);
+		segment.end = Round(intercept + slope * length, low, high);
+		position += length;
+	}
+	return count;
+}
+
+} // namespace tdk
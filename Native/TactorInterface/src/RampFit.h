@@ -0,0 +1,64 @@
+/************************************************************************
+*                                                                       *
+*   RampFit.h -- fewest linear ramps that follow an envelope            *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_RAMPFIT_H_
+#define TDK_RAMPFIT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <EAI_Defines.h>
+
+namespace tdk
+{
+
+// Envelopes are sampled once per time factor unit, and every ramp of one
+// must start within a single action delay (255 units) of the first.
+const int kMaxEnvelopeUnits = 2 * 0xFF;
+
+// Analytic envelopes, from start at 0 to end at 1. The values match the
+// TDK_CURVE_* defines of TactorInterface.h; kCurveLinear is TDK_LINEAR_RAMP.
+enum EnvelopeCurve
+{
+	kCurveLinear = 1,
+	kCurveEaseIn = 2,		// quadratic
+	kCurveEaseOut = 3,
+	kCurveEaseInOut = 4,	// smoothstep
+	kCurveExponential = 5	// 2^(10t), scaled to end exactly at end
+};
+
+// A linear ramp from start to end over units, beginning offset units after
+// the envelope does.
+struct RampSegment
+{
+	int offset;
+	int units;
+	int start;
+	int end;
+};
+
+// Fills points[0..units] with curve from start to end; units is the
+// envelope length. Returns 0 or an EAI error code.
+int SampleCurve(int curve, int start, int end, int units, double* points);
+
+// Fills points with the polyline through values, taken every msStep, at
+// each unit of timeFactor milliseconds. Returns the envelope length in
+// units, or -error.
+int ResampleValues(const int* values, int count, int msStep, int timeFactor, double* points);
+
+// Splits the envelope in points[0..units] into as few ramps as possible,
+// each between minUnits and maxUnits long, so that no point is further than
+// maxError from the ramp covering it, with ramp ends that are integers in
+// [low, high]. Ramps are cut back to back; each is fitted on its own, so
+// consecutive ramps need not meet. Where the envelope bends faster than
+// minUnits allow, a ramp of minUnits is used even if it misses the bound.
+// Returns the number of ramps, or -error.
+int FitRamps(const double* points, int units, double maxError, int minUnits, int maxUnits, int low, int high,
+	RampSegment* out, int capacity);
+
+} // namespace tdk
+
+#endif
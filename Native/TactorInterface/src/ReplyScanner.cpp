@@ -0,0 +1,137 @@
+#include "ReplyScanner.h"
+
+#include <cstring>
+
+namespace tdk
+{
+
+namespace
+{
+
+// The buffer is compacted once less than this is left after the data, so
+// one read can take what a busy link delivers between two wakeups.
+const size_t kMinReadSpace = 1024;
+
+static_assert(kReplyScanSize >= kMinReadSpace + kMaxReplyFrame, "scan buffer too small");
+
+} // namespace
+
+ReplyScanner::ReplyScanner()
+{
+	Reset();
+}
+
+void ReplyScanner::Reset()
+{
+	m_start = 0;
+	m_end = 0;
+	m_skipped = 0;
+}
+
+bool ReplyScanner::Plausible(uint8_t type, size_t length)
+{
+	switch (type)
+	{
+	case kFrameTypeAck:
+		return length == 0;
+	case kFrameTypeNak:
+		return length == 1;
+	case kFrameTypeData:
+		return length > 0 && length <= kMaxPayload;
+	default:
+		return false;
+	}
+}
+
+uint8_t* ReplyScanner::WriteSpace(size_t& capacity)
+{
+	if (m_start == m_end)
+	{
+		m_start = 0;
+		m_end = 0;
+	}
+	else if (kReplyScanSize - m_end < kMinReadSpace)
+	{
+		// Only an unfinished frame is left, so this moves a few bytes.
+		memmove(m_data, m_data + m_start, m_end - m_start);
+		m_end -= m_start;
+		m_start = 0;
+	}
+	capacity = kReplyScanSize - m_end;
+	return m_data + m_end;
+}
+
+void ReplyScanner::Wrote(size_t bytes)
+{
+	m_end += bytes;
+}
+
+bool ReplyScanner::Abandon()
+{
+	// Next leaves nothing buffered ahead of an STX.
+	if (m_start == m_end)
+		return false;
+	++m_skipped;
+	++m_start;
+	return true;
+}
+
+ReplyScanner::Result ReplyScanner::Next(Frame& frame)
+{
+	while (m_start < m_end)
+	{
+		const uint8_t* at = m_data + m_start;
+		size_t available = m_end - m_start;
+		if (at[0] != kFrameStx)
+		{
+			const void* stx = memchr(at, kFrameStx, available);
+			size_t skip = stx != nullptr ? static_cast<const uint8_t*>(stx) - at : available;
+			m_skipped += skip;
+			m_start += skip;
+			continue;
+		}
+
+		// A length is waited for only after a type that could be a reply.
+		if (available == 2 && at[1] != kFrameTypeAck && at[1] != kFrameTypeNak && at[1] != kFrameTypeData)
+		{
+			++m_skipped;
+			++m_start;
+			continue;
+		}
+		if (available < 3)
+			return kNeedMore;
+		if (!Plausible(at[1], at[2]))
+		{
+			++m_skipped;
+			++m_start;
+			continue;
+		}
+
+		size_t size = at[2] + kFrameOverhead;
+		if (available < size)
+			return kNeedMore;
+
+		frame.type = at[1];
+		frame.payload = at + 3;
+		frame.length = at[2];
+		frame.bytes = at;
+		frame.size = size;
+		if (at[size - 1] != kFrameEtx)
+		{
+			++m_skipped;
+			++m_start;
+			return kBadEtx;
+		}
+		if (at[size - 2] != Checksum(frame.type, frame.payload, frame.length))
+		{
+			++m_skipped;
+			++m_start;
+			return kBadChecksum;
+		}
+		m_start += size;
+		return kFrame;
+	}
+	return kNeedMore;
+}
+
+} // namespace tdk
@@ -0,0 +1,90 @@
+/************************************************************************
+*                                                                       *
+*   ReplyScanner.h -- in-place decoder for controller replies           *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_REPLYSCANNER_H_
+#define TDK_REPLYSCANNER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Protocol.h"
+
+namespace tdk
+{
+
+const size_t kReplyScanSize = 4096;
+// Largest frame the scanner believes, a data reply of kMaxPayload bytes.
+const size_t kMaxReplyFrame = kMaxFrameSize;
+
+// Finds reply frames in the buffer the port reads into. A read goes
+// straight to WriteSpace, and Next hands out each frame found as pointers
+// into that same buffer, so no frame is copied on its way in. Frames split
+// over reads are simply picked up once the rest arrives: only the
+// unfinished tail of the data is ever moved, back to the start of the
+// buffer, and only once the space after it runs short.
+//
+// A header is only believed if its type is ACK, NAK or data and its length
+// suits that type; any other byte, STX or not, is skipped. A believed frame
+// whose ETX or checksum is wrong is reported once, and scanning resumes one
+// byte past its STX, so a real frame that the damaged one seemed to cover
+// is still found, as is one behind a header given up with Abandon.
+class ReplyScanner
+{
+public:
+	enum Result
+	{
+		kNeedMore,
+		kFrame,
+		kBadEtx,
+		kBadChecksum
+	};
+
+	struct Frame
+	{
+		uint8_t type;
+		const uint8_t* payload;
+		size_t length;
+		// The whole frame, STX to ETX.
+		const uint8_t* bytes;
+		size_t size;
+	};
+
+	ReplyScanner();
+
+	// Drops everything buffered.
+	void Reset();
+
+	// Where the next read goes, with room for at least kMaxReplyFrame bytes.
+	// Frames returned by Next are only valid until this is called again.
+	uint8_t* WriteSpace(size_t& capacity);
+	void Wrote(size_t bytes);
+
+	// The next frame in the bytes written so far. kFrame and the two errors
+	// fill frame; the errors describe the header that failed.
+	Result Next(Frame& frame);
+
+	// For when the link has gone quiet with part of a frame buffered: a
+	// damaged length can make a header wait for bytes that never come.
+	// Skips the STX, so Next looks past it. Returns false if nothing was
+	// buffered.
+	bool Abandon();
+
+	size_t Buffered() const { return m_end - m_start; }
+	// Bytes passed over outside any believed frame.
+	uint64_t Skipped() const { return m_skipped; }
+
+private:
+	static bool Plausible(uint8_t type, size_t length);
+
+	size_t m_start;
+	size_t m_end;
+	uint64_t m_skipped;
+	uint8_t m_data[kReplyScanSize];
+};
+
+} // namespace tdk
+
+#endif
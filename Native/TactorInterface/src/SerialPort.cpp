@@ -0,0 +1,182 @@
+#include "SerialPort.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <EAI_Defines.h>
+
+namespace tdk
+{
+
+namespace
+{
+
+speed_t BaudConstant(int baudRate)
+{
+	switch (baudRate)
+	{
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 921600: return B921600;
+	default: return B115200;
+	}
+}
+
+} // namespace
+
+SerialPort::SerialPort()
+	: m_fd(-1)
+{
+	m_name[0] = '\0';
+}
+
+SerialPort::~SerialPort()
+{
+	Close();
+}
+
+bool SerialPort::ResolveName(const char* name, char* out, size_t capacity)
+{
+	if (name == nullptr || name[0] == '\0')
+		return false;
+
+	int written = name[0] == '/'
+		? snprintf(out, capacity, "%s", name)
+		: snprintf(out, capacity, "/dev/%s", name);
+	return written > 0 && static_cast<size_t>(written) < capacity;
+}
+
+int SerialPort::Open(const char* name, int baudRate)
+{
+	Close();
+
+	if (!ResolveName(name, m_name, sizeof(m_name)))
+		return ERROR_BADPARAMETER;
+
+	int fd = ::open(m_name, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return ERROR_CONNECTION;
+
+	termios tio;
+	if (tcgetattr(fd, &tio) != 0)
+	{
+		::close(fd);
+		return ERROR_CONNECTION;
+	}
+
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, BaudConstant(baudRate));
+	cfsetospeed(&tio, BaudConstant(baudRate));
+	if (tcsetattr(fd, TCSANOW, &tio) != 0)
+	{
+		::close(fd);
+		return ERROR_CONNECTION;
+	}
+
+	tcflush(fd, TCIOFLUSH);
+	m_fd = fd;
+	return 0;
+}
+
+void SerialPort::Close()
+{
+	if (m_fd >= 0)
+	{
+		::close(m_fd);
+		m_fd = -1;
+	}
+}
+
+int SerialPort::Write(const uint8_t* data, size_t length, int timeoutMs)
+{
+	if (m_fd < 0)
+		return ERROR_HANDLE_NULL;
+
+	size_t sent = 0;
+	while (sent < length)
+	{
+		ssize_t n = ::write(m_fd, data + sent, length - sent);
+		if (n > 0)
+		{
+			sent += static_cast<size_t>(n);
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno != EAGAIN)
+			return ERROR_FAILED_TO_WRITE;
+
+		pollfd pfd = { m_fd, POLLOUT, 0 };
+		int ready = ::poll(&pfd, 1, timeoutMs);
+		if (ready == 0)
+			return ERROR_EAITIMEOUT;
+		if (ready < 0 && errno != EINTR)
+			return ERROR_FAILED_TO_WRITE;
+	}
+	return 0;
+}
+
+long SerialPort::WriteSome(const uint8_t* data, size_t length)
+{
+	if (m_fd < 0)
+		return -ERROR_HANDLE_NULL;
+
+	for (;;)
+	{
+		ssize_t n = ::write(m_fd, data, length);
+		if (n >= 0)
+			return n;
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN)
+			return 0;
+		return -ERROR_FAILED_TO_WRITE;
+	}
+}
+
+long SerialPort::Read(uint8_t* buffer, size_t capacity)
+{
+	if (m_fd < 0)
+		return -ERROR_HANDLE_NULL;
+
+	for (;;)
+	{
+		ssize_t n = ::read(m_fd, buffer, capacity);
+		if (n >= 0)
+			return n;
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN)
+			return 0;
+		return -ERROR_FAILED_TO_READ;
+	}
+}
+
+int SerialPort::WaitReadable(int timeoutMs)
+{
+	if (m_fd < 0)
+		return -ERROR_HANDLE_NULL;
+
+	pollfd pfd = { m_fd, POLLIN, 0 };
+	int ready = ::poll(&pfd, 1, timeoutMs);
+	if (ready < 0)
+		return errno == EINTR ? 0 : -ERROR_FAILED_TO_READ;
+	if (ready > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) && !(pfd.revents & POLLIN))
+		return -ERROR_FAILED_TO_READ;
+	return ready;
+}
+
+} // namespace tdk
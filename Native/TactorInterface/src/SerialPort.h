@@ -0,0 +1,56 @@
+/************************************************************************
+*                                                                       *
+*   SerialPort.h -- POSIX termios transport to a tactor controller      *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_SERIALPORT_H_
+#define TDK_SERIALPORT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tdk
+{
+
+const int kDefaultBaudRate = 115200;
+const int kWriteTimeoutMs = 100;
+const size_t kMaxPortName = 64;
+
+// Thin wrapper around a non-blocking raw-mode tty. Methods return 0 or an
+// EAI error code; Read returns the byte count or -error.
+class SerialPort
+{
+public:
+	SerialPort();
+	~SerialPort();
+
+	SerialPort(const SerialPort&) = delete;
+	SerialPort& operator=(const SerialPort&) = delete;
+
+	int Open(const char* name, int baudRate = kDefaultBaudRate);
+	void Close();
+	bool IsOpen() const { return m_fd >= 0; }
+	int Fd() const { return m_fd; }
+	const char* Name() const { return m_name; }
+
+	// Writes every byte, waiting up to timeoutMs for the driver to drain.
+	int Write(const uint8_t* data, size_t length, int timeoutMs = kWriteTimeoutMs);
+	// Writes what the driver takes without waiting. Returns the number of
+	// bytes written, or -error.
+	long WriteSome(const uint8_t* data, size_t length);
+	long Read(uint8_t* buffer, size_t capacity);
+	// Waits until bytes are readable. Returns 1, 0 on timeout, or -error.
+	int WaitReadable(int timeoutMs);
+
+	// "ttyUSB0" and "/dev/ttyUSB0" both name the same port.
+	static bool ResolveName(const char* name, char* out, size_t capacity);
+
+private:
+	int m_fd;
+	char m_name[kMaxPortName];
+};
+
+} // namespace tdk
+
+#endif
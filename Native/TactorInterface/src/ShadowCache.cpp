@@ -0,0 +1,156 @@
+#include "ShadowCache.h"
+
+namespace tdk
+{
+
+ShadowCache::ShadowCache()
+	: m_recording(false)
+{
+	for (int tactor = 0; tactor < kMaxTactors; ++tactor)
+	{
+		for (int setting = 0; setting < kSettingCount; ++setting)
+			m_pendingUntil[tactor][setting] = 0;
+	}
+	TrackAll();
+	Invalidate();
+	ResetStats();
+}
+
+void ShadowCache::Invalidate()
+{
+	for (int tactor = 0; tactor < kMaxTactors; ++tactor)
+	{
+		for (int setting = 0; setting < kSettingCount; ++setting)
+			m_values[tactor][setting] = kUnknown;
+	}
+	++m_stats.invalidations;
+}
+
+void ShadowCache::Untrack(int tactor, uint8_t target)
+{
+	if (tactor < 1 || tactor > kMaxTactors)
+		return;
+
+	Setting setting = target == kRampTargetFreq ? kFreq : kGain;
+	m_untracked[setting] |= 1ull << (tactor - 1);
+	Forget(tactor, setting, 0);
+}
+
+void ShadowCache::TrackAll()
+{
+	m_untracked[kGain] = 0;
+	m_untracked[kFreq] = 0;
+}
+
+void ShadowCache::ResetStats()
+{
+	m_stats.suppressed = 0;
+	m_stats.bytesSaved = 0;
+	m_stats.invalidations = 0;
+}
+
+int64_t ShadowCache::SettleNs(const Action& action, uint8_t timeFactor)
+{
+	int64_t units = action.delay;
+	switch (action.command)
+	{
+	case TDK_COMMAND_GAIN:
+	case TDK_COMMAND_FREQ:
+	case TDK_COMMAND_SETSIGSOURCE:
+	case TDK_COMMAND_SET_TACTOR_TYPE:
+		break;
+	case TDK_COMMAND_RAMP:
+		units += action.args[6];
+		break;
+	default:
+		return 0;
+	}
+	return units * timeFactor * 1000000;
+}
+
+void ShadowCache::Forget(int tactor, Setting setting, int64_t untilNs)
+{
+	if (tactor < 1 || tactor > kMaxTactors)
+		return;
+
+	m_values[tactor - 1][setting] = kUnknown;
+	int64_t& pending = m_pendingUntil[tactor - 1][setting];
+	if (untilNs > pending)
+		pending = untilNs;
+}
+
+bool ShadowCache::Apply(int tactor, Setting setting, int32_t value, int64_t settleNs, int64_t now)
+{
+	if (tactor < 1 || tactor > kMaxTactors)
+		return false;
+
+	int32_t& known = m_values[tactor - 1][setting];
+	bool untracked = setting <= kFreq && (m_untracked[setting] >> (tactor - 1)) & 1;
+	if (settleNs != 0)
+	{
+		Forget(tactor, setting, now + settleNs + kShadowTransitNs);
+		return false;
+	}
+	// Whatever is still pending would land on top of this value.
+	if (untracked || now < m_pendingUntil[tactor - 1][setting])
+	{
+		known = kUnknown;
+		return false;
+	}
+	if (known == value)
+		return true;
+
+	known = value;
+	return false;
+}
+
+bool ShadowCache::Filter(const Action& action, uint8_t timeFactor, int64_t now)
+{
+	const uint8_t* args = action.args;
+	int64_t settleNs = SettleNs(action, timeFactor);
+
+	if (m_recording)
+	{
+		if (action.command == TDK_COMMAND_TACTION_END)
+			m_recording = false;
+		return false;
+	}
+
+	bool redundant = false;
+	switch (action.command)
+	{
+	case TDK_COMMAND_GAIN:
+		redundant = Apply(args[0], kGain, args[1], settleNs, now);
+		break;
+	case TDK_COMMAND_FREQ:
+		redundant = Apply(args[0], kFreq, (args[1] << 8) | args[2], settleNs, now);
+		break;
+	case TDK_COMMAND_SETSIGSOURCE:
+		redundant = Apply(args[0], kSigSource, args[1], settleNs, now);
+		break;
+	case TDK_COMMAND_SET_TACTOR_TYPE:
+		redundant = Apply(args[0], kTactorType, args[1], settleNs, now);
+		break;
+	case TDK_COMMAND_RAMP:
+		Forget(args[0], args[1] == kRampTargetFreq ? kFreq : kGain, now + settleNs + kShadowTransitNs);
+		break;
+	case TDK_COMMAND_TACTION_START:
+		m_recording = true;
+		break;
+	case TDK_COMMAND_TACTION_PLAY:
+	case TDK_COMMAND_STOP:
+		Invalidate();
+		break;
+	default:
+		break;
+	}
+
+	if (redundant)
+	{
+		++m_stats.suppressed;
+		m_stats.bytesSaved += action.EncodedSize();
+	}
+	return redundant;
+}
+
+} // namespace tdk
@@ -0,0 +1,87 @@
+/************************************************************************
+*                                                                       *
+*   ShadowCache.h -- last known per-tactor settings of a controller     *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_SHADOWCACHE_H_
+#define TDK_SHADOWCACHE_H_
+
+#include <cstdint>
+
+#include "Protocol.h"
+
+namespace tdk
+{
+
+// Allowed for a command to reach the controller after it is submitted;
+// the I/O thread invalidates the cache itself if one goes out later.
+const int64_t kShadowTransitNs = 20000000;
+
+struct ShadowStats
+{
+	uint64_t suppressed;
+	uint64_t bytesSaved;
+	uint64_t invalidations;
+};
+
+// Mirrors the gain, frequency, signal source and tactor type each tactor
+// will have once everything sent so far has run, so a command that would
+// not change any of them can be dropped before it reaches the link.
+//
+// Only undelayed commands are cached: a delayed command may run after ones
+// sent later, so it is always sent and leaves its setting unknown until it
+// should have run, as does a ramp until it ends. Stored TAction playback
+// forgets everything, and commands recorded between TACTION_START and
+// TACTION_END pass untouched.
+class ShadowCache
+{
+public:
+	ShadowCache();
+
+	// Returns true if action is redundant and should not be sent, otherwise
+	// records its effect. now is when it is submitted.
+	bool Filter(const Action& action, uint8_t timeFactor, int64_t now);
+	// How long after it reaches the controller action may still change a
+	// setting this cache tracks: its delay, plus a ramp's duration. 0 for
+	// anything that takes effect at once or touches no such setting.
+	static int64_t SettleNs(const Action& action, uint8_t timeFactor);
+	// Forget everything, e.g. after a NAK, Stop or reconnect.
+	void Invalidate();
+	// The tactor's gain or frequency (kRampTarget*) is streamed, so it
+	// changes where the cache cannot follow; it stays unknown until
+	// TrackAll, e.g. on reconnect.
+	void Untrack(int tactor, uint8_t target);
+	void TrackAll();
+	void ResetStats();
+
+	const ShadowStats& Stats() const { return m_stats; }
+
+private:
+	enum Setting
+	{
+		kGain,
+		kFreq,
+		kSigSource,
+		kTactorType,
+		kSettingCount
+	};
+
+	static const int32_t kUnknown = -1;
+
+	bool Apply(int tactor, Setting setting, int32_t value, int64_t settleNs, int64_t now);
+	void Forget(int tactor, Setting setting, int64_t untilNs);
+
+	int32_t m_values[kMaxTactors][kSettingCount];
+	// A delayed command or ramp may still change the setting until then, so
+	// undelayed values are not cached before it passes.
+	int64_t m_pendingUntil[kMaxTactors][kSettingCount];
+	// Bit tactor - 1 of the kGain and kFreq masks.
+	uint64_t m_untracked[2];
+	bool m_recording;
+	ShadowStats m_stats;
+};
+
+} // namespace tdk
+
+#endif
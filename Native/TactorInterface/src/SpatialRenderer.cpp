@@ -0,0 +1,135 @@
+#include "SpatialRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace tdk
+{
+
+namespace
+{
+
+static_assert(kMaxTactors % 4 == 0, "tactors are weighed 4 at a time");
+
+// Fills weights with 1 - distance / radius for every placed tactor within
+// the radius of (cx, cy, cz), 0 for the rest, and returns their sum.
+float Weigh(const float* x, const float* y, const float* z, const float* placed, float cx, float cy, float cz,
+	float inverseRadius, float* weights)
+{
+#if defined(__SSE2__)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 px = _mm_set1_ps(cx);
+	const __m128 py = _mm_set1_ps(cy);
+	const __m128 pz = _mm_set1_ps(cz);
+	const __m128 scale = _mm_set1_ps(inverseRadius);
+	__m128 sum = zero;
+	for (int i = 0; i < kMaxTactors; i += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_load_ps(x + i), px);
+		__m128 dy = _mm_sub_ps(_mm_load_ps(y + i), py);
+		__m128 dz = _mm_sub_ps(_mm_load_ps(z + i), pz);
+		__m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		__m128 falloff = _mm_sub_ps(one, _mm_mul_ps(_mm_sqrt_ps(squared), scale));
+		// max returns its second operand for NaN, so bad input weighs 0.
+		__m128 weight = _mm_mul_ps(_mm_max_ps(falloff, zero), _mm_load_ps(placed + i));
+		_mm_store_ps(weights + i, weight);
+		sum = _mm_add_ps(sum, weight);
+	}
+	alignas(16) float lanes[4];
+	_mm_store_ps(lanes, sum);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#else
+	float sum = 0.0f;
+	for (int i = 0; i < kMaxTactors; ++i)
+	{
+		float dx = x[i] - cx;
+		float dy = y[i] - cy;
+		float dz = z[i] - cz;
+		float falloff = 1.0f - std::sqrt(dx * dx + dy * dy + dz * dz) * inverseRadius;
+		weights[i] = std::max(0.0f, falloff) * placed[i];
+		sum += weights[i];
+	}
+	return sum;
+#endif
+}
+
+// energy[i] += share * weights[i]
+void Accumulate(const float* weights, float share, float* energy)
+{
+#if defined(__SSE2__)
+	const __m128 scale = _mm_set1_ps(share);
+	for (int i = 0; i < kMaxTactors; i += 4)
+		_mm_store_ps(energy + i, _mm_add_ps(_mm_load_ps(energy + i), _mm_mul_ps(_mm_load_ps(weights + i), scale)));
+#else
+	for (int i = 0; i < kMaxTactors; ++i)
+		energy[i] += share * weights[i];
+#endif
+}
+
+} // namespace
+
+SpatialRenderer::SpatialRenderer()
+{
+	Reset();
+	memset(m_weights, 0, sizeof(m_weights));
+	memset(m_energy, 0, sizeof(m_energy));
+}
+
+void SpatialRenderer::Reset()
+{
+	Clear();
+	m_radius = kDefaultContactRadius;
+}
+
+void SpatialRenderer::Clear()
+{
+	memset(m_x, 0, sizeof(m_x));
+	memset(m_y, 0, sizeof(m_y));
+	memset(m_z, 0, sizeof(m_z));
+	memset(m_placed, 0, sizeof(m_placed));
+}
+
+void SpatialRenderer::Place(int tactor, float x, float y, float z)
+{
+	if (tactor < 1 || tactor > kMaxTactors)
+		return;
+
+	m_x[tactor - 1] = x;
+	m_y[tactor - 1] = y;
+	m_z[tactor - 1] = z;
+	m_placed[tactor - 1] = 1.0f;
+}
+
+int SpatialRenderer::Render(const Contact* contacts, size_t count, uint8_t* intensities)
+{
+	memset(m_energy, 0, sizeof(m_energy));
+	float inverseRadius = 1.0f / m_radius;
+	int felt = 0;
+	for (size_t c = 0; c < count; ++c)
+	{
+		const Contact& contact = contacts[c];
+		// Also false for NaN.
+		if (!(contact.intensity > 0.0f))
+			continue;
+
+		float total = Weigh(m_x, m_y, m_z, m_placed, contact.x, contact.y, contact.z, inverseRadius, m_weights);
+		if (!(total > 0.0f))
+			continue;
+
+		float intensity = std::min(contact.intensity, 255.0f);
+		Accumulate(m_weights, intensity * intensity / total, m_energy);
+		++felt;
+	}
+
+	for (int i = 0; i < kMaxTactors; ++i)
+		intensities[i] = static_cast<uint8_t>(std::lround(std::min(std::sqrt(m_energy[i]), 255.0f)));
+	return felt;
+}
+
+} // namespace tdk
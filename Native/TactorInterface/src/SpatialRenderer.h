@@ -0,0 +1,74 @@
+/************************************************************************
+*                                                                       *
+*   SpatialRenderer.h -- contact points rendered as tactor intensities  *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_SPATIALRENDERER_H_
+#define TDK_SPATIALRENDERER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <EAI_Defines.h>
+
+#include "Protocol.h"
+
+namespace tdk
+{
+
+const float kDefaultContactRadius = 0.1f;
+
+// A point touched on the body, in the units of the tactor positions, and
+// the gain (0-255) it would have on a tactor right under it. Matches
+// TdkContact.
+struct Contact
+{
+	float x;
+	float y;
+	float z;
+	float intensity;
+};
+
+// Where each tactor sits on the body, and the kernel that turns a batch of
+// contacts into one intensity per tactor. A contact between tactors is felt
+// there (a phantom sensation) when the tactors around it share its energy:
+// each tactor within the radius is weighted by 1 - distance / radius, and
+// gets the contact's intensity squared times its share of the weights.
+// Contacts add up as energy, so the intensity of a tactor is the square
+// root of what it was given. A contact with no tactor within the radius is
+// not felt.
+//
+// Positions are kept as separate x, y and z arrays, so each contact is
+// weighed against 4 tactors at a time with SSE where the compiler targets
+// it. Owned by the API thread.
+class SpatialRenderer
+{
+public:
+	SpatialRenderer();
+
+	// No tactor is placed and the radius is the default.
+	void Reset();
+	// Unplaces every tactor but keeps the radius.
+	void Clear();
+	void Place(int tactor, float x, float y, float z);
+	void SetRadius(float radius) { m_radius = radius; }
+
+	// Fills intensities, one per tactor (kMaxTactors of them), 0 for off.
+	// Returns how many contacts reached a tactor.
+	int Render(const Contact* contacts, size_t count, uint8_t* intensities);
+
+private:
+	alignas(16) float m_x[kMaxTactors];
+	alignas(16) float m_y[kMaxTactors];
+	alignas(16) float m_z[kMaxTactors];
+	// 1 for placed tactors, 0 for the rest, so they weigh nothing.
+	alignas(16) float m_placed[kMaxTactors];
+	alignas(16) float m_weights[kMaxTactors];
+	alignas(16) float m_energy[kMaxTactors];
+	float m_radius;
+};
+
+} // namespace tdk
+
+#endif
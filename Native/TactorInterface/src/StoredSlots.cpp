@@ -0,0 +1,189 @@
+#include "StoredSlots.h"
+
+#include <cstring>
+
+namespace tdk
+{
+
+StoredSlotManager::StoredSlotManager()
+	: m_slotCount(TDK_MAX_STORED_TACTIONS)
+	, m_tick(0)
+{
+	Reset();
+}
+
+void StoredSlotManager::Reset()
+{
+	for (Slot& slot : m_slots)
+	{
+		slot.state = kEmpty;
+		slot.uses = 0;
+		slot.lastUse = 0;
+		slot.count = 0;
+	}
+	for (Candidate& candidate : m_candidates)
+	{
+		candidate.plays = 0;
+		candidate.valid = false;
+	}
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void StoredSlotManager::Reconnected()
+{
+	for (Slot& slot : m_slots)
+	{
+		if (slot.state == kStored || slot.state == kUploading)
+			slot.state = kStale;
+		else if (slot.state == kClaimed)
+			slot.state = kEmpty;
+	}
+}
+
+void StoredSlotManager::Claim(int slot)
+{
+	if (slot >= 1 && slot <= TDK_MAX_STORED_TACTIONS)
+		m_slots[slot - 1].state = kClaimed;
+}
+
+bool StoredSlotManager::Usable(int index) const
+{
+	return index >= TDK_MAX_STORED_TACTIONS - m_slotCount && m_slots[index].state != kClaimed;
+}
+
+int StoredSlotManager::Find(const CommandKey& key)
+{
+	for (int i = 0; i < TDK_MAX_STORED_TACTIONS; ++i)
+	{
+		Slot& slot = m_slots[i];
+		if (slot.state == kStored && slot.key == key && Usable(i))
+		{
+			++slot.uses;
+			slot.lastUse = ++m_tick;
+			++m_stats.storedPlays;
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+int StoredSlotManager::ChooseVictim(uint32_t plays)
+{
+	int victim = -1;
+	for (int i = 0; i < TDK_MAX_STORED_TACTIONS; ++i)
+	{
+		if (!Usable(i))
+			continue;
+
+		const Slot& slot = m_slots[i];
+		if (slot.state == kEmpty)
+			return i;
+		if (slot.state == kUploading)
+			continue;
+		if (victim < 0 || slot.uses < m_slots[victim].uses
+			|| (slot.uses == m_slots[victim].uses && slot.lastUse < m_slots[victim].lastUse))
+			victim = i;
+	}
+
+	// Only displace a sequence that is used less than the newcomer.
+	if (victim >= 0 && m_slots[victim].state == kStored && m_slots[victim].uses >= plays)
+		return -1;
+	return victim;
+}
+
+int StoredSlotManager::Observe(const CommandKey& key, const Command* commands, size_t count)
+{
+	if (m_slotCount <= 0 || count > TDK_MAX_STORED_TACTION_LENGTH)
+		return 0;
+
+	for (const Slot& slot : m_slots)
+	{
+		if ((slot.state == kUploading || slot.state == kStored || slot.state == kStale) && slot.key == key)
+			return 0;
+	}
+
+	Candidate* candidate = nullptr;
+	Candidate* weakest = &m_candidates[0];
+	for (Candidate& c : m_candidates)
+	{
+		if (c.valid && c.key == key)
+		{
+			candidate = &c;
+			break;
+		}
+		if (!c.valid || (weakest->valid && c.plays < weakest->plays))
+			weakest = &c;
+	}
+	if (candidate == nullptr)
+	{
+		candidate = weakest;
+		candidate->key = key;
+		candidate->plays = candidate->valid ? candidate->plays : 0;
+		candidate->valid = true;
+	}
+	if (++candidate->plays < kStoredSlotThreshold)
+		return 0;
+
+	int index = ChooseVictim(candidate->plays);
+	if (index < 0)
+		return 0;
+
+	Slot& slot = m_slots[index];
+	if (slot.state != kEmpty)
+		++m_stats.evictions;
+	for (Slot& other : m_slots)
+		other.uses /= 2;
+
+	slot.state = kUploading;
+	slot.key = key;
+	slot.uses = candidate->plays;
+	slot.lastUse = ++m_tick;
+	slot.count = static_cast<uint32_t>(count);
+	memcpy(slot.commands, commands, count * sizeof(Command));
+	candidate->valid = false;
+	candidate->plays = 0;
+	++m_stats.uploads;
+	return index + 1;
+}
+
+int StoredSlotManager::TakeReupload()
+{
+	for (int i = 0; i < TDK_MAX_STORED_TACTIONS; ++i)
+	{
+		if (m_slots[i].state == kStale && Usable(i))
+		{
+			m_slots[i].state = kUploading;
+			++m_stats.uploads;
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+const Command* StoredSlotManager::Commands(int slot, size_t& count) const
+{
+	const Slot& s = m_slots[slot - 1];
+	count = s.count;
+	return s.commands;
+}
+
+void StoredSlotManager::UploadFinished(int slot, bool ok)
+{
+	Slot& s = m_slots[slot - 1];
+	if (s.state != kUploading)
+		return;
+
+	s.state = ok ? kStored : kEmpty;
+	if (!ok)
+		++m_stats.uploadFailures;
+}
+
+const StoredSlotStats& StoredSlotManager::Stats() const
+{
+	m_stats.slotsInUse = 0;
+	for (const Slot& slot : m_slots)
+		m_stats.slotsInUse += slot.state == kStored ? 1 : 0;
+	return m_stats;
+}
+
+} // namespace tdk
@@ -0,0 +1,112 @@
+/************************************************************************
+*                                                                       *
+*   StoredSlots.h -- which TActions live in the controller's slots      *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_STOREDSLOTS_H_
+#define TDK_STOREDSLOTS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <EAI_Defines.h>
+
+#include "CommandCache.h"
+#include "Protocol.h"
+
+namespace tdk
+{
+
+const int kStoredSlotCandidates = 32;
+// Plays seen through the normal path before a sequence is worth a slot.
+const uint32_t kStoredSlotThreshold = 3;
+
+struct StoredSlotStats
+{
+	uint64_t storedPlays;
+	uint64_t uploads;
+	uint64_t uploadFailures;
+	uint64_t evictions;
+	int slotsInUse;
+};
+
+// Bookkeeping for the automatic use of the controller's stored TAction
+// slots; Device does the sending. Play counts are tracked for a bounded
+// set of candidates (space-saving: a new key replaces the least played
+// candidate and inherits its count), and a candidate that reaches the
+// threshold takes a free slot or evicts the stored sequence with the
+// fewest uses, the least recently used among equals. Uses are halved
+// whenever a slot changes hands so past favourites age out.
+class StoredSlotManager
+{
+public:
+	StoredSlotManager();
+
+	// Forget everything, including slots claimed by the application.
+	void Reset();
+	// The controller lost its slots: keep what was stored so it can be
+	// uploaded again, but play none of it until then.
+	void Reconnected();
+
+	// Slots from TDK_MAX_STORED_TACTIONS downwards that may be used.
+	void SetSlotCount(int count) { m_slotCount = count; }
+	// The application recorded into slot itself; leave it alone.
+	void Claim(int slot);
+
+	// Slot number holding key, confirmed on the controller, or 0.
+	int Find(const CommandKey& key);
+
+	// Counts a play that went out in full. Returns the slot key should be
+	// uploaded into, or 0; the sequence is copied so it can be uploaded
+	// again after a reconnect.
+	int Observe(const CommandKey& key, const Command* commands, size_t count);
+	// A slot left over from before a reconnect, now marked as uploading,
+	// or 0 if none needs it.
+	int TakeReupload();
+
+	const Command* Commands(int slot, size_t& count) const;
+	void UploadFinished(int slot, bool ok);
+
+	const StoredSlotStats& Stats() const;
+
+private:
+	enum SlotState
+	{
+		kEmpty,
+		kUploading,
+		kStored,
+		kStale,
+		kClaimed
+	};
+
+	struct Slot
+	{
+		SlotState state;
+		CommandKey key;
+		uint32_t uses;
+		uint64_t lastUse;
+		uint32_t count;
+		Command commands[TDK_MAX_STORED_TACTION_LENGTH];
+	};
+
+	struct Candidate
+	{
+		CommandKey key;
+		uint32_t plays;
+		bool valid;
+	};
+
+	bool Usable(int index) const;
+	int ChooseVictim(uint32_t plays);
+
+	Slot m_slots[TDK_MAX_STORED_TACTIONS];
+	Candidate m_candidates[kStoredSlotCandidates];
+	int m_slotCount;
+	uint64_t m_tick;
+	mutable StoredSlotStats m_stats;
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,115 @@
+#include "StreamChannels.h"
+
+namespace tdk
+{
+
+namespace
+{
+
+uint64_t Bit(int channel)
+{
+	return 1ull << (channel % kMaxTactors);
+}
+
+void Add(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+} // namespace
+
+StreamChannels::StreamChannels()
+{
+	Reset();
+}
+
+void StreamChannels::Reset()
+{
+	for (std::atomic<uint16_t>& value : m_values)
+		value.store(0, std::memory_order_relaxed);
+	for (std::atomic<uint64_t>& dirty : m_dirty)
+		dirty.store(0, std::memory_order_relaxed);
+	m_updates.store(0, std::memory_order_relaxed);
+	m_superseded.store(0, std::memory_order_relaxed);
+	m_sent.store(0, std::memory_order_relaxed);
+	m_resent.store(0, std::memory_order_relaxed);
+	m_flushes.store(0, std::memory_order_relaxed);
+	m_next = 0;
+}
+
+bool StreamChannels::Set(uint8_t target, int tactor, int value)
+{
+	int channel = target * kMaxTactors + tactor - 1;
+	m_values[channel].store(static_cast<uint16_t>(value), std::memory_order_relaxed);
+	// Publishes the value to the Take that clears the bit.
+	uint64_t before = m_dirty[target].fetch_or(Bit(channel), std::memory_order_release);
+
+	m_updates.fetch_add(1, std::memory_order_relaxed);
+	if (before & Bit(channel))
+		m_superseded.fetch_add(1, std::memory_order_relaxed);
+	return before == 0 && m_dirty[1 - target].load(std::memory_order_relaxed) == 0;
+}
+
+bool StreamChannels::Dirty() const
+{
+	return (m_dirty[0].load(std::memory_order_relaxed) | m_dirty[1].load(std::memory_order_relaxed)) != 0;
+}
+
+size_t StreamChannels::Take(Command* out, int* channel, size_t capacity, uint8_t timeFactor)
+{
+	uint64_t waiting[kStreamTargets];
+	for (int target = 0; target < kStreamTargets; ++target)
+		waiting[target] = m_dirty[target].load(std::memory_order_relaxed);
+
+	size_t count = 0;
+	int start = m_next;
+	for (int i = 0; i < kStreamChannels && count < capacity; ++i)
+	{
+		int c = (start + i) % kStreamChannels;
+		int target = c / kMaxTactors;
+		if (!(waiting[target] & Bit(c)))
+			continue;
+
+		// Clearing first means a value set from here on marks the channel
+		// again and goes out with the next flush.
+		m_dirty[target].fetch_and(~Bit(c), std::memory_order_acquire);
+		int value = m_values[c].load(std::memory_order_relaxed);
+		int tactor = c % kMaxTactors + 1;
+		Action& action = out[count].action;
+		// Set only stores values the builders accept.
+		if (target == kRampTargetGain)
+			MakeGain(action, tactor, value, 0, timeFactor);
+		else
+			MakeFreq(action, tactor, value, 0, timeFactor);
+		out[count].timeFactor = timeFactor;
+		channel[count] = c;
+		++count;
+		m_next = c + 1;
+	}
+
+	if (count != 0)
+	{
+		Add(m_sent, count);
+		Add(m_flushes, 1);
+	}
+	return count;
+}
+
+void StreamChannels::Retry(int channel)
+{
+	int target = channel / kMaxTactors;
+	uint64_t before = m_dirty[target].fetch_or(Bit(channel), std::memory_order_relaxed);
+	if (!(before & Bit(channel)))
+		Add(m_resent, 1);
+}
+
+void StreamChannels::Read(StreamStats& out) const
+{
+	out.updates = m_updates.load(std::memory_order_relaxed);
+	out.superseded = m_superseded.load(std::memory_order_relaxed);
+	out.sent = m_sent.load(std::memory_order_relaxed);
+	out.resent = m_resent.load(std::memory_order_relaxed);
+	out.flushes = m_flushes.load(std::memory_order_relaxed);
+}
+
+} // namespace tdk
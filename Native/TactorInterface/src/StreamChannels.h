@@ -0,0 +1,77 @@
+/************************************************************************
+*                                                                       *
+*   StreamChannels.h -- latest-value-wins gain and frequency targets    *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_STREAMCHANNELS_H_
+#define TDK_STREAMCHANNELS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <EAI_Defines.h>
+
+#include "Protocol.h"
+
+namespace tdk
+{
+
+// One channel per tactor for each kRampTarget* parameter.
+const int kStreamTargets = 2;
+const int kStreamChannels = kStreamTargets * kMaxTactors;
+const int kDefaultStreamRateHz = 60;
+
+struct StreamStats
+{
+	uint64_t updates;		// values set
+	uint64_t superseded;	// values replaced before they were sent
+	uint64_t sent;			// values written to the link
+	uint64_t resent;		// values sent again after a NAK or timeout
+	uint64_t flushes;		// frames of streamed values
+};
+
+// The newest target of every streamed channel of a device, and which
+// channels changed since they were last taken. Setting a value replaces
+// the one waiting, so however often it is set, a channel costs at most one
+// action per flush. Any API thread may Set; only the I/O thread takes.
+class StreamChannels
+{
+public:
+	StreamChannels();
+
+	void Reset();
+
+	// Stores value as the channel's target. Returns true when no channel
+	// was waiting before, so the caller wakes the I/O thread.
+	bool Set(uint8_t target, int tactor, int value);
+	bool Dirty() const;
+
+	// I/O thread. Writes undelayed GAIN or FREQ commands for up to capacity
+	// waiting channels into out and marks them taken; channel[i] is the
+	// channel of out[i]. Channels are taken round robin, so a flush capped
+	// below the number waiting does not starve the higher tactors. Returns
+	// how many.
+	size_t Take(Command* out, int* channel, size_t capacity, uint8_t timeFactor);
+	// The value taken for channel did not reach the controller: send the
+	// current target again unless a newer one is already waiting.
+	void Retry(int channel);
+
+	void Read(StreamStats& out) const;
+
+private:
+	std::atomic<uint16_t> m_values[kStreamChannels];
+	std::atomic<uint64_t> m_dirty[kStreamTargets];
+	std::atomic<uint64_t> m_updates;
+	std::atomic<uint64_t> m_superseded;
+	// Written by the I/O thread.
+	std::atomic<uint64_t> m_sent;
+	std::atomic<uint64_t> m_resent;
+	std::atomic<uint64_t> m_flushes;
+	int m_next;
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,171 @@
+#include "TActionBundle.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include <EAI_Defines.h>
+
+namespace tdk
+{
+
+namespace
+{
+
+bool TableFits(uint64_t offset, uint64_t count, uint64_t recordSize, uint64_t fileSize)
+{
+	if (offset % 8 != 0 || offset > fileSize)
+		return false;
+	return count <= (fileSize - offset) / recordSize;
+}
+
+} // namespace
+
+TActionBundle::TActionBundle()
+	: m_base(nullptr)
+	, m_size(0)
+	, m_header(nullptr)
+	, m_entries(nullptr)
+	, m_segments(nullptr)
+	, m_names(nullptr)
+{
+}
+
+TActionBundle::~TActionBundle()
+{
+	Unmap();
+}
+
+bool TActionBundle::IsBundle(const char* path)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	char magic[sizeof(kBundleMagic)];
+	bool match = read(fd, magic, sizeof(magic)) == static_cast<ssize_t>(sizeof(magic))
+		&& memcmp(magic, kBundleMagic, sizeof(magic)) == 0;
+	close(fd);
+	return match;
+}
+
+int TActionBundle::Map(const char* path)
+{
+	Unmap();
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return ERROR_TM_DATABASE_FAILED_TO_OPEN;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(BundleHeader)))
+	{
+		close(fd);
+		return ERROR_BAD_DATA;
+	}
+
+	size_t size = static_cast<size_t>(info.st_size);
+	void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return ERROR_TM_DATABASE_FAILED_TO_OPEN;
+	return Adopt(base, size);
+}
+
+int TActionBundle::Load(const uint8_t* data, size_t size)
+{
+	Unmap();
+	if (size < sizeof(BundleHeader))
+		return ERROR_BAD_DATA;
+
+	void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		return ERROR_TM_DATABASE_FAILED_TO_OPEN;
+	memcpy(base, data, size);
+	mprotect(base, size, PROT_READ);
+	return Adopt(base, size);
+}
+
+int TActionBundle::Adopt(void* base, size_t size)
+{
+	const BundleHeader* header = static_cast<const BundleHeader*>(base);
+	const uint8_t* bytes = static_cast<const uint8_t*>(base);
+	bool valid = memcmp(header->magic, kBundleMagic, sizeof(kBundleMagic)) == 0
+		&& header->version == kBundleVersion
+		&& header->byteOrder == kBundleByteOrder
+		&& header->fileSize == size
+		&& TableFits(header->entryOffset, header->actionCount, sizeof(BundleEntry), size)
+		&& TableFits(header->segmentOffset, header->segmentCount, sizeof(BundleSegment), size)
+		&& header->nameOffset <= size
+		&& header->nameSize > 0
+		&& header->nameSize <= size - header->nameOffset
+		&& bytes[header->nameOffset + header->nameSize - 1] == '\0';
+	if (!valid)
+	{
+		munmap(base, size);
+		return ERROR_BAD_DATA;
+	}
+
+	m_base = bytes;
+	m_size = size;
+	m_header = header;
+	m_entries = reinterpret_cast<const BundleEntry*>(bytes + header->entryOffset);
+	m_segments = reinterpret_cast<const BundleSegment*>(bytes + header->segmentOffset);
+	m_names = reinterpret_cast<const char*>(bytes + header->nameOffset);
+	return 0;
+}
+
+void TActionBundle::Unmap()
+{
+	if (m_base == nullptr)
+		return;
+
+	munmap(const_cast<uint8_t*>(m_base), m_size);
+	m_base = nullptr;
+	m_size = 0;
+	m_header = nullptr;
+	m_entries = nullptr;
+	m_segments = nullptr;
+	m_names = nullptr;
+}
+
+const BundleEntry* TActionBundle::Find(int tacId) const
+{
+	if (m_header == nullptr)
+		return nullptr;
+
+	size_t low = 0;
+	size_t high = m_header->actionCount;
+	while (low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+		if (m_entries[mid].tacId < tacId)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low == m_header->actionCount || m_entries[low].tacId != tacId)
+		return nullptr;
+
+	const BundleEntry& entry = m_entries[low];
+	if (entry.name >= m_header->nameSize
+		|| entry.firstSegment > m_header->segmentCount
+		|| entry.segmentCount > m_header->segmentCount - entry.firstSegment)
+		return nullptr;
+	return &entry;
+}
+
+const char* TActionBundle::Name(const BundleEntry& entry) const
+{
+	return m_names + entry.name;
+}
+
+const BundleSegment* TActionBundle::Segments(const BundleEntry& entry) const
+{
+	return m_segments + entry.firstSegment;
+}
+
+} // namespace tdk
@@ -0,0 +1,116 @@
+/************************************************************************
+*                                                                       *
+*   TActionBundle.h -- compiled, memory-mappable TAction library        *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_TACTIONBUNDLE_H_
+#define TDK_TACTIONBUNDLE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tdk
+{
+
+// File layout, written by tactionc and mapped as-is by TActionBundle. All
+// integers are in host byte order (checked through byteOrder) and every
+// table starts on an 8 byte boundary:
+//
+//   BundleHeader
+//   BundleEntry[actionCount]      sorted by tacId
+//   BundleSegment[segmentCount]   grouped by TAction, sorted by start
+//   names                         NUL-terminated, identical names shared
+const char kBundleMagic[8] = { 'T', 'D', 'K', 'T', 'A', 'C', 'B', '\0' };
+const uint32_t kBundleVersion = 1;
+const uint32_t kBundleByteOrder = 0x01020304;
+
+struct BundleHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t actionCount;
+	uint32_t segmentCount;
+	uint64_t entryOffset;
+	uint64_t segmentOffset;
+	uint64_t nameOffset;
+	uint64_t nameSize;
+	uint64_t fileSize;
+};
+
+struct BundleEntry
+{
+	int32_t tacId;
+	uint32_t name;			// offset into the name table
+	uint32_t firstSegment;
+	uint32_t segmentCount;
+	uint32_t durationMs;	// end of the last segment
+	uint32_t tactorSpan;	// highest tactor offset used, 1-based
+};
+
+// One tactor's activity within a TAction. tactor is relative to the tactor
+// the TAction is played on (1 = that tactor). Gain and both frequencies
+// move linearly from start to end over durationMs.
+struct BundleSegment
+{
+	uint32_t startMs;
+	uint32_t durationMs;
+	uint8_t tactor;
+	uint8_t sigSource;
+	uint8_t gainStart;
+	uint8_t gainEnd;
+	uint16_t freq1Start;
+	uint16_t freq1End;
+	uint16_t freq2Start;
+	uint16_t freq2End;
+};
+
+static_assert(sizeof(BundleHeader) == 64, "bundle header layout");
+static_assert(sizeof(BundleEntry) == 24, "bundle entry layout");
+static_assert(sizeof(BundleSegment) == 20, "bundle segment layout");
+
+// A read-only view of a mapped bundle. Map only checks the header, so its
+// cost does not depend on the size of the library; each lookup bounds
+// checks the records it touches.
+class TActionBundle
+{
+public:
+	TActionBundle();
+	~TActionBundle();
+
+	TActionBundle(const TActionBundle&) = delete;
+	TActionBundle& operator=(const TActionBundle&) = delete;
+
+	// Returns 0 or an EAI error code.
+	int Map(const char* path);
+	// The same for a bundle built in memory, which is copied.
+	int Load(const uint8_t* data, size_t size);
+	void Unmap();
+	bool IsMapped() const { return m_base != nullptr; }
+
+	// True if the file at path starts with the bundle magic.
+	static bool IsBundle(const char* path);
+
+	int Count() const { return m_header != nullptr ? static_cast<int>(m_header->actionCount) : 0; }
+	// Binary search over the tacId index; nullptr if absent or malformed.
+	const BundleEntry* Find(int tacId) const;
+	const char* Name(const BundleEntry& entry) const;
+	const BundleSegment* Segments(const BundleEntry& entry) const;
+
+private:
+	// Takes over the mapping at base once its header checks out; unmaps it
+	// otherwise.
+	int Adopt(void* base, size_t size);
+
+	const uint8_t* m_base;
+	size_t m_size;
+	const BundleHeader* m_header;
+	const BundleEntry* m_entries;
+	const BundleSegment* m_segments;
+	const char* m_names;
+};
+
+} // namespace tdk
+
+#endif
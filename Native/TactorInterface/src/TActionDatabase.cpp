@@ -0,0 +1,215 @@
+#include "TActionDatabase.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include <sqlite3.h>
+
+#include "Protocol.h"
+#include "TActionBundle.h"
+
+namespace tdk
+{
+
+namespace
+{
+
+struct SourceAction
+{
+	int32_t tacId;
+	std::string name;
+	std::vector<BundleSegment> segments;
+};
+
+bool InRange(sqlite3_int64 value, sqlite3_int64 low, sqlite3_int64 high)
+{
+	return value >= low && value <= high;
+}
+
+bool ReadActions(sqlite3* db, std::vector<SourceAction>& actions, std::string& error)
+{
+	sqlite3_stmt* statement = nullptr;
+	if (sqlite3_prepare_v2(db, "SELECT id, name FROM TActions ORDER BY id", -1, &statement, nullptr) != SQLITE_OK)
+	{
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+
+	int rc;
+	while ((rc = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		SourceAction action;
+		action.tacId = static_cast<int32_t>(sqlite3_column_int64(statement, 0));
+		const unsigned char* name = sqlite3_column_text(statement, 1);
+		action.name = name != nullptr ? reinterpret_cast<const char*>(name) : "";
+		if (!actions.empty() && actions.back().tacId == action.tacId)
+		{
+			error = "duplicate TAction id " + std::to_string(action.tacId);
+			sqlite3_finalize(statement);
+			return false;
+		}
+		actions.push_back(action);
+	}
+	sqlite3_finalize(statement);
+	if (rc != SQLITE_DONE)
+	{
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	return true;
+}
+
+bool ReadSegments(sqlite3* db, std::vector<SourceAction>& actions, std::string& error)
+{
+	std::unordered_map<int32_t, size_t> byId;
+	for (size_t i = 0; i < actions.size(); ++i)
+		byId[actions[i].tacId] = i;
+
+	const char* query =
+		"SELECT tacId, startMs, durationMs, tactor, sigSource, gainStart, gainEnd,"
+		" freq1Start, freq1End, freq2Start, freq2End"
+		" FROM TActionSegments ORDER BY tacId, startMs, tactor";
+	sqlite3_stmt* statement = nullptr;
+	if (sqlite3_prepare_v2(db, query, -1, &statement, nullptr) != SQLITE_OK)
+	{
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+
+	bool ok = true;
+	int rc;
+	while (ok && (rc = sqlite3_step(statement)) == SQLITE_ROW)
+	{
+		sqlite3_int64 column[11];
+		for (int i = 0; i < 11; ++i)
+			column[i] = sqlite3_column_int64(statement, i);
+
+		auto owner = byId.find(static_cast<int32_t>(column[0]));
+		if (owner == byId.end())
+		{
+			error = "segment of unknown TAction " + std::to_string(column[0]);
+			ok = false;
+			break;
+		}
+
+		if (!InRange(column[1], 0, UINT32_MAX) || !InRange(column[2], 0, UINT32_MAX)
+			|| !InRange(column[3], 1, kMaxTactors) || !InRange(column[4], 0, 0xFF)
+			|| !InRange(column[5], 0, 0xFF) || !InRange(column[6], 0, 0xFF)
+			|| !InRange(column[7], 0, kMaxFrequency) || !InRange(column[8], 0, kMaxFrequency)
+			|| !InRange(column[9], 0, kMaxFrequency) || !InRange(column[10], 0, kMaxFrequency))
+		{
+			error = "TAction " + std::to_string(column[0]) + " has a segment out of range";
+			ok = false;
+			break;
+		}
+
+		BundleSegment segment;
+		segment.startMs = static_cast<uint32_t>(column[1]);
+		segment.durationMs = static_cast<uint32_t>(column[2]);
+		segment.tactor = static_cast<uint8_t>(column[3]);
+		segment.sigSource = static_cast<uint8_t>(column[4]);
+		segment.gainStart = static_cast<uint8_t>(column[5]);
+		segment.gainEnd = static_cast<uint8_t>(column[6]);
+		segment.freq1Start = static_cast<uint16_t>(column[7]);
+		segment.freq1End = static_cast<uint16_t>(column[8]);
+		segment.freq2Start = static_cast<uint16_t>(column[9]);
+		segment.freq2End = static_cast<uint16_t>(column[10]);
+		actions[owner->second].segments.push_back(segment);
+	}
+	sqlite3_finalize(statement);
+	if (ok && rc != SQLITE_DONE)
+	{
+		error = sqlite3_errmsg(db);
+		return false;
+	}
+	return ok;
+}
+
+size_t Align8(size_t value)
+{
+	return (value + 7) & ~static_cast<size_t>(7);
+}
+
+std::vector<uint8_t> Build(const std::vector<SourceAction>& actions)
+{
+	std::vector<BundleEntry> entries;
+	std::vector<BundleSegment> segments;
+	std::string names;
+	std::unordered_map<std::string, uint32_t> interned;
+
+	for (const SourceAction& action : actions)
+	{
+		auto name = interned.find(action.name);
+		if (name == interned.end())
+		{
+			name = interned.emplace(action.name, static_cast<uint32_t>(names.size())).first;
+			names.append(action.name);
+			names.push_back('\0');
+		}
+
+		BundleEntry entry;
+		entry.tacId = action.tacId;
+		entry.name = name->second;
+		entry.firstSegment = static_cast<uint32_t>(segments.size());
+		entry.segmentCount = static_cast<uint32_t>(action.segments.size());
+		entry.durationMs = 0;
+		entry.tactorSpan = 0;
+		for (const BundleSegment& segment : action.segments)
+		{
+			entry.durationMs = std::max(entry.durationMs, segment.startMs + segment.durationMs);
+			entry.tactorSpan = std::max<uint32_t>(entry.tactorSpan, segment.tactor);
+			segments.push_back(segment);
+		}
+		entries.push_back(entry);
+	}
+	if (names.empty())
+		names.push_back('\0');
+
+	BundleHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kBundleMagic, sizeof(kBundleMagic));
+	header.version = kBundleVersion;
+	header.byteOrder = kBundleByteOrder;
+	header.actionCount = static_cast<uint32_t>(entries.size());
+	header.segmentCount = static_cast<uint32_t>(segments.size());
+	header.entryOffset = Align8(sizeof(header));
+	header.segmentOffset = Align8(header.entryOffset + entries.size() * sizeof(BundleEntry));
+	header.nameOffset = Align8(header.segmentOffset + segments.size() * sizeof(BundleSegment));
+	header.nameSize = names.size();
+	header.fileSize = header.nameOffset + header.nameSize;
+
+	std::vector<uint8_t> out(header.fileSize, 0);
+	memcpy(out.data(), &header, sizeof(header));
+	if (!entries.empty())
+		memcpy(out.data() + header.entryOffset, entries.data(), entries.size() * sizeof(BundleEntry));
+	if (!segments.empty())
+		memcpy(out.data() + header.segmentOffset, segments.data(), segments.size() * sizeof(BundleSegment));
+	memcpy(out.data() + header.nameOffset, names.data(), names.size());
+	return out;
+}
+
+} // namespace
+
+bool CompileTActionDatabase(const char* path, std::vector<uint8_t>& bundle, size_t& actionCount, std::string& error)
+{
+	sqlite3* db = nullptr;
+	if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+	{
+		error = std::string("cannot open ") + path + ": " + sqlite3_errmsg(db);
+		sqlite3_close(db);
+		return false;
+	}
+
+	std::vector<SourceAction> actions;
+	bool ok = ReadActions(db, actions, error) && ReadSegments(db, actions, error);
+	sqlite3_close(db);
+	if (!ok)
+		return false;
+
+	bundle = Build(actions);
+	actionCount = actions.size();
+	return true;
+}
+
+} // namespace tdk
@@ -0,0 +1,31 @@
+/************************************************************************
+*                                                                       *
+*   TActionDatabase.h -- compiles a TAction SQLite database to a bundle *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_TACTIONDATABASE_H_
+#define TDK_TACTIONDATABASE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tdk
+{
+
+// Reads the tables
+//   TActions(id INTEGER, name TEXT)
+//   TActionSegments(tacId, startMs, durationMs, tactor, sigSource,
+//                   gainStart, gainEnd, freq1Start, freq1End,
+//                   freq2Start, freq2End)
+// of the database at path into the layout described in TActionBundle.h.
+// Used by tactionc, and by LoadTActionDatabase in builds that link SQLite.
+// Returns false with a message in error when the database cannot be read
+// or holds values a bundle cannot.
+bool CompileTActionDatabase(const char* path, std::vector<uint8_t>& bundle, size_t& actionCount, std::string& error);
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,86 @@
+#include "TActionEncoder.h"
+
+#include <cmath>
+
+namespace tdk
+{
+
+namespace
+{
+
+int Scale(int value, float factor, int low, int high)
+{
+	long scaled = lroundf(static_cast<float>(value) * factor);
+	if (scaled < low)
+		return low;
+	if (scaled > high)
+		return high;
+	return static_cast<int>(scaled);
+}
+
+int ScaleTime(uint32_t ms, float factor)
+{
+	double scaled = static_cast<double>(ms) * factor;
+	return scaled > 0x7FFFFFFF ? 0x7FFFFFFF : static_cast<int>(lround(scaled));
+}
+
+} // namespace
+
+int EncodeTAction(const TActionBundle& bundle, const BundleEntry& entry, int baseTactor, const TActionScale& scale,
+	int timeFactor, Command* out, size_t capacity, size_t& count)
+{
+	count = 0;
+	if (scale.gain < 0.0f || scale.freq1 < 0.0f || scale.time < 0.0f)
+		return ERROR_BADPARAMETER;
+
+	const BundleSegment* segments = bundle.Segments(entry);
+	for (uint32_t i = 0; i < entry.segmentCount; ++i)
+	{
+		const BundleSegment& segment = segments[i];
+		int tactor = baseTactor + segment.tactor - 1;
+		int delay = ScaleTime(segment.startMs, scale.time);
+		int duration = ScaleTime(segment.durationMs, scale.time);
+		if (capacity - count < 4)
+			return ERROR_TM_MAX_ACTION_LIMIT_REACHED;
+
+		Action action;
+		if (segment.sigSource != 0)
+		{
+			if (int error = MakeSigSource(action, tactor, segment.sigSource, delay, timeFactor))
+				return error;
+			out[count++] = Command{ action, static_cast<uint8_t>(timeFactor) };
+		}
+
+		int gainStart = Scale(segment.gainStart, scale.gain, 0, MAX_ACTION_GAIN);
+		int gainEnd = Scale(segment.gainEnd, scale.gain, 0, MAX_ACTION_GAIN);
+		int error = gainStart == gainEnd
+			? MakeGain(action, tactor, gainStart, delay, timeFactor)
+			: MakeRamp(action, kRampTargetGain, tactor, gainStart, gainEnd, duration, TDK_LINEAR_RAMP, delay, timeFactor);
+		if (error != 0)
+			return error;
+		out[count++] = Command{ action, static_cast<uint8_t>(timeFactor) };
+
+		if (segment.freq1Start != 0)
+		{
+			int freqStart = Scale(segment.freq1Start, scale.freq1, MIN_ACTION_FREQUENCY, kMaxFrequency);
+			int freqEnd = Scale(segment.freq1End != 0 ? segment.freq1End : segment.freq1Start, scale.freq1,
+				MIN_ACTION_FREQUENCY, kMaxFrequency);
+			error = freqStart == freqEnd
+				? MakeFreq(action, tactor, freqStart, delay, timeFactor)
+				: MakeRamp(action, kRampTargetFreq, tactor, freqStart, freqEnd, duration, TDK_LINEAR_RAMP, delay, timeFactor);
+			if (error != 0)
+				return error;
+			out[count++] = Command{ action, static_cast<uint8_t>(timeFactor) };
+		}
+
+		if (segment.durationMs != 0)
+		{
+			if (int error = MakePulse(action, tactor, duration, delay, timeFactor))
+				return error;
+			out[count++] = Command{ action, static_cast<uint8_t>(timeFactor) };
+		}
+	}
+	return 0;
+}
+
+} // namespace tdk
@@ -0,0 +1,45 @@
+/************************************************************************
+*                                                                       *
+*   TActionEncoder.h -- TAction segments to controller commands         *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_TACTIONENCODER_H_
+#define TDK_TACTIONENCODER_H_
+
+#include <cstddef>
+
+#include "Protocol.h"
+#include "TActionBundle.h"
+
+namespace tdk
+{
+
+// Scale factors of PlayTAction. freq2 is carried for completeness: the
+// controller has a single frequency per tactor, driven by freq1.
+struct TActionScale
+{
+	float gain;
+	float freq1;
+	float freq2;
+	float time;
+};
+
+// Commands needed to play entry with its first tactor on baseTactor. Each
+// segment becomes a signal source change, a gain and a frequency change
+// (ramps when start and end differ) and a pulse, all delayed to the
+// segment start. Returns 0 or an EAI error code; ERROR_TM_MAX_ACTION_LIMIT_REACHED
+// if capacity is too small, ERROR_BADPARAMETER if a time does not fit an
+// action delay or duration at this time factor.
+int EncodeTAction(const TActionBundle& bundle, const BundleEntry& entry, int baseTactor, const TActionScale& scale,
+	int timeFactor, Command* out, size_t capacity, size_t& count);
+
+// Upper bound on the commands EncodeTAction produces for entry.
+inline size_t EncodedCommandBound(const BundleEntry& entry)
+{
+	return static_cast<size_t>(entry.segmentCount) * 4;
+}
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,317 @@
+/************************************************************************
+*                                                                       *
+*   TActionInterface.cpp -- TAction entry points of TActionInterface.h  *
+*                                                                       *
+************************************************************************/
+
+#include <TActionInterface.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <EAI_Defines.h>
+
+#include "DeviceManager.h"
+#include "ErrorState.h"
+#include "CommandCache.h"
+#include "TActionBundle.h"
+#if defined(TDK_HAVE_SQLITE)
+#include "TActionDatabase.h"
+#endif
+#include "TActionEncoder.h"
+
+using namespace tdk;
+
+namespace
+{
+
+// Guards the bundle and the cache. Taken after a device's ApiLock, never
+// before, and not held while commands are queued.
+std::mutex& TActionLock()
+{
+	static std::mutex lock;
+	return lock;
+}
+
+// The loaded library. Guarded by the TAction lock.
+TActionBundle& Bundle()
+{
+	static TActionBundle bundle;
+	return bundle;
+}
+
+// Encoded PlayTAction output. Guarded by the TAction lock, and cleared
+// whenever the bundle changes.
+CommandCache& Cache()
+{
+	static CommandCache cache;
+	return cache;
+}
+
+// Shared tail of PlayTAction and PlayTActionToSegment once the first tactor
+// is known. Caller holds the device and the TAction lock; the TAction lock
+// is released before the commands are queued.
+int Play(Device& device, std::unique_lock<std::mutex>& tactions, int tacID, int baseTactor, float gainScale,
+	float freq1Scale, float freq2Scale, float timeScale)
+{
+	const BundleEntry* entry = Bundle().Find(tacID);
+	if (entry == nullptr)
+		return ERROR_TM_TACTIONID_DOESNT_EXIST;
+	if (baseTactor < 1 || baseTactor + static_cast<int>(entry->tactorSpan) - 1 > kMaxTactors)
+		return ERROR_TM_INVALID_PARAM;
+
+	CommandCache& cache = Cache();
+	CommandKey key;
+	key.tacId = tacID;
+	key.baseTactor = baseTactor;
+	key.gain = cache.Quantize(gainScale);
+	key.freq1 = cache.Quantize(freq1Scale);
+	key.time = cache.Quantize(timeScale);
+	key.timeFactor = DeviceManager::Instance().TimeFactor();
+
+	// Per thread, so the commands can be queued once the lock is released.
+	thread_local std::vector<Command> scratch;
+	size_t count = 0;
+	if (const Command* commands = cache.Find(key, count))
+	{
+		scratch.assign(commands, commands + count);
+		tactions.unlock();
+		return device.PlaySequence(key, scratch.data(), count);
+	}
+
+	scratch.resize(EncodedCommandBound(*entry));
+
+	TActionScale scale;
+	scale.gain = cache.Dequantize(key.gain);
+	scale.freq1 = cache.Dequantize(key.freq1);
+	scale.freq2 = freq2Scale;
+	scale.time = cache.Dequantize(key.time);
+	if (int error = EncodeTAction(Bundle(), *entry, baseTactor, scale, key.timeFactor, scratch.data(), scratch.size(), count))
+		return error;
+
+	cache.Insert(key, scratch.data(), count);
+	tactions.unlock();
+	return device.PlaySequence(key, scratch.data(), count);
+}
+
+// Compiles the SQLite database at path as tactionc would. Without SQLite
+// in the build, databases must be compiled offline.
+int CompileDatabase(const char* path, std::vector<uint8_t>& out)
+{
+#if defined(TDK_HAVE_SQLITE)
+	size_t actions = 0;
+	std::string message;
+	if (!CompileTActionDatabase(path, out, actions, message))
+		return ERROR_TM_DATABASE_FAILED_TO_OPEN;
+	return 0;
+#else
+	(void)path;
+	(void)out;
+	return ERROR_TM_DATABASE_FAILED_TO_OPEN;
+#endif
+}
+
+int LoadBundle(const char* path)
+{
+	if (path == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	// A database is compiled before the lock is taken.
+	bool bundle = TActionBundle::IsBundle(path);
+	std::vector<uint8_t> compiled;
+	if (!bundle)
+	{
+		if (int error = CompileDatabase(path, compiled))
+			return Complete(error);
+	}
+
+	std::lock_guard<std::mutex> guard(TActionLock());
+	Cache().Clear();
+	int error = bundle ? Bundle().Map(path) : Bundle().Load(compiled.data(), compiled.size());
+	if (error != 0)
+		return Complete(error);
+	return Bundle().Count();
+}
+
+} // namespace
+
+EXPORTtactionInterface
+int LoadTActionDatabase(char* tactionFile)
+{
+	return LoadBundle(tactionFile);
+}
+
+EXPORTtactionInterface
+int LoadTActionBundle(const char* bundleFile)
+{
+	return LoadBundle(bundleFile);
+}
+
+EXPORTtactionInterface
+int IsDatabaseLoaded()
+{
+	std::lock_guard<std::mutex> guard(TActionLock());
+	return Bundle().IsMapped() ? 1 : 0;
+}
+
+EXPORTtactionInterface
+int GetLoadedTActionSize()
+{
+	std::lock_guard<std::mutex> guard(TActionLock());
+	if (!Bundle().IsMapped())
+		return Complete(ERROR_TM_DATABASE_NOT_INITIALIZED);
+	return Bundle().Count();
+}
+
+EXPORTtactionInterface
+int GetTActionDuration(int tacID)
+{
+	std::lock_guard<std::mutex> guard(TActionLock());
+	if (!Bundle().IsMapped())
+		return Complete(ERROR_TM_DATABASE_NOT_INITIALIZED);
+
+	const BundleEntry* entry = Bundle().Find(tacID);
+	if (entry == nullptr)
+		return Complete(ERROR_TM_TACTIONID_DOESNT_EXIST);
+	return static_cast<int>(entry->durationMs);
+}
+
+EXPORTtactionInterface
+int UnloadTActions()
+{
+	std::lock_guard<std::mutex> guard(TActionLock());
+	Bundle().Unmap();
+	Cache().Clear();
+	return 0;
+}
+
+EXPORTtactionInterface
+char* GetTActionName(int tacID)
+{
+	std::lock_guard<std::mutex> guard(TActionLock());
+	const BundleEntry* entry = Bundle().IsMapped() ? Bundle().Find(tacID) : nullptr;
+	if (entry == nullptr)
+	{
+		SetLastError(Bundle().IsMapped() ? ERROR_TM_TACTIONID_DOESNT_EXIST : ERROR_TM_DATABASE_NOT_INITIALIZED);
+		return nullptr;
+	}
+	// Points into the mapping; valid until the bundle is unloaded.
+	return const_cast<char*>(Bundle().Name(*entry));
+}
+
+EXPORTtactionInterface
+int CanTActionMap(int boardID, int tacID, int tactorID)
+{
+	DeviceGuard device(DeviceManager::Instance(), boardID);
+	if (!device)
+		return Complete(ERROR_TM_CONTROLLER_NOT_FOUND);
+	std::lock_guard<std::mutex> guard(TActionLock());
+	if (!Bundle().IsMapped())
+		return Complete(ERROR_TM_DATABASE_NOT_INITIALIZED);
+
+	const BundleEntry* entry = Bundle().Find(tacID);
+	if (entry == nullptr)
+		return Complete(ERROR_TM_TACTIONID_DOESNT_EXIST);
+	if (tactorID < 1 || tactorID + static_cast<int>(entry->tactorSpan) - 1 > kMaxTactors)
+		return Complete(ERROR_TM_CANT_MAP);
+	return 0;
+}
+
+EXPORTtactionInterface
+int PlayTAction(int boardID, int tacID, int tactorID, float gainScale, float freq1Scale, float freq2Scale, float timeScale)
+{
+	DeviceGuard device(DeviceManager::Instance(), boardID);
+	if (!device)
+		return Complete(ERROR_TM_CONTROLLER_NOT_FOUND);
+	std::unique_lock<std::mutex> tactions(TActionLock());
+	if (!Bundle().IsMapped())
+		return Complete(ERROR_TM_DATABASE_NOT_INITIALIZED);
+
+	return Complete(Play(*device, tactions, tacID, tactorID, gainScale, freq1Scale, freq2Scale, timeScale));
+}
+
+EXPORTtactionInterface
+int PlayTActionToSegment(int boardID, int tacID, int tactorIDOffset, int controllerSegmentID, float gainScale,
+	float freq1Scale, float freq2Scale, float timeScale)
+{
+	DeviceGuard device(DeviceManager::Instance(), boardID);
+	if (!device)
+		return Complete(ERROR_TM_CONTROLLER_NOT_FOUND);
+	std::unique_lock<std::mutex> tactions(TActionLock());
+	if (!Bundle().IsMapped())
+		return Complete(ERROR_TM_DATABASE_NOT_INITIALIZED);
+
+	int base = device->SegmentBase(controllerSegmentID, tactorIDOffset);
+	if (base < 0)
+		return Complete(-base);
+	return Complete(Play(*device, tactions, tacID, base, gainScale, freq1Scale, freq2Scale, timeScale));
+}
+
+EXPORTtactionInterface
+int SetTActionCacheCapacity(int entries)
+{
+	if (entries < 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	std::lock_guard<std::mutex> guard(TActionLock());
+	Cache().SetCapacity(static_cast<size_t>(entries));
+	return 0;
+}
+
+EXPORTtactionInterface
+int SetTActionCacheQuantization(float step)
+{
+	if (!(step > 0.0f))
+		return Complete(ERROR_BADPARAMETER);
+
+	std::lock_guard<std::mutex> guard(TActionLock());
+	Cache().SetQuantum(step);
+	return 0;
+}
+
+EXPORTtactionInterface
+int GetTActionCacheStats(TdkTActionCacheStats* stats)
+{
+	if (stats == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	std::lock_guard<std::mutex> guard(TActionLock());
+	CommandCacheStats cache = Cache().Stats();
+	stats->hits = cache.hits;
+	stats->misses = cache.misses;
+	stats->evictions = cache.evictions;
+	stats->uncacheable = cache.uncacheable;
+	stats->entries = cache.entries;
+	stats->capacity = cache.capacity;
+	return 0;
+}
+
+EXPORTtactionInterface
+int SetStoredTActionSlots(int count)
+{
+	if (count < 0 || count > TDK_MAX_STORED_TACTIONS)
+		return Complete(ERROR_BADPARAMETER);
+
+	Device::SetStoredSlotCount(count);
+	return 0;
+}
+
+EXPORTtactionInterface
+int GetStoredTActionStats(int boardID, TdkStoredTActionStats* stats)
+{
+	if (stats == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	DeviceGuard device(DeviceManager::Instance(), boardID);
+	if (!device)
+		return Complete(ERROR_TM_CONTROLLER_NOT_FOUND);
+
+	const StoredSlotStats& slots = device->GetStoredSlotStats();
+	stats->storedPlays = slots.storedPlays;
+	stats->uploads = slots.uploads;
+	stats->uploadFailures = slots.uploadFailures;
+	stats->evictions = slots.evictions;
+	stats->slotsInUse = slots.slotsInUse;
+	return 0;
+}
@@ -0,0 +1,165 @@
+#include "TactorFrame.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "ShadowCache.h"
+
+namespace tdk
+{
+
+namespace
+{
+
+static_assert(kMaxTactors == 64, "frames are compared as 64-bit masks");
+
+// Sets bit t of on where next[t] is not 0, and of changed where next[t]
+// differs from sent[t].
+void Compare(const uint8_t* next, const uint8_t* sent, uint64_t& on, uint64_t& changed)
+{
+	uint64_t off = 0;
+	uint64_t same = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (int i = 0; i < kMaxTactors / 16; ++i)
+	{
+		__m128i values = _mm_load_si128(reinterpret_cast<const __m128i*>(next) + i);
+		__m128i gains = _mm_load_si128(reinterpret_cast<const __m128i*>(sent) + i);
+		uint64_t zeroBits = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(values, zero)));
+		uint64_t sameBits = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(values, gains)));
+		off |= zeroBits << (16 * i);
+		same |= sameBits << (16 * i);
+	}
+#else
+	for (int t = 0; t < kMaxTactors; ++t)
+	{
+		off |= static_cast<uint64_t>(next[t] == 0) << t;
+		same |= static_cast<uint64_t>(next[t] == sent[t]) << t;
+	}
+#endif
+	on = ~off;
+	changed = ~same;
+}
+
+} // namespace
+
+TactorFrame::TactorFrame()
+{
+	Reset();
+	memset(m_next, 0, sizeof(m_next));
+	m_nextOn = 0;
+	m_unsettled = 0;
+	m_gainsSettleNs = 0;
+	m_statesSettleNs = 0;
+}
+
+void TactorFrame::Reset()
+{
+	memset(m_gains, 0, sizeof(m_gains));
+	m_on = 0;
+	m_known = false;
+}
+
+void TactorFrame::Observe(const Action& action, uint8_t timeFactor, int64_t now)
+{
+	int tactor = action.args[0];
+	int64_t delayNs = static_cast<int64_t>(action.delay) * timeFactor * 1000000;
+	switch (action.command)
+	{
+	case TDK_COMMAND_GAIN:
+	case TDK_COMMAND_RAMP:
+	{
+		if (tactor < 1 || tactor > kMaxTactors || (action.command == TDK_COMMAND_RAMP && action.args[1] != kRampTargetGain))
+			break;
+		m_gains[tactor - 1] = 0;
+		int64_t settleNs = ShadowCache::SettleNs(action, timeFactor);
+		if (settleNs != 0)
+		{
+			m_unsettled |= 1ull << (tactor - 1);
+			m_gainsSettleNs = std::max(m_gainsSettleNs, now + settleNs + kShadowTransitNs);
+		}
+		break;
+	}
+	case TDK_COMMAND_PULSE:
+		// The tactor turns off again once the pulse ends.
+		delayNs += static_cast<int64_t>(action.args[1]) * timeFactor * 1000000;
+		m_known = false;
+		m_statesSettleNs = std::max(m_statesSettleNs, now + delayNs + kShadowTransitNs);
+		break;
+	case TDK_COMMAND_SET_TACTORS:
+		m_known = false;
+		if (delayNs != 0)
+			m_statesSettleNs = std::max(m_statesSettleNs, now + delayNs + kShadowTransitNs);
+		break;
+	case TDK_COMMAND_STOP:
+	case TDK_COMMAND_TACTION_PLAY:
+		Reset();
+		break;
+	default:
+		break;
+	}
+}
+
+void TactorFrame::Settle(int64_t now)
+{
+	// Whatever was pending has run over what frames sent meanwhile.
+	if (m_unsettled != 0 && now >= m_gainsSettleNs)
+	{
+		for (uint64_t bits = m_unsettled; bits != 0; bits &= bits - 1)
+			m_gains[__builtin_ctzll(bits)] = 0;
+		m_unsettled = 0;
+	}
+	if (m_statesSettleNs != 0 && now >= m_statesSettleNs)
+	{
+		m_known = false;
+		m_statesSettleNs = 0;
+	}
+}
+
+int TactorFrame::Diff(const uint8_t* intensities, int msDelay, int timeFactor, int64_t now, Command* out)
+{
+	Settle(now);
+	memcpy(m_next, intensities, sizeof(m_next));
+	uint64_t changed = 0;
+	Compare(m_next, m_gains, m_nextOn, changed);
+	changed |= m_unsettled;
+
+	// Gains first, so a tactor turned on starts at its new gain.
+	int count = 0;
+	for (uint64_t bits = changed & m_nextOn; bits != 0; bits &= bits - 1)
+	{
+		int t = __builtin_ctzll(bits);
+		if (int error = MakeGain(out[count].action, t + 1, m_next[t], msDelay, timeFactor))
+			return -error;
+		out[count++].timeFactor = static_cast<uint8_t>(timeFactor);
+	}
+
+	if (!m_known || m_statesSettleNs != 0 || m_nextOn != m_on)
+	{
+		uint8_t states[kTactorStateBytes];
+		for (int i = 0; i < kTactorStateBytes; ++i)
+			states[i] = static_cast<uint8_t>(m_nextOn >> (8 * i));
+		if (int error = MakeSetTactors(out[count].action, states, msDelay, timeFactor))
+			return -error;
+		out[count++].timeFactor = static_cast<uint8_t>(timeFactor);
+	}
+	return count;
+}
+
+void TactorFrame::Commit()
+{
+	// A tactor turned off keeps its gain on the controller.
+	for (uint64_t bits = m_nextOn; bits != 0; bits &= bits - 1)
+	{
+		int t = __builtin_ctzll(bits);
+		m_gains[t] = m_next[t];
+	}
+	m_on = m_nextOn;
+	m_known = true;
+}
+
+} // namespace tdk
@@ -0,0 +1,70 @@
+/************************************************************************
+*                                                                       *
+*   TactorFrame.h -- whole-array tactor states sent as differences      *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_TACTORFRAME_H_
+#define TDK_TACTORFRAME_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <EAI_Defines.h>
+
+#include "Protocol.h"
+
+namespace tdk
+{
+
+// The most a frame can cost: a GAIN per tactor and one SET_TACTORS.
+const size_t kMaxFrameCommands = kMaxTactors + 1;
+
+// What the controller was last told about every tactor through frames, so
+// a new frame, one intensity per tactor (0 off, otherwise on at that gain),
+// is sent as only what changed: a GAIN for each tactor that is on and has a
+// new gain, then one SET_TACTORS if any tactor turned on or off. Frames are
+// compared 16 tactors at a time with SSE2 where the compiler targets it.
+//
+// Commands sent some other way that touch the same state are passed to
+// Observe, which forgets what they may have changed. A delayed command,
+// a frame's own included, or a ramp may change it again once it runs, so
+// what it touches stays unknown until then. Owned by the API thread.
+class TactorFrame
+{
+public:
+	TactorFrame();
+
+	// Nothing is known: the next frame is sent in full.
+	void Reset();
+	// now is when action is submitted.
+	void Observe(const Action& action, uint8_t timeFactor, int64_t now);
+
+	// Writes the commands that take the controller to intensities (one per
+	// tactor, kMaxTactors of them) into out, which has room for
+	// kMaxFrameCommands, and returns how many, or -error. Commit once they
+	// are sent.
+	int Diff(const uint8_t* intensities, int msDelay, int timeFactor, int64_t now, Command* out);
+	void Commit();
+
+private:
+	void Settle(int64_t now);
+
+	// Last gain sent to each tactor; 0, never an on intensity, is unknown.
+	alignas(16) uint8_t m_gains[kMaxTactors];
+	alignas(16) uint8_t m_next[kMaxTactors];
+	// Bit tactor - 1 set while the tactor is on.
+	uint64_t m_on;
+	uint64_t m_nextOn;
+	bool m_known;
+	// Tactors whose gain delayed commands or ramps may still change, until
+	// m_gainsSettleNs; on/off states may change until m_statesSettleNs, 0
+	// once they cannot.
+	uint64_t m_unsettled;
+	int64_t m_gainsSettleNs;
+	int64_t m_statesSettleNs;
+};
+
+} // namespace tdk
+
+#endif
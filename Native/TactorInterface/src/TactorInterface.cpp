@@ -0,0 +1,1002 @@
+/************************************************************************
+*                                                                       *
+*   TactorInterface.cpp -- C entry points declared in TactorInterface.h *
+*                                                                       *
+************************************************************************/
+
+#include <TactorInterface.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include "Clock.h"
+#include "DeviceManager.h"
+#include "Discovery.h"
+#include "ErrorState.h"
+#include "Protocol.h"
+#include "RampFit.h"
+#include "SpatialRenderer.h"
+#include "WireTrace.h"
+
+using namespace tdk;
+
+namespace
+{
+
+const char* const kVersionNumber = "1.0.0.0";
+
+int TimeFactor()
+{
+	return DeviceManager::Instance().TimeFactor();
+}
+
+// Shared tail of every command entry point: report a build error, or send
+// the encoded action to the board.
+int Submit(int deviceID, int buildError, const Action& action)
+{
+	if (buildError != 0)
+		return Complete(buildError);
+
+	DeviceManager& manager = DeviceManager::Instance();
+	if (!manager.IsInitialized())
+		return Complete(ERROR_NOINIT);
+
+	return Complete(manager.Send(deviceID, action));
+}
+
+// Submit for the *Async entry points: returns the completion token.
+int SubmitAsync(int deviceID, int buildError, const Action& action)
+{
+	if (buildError != 0)
+		return Complete(buildError);
+
+	DeviceManager& manager = DeviceManager::Instance();
+	if (!manager.IsInitialized())
+		return Complete(ERROR_NOINIT);
+
+	int token = manager.SendAsync(deviceID, action);
+	if (token < 0)
+		return Complete(-token);
+	return token;
+}
+
+static_assert(TDK_CURVE_LINEAR == kCurveLinear && TDK_CURVE_EASE_IN == kCurveEaseIn
+	&& TDK_CURVE_EASE_OUT == kCurveEaseOut && TDK_CURVE_EASE_IN_OUT == kCurveEaseInOut
+	&& TDK_CURVE_EXPONENTIAL == kCurveExponential, "curve values");
+
+// Contacts are rendered straight from the caller's array.
+static_assert(sizeof(TdkContact) == sizeof(Contact) && offsetof(TdkContact, x) == offsetof(Contact, x)
+	&& offsetof(TdkContact, y) == offsetof(Contact, y) && offsetof(TdkContact, z) == offsetof(Contact, z)
+	&& offsetof(TdkContact, intensity) == offsetof(Contact, intensity), "contact layout");
+
+static_assert(sizeof(TdkTelemetry::firmware) == kMaxFirmwareBytes
+	&& sizeof(TdkTelemetry::segmentSizes) == kMaxSegments, "telemetry array sizes");
+
+int RampLow(uint8_t target)
+{
+	return target == kRampTargetGain ? 0 : MIN_ACTION_FREQUENCY;
+}
+
+int RampHigh(uint8_t target)
+{
+	return target == kRampTargetGain ? MAX_ACTION_GAIN : kMaxFrequency;
+}
+
+// Shared tail of the envelope entry points: fits ramps to points[0..units]
+// and sends them in one write. Returns the number of ramps.
+int SubmitEnvelope(int deviceID, uint8_t target, int tactor, const double* points, int units, int maxError,
+	int msDelay, int timeFactor)
+{
+	DeviceManager& manager = DeviceManager::Instance();
+	if (!manager.IsInitialized())
+		return Complete(ERROR_NOINIT);
+	if (msDelay < 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	int minUnits = (MIN_ACTION_DURATION + timeFactor - 1) / timeFactor;
+	int maxUnits = std::min(0xFF, MAX_ACTION_DURATION / timeFactor);
+	RampSegment segments[kMaxEnvelopeUnits];
+	int count = FitRamps(points, units, maxError, minUnits, maxUnits, RampLow(target), RampHigh(target), segments,
+		kMaxEnvelopeUnits);
+	if (count < 0)
+		return Complete(-count);
+
+	// Offsets are whole units, so only the first delay is rounded.
+	int delayUnits = (msDelay + timeFactor / 2) / timeFactor;
+	Command commands[kMaxEnvelopeUnits];
+	for (int i = 0; i < count; ++i)
+	{
+		const RampSegment& segment = segments[i];
+		int error = MakeRamp(commands[i].action, target, tactor, segment.start, segment.end, segment.units * timeFactor,
+			TDK_LINEAR_RAMP, (delayUnits + segment.offset) * timeFactor, timeFactor);
+		if (error != 0)
+			return Complete(error);
+		commands[i].timeFactor = static_cast<uint8_t>(timeFactor);
+	}
+
+	if (int error = manager.SendSequence(deviceID, commands, static_cast<size_t>(count)))
+		return Complete(error);
+	return count;
+}
+
+int SubmitSampledEnvelope(int deviceID, uint8_t target, int tactor, const int* values, int count, int msStep,
+	int maxError, int msDelay)
+{
+	if (values == nullptr || count < 2)
+		return Complete(ERROR_BADPARAMETER);
+	for (int i = 0; i < count; ++i)
+	{
+		if (values[i] < RampLow(target) || values[i] > RampHigh(target))
+			return Complete(ERROR_BADPARAMETER);
+	}
+
+	int timeFactor = TimeFactor();
+	double points[kMaxEnvelopeUnits + 1];
+	int units = ResampleValues(values, count, msStep, timeFactor, points);
+	if (units < 0)
+		return Complete(-units);
+	return SubmitEnvelope(deviceID, target, tactor, points, units, maxError, msDelay, timeFactor);
+}
+
+int SubmitEasedEnvelope(int deviceID, uint8_t target, int tactor, int start, int end, int msDuration, int curve,
+	int maxError, int msDelay)
+{
+	if (start < RampLow(target) || start > RampHigh(target) || end < RampLow(target) || end > RampHigh(target)
+		|| msDuration <= 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	int timeFactor = TimeFactor();
+	int units = (msDuration + timeFactor / 2) / timeFactor;
+	double points[kMaxEnvelopeUnits + 1];
+	if (int error = SampleCurve(curve, start, end, units, points))
+		return Complete(error);
+	return SubmitEnvelope(deviceID, target, tactor, points, units, maxError, msDelay, timeFactor);
+}
+
+} // namespace
+
+EXPORTtactionInterface
+int InitializeTI()
+{
+	return Complete(DeviceManager::Instance().Initialize());
+}
+
+EXPORTtactionInterface
+int ShutdownTI()
+{
+	return Complete(DeviceManager::Instance().Shutdown());
+}
+
+EXPORTtactionInterface
+const char* GetVersionNumber()
+{
+	return kVersionNumber;
+}
+
+EXPORTtactionInterface
+int Connect(const char* name, int type, void* _callback)
+{
+	DeviceManager& manager = DeviceManager::Instance();
+	int result = manager.Connect(name, type, reinterpret_cast<DataCallback>(_callback));
+	if (result < 0)
+		return Complete(-result);
+
+	// Tried first by the next Discover, possibly in another process.
+	// The table lock before the device, as Connect takes them.
+	std::lock_guard<std::recursive_mutex> guard(manager.Lock());
+	DeviceGuard device(manager, result);
+	if (device)
+		Discovery::Instance().Remember(name, device->Type());
+	return result;
+}
+
+EXPORTtactionInterface
+int Discover(int type)
+{
+	return DiscoverLimited(type, kMaxDiscovered);
+}
+
+EXPORTtactionInterface
+int DiscoverLimited(int type, int amount)
+{
+	DeviceManager& manager = DeviceManager::Instance();
+	if (!manager.IsInitialized())
+		return Complete(ERROR_NOINIT);
+
+	std::lock_guard<std::recursive_mutex> guard(manager.Lock());
+	int result = Discovery::Instance().Run(type, amount);
+	if (result < 0)
+		return Complete(-result);
+	return result;
+}
+
+EXPORTtactionInterface
+int SetDiscoveryCache(bool _enabled)
+{
+	Discovery::SetCacheEnabled(_enabled);
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+const char* GetDiscoveredDeviceName(int index)
+{
+	std::lock_guard<std::recursive_mutex> guard(DeviceManager::Instance().Lock());
+	const DiscoveredDevice* device = Discovery::Instance().Get(index);
+	if (device == nullptr)
+	{
+		SetLastError(ERROR_BADPARAMETER);
+		return nullptr;
+	}
+	return device->name;
+}
+
+EXPORTtactionInterface
+int GetDiscoveredDeviceType(int index)
+{
+	std::lock_guard<std::recursive_mutex> guard(DeviceManager::Instance().Lock());
+	const DiscoveredDevice* device = Discovery::Instance().Get(index);
+	if (device == nullptr)
+	{
+		SetLastError(ERROR_BADPARAMETER);
+		return 0;
+	}
+	return device->type;
+}
+
+EXPORTtactionInterface
+int Close(int deviceID)
+{
+	return Complete(DeviceManager::Instance().Close(deviceID));
+}
+
+EXPORTtactionInterface
+int CloseAll()
+{
+	return Complete(DeviceManager::Instance().CloseAll());
+}
+
+EXPORTtactionInterface
+int Pulse(int deviceID, int _tacNum, int _msDuration, int _delay)
+{
+	Action action;
+	int error = MakePulse(action, _tacNum, _msDuration, _delay, TimeFactor());
+	return Submit(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int SendActionWait(int deviceID, int _msDuration, int _delay)
+{
+	Action action;
+	int error = MakeActionWait(action, _msDuration, _delay, TimeFactor());
+	return Submit(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int ChangeGain(int deviceID, int _tacNum, int gainval, int _delay)
+{
+	Action action;
+	int error = MakeGain(action, _tacNum, gainval, _delay, TimeFactor());
+	return Submit(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int RampGain(int deviceID, int _tacNum, int _gainStart, int _gainEnd,
+		int _duration, int _func, int _delay)
+{
+	Action action;
+	int error = MakeRamp(action, kRampTargetGain, _tacNum, _gainStart, _gainEnd, _duration, _func, _delay, TimeFactor());
+	return Submit(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int ChangeFreq(int deviceID, int _tacNum, int freqVal, int _delay)
+{
+	Action action;
+	int error = MakeFreq(action, _tacNum, freqVal, _delay, TimeFactor());
+	return Submit(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int RampFreq(int deviceID, int _tacNum, int _freqStart, int _freqEnd,
+		int _duration, int _func, int _delay)
+{
+	Action action;
+	int error = MakeRamp(action, kRampTargetFreq, _tacNum, _freqStart, _freqEnd, _duration, _func, _delay, TimeFactor());
+	return Submit(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int RampGainCurve(int _deviceID, int _tacNum, const int* _values, int _count, int _msStep, int _maxError, int _delay)
+{
+	return SubmitSampledEnvelope(_deviceID, kRampTargetGain, _tacNum, _values, _count, _msStep, _maxError, _delay);
+}
+
+EXPORTtactionInterface
+int RampFreqCurve(int _deviceID, int _tacNum, const int* _values, int _count, int _msStep, int _maxError, int _delay)
+{
+	return SubmitSampledEnvelope(_deviceID, kRampTargetFreq, _tacNum, _values, _count, _msStep, _maxError, _delay);
+}
+
+EXPORTtactionInterface
+int RampGainEased(int _deviceID, int _tacNum, int _gainStart, int _gainEnd, int _duration, int _curve, int _maxError,
+		int _delay)
+{
+	return SubmitEasedEnvelope(_deviceID, kRampTargetGain, _tacNum, _gainStart, _gainEnd, _duration, _curve,
+		_maxError, _delay);
+}
+
+EXPORTtactionInterface
+int RampFreqEased(int _deviceID, int _tacNum, int _freqStart, int _freqEnd, int _duration, int _curve, int _maxError,
+		int _delay)
+{
+	return SubmitEasedEnvelope(_deviceID, kRampTargetFreq, _tacNum, _freqStart, _freqEnd, _duration, _curve,
+		_maxError, _delay);
+}
+
+EXPORTtactionInterface
+int ChangeSigSource(int _device, int _tacNum, int _type, int _delay)
+{
+	Action action;
+	int error = MakeSigSource(action, _tacNum, _type, _delay, TimeFactor());
+	return Submit(_device, error, action);
+}
+
+EXPORTtactionInterface
+int ReadFW(int deviceID)
+{
+	Action action;
+	int error = MakeSimple(action, TDK_COMMAND_READFW, 0, TimeFactor());
+	return Submit(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int TactorSelfTest(int deviceID, int _delay)
+{
+	Action action;
+	int error = MakeSimple(action, TDK_COMMAND_SELFTEST, _delay, TimeFactor());
+	return Submit(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int ReadSegmentList(int deviceID, int _delay)
+{
+	Action action;
+	int error = MakeSimple(action, TDK_COMMAND_GETSEGMENTLIST, _delay, TimeFactor());
+	return Submit(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int ReadBatteryLevel(int deviceID, int _delay)
+{
+	Action action;
+	int error = MakeSimple(action, TDK_COMMAND_READ_BAT_DATA, _delay, TimeFactor());
+	return Submit(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int Stop(int deviceID, int _delay)
+{
+	Action action;
+	int error = MakeSimple(action, TDK_COMMAND_STOP, _delay, TimeFactor());
+	return Submit(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int SetTactors(int device_id, int delay, unsigned char* states)
+{
+	Action action;
+	int error = MakeSetTactors(action, states, delay, TimeFactor());
+	return Submit(device_id, error, action);
+}
+
+EXPORTtactionInterface
+int SetTactorType(int device_id, int delay, int tactor, int type)
+{
+	Action action;
+	int error = MakeSetTactorType(action, tactor, type, delay, TimeFactor());
+	return Submit(device_id, error, action);
+}
+
+EXPORTtactionInterface
+int UpdateTI()
+{
+	int error = DeviceManager::Instance().Update();
+	if (error != 0)
+		SetLastError(error);
+	return error;
+}
+
+EXPORTtactionInterface
+int GetLastEAIError()
+{
+	return LastError();
+}
+
+EXPORTtactionInterface
+int SetLastEAIError(int e)
+{
+	SetLastError(e);
+	return e;
+}
+
+EXPORTtactionInterface
+int SetTimeFactor(int value)
+{
+	return Complete(DeviceManager::Instance().SetTimeFactor(value));
+}
+
+EXPORTtactionInterface
+int BeginStoreTAction(int _deviceID, int tacID)
+{
+	Action action;
+	int error = MakeStoredTAction(action, TDK_COMMAND_TACTION_START, tacID, 0, TimeFactor());
+	return Submit(_deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int FinishStoreTAction(int _deviceID)
+{
+	Action action;
+	int error = MakeSimple(action, TDK_COMMAND_TACTION_END, 0, TimeFactor());
+	return Submit(_deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int PlayStoredTAction(int _deviceID, int _delay, int tacId)
+{
+	Action action;
+	int error = MakeStoredTAction(action, TDK_COMMAND_TACTION_PLAY, tacId, _delay, TimeFactor());
+	return Submit(_deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int SetFreqTimeDelay(int _deviceID, bool _delayOn)
+{
+	Action action;
+	int error = MakeFreqTimeDelay(action, _delayOn);
+	return Submit(_deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int BeginBatch(int _deviceID)
+{
+	return Complete(DeviceManager::Instance().BeginBatch(_deviceID));
+}
+
+EXPORTtactionInterface
+int CommitBatch(int _deviceID)
+{
+	int result = DeviceManager::Instance().CommitBatch(_deviceID);
+	if (result < 0)
+		return Complete(-result);
+	return result;
+}
+
+EXPORTtactionInterface
+int CreateDeviceGroup(const int* _deviceIDs, int _count)
+{
+	int result = DeviceManager::Instance().CreateGroup(_deviceIDs, _count);
+	if (result < 0)
+		return Complete(-result);
+	return result;
+}
+
+EXPORTtactionInterface
+int DestroyDeviceGroup(int _groupID)
+{
+	return Complete(DeviceManager::Instance().DestroyGroup(_groupID));
+}
+
+EXPORTtactionInterface
+int GetQueueStats(int _deviceID, TdkQueueStats* _stats)
+{
+	if (_stats == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	QueueStats stats;
+	if (int error = DeviceManager::Instance().GetQueueStats(_deviceID, stats))
+		return Complete(error);
+
+	_stats->depth = stats.depth;
+	_stats->maxDepth = stats.maxDepth;
+	_stats->enqueued = stats.enqueued;
+	_stats->written = stats.written;
+	_stats->dropped = stats.dropped;
+	_stats->writes = stats.writes;
+	_stats->wireLatencyTotalUs = stats.wireLatencyTotalUs;
+	_stats->wireLatencyMaxUs = stats.wireLatencyMaxUs;
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int SetMaxQueueLatency(int _ms)
+{
+	if (_ms < 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	Device::SetMaxQueueLatencyMs(_ms);
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int PulseAsync(int deviceID, int _tacNum, int _msDuration, int _delay)
+{
+	Action action;
+	int error = MakePulse(action, _tacNum, _msDuration, _delay, TimeFactor());
+	return SubmitAsync(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int ChangeGainAsync(int deviceID, int _tacNum, int gainval, int _delay)
+{
+	Action action;
+	int error = MakeGain(action, _tacNum, gainval, _delay, TimeFactor());
+	return SubmitAsync(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int RampGainAsync(int deviceID, int _tacNum, int _gainStart, int _gainEnd,
+		int _duration, int _func, int _delay)
+{
+	Action action;
+	int error = MakeRamp(action, kRampTargetGain, _tacNum, _gainStart, _gainEnd, _duration, _func, _delay, TimeFactor());
+	return SubmitAsync(deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int PlayStoredTActionAsync(int _deviceID, int _delay, int tacId)
+{
+	Action action;
+	int error = MakeStoredTAction(action, TDK_COMMAND_TACTION_PLAY, tacId, _delay, TimeFactor());
+	return SubmitAsync(_deviceID, error, action);
+}
+
+EXPORTtactionInterface
+int PollCompletion(TdkCompletion* _completion)
+{
+	if (_completion == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	Completion completion;
+	if (!DeviceManager::Instance().PollCompletion(completion))
+		return 0;
+
+	_completion->deviceID = completion.boardId;
+	_completion->token = completion.token;
+	_completion->status = completion.status;
+	_completion->detail = completion.detail;
+	_completion->roundTripUs = completion.roundTripUs;
+	return 1;
+}
+
+EXPORTtactionInterface
+int GetDroppedCompletions()
+{
+	uint64_t dropped = DeviceManager::Instance().DroppedCompletions();
+	return static_cast<int>(std::min<uint64_t>(dropped, INT_MAX));
+}
+
+EXPORTtactionInterface
+int SetCompletionTimeout(int _ms)
+{
+	if (_ms <= 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	Device::SetReplyTimeoutMs(_ms);
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int GetShadowStats(int _deviceID, TdkShadowStats* _stats)
+{
+	if (_stats == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	ShadowStats stats;
+	if (int error = DeviceManager::Instance().GetShadowStats(_deviceID, stats))
+		return Complete(error);
+
+	_stats->suppressed = stats.suppressed;
+	_stats->bytesSaved = stats.bytesSaved;
+	_stats->invalidations = stats.invalidations;
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int GetTdkStats(int _deviceID, TdkStats* _stats)
+{
+	static_assert(TDK_STATS_OPCODES == kStatsOpcodes, "opcode table size");
+	static_assert(TDK_STATS_NAK_REASONS == kStatsNakReasons, "NAK reason table size");
+	static_assert(TDK_STATS_LATENCY_BUCKETS == kLatencyBuckets, "histogram size");
+
+	if (_stats == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	StatsSnapshot stats;
+	if (int error = DeviceManager::Instance().GetStats(_deviceID, stats))
+		return Complete(error);
+
+	_stats->submitted = stats.submitted;
+	_stats->written = stats.written;
+	_stats->writes = stats.writes;
+	_stats->bytesWritten = stats.bytesWritten;
+	_stats->acks = stats.acks;
+	_stats->naks = stats.naks;
+	_stats->timeouts = stats.timeouts;
+	for (int i = 0; i < kStatsNakReasons; ++i)
+		_stats->naksByReason[i] = stats.naksByReason[i];
+	for (int i = 0; i < kStatsOpcodes; ++i)
+	{
+		_stats->submittedByOpcode[i] = stats.submittedByOpcode[i];
+		_stats->writtenByOpcode[i] = stats.writtenByOpcode[i];
+	}
+	for (int i = 0; i < kLatencyBuckets; ++i)
+	{
+		_stats->queueLatencyUs[i] = stats.queueLatencyUs[i];
+		_stats->ackLatencyUs[i] = stats.ackLatencyUs[i];
+	}
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int StartWireTrace(const char* _path, int _records)
+{
+	if (_records < 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	uint32_t records = _records == 0 ? kDefaultTraceRecords : static_cast<uint32_t>(_records);
+	return Complete(WireTrace::Instance().Start(_path, records));
+}
+
+EXPORTtactionInterface
+int StopWireTrace()
+{
+	WireTrace::Instance().Stop();
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int SetShadowCache(bool _enabled)
+{
+	Device::SetShadowCacheEnabled(_enabled);
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int BeginTimeline(int _deviceID)
+{
+	return Complete(DeviceManager::Instance().BeginTimeline(_deviceID));
+}
+
+EXPORTtactionInterface
+int SetTimelineOffset(int _deviceID, int _msOffset)
+{
+	return Complete(DeviceManager::Instance().SetTimelineOffset(_deviceID, _msOffset));
+}
+
+EXPORTtactionInterface
+int PlayTimeline(int _deviceID, int _delay)
+{
+	int result = DeviceManager::Instance().PlayTimeline(_deviceID, _delay);
+	if (result < 0)
+		return Complete(-result);
+	return result;
+}
+
+EXPORTtactionInterface
+int CancelTimeline(int _deviceID)
+{
+	int result = DeviceManager::Instance().CancelTimeline(_deviceID);
+	if (result < 0)
+		return Complete(-result);
+	return result;
+}
+
+EXPORTtactionInterface
+int SetTimelineBudget(int _actions)
+{
+	if (_actions < 1)
+		return Complete(ERROR_BADPARAMETER);
+
+	Device::SetTimelineBudget(_actions);
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int GetTimelineStats(int _deviceID, TdkTimelineStats* _stats)
+{
+	if (_stats == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	TimelineStats stats;
+	if (int error = DeviceManager::Instance().GetTimelineStats(_deviceID, stats))
+		return Complete(error);
+
+	_stats->scheduled = stats.scheduled;
+	_stats->sent = stats.sent;
+	_stats->late = stats.late;
+	_stats->cancelled = stats.cancelled;
+	_stats->maxLateUs = stats.maxLateUs;
+	_stats->pending = stats.pending;
+	_stats->onController = stats.onController;
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int SetTactorFrame(int _deviceID, int _delay, const unsigned char* _intensities, int _count)
+{
+	if ((_intensities == nullptr && _count != 0) || _count < 0 || _count > kMaxTactors || _delay < 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	DeviceManager& manager = DeviceManager::Instance();
+	if (!manager.IsInitialized())
+		return Complete(ERROR_NOINIT);
+
+	// Tactors past _count are off.
+	uint8_t intensities[kMaxTactors] = {};
+	if (_count != 0)
+		memcpy(intensities, _intensities, static_cast<size_t>(_count));
+	int result = manager.SendFrame(_deviceID, intensities, _delay);
+	if (result < 0)
+		return Complete(-result);
+	return result;
+}
+
+EXPORTtactionInterface
+int SetTactorPosition(int _deviceID, int _segment, int _offset, float _x, float _y, float _z)
+{
+	if (!std::isfinite(_x) || !std::isfinite(_y) || !std::isfinite(_z))
+		return Complete(ERROR_BADPARAMETER);
+
+	DeviceManager& manager = DeviceManager::Instance();
+	if (!manager.IsInitialized())
+		return Complete(ERROR_NOINIT);
+	return Complete(manager.PlaceTactor(_deviceID, _segment, _offset, _x, _y, _z));
+}
+
+EXPORTtactionInterface
+int ClearTactorPositions(int _deviceID)
+{
+	DeviceManager& manager = DeviceManager::Instance();
+	if (!manager.IsInitialized())
+		return Complete(ERROR_NOINIT);
+	return Complete(manager.ClearTactorPlaces(_deviceID));
+}
+
+EXPORTtactionInterface
+int SetContactRadius(int _deviceID, float _radius)
+{
+	if (!std::isfinite(_radius) || _radius <= 0.0f)
+		return Complete(ERROR_BADPARAMETER);
+
+	DeviceManager& manager = DeviceManager::Instance();
+	if (!manager.IsInitialized())
+		return Complete(ERROR_NOINIT);
+	return Complete(manager.SetContactRadius(_deviceID, _radius));
+}
+
+EXPORTtactionInterface
+int RenderContacts(int _deviceID, int _delay, const TdkContact* _contacts, int _count)
+{
+	if ((_contacts == nullptr && _count != 0) || _count < 0 || _delay < 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	DeviceManager& manager = DeviceManager::Instance();
+	if (!manager.IsInitialized())
+		return Complete(ERROR_NOINIT);
+
+	int result = manager.RenderContacts(_deviceID, reinterpret_cast<const Contact*>(_contacts),
+		static_cast<size_t>(_count), _delay);
+	if (result < 0)
+		return Complete(-result);
+	return result;
+}
+
+EXPORTtactionInterface
+int StreamGain(int _deviceID, int _tacNum, int _gainVal)
+{
+	Action action;
+	if (int error = MakeGain(action, _tacNum, _gainVal, 0, kDefaultTimeFactor))
+		return Complete(error);
+	return Complete(DeviceManager::Instance().Stream(_deviceID, action));
+}
+
+EXPORTtactionInterface
+int StreamFreq(int _deviceID, int _tacNum, int _freqVal)
+{
+	Action action;
+	if (int error = MakeFreq(action, _tacNum, _freqVal, 0, kDefaultTimeFactor))
+		return Complete(error);
+	return Complete(DeviceManager::Instance().Stream(_deviceID, action));
+}
+
+EXPORTtactionInterface
+int SetStreamRate(int _hz)
+{
+	if (_hz < 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	Device::SetStreamRate(_hz);
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int GetStreamStats(int _deviceID, TdkStreamStats* _stats)
+{
+	if (_stats == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	StreamStats stats;
+	if (int error = DeviceManager::Instance().GetStreamStats(_deviceID, stats))
+		return Complete(error);
+
+	_stats->updates = stats.updates;
+	_stats->superseded = stats.superseded;
+	_stats->sent = stats.sent;
+	_stats->resent = stats.resent;
+	_stats->flushes = stats.flushes;
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int SetControllerLimits(int _deviceID, int _actionList, int _rampList, int _busSlots)
+{
+	if (_actionList < 0 || _rampList < 0 || _busSlots < 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	CreditLimits limits;
+	limits.actionList = _actionList;
+	limits.rampList = _rampList;
+	limits.busSlots = _busSlots;
+	return Complete(DeviceManager::Instance().SetCreditLimits(_deviceID, limits));
+}
+
+EXPORTtactionInterface
+int GetAvailableCredits(int _deviceID, TdkCredits* _credits)
+{
+	if (_credits == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	CreditState state;
+	if (int error = DeviceManager::Instance().GetCredits(_deviceID, state))
+		return Complete(error);
+
+	_credits->actions = state.actions;
+	_credits->ramps = state.ramps;
+	_credits->busSlots = state.busSlots;
+	_credits->held = state.held;
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+long long GetTdkTimeUs()
+{
+	return MonotonicNs() / 1000;
+}
+
+EXPORTtactionInterface
+int PulseAt(int _deviceID, int _tacNum, int _msDuration, long long _atUs)
+{
+	Action action;
+	if (int error = MakePulse(action, _tacNum, _msDuration, 0, TimeFactor()))
+		return Complete(error);
+
+	DeviceManager& manager = DeviceManager::Instance();
+	if (!manager.IsInitialized())
+		return Complete(ERROR_NOINIT);
+	return Complete(manager.SendAt(_deviceID, action, static_cast<int64_t>(_atUs) * 1000));
+}
+
+EXPORTtactionInterface
+int PlayTimelineAt(int _deviceID, long long _atUs)
+{
+	int result = DeviceManager::Instance().PlayTimelineAt(_deviceID, static_cast<int64_t>(_atUs) * 1000);
+	if (result < 0)
+		return Complete(-result);
+	return result;
+}
+
+EXPORTtactionInterface
+int SetClockProbeInterval(int _ms)
+{
+	if (_ms < 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	Device::SetClockProbeIntervalMs(_ms);
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int GetClockSync(int _deviceID, TdkClockSync* _sync)
+{
+	if (_sync == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	ClockSyncState state;
+	if (int error = DeviceManager::Instance().GetClockSync(_deviceID, state))
+		return Complete(error);
+
+	_sync->samples = state.samples;
+	_sync->latencyUs = static_cast<int>(state.latencyNs / 1000);
+	_sync->jitterUs = static_cast<int>(state.jitterNs / 1000);
+	_sync->minRoundTripUs = static_cast<int>(state.minRoundTripNs / 1000);
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int SetTelemetryInterval(int _batteryMs, int _selfTestMs)
+{
+	if (_batteryMs < 0 || _selfTestMs < 0)
+		return Complete(ERROR_BADPARAMETER);
+
+	Device::SetTelemetryIntervalsMs(_batteryMs, _selfTestMs);
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int GetTelemetry(int _deviceID, TdkTelemetry* _telemetry)
+{
+	if (_telemetry == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	TelemetrySnapshot telemetry;
+	if (int error = DeviceManager::Instance().GetTelemetry(_deviceID, telemetry))
+		return Complete(error);
+
+	_telemetry->batteryUs = telemetry.batteryNs / 1000;
+	_telemetry->selfTestUs = telemetry.selfTestNs / 1000;
+	_telemetry->battery = telemetry.battery;
+	_telemetry->selfTest = telemetry.selfTest;
+	_telemetry->selfTestRunning = telemetry.selfTestRunning ? 1 : 0;
+	_telemetry->segmentCount = telemetry.segmentCount;
+	_telemetry->firmwareLength = telemetry.firmwareLength;
+	_telemetry->replies = telemetry.replies;
+	memcpy(_telemetry->firmware, telemetry.firmware, sizeof(_telemetry->firmware));
+	memcpy(_telemetry->segmentSizes, telemetry.segmentSizes, sizeof(_telemetry->segmentSizes));
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int SetSendPriority(int _priority)
+{
+	static_assert(TDK_PRIORITY_CLASSES == kPriorityClasses, "priority classes");
+
+	if (_priority < 0 || _priority >= kPriorityClasses)
+		return Complete(ERROR_BADPARAMETER);
+
+	Device::SetSendPriority(static_cast<uint8_t>(_priority));
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int SetPriorityPreemption(int _enabled)
+{
+	Device::SetPreemptStop(_enabled != 0);
+	return Complete(0);
+}
+
+EXPORTtactionInterface
+int GetPriorityStats(int _deviceID, TdkPriorityStats* _stats)
+{
+	if (_stats == nullptr)
+		return Complete(ERROR_BADPARAMETER);
+
+	StatsSnapshot stats;
+	if (int error = DeviceManager::Instance().GetStats(_deviceID, stats))
+		return Complete(error);
+
+	_stats->preemptions = stats.preemptions;
+	for (int c = 0; c < kPriorityClasses; ++c)
+	{
+		_stats->written[c] = stats.writtenByClass[c];
+		for (int i = 0; i < kLatencyBuckets; ++i)
+		{
+			_stats->queueLatencyUs[c][i] = stats.classQueueLatencyUs[c][i];
+			_stats->replyLatencyUs[c][i] = stats.classReplyLatencyUs[c][i];
+		}
+	}
+	return Complete(0);
+}
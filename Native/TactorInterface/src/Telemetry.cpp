@@ -0,0 +1,241 @@
+#include "Telemetry.h"
+
+#include <algorithm>
+
+#include <EAI_Defines.h>
+
+namespace tdk
+{
+
+namespace
+{
+
+const int64_t kNever = INT64_MIN / 2;
+const int64_t kTelemetryRetryNs = 2000000000;
+// How long the link must have been quiet before the poller starts a self
+// test.
+const int64_t kSelfTestQuietNs = 1000000000;
+
+enum Query
+{
+	kQueryFirmware,
+	kQuerySegments,
+	kQueryBattery,
+	kQuerySelfTest
+};
+
+const uint8_t kQueryCommands[kTelemetryQueries] =
+{
+	TDK_COMMAND_READFW,
+	TDK_COMMAND_GETSEGMENTLIST,
+	TDK_COMMAND_READ_BAT_DATA,
+	TDK_COMMAND_SELFTEST
+};
+
+int QueryOf(uint8_t command)
+{
+	for (int query = 0; query < kTelemetryQueries; ++query)
+	{
+		if (kQueryCommands[query] == command)
+			return query;
+	}
+	return -1;
+}
+
+} // namespace
+
+Telemetry::Telemetry()
+	: m_sequence(0)
+{
+	Reset();
+}
+
+void Telemetry::Reset()
+{
+	BeginWrite();
+	m_batteryNs.store(0, std::memory_order_relaxed);
+	m_selfTestNs.store(0, std::memory_order_relaxed);
+	m_battery.store(-1, std::memory_order_relaxed);
+	m_selfTest.store(-1, std::memory_order_relaxed);
+	m_selfTestRunning.store(false, std::memory_order_relaxed);
+	m_segmentCount.store(-1, std::memory_order_relaxed);
+	for (std::atomic<uint8_t>& size : m_segmentSizes)
+		size.store(0, std::memory_order_relaxed);
+	m_firmwareLength.store(0, std::memory_order_relaxed);
+	for (std::atomic<uint8_t>& byte : m_firmware)
+		byte.store(0, std::memory_order_relaxed);
+	m_replies.store(0, std::memory_order_relaxed);
+	EndWrite();
+}
+
+void Telemetry::BeginWrite()
+{
+	m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+void Telemetry::EndWrite()
+{
+	m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool Telemetry::Record(const uint8_t* payload, size_t length, int64_t now)
+{
+	if (length < 2)
+		return false;
+
+	switch (payload[0])
+	{
+	case TDK_COMMAND_READ_BAT_DATA:
+		BeginWrite();
+		m_battery.store(payload[1], std::memory_order_relaxed);
+		m_batteryNs.store(now, std::memory_order_relaxed);
+		break;
+	case TDK_COMMAND_SELFTEST:
+		BeginWrite();
+		m_selfTest.store(payload[1], std::memory_order_relaxed);
+		m_selfTestNs.store(now, std::memory_order_relaxed);
+		m_selfTestRunning.store(false, std::memory_order_relaxed);
+		break;
+	case TDK_COMMAND_READFW:
+	{
+		int count = static_cast<int>(std::min<size_t>(length - 1, kMaxFirmwareBytes));
+		BeginWrite();
+		for (int i = 0; i < kMaxFirmwareBytes; ++i)
+			m_firmware[i].store(i < count ? payload[1 + i] : 0, std::memory_order_relaxed);
+		m_firmwareLength.store(count, std::memory_order_relaxed);
+		break;
+	}
+	case TDK_COMMAND_GETSEGMENTLIST:
+	{
+		int count = payload[1];
+		if (count > kMaxSegments || length < 2 + static_cast<size_t>(count))
+			return false;
+		BeginWrite();
+		for (int i = 0; i < kMaxSegments; ++i)
+			m_segmentSizes[i].store(i < count ? payload[2 + i] : 0, std::memory_order_relaxed);
+		m_segmentCount.store(count, std::memory_order_relaxed);
+		break;
+	}
+	default:
+		return false;
+	}
+
+	m_replies.store(m_replies.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	EndWrite();
+	return true;
+}
+
+void Telemetry::SetSelfTestRunning(bool running)
+{
+	BeginWrite();
+	m_selfTestRunning.store(running, std::memory_order_relaxed);
+	EndWrite();
+}
+
+void Telemetry::Read(TelemetrySnapshot& out) const
+{
+	for (;;)
+	{
+		uint32_t before = m_sequence.load(std::memory_order_acquire);
+		out.batteryNs = m_batteryNs.load(std::memory_order_relaxed);
+		out.selfTestNs = m_selfTestNs.load(std::memory_order_relaxed);
+		out.battery = m_battery.load(std::memory_order_relaxed);
+		out.selfTest = m_selfTest.load(std::memory_order_relaxed);
+		out.selfTestRunning = m_selfTestRunning.load(std::memory_order_relaxed);
+		out.segmentCount = m_segmentCount.load(std::memory_order_relaxed);
+		for (int i = 0; i < kMaxSegments; ++i)
+			out.segmentSizes[i] = m_segmentSizes[i].load(std::memory_order_relaxed);
+		out.firmwareLength = m_firmwareLength.load(std::memory_order_relaxed);
+		for (int i = 0; i < kMaxFirmwareBytes; ++i)
+			out.firmware[i] = m_firmware[i].load(std::memory_order_relaxed);
+		out.replies = m_replies.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if ((before & 1) == 0 && m_sequence.load(std::memory_order_relaxed) == before)
+			return;
+	}
+}
+
+TelemetryPoller::TelemetryPoller()
+{
+	Reset(0);
+}
+
+void TelemetryPoller::Reset(int64_t now)
+{
+	for (int query = 0; query < kTelemetryQueries; ++query)
+	{
+		m_answeredNs[query] = kNever;
+		m_retryNs[query] = 0;
+	}
+	// The first periodic self test is an interval after connecting.
+	m_answeredNs[kQuerySelfTest] = now;
+	m_awaited = 0;
+}
+
+int64_t TelemetryPoller::DueAt(int query, int64_t batteryNs, int64_t selfTestNs, int64_t quietSinceNs) const
+{
+	switch (query)
+	{
+	case kQueryFirmware:
+	case kQuerySegments:
+		return m_answeredNs[query] == kNever ? m_retryNs[query] : -1;
+	case kQueryBattery:
+		if (batteryNs <= 0)
+			return -1;
+		return std::max(m_answeredNs[query] + batteryNs, m_retryNs[query]);
+	default:
+		if (selfTestNs <= 0)
+			return -1;
+		return std::max(std::max(m_answeredNs[query] + selfTestNs, m_retryNs[query]), quietSinceNs + kSelfTestQuietNs);
+	}
+}
+
+uint8_t TelemetryPoller::Due(int64_t now, int64_t batteryNs, int64_t selfTestNs, int64_t quietSinceNs) const
+{
+	for (int query = 0; query < kTelemetryQueries; ++query)
+	{
+		int64_t due = DueAt(query, batteryNs, selfTestNs, quietSinceNs);
+		if (due >= 0 && due <= now)
+			return kQueryCommands[query];
+	}
+	return 0;
+}
+
+int64_t TelemetryPoller::NextDue(int64_t batteryNs, int64_t selfTestNs, int64_t quietSinceNs) const
+{
+	int64_t next = -1;
+	for (int query = 0; query < kTelemetryQueries; ++query)
+	{
+		int64_t due = DueAt(query, batteryNs, selfTestNs, quietSinceNs);
+		if (due >= 0 && (next < 0 || due < next))
+			next = due;
+	}
+	return next;
+}
+
+void TelemetryPoller::Sent(uint8_t command, int64_t now)
+{
+	int query = QueryOf(command);
+	if (query < 0)
+		return;
+
+	m_retryNs[query] = now + kTelemetryRetryNs;
+	m_awaited = command;
+}
+
+bool TelemetryPoller::Answered(uint8_t command, int64_t now)
+{
+	int query = QueryOf(command);
+	if (query < 0)
+		return false;
+
+	m_answeredNs[query] = now;
+	m_retryNs[query] = 0;
+	if (m_awaited != command)
+		return false;
+	m_awaited = 0;
+	return true;
+}
+
+} // namespace tdk
@@ -0,0 +1,108 @@
+/************************************************************************
+*                                                                       *
+*   Telemetry.h -- controller status polled in the link's idle gaps     *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_TELEMETRY_H_
+#define TDK_TELEMETRY_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace tdk
+{
+
+const int kMaxSegments = 16;
+const int kMaxFirmwareBytes = 8;
+const int kDefaultBatteryPollMs = 5000;
+// Status queries the poller sends.
+const int kTelemetryQueries = 4;
+
+struct TelemetrySnapshot
+{
+	int64_t batteryNs;		// when the battery level arrived, 0 until then
+	int64_t selfTestNs;		// when the self test reported, 0 until then
+	int battery;			// -1 until read
+	int selfTest;			// result byte, 0 passed; -1 until one reported
+	bool selfTestRunning;
+	int segmentCount;		// -1 until read
+	uint8_t segmentSizes[kMaxSegments];
+	int firmwareLength;		// 0 until read
+	uint8_t firmware[kMaxFirmwareBytes];
+	uint32_t replies;		// status replies recorded since connecting
+};
+
+// The latest answer to each status query of a device, decoded from its
+// DATA replies whoever asked. Only the I/O thread writes; any thread reads
+// a consistent copy without a lock, retrying while a write is under way
+// (a sequence lock).
+class Telemetry
+{
+public:
+	Telemetry();
+
+	void Reset();
+
+	// I/O thread. Records a status reply; false for any other DATA.
+	bool Record(const uint8_t* payload, size_t length, int64_t now);
+	// A self test was written, or will not report after all.
+	void SetSelfTestRunning(bool running);
+
+	void Read(TelemetrySnapshot& out) const;
+
+private:
+	void BeginWrite();
+	void EndWrite();
+
+	std::atomic<uint32_t> m_sequence;
+	std::atomic<int64_t> m_batteryNs;
+	std::atomic<int64_t> m_selfTestNs;
+	std::atomic<int> m_battery;
+	std::atomic<int> m_selfTest;
+	std::atomic<bool> m_selfTestRunning;
+	std::atomic<int> m_segmentCount;
+	std::atomic<uint8_t> m_segmentSizes[kMaxSegments];
+	std::atomic<int> m_firmwareLength;
+	std::atomic<uint8_t> m_firmware[kMaxFirmwareBytes];
+	std::atomic<uint32_t> m_replies;
+};
+
+// Which status query the I/O thread sends next. Firmware and the segment
+// list are read once per connection, the battery level and the self test
+// every interval (0 never). A query left unanswered is tried again after a
+// retry interval rather than at the next idle moment.
+class TelemetryPoller
+{
+public:
+	TelemetryPoller();
+
+	void Reset(int64_t now);
+
+	// The opcode of a query due at now, or 0. The self test, which holds
+	// the link while it runs, is only due once the link has been quiet
+	// since quietSinceNs for a while.
+	uint8_t Due(int64_t now, int64_t batteryNs, int64_t selfTestNs, int64_t quietSinceNs) const;
+	// When Due next returns a query, or -1.
+	int64_t NextDue(int64_t batteryNs, int64_t selfTestNs, int64_t quietSinceNs) const;
+
+	void Sent(uint8_t command, int64_t now);
+	// Returns true when command answers the query this poller sent.
+	bool Answered(uint8_t command, int64_t now);
+	// The query's frame was NAK'd or timed out.
+	void Failed() { m_awaited = 0; }
+
+private:
+	int64_t DueAt(int query, int64_t batteryNs, int64_t selfTestNs, int64_t quietSinceNs) const;
+
+	// When each query was last answered, and the earliest it may be sent
+	// again.
+	int64_t m_answeredNs[kTelemetryQueries];
+	int64_t m_retryNs[kTelemetryQueries];
+	uint8_t m_awaited;
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,161 @@
+#include "Timeline.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+namespace tdk
+{
+
+namespace
+{
+
+const int64_t kNsPerMs = 1000000;
+
+} // namespace
+
+Timeline::Timeline()
+	: m_budget(kDefaultTimelineBudget)
+{
+	Clear();
+}
+
+void Timeline::Clear()
+{
+	m_count = 0;
+	m_recorded = 0;
+	m_recording = false;
+	m_offsetNs = 0;
+	m_sequence = 0;
+	m_releasedCount = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool Timeline::Later(const Entry& a, const Entry& b)
+{
+	if (a.dueNs != b.dueNs)
+		return a.dueNs > b.dueNs;
+	return a.sequence > b.sequence;
+}
+
+int Timeline::Begin()
+{
+	if (m_recording)
+		return ERROR_BADPARAMETER;
+
+	m_recording = true;
+	m_recorded = 0;
+	m_offsetNs = 0;
+	return 0;
+}
+
+int Timeline::SetOffset(int ms)
+{
+	if (!m_recording || ms < 0)
+		return ERROR_BADPARAMETER;
+
+	m_offsetNs = ms * kNsPerMs;
+	return 0;
+}
+
+int Timeline::Record(const Action& action, uint8_t timeFactor)
+{
+	if (m_count + m_recorded == kMaxTimelineCommands)
+		return ERROR_TM_MAX_ACTION_LIMIT_REACHED;
+
+	Entry& entry = m_entries[m_count + m_recorded++];
+	entry.dueNs = m_offsetNs + static_cast<int64_t>(action.delay) * timeFactor * kNsPerMs;
+	entry.sequence = m_sequence++;
+	entry.command.action = action;
+	entry.command.action.delay = 0;
+	entry.command.timeFactor = timeFactor;
+	return 0;
+}
+
+int Timeline::Commit(int64_t startNs, int& count)
+{
+	if (!m_recording)
+		return ERROR_BADPARAMETER;
+
+	size_t recorded = m_recorded;
+	for (size_t i = 0; i < recorded; ++i)
+	{
+		m_entries[m_count].dueNs += startNs;
+		std::push_heap(m_entries, m_entries + ++m_count, Later);
+	}
+	m_recording = false;
+	m_recorded = 0;
+	m_stats.scheduled += recorded;
+	m_stats.pending = static_cast<int>(m_count);
+	count = static_cast<int>(recorded);
+	return 0;
+}
+
+int Timeline::Cancel()
+{
+	int dropped = static_cast<int>(m_count);
+	memmove(m_entries, m_entries + m_count, m_recorded * sizeof(Entry));
+	m_count = 0;
+	m_stats.cancelled += static_cast<uint64_t>(dropped);
+	m_stats.pending = 0;
+	return dropped;
+}
+
+void Timeline::Flushed()
+{
+	m_releasedCount = 0;
+	m_stats.onController = 0;
+}
+
+size_t Timeline::Take(int64_t now, Command* out, int64_t* dueNs, size_t capacity)
+{
+	while (m_releasedCount != 0 && m_released[0] <= now)
+		std::pop_heap(m_released, m_released + m_releasedCount--, std::greater<int64_t>());
+
+	size_t budget = m_budget > 0 ? std::min(static_cast<size_t>(m_budget), kMaxTimelineCommands) : 0;
+	size_t taken = 0;
+	while (taken < capacity && m_count != 0 && m_releasedCount < budget)
+	{
+		const Entry& next = m_entries[0];
+		int64_t unitNs = next.command.timeFactor * kNsPerMs;
+		int64_t horizonNs = std::min<int64_t>(0xFF * unitNs, MAX_ACTION_DURATION * kNsPerMs);
+		int64_t leadNs = next.dueNs - now;
+		// Later entries may use a longer time factor, but releasing them
+		// first would reorder commands due together.
+		if (leadNs > horizonNs)
+			break;
+
+		dueNs[taken] = next.dueNs;
+		Command& command = out[taken++];
+		command = next.command;
+		if (leadNs > 0)
+		{
+			command.action.delay = static_cast<uint8_t>(std::min<int64_t>((leadNs + unitNs / 2) / unitNs, 0xFF));
+			m_released[m_releasedCount++] = next.dueNs;
+		}
+		else
+		{
+			// Due already: send it now rather than never. Within half a unit
+			// it is as close as a delay could have put it.
+			if (-leadNs > unitNs / 2)
+			{
+				++m_stats.late;
+				uint32_t lateUs = static_cast<uint32_t>(std::min<int64_t>(-leadNs / 1000, UINT32_MAX));
+				m_stats.maxLateUs = std::max(m_stats.maxLateUs, lateUs);
+			}
+			m_released[m_releasedCount++] = now;
+		}
+		std::push_heap(m_released, m_released + m_releasedCount, std::greater<int64_t>());
+		std::pop_heap(m_entries, m_entries + m_count--, Later);
+		// Keep a recording in progress directly behind the heap.
+		if (m_recorded != 0)
+			m_entries[m_count] = m_entries[m_count + m_recorded];
+	}
+
+	m_stats.sent += taken;
+	m_stats.pending = static_cast<int>(m_count);
+	m_stats.onController = static_cast<int>(m_releasedCount);
+	return taken;
+}
+
+} // namespace tdk
@@ -0,0 +1,106 @@
+/************************************************************************
+*                                                                       *
+*   Timeline.h -- future commands released to the controller early      *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_TIMELINE_H_
+#define TDK_TIMELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <EAI_Defines.h>
+
+#include "Protocol.h"
+
+namespace tdk
+{
+
+const size_t kMaxTimelineCommands = 512;
+// Timeline actions allowed on the controller's action list at once; the
+// rest of the list is left to commands sent directly.
+const int kDefaultTimelineBudget = 24;
+
+struct TimelineStats
+{
+	uint64_t scheduled;
+	uint64_t sent;
+	uint64_t late;
+	uint64_t cancelled;
+	uint32_t maxLateUs;
+	int pending;		// scheduled, not yet sent
+	int onController;	// sent, not yet due
+};
+
+// Commands with absolute due times, handed out as early as the controller
+// can hold them so the controller's own action delays, not the host's
+// frame loop, decide when they run. Device does the sending.
+//
+// A command is released once its due time is within one action delay
+// (255 units of its time factor, and never more than MAX_ACTION_DURATION)
+// and fewer than the budget of released commands are still waiting on the
+// controller. Commands due at the same time keep the order they were
+// recorded in.
+class Timeline
+{
+public:
+	Timeline();
+
+	// Drops everything, including what is believed to be on the controller.
+	void Clear();
+
+	// Recording: each command's offset is the current offset plus its own
+	// delay. Commit schedules the recording with offset 0 at startNs and
+	// sets count to the number of commands. Each returns 0 or an EAI error
+	// code.
+	int Begin();
+	bool Recording() const { return m_recording; }
+	int SetOffset(int ms);
+	int Record(const Action& action, uint8_t timeFactor);
+	int Commit(int64_t startNs, int& count);
+
+	// Drops every command not yet released; returns how many.
+	int Cancel();
+	// The controller cleared its action list (Stop).
+	void Flushed();
+
+	void SetBudget(int actions) { m_budget = actions; }
+
+	// Copies up to capacity commands to release at now into out, their
+	// delays set relative to now, and when each is due into dueNs, so the
+	// delay can be set again as it is written. Returns how many.
+	size_t Take(int64_t now, Command* out, int64_t* dueNs, size_t capacity);
+
+	const TimelineStats& Stats() const { return m_stats; }
+
+private:
+	struct Entry
+	{
+		int64_t dueNs;
+		uint64_t sequence;
+		Command command;
+	};
+
+	static bool Later(const Entry& a, const Entry& b);
+
+	// m_entries[0, m_count) is a min-heap on (dueNs, sequence); the commands
+	// being recorded follow it, with dueNs holding their offset in ns.
+	Entry m_entries[kMaxTimelineCommands];
+	size_t m_count;
+	size_t m_recorded;
+	bool m_recording;
+	int64_t m_offsetNs;
+	uint64_t m_sequence;
+
+	// Min-heap of the due times of released commands.
+	int64_t m_released[kMaxTimelineCommands];
+	size_t m_releasedCount;
+	int m_budget;
+
+	TimelineStats m_stats;
+};
+
+} // namespace tdk
+
+#endif
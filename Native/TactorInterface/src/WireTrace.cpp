@@ -0,0 +1,220 @@
+#include "WireTrace.h"
+
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Clock.h"
+
+namespace tdk
+{
+
+WireTrace& WireTrace::Instance()
+{
+	static WireTrace instance;
+	return instance;
+}
+
+WireTrace::WireTrace()
+	: m_enabled(false)
+	, m_writers(0)
+	, m_header(nullptr)
+	, m_records(nullptr)
+	, m_mappedSize(0)
+{
+}
+
+WireTrace::~WireTrace()
+{
+	Stop();
+}
+
+int WireTrace::Start(const char* path, uint32_t records)
+{
+	if (path == nullptr || path[0] == '\0' || records == 0 || records > kMaxTraceRecords)
+		return ERROR_BADPARAMETER;
+
+	std::lock_guard<std::mutex> guard(m_control);
+	m_enabled.store(false);
+	Unmap();
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return ERROR_BADPARAMETER;
+
+	size_t size = sizeof(TraceHeader) + static_cast<size_t>(records) * sizeof(TraceRecord);
+	void* base = MAP_FAILED;
+	if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+		base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		unlink(path);
+		return ERROR_INTERNALERROR;
+	}
+
+	// The file is zero-filled, so every record starts incomplete.
+	TraceHeader* header = static_cast<TraceHeader*>(base);
+	memcpy(header->magic, kTraceMagic, sizeof(header->magic));
+	header->version = kTraceVersion;
+	header->byteOrder = kTraceByteOrder;
+	header->recordSize = sizeof(TraceRecord);
+	header->capacity = records;
+	timespec wall;
+	clock_gettime(CLOCK_REALTIME, &wall);
+	header->startMonotonicNs = MonotonicNs();
+	header->startRealtimeNs = static_cast<int64_t>(wall.tv_sec) * 1000000000 + wall.tv_nsec;
+	header->head.store(0, std::memory_order_relaxed);
+
+	m_header = header;
+	m_records = reinterpret_cast<TraceRecord*>(static_cast<uint8_t*>(base) + sizeof(TraceHeader));
+	m_mappedSize = size;
+	m_enabled.store(true);
+	return 0;
+}
+
+void WireTrace::Stop()
+{
+	std::lock_guard<std::mutex> guard(m_control);
+	m_enabled.store(false);
+	Unmap();
+}
+
+void WireTrace::Unmap()
+{
+	// Pairs with the increment in Record: a writer that saw the trace on
+	// is counted before this looks.
+	while (m_writers.load() != 0)
+		std::this_thread::yield();
+
+	if (m_header != nullptr)
+		munmap(m_header, m_mappedSize);
+	m_header = nullptr;
+	m_records = nullptr;
+	m_mappedSize = 0;
+}
+
+void WireTrace::Record(int deviceId, TraceDirection direction, const uint8_t* frame, size_t length)
+{
+	if (!m_enabled.load(std::memory_order_relaxed))
+		return;
+
+	m_writers.fetch_add(1);
+	if (m_enabled.load())
+	{
+		uint64_t n = m_header->head.fetch_add(1, std::memory_order_relaxed);
+		TraceRecord& record = m_records[n % m_header->capacity];
+		record.sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		if (length > kTraceFrameBytes)
+			length = kTraceFrameBytes;
+		record.timeNs = MonotonicNs();
+		record.deviceId = deviceId;
+		record.direction = static_cast<uint8_t>(direction);
+		record.reserved = 0;
+		record.length = static_cast<uint16_t>(length);
+		memcpy(record.frame, frame, length);
+		record.sequence.store(n + 1, std::memory_order_release);
+	}
+	m_writers.fetch_sub(1, std::memory_order_release);
+}
+
+void WireTrace::RecordFrames(int deviceId, TraceDirection direction, const uint8_t* data, size_t length)
+{
+	if (!m_enabled.load(std::memory_order_relaxed))
+		return;
+
+	size_t offset = 0;
+	while (offset + kFrameOverhead <= length)
+	{
+		size_t frameLength = data[offset + 2] + kFrameOverhead;
+		if (offset + frameLength > length)
+			frameLength = length - offset;
+		Record(deviceId, direction, data + offset, frameLength);
+		offset += frameLength;
+	}
+}
+
+TraceReader::TraceReader()
+	: m_header(nullptr)
+	, m_records(nullptr)
+	, m_size(0)
+{
+}
+
+TraceReader::~TraceReader()
+{
+	Close();
+}
+
+int TraceReader::Open(const char* path)
+{
+	Close();
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return ERROR_BADPARAMETER;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(TraceHeader))
+	{
+		close(fd);
+		return ERROR_BADPARAMETER;
+	}
+
+	size_t size = static_cast<size_t>(info.st_size);
+	void* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return ERROR_INTERNALERROR;
+
+	const TraceHeader* header = static_cast<const TraceHeader*>(base);
+	if (memcmp(header->magic, kTraceMagic, sizeof(kTraceMagic)) != 0 || header->version != kTraceVersion
+		|| header->byteOrder != kTraceByteOrder || header->recordSize != sizeof(TraceRecord)
+		|| header->capacity == 0 || sizeof(TraceHeader) + static_cast<size_t>(header->capacity) * sizeof(TraceRecord) > size)
+	{
+		munmap(base, size);
+		return ERROR_BADPARAMETER;
+	}
+
+	m_header = header;
+	m_records = reinterpret_cast<const TraceRecord*>(static_cast<const uint8_t*>(base) + sizeof(TraceHeader));
+	m_size = size;
+	return 0;
+}
+
+void TraceReader::Close()
+{
+	if (m_header != nullptr)
+		munmap(const_cast<TraceHeader*>(m_header), m_size);
+	m_header = nullptr;
+	m_records = nullptr;
+	m_size = 0;
+}
+
+uint64_t TraceReader::First() const
+{
+	uint64_t end = End();
+	return end > m_header->capacity ? end - m_header->capacity : 0;
+}
+
+uint64_t TraceReader::End() const
+{
+	return m_header->head.load(std::memory_order_acquire);
+}
+
+const TraceRecord* TraceReader::Get(uint64_t n) const
+{
+	const TraceRecord& record = m_records[n % m_header->capacity];
+	if (record.sequence.load(std::memory_order_acquire) != n + 1 || record.length > kTraceFrameBytes)
+		return nullptr;
+	return &record;
+}
+
+} // namespace tdk
@@ -0,0 +1,140 @@
+/************************************************************************
+*                                                                       *
+*   WireTrace.h -- memory-mapped ring file of every frame on the link   *
+*                                                                       *
+************************************************************************/
+
+#ifndef TDK_WIRETRACE_H_
+#define TDK_WIRETRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "Protocol.h"
+
+namespace tdk
+{
+
+// File layout, written through a shared mapping and read back by tdktrace
+// and tdkreplay.
+// Integers are in host byte order (checked through byteOrder):
+//
+//   TraceHeader
+//   TraceRecord[capacity]     record n lives at n % capacity
+//
+// head counts the records ever started. A record's sequence is 0 while it
+// is being written and n + 1 once record n is complete, so a reader can
+// tell a finished record from one being overwritten. Frames longer than
+// kTraceFrameBytes (only DATA replies can be) are cut to fit.
+const char kTraceMagic[8] = { 'T', 'D', 'K', 'T', 'R', 'A', 'C', 'E' };
+const uint32_t kTraceVersion = 1;
+const uint32_t kTraceByteOrder = 0x01020304;
+const size_t kTraceFrameBytes = 136;
+const uint32_t kDefaultTraceRecords = 65536;
+const uint32_t kMaxTraceRecords = 1u << 24;
+
+static_assert(kTraceFrameBytes >= kMaxFrameSize, "trace records hold a whole frame");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "trace counters live in a shared mapping");
+
+enum TraceDirection
+{
+	kTraceOut = 0,	// host -> controller
+	kTraceIn = 1	// controller -> host
+};
+
+struct TraceHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t recordSize;
+	uint32_t capacity;
+	int64_t startMonotonicNs;
+	int64_t startRealtimeNs;	// wall clock at startMonotonicNs
+	std::atomic<uint64_t> head;
+	uint8_t reserved[16];
+};
+
+struct TraceRecord
+{
+	std::atomic<uint64_t> sequence;
+	int64_t timeNs;				// CLOCK_MONOTONIC
+	int32_t deviceId;
+	uint8_t direction;			// TraceDirection
+	uint8_t reserved;
+	uint16_t length;
+	uint8_t frame[kTraceFrameBytes];
+};
+
+static_assert(sizeof(TraceHeader) == 64, "trace header layout");
+static_assert(sizeof(TraceRecord) == 160, "trace record layout");
+
+// The process-wide trace. While it runs, the I/O thread copies each frame
+// it writes or parses into the next record of the mapped file: a few
+// stores, no system call and no allocation. The kernel writes the pages
+// back on its own, and the file stays readable after a crash.
+class WireTrace
+{
+public:
+	static WireTrace& Instance();
+
+	// Creates or truncates path, sized for records frames, and starts
+	// recording into it; a trace already running is stopped first. Returns
+	// 0 or an EAI error code.
+	int Start(const char* path, uint32_t records);
+	// Waits for any frame being recorded, then unmaps the file.
+	void Stop();
+
+	bool Enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+	// I/O thread. Both return at once while the trace is off.
+	void Record(int deviceId, TraceDirection direction, const uint8_t* frame, size_t length);
+	// Splits back-to-back frames and records each.
+	void RecordFrames(int deviceId, TraceDirection direction, const uint8_t* data, size_t length);
+
+private:
+	WireTrace();
+	~WireTrace();
+
+	void Unmap();
+
+	std::mutex m_control;
+	std::atomic<bool> m_enabled;
+	std::atomic<int> m_writers;
+	TraceHeader* m_header;
+	TraceRecord* m_records;
+	size_t m_mappedSize;
+};
+
+// A read-only view of a trace file, for the tools.
+class TraceReader
+{
+public:
+	TraceReader();
+	~TraceReader();
+
+	TraceReader(const TraceReader&) = delete;
+	TraceReader& operator=(const TraceReader&) = delete;
+
+	// Returns 0 or an EAI error code.
+	int Open(const char* path);
+	void Close();
+
+	const TraceHeader& Header() const { return *m_header; }
+	// Oldest record still in the ring, and one past the newest.
+	uint64_t First() const;
+	uint64_t End() const;
+	// Record n, or nullptr if it was overwritten or never completed.
+	const TraceRecord* Get(uint64_t n) const;
+
+private:
+	const TraceHeader* m_header;
+	const TraceRecord* m_records;
+	size_t m_size;
+};
+
+} // namespace tdk
+
+#endif
@@ -0,0 +1,248 @@
+/************************************************************************
+*                                                                       *
+*   ContentionBench.cpp -- API throughput of threads driving boards     *
+*                                                                       *
+*   usage: tdkcontention [--threads N] [--ms N]                         *
+*                                                                       *
+*   Serves N simulated 64 tactor controllers on ptys in this process    *
+*   and connects to each. Then, for 1, 2, 4 ... N threads, every        *
+*   thread calls SetTactorFrame as fast as it can for the given time,   *
+*   moving one tactor's gain every call so each call queues a command,  *
+*   in three arrangements:                                              *
+*                                                                       *
+*     per board  thread i drives board i                                *
+*     one lock   the same, but every call holds one process-wide        *
+*                mutex, as if the whole API had a single lock           *
+*     one board  every thread drives board 0                            *
+*                                                                       *
+*   Prints calls per second, per thread, call latency percentiles and   *
+*   the calls refused because a board's queue was full. No link keeps   *
+*   up with these rates, so once a queue fills most calls are refused   *
+*   after the diff, having found no room to push.                       *
+*   With per board locking, throughput per thread stays flat as         *
+*   threads are added, up to the number of cores.                       *
+*                                                                       *
+************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <TactorInterface.h>
+
+#include "Clock.h"
+#include "PtyLink.h"
+
+using namespace tdk;
+
+namespace
+{
+
+const int kDefaultThreads = 8;
+const int kDefaultMs = 500;
+const int kLatencyBuckets = 32;
+
+enum Arrangement
+{
+	kPerBoard,
+	kOneLock,
+	kOneBoard
+};
+
+const char* const kArrangementNames[] = { "per board", "one lock", "one board" };
+
+struct Result
+{
+	unsigned long long calls;
+	unsigned long long refused;
+	// Bucket b counts calls that took [2^b, 2^(b+1)) ns.
+	unsigned long long latency[kLatencyBuckets];
+	long long maxNs;
+};
+
+void Usage()
+{
+	fprintf(stderr, "usage: tdkcontention [--threads N] [--ms N]\n");
+}
+
+void DataCallback(int, unsigned char*, int)
+{
+}
+
+int Bucket(long long ns)
+{
+	int bucket = 0;
+	while (ns > 1 && bucket < kLatencyBuckets - 1)
+	{
+		ns >>= 1;
+		++bucket;
+	}
+	return bucket;
+}
+
+// Upper bound of the bucket holding the given fraction of calls.
+unsigned long long Percentile(const Result& result, double fraction)
+{
+	unsigned long long target = static_cast<unsigned long long>(fraction * static_cast<double>(result.calls));
+	unsigned long long seen = 0;
+	for (int b = 0; b < kLatencyBuckets; ++b)
+	{
+		seen += result.latency[b];
+		if (seen > target)
+			return 2ull << b;
+	}
+	return 2ull << (kLatencyBuckets - 1);
+}
+
+void Drive(int board, int64_t untilNs, std::mutex* global, Result& out)
+{
+	// Tactor 1 stays on, so each call sends one GAIN and nothing else.
+	unsigned char frame[64] = {};
+	int step = 0;
+	for (;;)
+	{
+		int64_t startNs = MonotonicNs();
+		if (startNs >= untilNs)
+			break;
+		++step;
+		frame[0] = static_cast<unsigned char>(64 + step % 128);
+
+		int result;
+		if (global != nullptr)
+		{
+			std::lock_guard<std::mutex> guard(*global);
+			result = SetTactorFrame(board, 0, frame, 64);
+		}
+		else
+			result = SetTactorFrame(board, 0, frame, 64);
+		long long ns = MonotonicNs() - startNs;
+
+		++out.calls;
+		if (result < 0)
+			++out.refused;
+		++out.latency[Bucket(ns)];
+		out.maxNs = std::max(out.maxNs, ns);
+	}
+}
+
+void Run(Arrangement arrangement, const std::vector<int>& boards, int threads, int ms)
+{
+	std::mutex global;
+	std::vector<Result> results(static_cast<size_t>(threads));
+	memset(results.data(), 0, results.size() * sizeof(Result));
+
+	int64_t untilNs = MonotonicNs() + static_cast<int64_t>(ms) * 1000000;
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+	{
+		int board = arrangement == kOneBoard ? boards[0] : boards[static_cast<size_t>(t)];
+		std::mutex* lock = arrangement == kOneLock ? &global : nullptr;
+		workers.emplace_back(Drive, board, untilNs, lock, std::ref(results[static_cast<size_t>(t)]));
+	}
+	for (std::thread& worker : workers)
+		worker.join();
+
+	Result total;
+	memset(&total, 0, sizeof(total));
+	for (const Result& result : results)
+	{
+		total.calls += result.calls;
+		total.refused += result.refused;
+		for (int b = 0; b < kLatencyBuckets; ++b)
+			total.latency[b] += result.latency[b];
+		total.maxNs = std::max(total.maxNs, result.maxNs);
+	}
+
+	double seconds = ms / 1000.0;
+	printf("%-10s %7d %12.0f %12.0f %9llu %9llu %10lld %8llu\n", kArrangementNames[arrangement], threads,
+		total.calls / seconds, total.calls / seconds / threads, Percentile(total, 0.5), Percentile(total, 0.99),
+		total.maxNs, total.refused);
+	fflush(stdout);
+	UpdateTI();
+}
+
+void Report(const std::vector<int>& boards, int threads, int ms)
+{
+	printf("%u cores, %d boards, %d ms per run\n", std::thread::hardware_concurrency(), threads, ms);
+	printf("%-10s %7s %12s %12s %9s %9s %10s %8s\n", "", "threads", "calls/s", "per thread", "p50 ns", "p99 ns",
+		"max ns", "refused");
+	for (int arrangement = kPerBoard; arrangement <= kOneBoard; ++arrangement)
+	{
+		for (int n = 1; n <= threads; n *= 2)
+			Run(static_cast<Arrangement>(arrangement), boards, n, ms);
+		if ((threads & (threads - 1)) != 0)
+			Run(static_cast<Arrangement>(arrangement), boards, threads, ms);
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	int threads = kDefaultThreads;
+	int ms = kDefaultMs;
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (strcmp(argv[i], "--threads") == 0 && value != nullptr)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--ms") == 0 && value != nullptr)
+			ms = atoi(argv[++i]);
+		else
+		{
+			Usage();
+			return 2;
+		}
+	}
+	if (threads <= 0 || ms <= 0)
+	{
+		Usage();
+		return 2;
+	}
+
+	ControllerConfig controller;
+	controller.tactorCount = 64;
+	LinkConfig link;
+	std::atomic<bool> stop(false);
+	std::vector<std::unique_ptr<PtyLink>> sims;
+	std::vector<std::thread> servers;
+	std::vector<int> boards;
+
+	InitializeTI();
+	int status = 0;
+	for (int i = 0; i < threads && status == 0; ++i)
+	{
+		sims.emplace_back(new PtyLink(controller, link));
+		if (int error = sims.back()->Open())
+		{
+			fprintf(stderr, "tdkcontention: cannot open pty: %s\n", strerror(error));
+			status = 1;
+			break;
+		}
+		servers.emplace_back([&stop, sim = sims.back().get()] { sim->Run(stop); });
+
+		int board = Connect(sims.back()->SlavePath(), DEVICE_TYPE_SERIAL, reinterpret_cast<void*>(&DataCallback));
+		if (board < 0)
+		{
+			fprintf(stderr, "tdkcontention: cannot connect to %s (error %d)\n", sims.back()->SlavePath(),
+				GetLastEAIError());
+			status = 1;
+		}
+		boards.push_back(board);
+	}
+
+	if (status == 0)
+		Report(boards, threads, ms);
+
+	ShutdownTI();
+	stop.store(true);
+	for (std::thread& server : servers)
+		server.join();
+	return status;
+}
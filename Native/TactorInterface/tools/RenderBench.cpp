@@ -0,0 +1,162 @@
+/************************************************************************
+*                                                                       *
+*   RenderBench.cpp -- times the contact rendering kernel               *
+*                                                                       *
+*   usage: tdkrenderbench [--frames N] [--radius R] [CONTACTS...]       *
+*                                                                       *
+*   Renders frames of CONTACTS random contact points (default 1, 16,    *
+*   100, 300 and 1000) onto a 64 tactor vest: two 4 x 8 panels, front   *
+*   and back, with tactors 6 cm apart. Prints per frame time            *
+*   percentiles, the mean cost of one contact and how many tactors      *
+*   each frame turned on. Only the kernel is timed; nothing is sent.    *
+*                                                                       *
+************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Clock.h"
+#include "SpatialRenderer.h"
+
+using namespace tdk;
+
+namespace
+{
+
+const int kDefaultFrames = 2000;
+const int kDefaultCounts[] = { 1, 16, 100, 300, 1000 };
+const int kColumns = 4;
+const int kRows = 8;
+const float kSpacing = 0.06f;
+const float kDepth = 0.25f;
+// Frames of contacts generated up front and cycled through.
+const int kContactFrames = 64;
+
+void Usage()
+{
+	fprintf(stderr, "usage: tdkrenderbench [--frames N] [--radius R] [CONTACTS...]\n");
+}
+
+uint32_t NextRandom(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+float Uniform(uint32_t& state, float low, float high)
+{
+	return low + (high - low) * static_cast<float>(NextRandom(state) >> 8) / static_cast<float>(1 << 24);
+}
+
+void PlaceVest(SpatialRenderer& renderer)
+{
+	int tactor = 1;
+	for (int panel = 0; panel < 2; ++panel)
+	{
+		for (int row = 0; row < kRows; ++row)
+		{
+			for (int column = 0; column < kColumns; ++column)
+				renderer.Place(tactor++, column * kSpacing, row * kSpacing, panel * kDepth);
+		}
+	}
+}
+
+// Points on either panel, a little past its edges, at gains a hit might use.
+void MakeContacts(uint32_t& state, Contact* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		out[i].x = Uniform(state, -kSpacing, kColumns * kSpacing);
+		out[i].y = Uniform(state, -kSpacing, kRows * kSpacing);
+		out[i].z = (NextRandom(state) & 1) != 0 ? kDepth : 0.0f;
+		out[i].intensity = Uniform(state, 4.0f, 64.0f);
+	}
+}
+
+long long Percentile(const std::vector<long long>& sorted, double fraction)
+{
+	size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+	return sorted[index];
+}
+
+void Run(SpatialRenderer& renderer, int contacts, int frames)
+{
+	std::vector<Contact> pool(static_cast<size_t>(contacts) * kContactFrames);
+	uint32_t state = 0x9E3779B9u;
+	MakeContacts(state, pool.data(), pool.size());
+
+	std::vector<long long> times(static_cast<size_t>(frames));
+	uint8_t intensities[kMaxTactors];
+	unsigned long long tactorsOn = 0;
+	unsigned long long felt = 0;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		const Contact* batch = pool.data() + static_cast<size_t>(frame % kContactFrames) * contacts;
+		int64_t startNs = MonotonicNs();
+		felt += static_cast<unsigned long long>(renderer.Render(batch, static_cast<size_t>(contacts), intensities));
+		times[static_cast<size_t>(frame)] = MonotonicNs() - startNs;
+		for (uint8_t intensity : intensities)
+			tactorsOn += intensity != 0;
+	}
+
+	long long total = 0;
+	for (long long time : times)
+		total += time;
+	std::sort(times.begin(), times.end());
+	printf("%8d %10lld %10lld %10lld %12.1f %10.1f %8.1f%%\n", contacts, Percentile(times, 0.5),
+		Percentile(times, 0.99), times.back(), static_cast<double>(total) / frames / contacts,
+		static_cast<double>(tactorsOn) / frames,
+		100.0 * static_cast<double>(felt) / (static_cast<double>(frames) * contacts));
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	int frames = kDefaultFrames;
+	float radius = 1.5f * kSpacing;
+	std::vector<int> counts;
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (strcmp(argv[i], "--frames") == 0 && value != nullptr)
+			frames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--radius") == 0 && value != nullptr)
+			radius = static_cast<float>(atof(argv[++i]));
+		else if (argv[i][0] != '-' && atoi(argv[i]) > 0)
+			counts.push_back(atoi(argv[i]));
+		else
+		{
+			Usage();
+			return 2;
+		}
+	}
+	if (frames <= 0 || !(radius > 0.0f))
+	{
+		Usage();
+		return 2;
+	}
+	if (counts.empty())
+		counts.assign(std::begin(kDefaultCounts), std::end(kDefaultCounts));
+
+	SpatialRenderer renderer;
+	PlaceVest(renderer);
+	renderer.SetRadius(radius);
+
+#if defined(__SSE2__)
+	const char* kernel = "SSE2";
+#else
+	const char* kernel = "scalar";
+#endif
+	printf("%d tactors, radius %.3f, %d frames, %s kernel\n", 2 * kColumns * kRows, radius, frames, kernel);
+	printf("%8s %10s %10s %10s %12s %10s %9s\n", "contacts", "p50 ns", "p99 ns", "max ns", "ns/contact",
+		"tactors on", "felt");
+	for (int contacts : counts)
+		Run(renderer, contacts, frames);
+	return 0;
+}
@@ -0,0 +1,192 @@
+/************************************************************************
+*                                                                       *
+*   ReplyBench.cpp -- reply decoding throughput                         *
+*                                                                       *
+*   usage: tdkreplybench [--megabytes N] [READSIZE...]                  *
+*                                                                       *
+*   Decodes a stream of controller replies, mostly ACKs with some NAKs  *
+*   and status data, handed over in reads of READSIZE bytes (default 5, *
+*   64, 512 and 4096). Compares the byte at a time FrameParser, with    *
+*   the re-encoding the I/O thread once did to keep each frame, against *
+*   ReplyScanner finding frames in place. Both copy each read in from   *
+*   the stream as the port would; nothing else is timed.                *
+*                                                                       *
+************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Clock.h"
+#include "FrameParser.h"
+#include "ReplyScanner.h"
+
+using namespace tdk;
+
+namespace
+{
+
+const int kDefaultMegabytes = 64;
+const int kDefaultReads[] = { 5, 64, 512, 4096 };
+// Stream generated up front and decoded repeatedly.
+const size_t kStreamBytes = 1 << 20;
+
+void Usage()
+{
+	fprintf(stderr, "usage: tdkreplybench [--megabytes N] [READSIZE...]\n");
+}
+
+uint32_t NextRandom(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+void Append(std::vector<uint8_t>& out, uint8_t type, const uint8_t* payload, size_t length)
+{
+	uint8_t frame[kMaxReplyFrame];
+	size_t size = EncodeFrame(type, payload, length, frame, sizeof(frame));
+	out.insert(out.end(), frame, frame + size);
+}
+
+// Eight ACKs to each NAK and each battery or segment list reply.
+size_t MakeStream(std::vector<uint8_t>& out)
+{
+	uint32_t state = 0x9E3779B9u;
+	size_t frames = 0;
+	while (out.size() < kStreamBytes)
+	{
+		uint32_t pick = NextRandom(state) % 10;
+		if (pick < 8)
+			Append(out, kFrameTypeAck, nullptr, 0);
+		else if (pick == 8)
+		{
+			uint8_t reason = kNakActionListFull;
+			Append(out, kFrameTypeNak, &reason, 1);
+		}
+		else
+		{
+			uint8_t data[18] = { TDK_COMMAND_GETSEGMENTLIST, 16 };
+			for (size_t i = 2; i < sizeof(data); ++i)
+				data[i] = static_cast<uint8_t>(NextRandom(state));
+			Append(out, kFrameTypeData, data, sizeof(data));
+		}
+		++frames;
+	}
+	return frames;
+}
+
+size_t RunParser(const std::vector<uint8_t>& stream, size_t readSize, size_t& checksum)
+{
+	FrameParser parser;
+	uint8_t read[kReplyScanSize];
+	size_t frames = 0;
+	for (size_t offset = 0; offset < stream.size();)
+	{
+		size_t n = std::min(std::min(readSize, sizeof(read)), stream.size() - offset);
+		memcpy(read, stream.data() + offset, n);
+		offset += n;
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (parser.Push(read[i]) != FrameParser::kFrame)
+				continue;
+			uint8_t frame[0xFF + kFrameOverhead];
+			size_t length = EncodeFrame(parser.Type(), parser.Payload(), parser.Length(), frame, sizeof(frame));
+			checksum += frame[length - 2];
+			++frames;
+		}
+	}
+	return frames;
+}
+
+size_t RunScanner(const std::vector<uint8_t>& stream, size_t readSize, size_t& checksum)
+{
+	ReplyScanner scanner;
+	size_t frames = 0;
+	for (size_t offset = 0; offset < stream.size();)
+	{
+		size_t capacity;
+		uint8_t* space = scanner.WriteSpace(capacity);
+		size_t n = std::min(std::min(readSize, capacity), stream.size() - offset);
+		memcpy(space, stream.data() + offset, n);
+		scanner.Wrote(n);
+		offset += n;
+
+		ReplyScanner::Frame frame;
+		while (scanner.Next(frame) == ReplyScanner::kFrame)
+		{
+			checksum += frame.bytes[frame.size - 2];
+			++frames;
+		}
+	}
+	return frames;
+}
+
+template <typename Decode>
+double Time(const std::vector<uint8_t>& stream, size_t readSize, int passes, size_t expected, Decode decode)
+{
+	size_t checksum = 0;
+	int64_t startNs = MonotonicNs();
+	for (int pass = 0; pass < passes; ++pass)
+	{
+		if (decode(stream, readSize, checksum) != expected)
+		{
+			fprintf(stderr, "tdkreplybench: decoder lost frames\n");
+			exit(1);
+		}
+	}
+	int64_t elapsedNs = MonotonicNs() - startNs;
+	// Keeps the frames from being optimised away.
+	if (checksum == 1)
+		printf(" ");
+	return static_cast<double>(elapsedNs) / (static_cast<double>(expected) * passes);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	int megabytes = kDefaultMegabytes;
+	std::vector<size_t> reads;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--megabytes") == 0 && i + 1 < argc)
+			megabytes = atoi(argv[++i]);
+		else if (argv[i][0] != '-' && atoi(argv[i]) > 0)
+			reads.push_back(static_cast<size_t>(atoi(argv[i])));
+		else
+		{
+			Usage();
+			return 2;
+		}
+	}
+	if (megabytes <= 0)
+	{
+		Usage();
+		return 2;
+	}
+	if (reads.empty())
+		reads.assign(std::begin(kDefaultReads), std::end(kDefaultReads));
+
+	std::vector<uint8_t> stream;
+	size_t frames = MakeStream(stream);
+	int passes = static_cast<int>((static_cast<size_t>(megabytes) << 20) / stream.size());
+	if (passes < 1)
+		passes = 1;
+	double bytesPerFrame = static_cast<double>(stream.size()) / static_cast<double>(frames);
+
+	printf("%zu frames in %zu bytes, %d passes\n", frames, stream.size(), passes);
+	printf("%8s %14s %14s %12s %12s\n", "read", "parser ns/fr", "scanner ns/fr", "parser MB/s", "scanner MB/s");
+	for (size_t readSize : reads)
+	{
+		double parserNs = Time(stream, readSize, passes, frames, RunParser);
+		double scannerNs = Time(stream, readSize, passes, frames, RunScanner);
+		printf("%8zu %14.1f %14.1f %12.1f %12.1f\n", readSize, parserNs, scannerNs, 1000.0 * bytesPerFrame / parserNs,
+			1000.0 * bytesPerFrame / scannerNs);
+	}
+	return 0;
+}
@@ -0,0 +1,306 @@
+/************************************************************************
+*                                                                       *
+*   ReplyFuzz.cpp -- randomised checks of the reply decoder             *
+*                                                                       *
+*   usage: tdkreplyfuzz [--iterations N] [--seed S]                     *
+*                                                                       *
+*   Feeds ReplyScanner streams of replies, some damaged by flipped      *
+*   bits, dropped or inserted bytes and some behind runs of noise,      *
+*   split into reads of random sizes, and checks that                   *
+*     - an undamaged stream decodes to exactly the frames sent,         *
+*     - how a stream is split into reads changes nothing,               *
+*     - every frame handed out is intact and lies in the stream,        *
+*     - at most one unfinished frame is ever kept buffered,             *
+*     - every reply sent intact is found, unless a frame handed out     *
+*       before it covers it.                                            *
+*   Prints the first failing seed and exits 1. Build with               *
+*   -fsanitize=address,undefined to also catch out of bounds reads.     *
+*                                                                       *
+************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "ReplyScanner.h"
+
+using namespace tdk;
+
+namespace
+{
+
+const int kDefaultIterations = 20000;
+
+struct Found
+{
+	ReplyScanner::Result result;
+	size_t offset;
+	size_t size;
+};
+
+void Usage()
+{
+	fprintf(stderr, "usage: tdkreplyfuzz [--iterations N] [--seed S]\n");
+}
+
+uint32_t NextRandom(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+uint32_t Below(uint32_t& state, uint32_t bound)
+{
+	return NextRandom(state) % bound;
+}
+
+void Append(std::vector<uint8_t>& out, uint8_t type, const uint8_t* payload, size_t length)
+{
+	uint8_t frame[0xFF + kFrameOverhead];
+	size_t size = EncodeFrame(type, payload, length, frame, sizeof(frame));
+	out.insert(out.end(), frame, frame + size);
+}
+
+// Any reply, including data of unusual lengths and STX or ETX bytes.
+void AppendReply(uint32_t& state, std::vector<uint8_t>& out)
+{
+	uint8_t payload[kMaxPayload];
+	switch (Below(state, 4))
+	{
+	case 0:
+	case 1:
+		Append(out, kFrameTypeAck, nullptr, 0);
+		break;
+	case 2:
+		payload[0] = static_cast<uint8_t>(Below(state, 0x16));
+		Append(out, kFrameTypeNak, payload, 1);
+		break;
+	default:
+	{
+		size_t length = 1 + Below(state, Below(state, 8) == 0 ? kMaxPayload : 20);
+		for (size_t i = 0; i < length; ++i)
+			payload[i] = Below(state, 4) == 0 ? static_cast<uint8_t>(kFrameStx + Below(state, 2)) : static_cast<uint8_t>(NextRandom(state));
+		Append(out, kFrameTypeData, payload, length);
+		break;
+	}
+	}
+}
+
+// Appends a reply with one flipped bit, a byte dropped or a byte added.
+void AppendDamaged(uint32_t& state, std::vector<uint8_t>& out)
+{
+	std::vector<uint8_t> reply;
+	AppendReply(state, reply);
+	size_t at = Below(state, static_cast<uint32_t>(reply.size()));
+	switch (Below(state, 3))
+	{
+	case 0:
+		reply[at] ^= static_cast<uint8_t>(1u << Below(state, 8));
+		break;
+	case 1:
+		reply.erase(reply.begin() + static_cast<long>(at));
+		break;
+	default:
+		reply.insert(reply.begin() + static_cast<long>(at), static_cast<uint8_t>(NextRandom(state)));
+		break;
+	}
+	out.insert(out.end(), reply.begin(), reply.end());
+}
+
+// Line noise, heavy in STX bytes.
+void AppendNoise(uint32_t& state, std::vector<uint8_t>& out)
+{
+	size_t length = 1 + Below(state, Below(state, 4) == 0 ? 300 : 8);
+	for (size_t i = 0; i < length; ++i)
+		out.push_back(Below(state, 3) == 0 ? kFrameStx : static_cast<uint8_t>(NextRandom(state)));
+}
+
+// Takes every result Next has for the bytes written so far. start is where
+// the scanner's buffer held stream offset base.
+bool Drain(ReplyScanner& scanner, const std::vector<uint8_t>& stream, size_t base, const uint8_t* start,
+	std::vector<Found>& found)
+{
+	ReplyScanner::Frame frame;
+	for (;;)
+	{
+		ReplyScanner::Result result = scanner.Next(frame);
+		if (result == ReplyScanner::kNeedMore)
+			return true;
+		Found entry = { result, base + static_cast<size_t>(frame.bytes - start), frame.size };
+		if (entry.offset + entry.size > stream.size() || memcmp(stream.data() + entry.offset, frame.bytes, frame.size) != 0)
+		{
+			fprintf(stderr, "frame at %zu is not in the stream\n", entry.offset);
+			return false;
+		}
+		if (result == ReplyScanner::kFrame
+			&& (frame.bytes[0] != kFrameStx || frame.bytes[frame.size - 1] != kFrameEtx || frame.size != frame.length + kFrameOverhead
+				|| frame.bytes[frame.size - 2] != Checksum(frame.type, frame.payload, frame.length)))
+		{
+			fprintf(stderr, "damaged frame at %zu handed out\n", entry.offset);
+			return false;
+		}
+		found.push_back(entry);
+	}
+}
+
+// Decodes stream in reads of random sizes, or in one go if state is null.
+// Offsets are positions in the stream, so splits can be compared.
+bool Decode(const std::vector<uint8_t>& stream, uint32_t* state, std::vector<Found>& found, uint64_t& skipped)
+{
+	ReplyScanner scanner;
+	size_t base = 0;
+	size_t offset = 0;
+	const uint8_t* start = nullptr;
+	while (offset < stream.size())
+	{
+		size_t capacity;
+		uint8_t* space = scanner.WriteSpace(capacity);
+		// The buffer moves under the frames; remember where it now starts.
+		start = space - scanner.Buffered();
+		base = offset - scanner.Buffered();
+		size_t n = stream.size() - offset;
+		if (state != nullptr)
+			n = std::min<size_t>(n, 1 + Below(*state, Below(*state, 4) == 0 ? 600 : 16));
+		n = std::min(n, capacity);
+		memcpy(space, stream.data() + offset, n);
+		scanner.Wrote(n);
+		offset += n;
+
+		if (!Drain(scanner, stream, base, start, found))
+			return false;
+		if (scanner.Buffered() >= kMaxReplyFrame)
+		{
+			fprintf(stderr, "%zu bytes left buffered\n", scanner.Buffered());
+			return false;
+		}
+	}
+
+	// The link goes quiet: whatever header still waits is given up on, as
+	// the I/O thread does.
+	while (scanner.Abandon())
+	{
+		if (!Drain(scanner, stream, base, start, found))
+			return false;
+	}
+	skipped = scanner.Skipped();
+	return true;
+}
+
+bool Same(const std::vector<Found>& a, const std::vector<Found>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		if (a[i].result != b[i].result || a[i].offset != b[i].offset || a[i].size != b[i].size)
+			return false;
+	}
+	return true;
+}
+
+bool Run(uint32_t seed)
+{
+	uint32_t state = seed | 1;
+	bool clean = Below(state, 3) == 0;
+	std::vector<uint8_t> stream;
+	std::vector<size_t> intact;
+	size_t replies = 1 + Below(state, 80);
+	for (size_t i = 0; i < replies; ++i)
+	{
+		uint32_t pick = clean ? 9 : Below(state, 10);
+		if (pick == 0)
+			AppendNoise(state, stream);
+		if (pick == 1 || pick == 2)
+			AppendDamaged(state, stream);
+		else
+		{
+			intact.push_back(stream.size());
+			AppendReply(state, stream);
+		}
+	}
+
+	std::vector<Found> whole;
+	std::vector<Found> split;
+	uint64_t wholeSkipped = 0;
+	uint64_t splitSkipped = 0;
+	if (!Decode(stream, nullptr, whole, wholeSkipped) || !Decode(stream, &state, split, splitSkipped))
+		return false;
+	if (!Same(whole, split) || wholeSkipped != splitSkipped)
+	{
+		fprintf(stderr, "result depends on how the stream is split\n");
+		return false;
+	}
+
+	if (clean)
+	{
+		bool exact = wholeSkipped == 0 && whole.size() == intact.size();
+		for (size_t i = 0; exact && i < intact.size(); ++i)
+			exact = whole[i].result == ReplyScanner::kFrame && whole[i].offset == intact[i];
+		if (!exact)
+		{
+			fprintf(stderr, "undamaged stream not decoded exactly\n");
+			return false;
+		}
+	}
+
+	// Damage may hide a frame only behind a frame that was believed whole.
+	size_t next = 0;
+	size_t coveredTo = 0;
+	for (size_t offset : intact)
+	{
+		while (next < whole.size() && whole[next].offset < offset)
+		{
+			if (whole[next].result == ReplyScanner::kFrame)
+				coveredTo = std::max(coveredTo, whole[next].offset + whole[next].size);
+			++next;
+		}
+		bool found = next < whole.size() && whole[next].offset == offset && whole[next].result == ReplyScanner::kFrame;
+		if (!found && offset >= coveredTo)
+		{
+			fprintf(stderr, "intact reply at %zu missed\n", offset);
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	int iterations = kDefaultIterations;
+	uint32_t seed = 1;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 0));
+		else
+		{
+			Usage();
+			return 2;
+		}
+	}
+	if (iterations <= 0)
+	{
+		Usage();
+		return 2;
+	}
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		uint32_t run = seed + static_cast<uint32_t>(i);
+		if (!Run(run))
+		{
+			fprintf(stderr, "tdkreplyfuzz: failed at --seed %u\n", run);
+			return 1;
+		}
+	}
+	printf("%d streams from seed %u passed\n", iterations, seed);
+	return 0;
+}
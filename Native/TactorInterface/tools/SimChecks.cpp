@@ -0,0 +1,445 @@
+/************************************************************************
+*                                                                       *
+*   SimChecks.cpp -- behavioural checks against a simulated controller  *
+*                                                                       *
+*   usage: tdksimcheck [--list] [NAME...]                               *
+*                                                                       *
+*   Runs each named check, or all of them, through the exported API     *
+*   against its own ControllerModel served on a pty in this process,    *
+*   and compares what reached the wire and where the controller ended   *
+*   up with what the calls asked for. The model is only looked at once  *
+*   its server has stopped. Prints one line per check and exits 1 if    *
+*   any failed.                                                         *
+*                                                                       *
+************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <unistd.h>
+
+#include <TActionInterface.h>
+#include <TactorInterface.h>
+
+#include "Clock.h"
+#include "Protocol.h"
+#include "PtyLink.h"
+#include "TActionBundle.h"
+
+using namespace tdk;
+
+namespace
+{
+
+// Long enough for everything written to be answered.
+const int kSettleMs = 100;
+// The TAction in the bundle WriteBundle makes.
+const int kCheckTAction = 1;
+
+void Usage()
+{
+	fprintf(stderr, "usage: tdksimcheck [--list] [NAME...]\n");
+}
+
+// Data callbacks so far, and those whose data was not whole frames.
+int g_callbacks = 0;
+int g_splitCallbacks = 0;
+
+void DataCallback(int, unsigned char* data, int size)
+{
+	++g_callbacks;
+	int at = 0;
+	while (at + 3 <= size && data[at] == kFrameStx)
+		at += data[at + 2] + static_cast<int>(kFrameOverhead);
+	if (at != size)
+		++g_splitCallbacks;
+}
+
+// One simulated controller and the board connected to it.
+class Sim
+{
+public:
+	Sim()
+		: m_link(ControllerConfig(), LinkConfig())
+		, m_stop(false)
+		, m_board(-1)
+	{
+	}
+
+	~Sim()
+	{
+		Finish();
+	}
+
+	bool Start()
+	{
+		if (int error = m_link.Open())
+		{
+			fprintf(stderr, "  cannot open pty: %s\n", strerror(error));
+			return false;
+		}
+		m_server = std::thread([this] { m_link.Run(m_stop); });
+		m_board = Connect(m_link.SlavePath(), DEVICE_TYPE_SERIAL, reinterpret_cast<void*>(&DataCallback));
+		if (m_board < 0)
+		{
+			fprintf(stderr, "  cannot connect to %s (error %d)\n", m_link.SlavePath(), GetLastEAIError());
+			return false;
+		}
+		return true;
+	}
+
+	int Board() const { return m_board; }
+
+	// Keeps calling UpdateTI, as an application's frame loop would.
+	void Wait(int ms)
+	{
+		int64_t untilNs = MonotonicNs() + static_cast<int64_t>(ms) * 1000000;
+		while (MonotonicNs() < untilNs)
+		{
+			UpdateTI();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	unsigned long long Written(int command) const
+	{
+		TdkStats stats;
+		if (GetTdkStats(m_board, &stats) < 0)
+			return 0;
+		return stats.writtenByOpcode[command];
+	}
+
+	// Closes the board and stops the server, after which Model may be read.
+	void Finish()
+	{
+		if (m_board >= 0)
+		{
+			Close(m_board);
+			m_board = -1;
+		}
+		m_stop.store(true);
+		if (m_server.joinable())
+			m_server.join();
+	}
+
+	const ControllerModel& Model() const { return m_link.Model(); }
+
+private:
+	PtyLink m_link;
+	std::atomic<bool> m_stop;
+	std::thread m_server;
+	int m_board;
+};
+
+// A bundle holding kCheckTAction, two 100 ms segments on tactors 1 and 2.
+bool WriteBundle(const char* path)
+{
+	const char name[] = "Check";
+	BundleSegment segments[2];
+	memset(segments, 0, sizeof(segments));
+	for (int i = 0; i < 2; ++i)
+	{
+		BundleSegment& segment = segments[i];
+		segment.startMs = static_cast<uint32_t>(i * 100);
+		segment.durationMs = 100;
+		segment.tactor = static_cast<uint8_t>(1 + i);
+		segment.sigSource = TDK_SIG_SRC_PRIMARY;
+		segment.gainStart = 200;
+		segment.gainEnd = 200;
+		segment.freq1Start = 250;
+		segment.freq1End = 250;
+	}
+	BundleEntry entry;
+	memset(&entry, 0, sizeof(entry));
+	entry.tacId = kCheckTAction;
+	entry.segmentCount = 2;
+	entry.durationMs = 200;
+	entry.tactorSpan = 2;
+
+	BundleHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kBundleMagic, sizeof(header.magic));
+	header.version = kBundleVersion;
+	header.byteOrder = kBundleByteOrder;
+	header.actionCount = 1;
+	header.segmentCount = 2;
+	header.entryOffset = sizeof(header);
+	header.segmentOffset = header.entryOffset + sizeof(entry);
+	header.nameOffset = header.segmentOffset + sizeof(segments);
+	header.nameSize = sizeof(name);
+	header.fileSize = header.nameOffset + sizeof(name);
+
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(&entry, sizeof(entry), 1, file) == 1
+		&& fwrite(segments, sizeof(segments), 1, file) == 1 && fwrite(name, sizeof(name), 1, file) == 1;
+	return fclose(file) == 0 && ok;
+}
+
+bool Expect(bool ok, const char* what, long long got, long long wanted)
+{
+	if (!ok)
+		fprintf(stderr, "  %s: got %lld, wanted %lld\n", what, got, wanted);
+	return ok;
+}
+
+// A value sent after a delayed one to the same setting is not taken as
+// already in place once the delayed one has run.
+bool ShadowAfterDelay(Sim& sim)
+{
+	int board = sim.Board();
+	ChangeGain(board, 1, 50, 500);
+	ChangeGain(board, 1, 200, 0);
+	sim.Wait(1000);
+	ChangeGain(board, 1, 200, 0);
+	sim.Wait(kSettleMs);
+
+	unsigned long long gains = sim.Written(TDK_COMMAND_GAIN);
+	sim.Finish();
+	bool ok = Expect(gains == 3, "gains written", static_cast<long long>(gains), 3);
+	return Expect(sim.Model().Tactor(1).gain == 200, "gain", sim.Model().Tactor(1).gain, 200) && ok;
+}
+
+// The same for a value sent while a ramp of that setting runs.
+bool ShadowAfterRamp(Sim& sim)
+{
+	int board = sim.Board();
+	ChangeGain(board, 1, 200, 0);
+	RampGain(board, 1, 200, 50, 300, TDK_LINEAR_RAMP, 0);
+	ChangeGain(board, 1, 200, 0);
+	sim.Wait(600);
+	ChangeGain(board, 1, 200, 0);
+	sim.Wait(kSettleMs);
+
+	unsigned long long gains = sim.Written(TDK_COMMAND_GAIN);
+	sim.Finish();
+	bool ok = Expect(gains == 3, "gains written", static_cast<long long>(gains), 3);
+	return Expect(sim.Model().Tactor(1).gain == 200, "gain", sim.Model().Tactor(1).gain, 200) && ok;
+}
+
+// A frame after a delayed one is compared against what the controller
+// ends up with, not against what the delayed frame was still to set.
+bool FrameAfterDelay(Sim& sim)
+{
+	int board = sim.Board();
+	unsigned char low[1] = { 50 };
+	unsigned char high[1] = { 200 };
+	SetTactorFrame(board, 500, low, 1);
+	SetTactorFrame(board, 0, high, 1);
+	sim.Wait(1000);
+	int sent = SetTactorFrame(board, 0, high, 1);
+	sim.Wait(kSettleMs);
+
+	sim.Finish();
+	bool ok = Expect(sent > 0, "commands in the last frame", sent, 1);
+	return Expect(sim.Model().Tactor(1).gain == 200, "gain", sim.Model().Tactor(1).gain, 200) && ok;
+}
+
+// Queues enough commands to keep the link busy for about 100 ms.
+void Backlog(int board)
+{
+	for (int i = 0; i < 250; ++i)
+		ChangeGain(board, 2, 100 + i % 2, 0);
+}
+
+bool StartedAt(Sim& sim, long long atUs)
+{
+	sim.Wait(600);
+	sim.Finish();
+	long long ranUs = sim.Model().Tactor(1).activeUntilUs - 50000;
+	return Expect(ranUs > atUs - 20000 && ranUs < atUs + 20000, "pulse started, us after the time asked for",
+		ranUs - atUs, 0);
+}
+
+// A command timed to a host time runs then, however long it waited behind
+// others to be written.
+bool PulseAtBehindBacklog(Sim& sim)
+{
+	int board = sim.Board();
+	Backlog(board);
+	long long atUs = GetTdkTimeUs() + 300000;
+	PulseAt(board, 1, 50, atUs);
+	return StartedAt(sim, atUs);
+}
+
+// The same for a timeline, whose commands are released ahead of time and
+// then wait for the link to drain.
+bool TimelineAtBehindBacklog(Sim& sim)
+{
+	int board = sim.Board();
+	Backlog(board);
+	BeginTimeline(board);
+	Pulse(board, 1, 50, 0);
+	long long atUs = GetTdkTimeUs() + 300000;
+	PlayTimelineAt(board, atUs);
+	return StartedAt(sim, atUs);
+}
+
+// Uploading a TAction played often into a stored slot leaves a timeline
+// already scheduled alone.
+bool TimelineAcrossUpload(Sim& sim)
+{
+	char path[] = "/tmp/tdksimcheck-XXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0)
+		return false;
+	close(fd);
+	bool written = WriteBundle(path);
+	int loaded = written ? LoadTActionBundle(path) : -1;
+	unlink(path);
+	if (loaded < 0)
+	{
+		fprintf(stderr, "  cannot load a bundle (error %d)\n", GetLastEAIError());
+		return false;
+	}
+
+	int board = sim.Board();
+	BeginTimeline(board);
+	Pulse(board, 3, 100, 0);
+	PlayTimeline(board, 1500);
+	for (int i = 0; i < 4; ++i)
+	{
+		PlayTAction(board, kCheckTAction, 1, 1.0f, 1.0f, 1.0f, 1.0f);
+		sim.Wait(200);
+	}
+	sim.Wait(1000);
+
+	TdkTimelineStats timeline;
+	GetTimelineStats(board, &timeline);
+	unsigned long long uploads = sim.Written(TDK_COMMAND_TACTION_START);
+	sim.Finish();
+	bool ok = Expect(uploads != 0, "uploads", static_cast<long long>(uploads), 1);
+	ok = Expect(timeline.sent == 1, "timeline commands sent", static_cast<long long>(timeline.sent), 1) && ok;
+	return Expect(timeline.cancelled == 0, "timeline commands cancelled", static_cast<long long>(timeline.cancelled), 0)
+		&& ok;
+}
+
+// Queues delayed low priority pulses on tactor 2, then a high priority
+// pulse on tactor 3 with preemption on, and returns the Stops sent.
+unsigned long long PreemptBackground(Sim& sim)
+{
+	int board = sim.Board();
+	SetPriorityPreemption(1);
+	SetSendPriority(TDK_PRIORITY_LOW);
+	for (int i = 0; i < 4; ++i)
+		Pulse(board, 2, 20, 200 + 50 * i);
+	sim.Wait(50);
+	SetSendPriority(TDK_PRIORITY_HIGH);
+	Pulse(board, 3, 30, 0);
+	SetSendPriority(TDK_PRIORITY_NORMAL);
+	sim.Wait(600);
+	SetPriorityPreemption(0);
+
+	TdkPriorityStats stats;
+	GetPriorityStats(board, &stats);
+	return stats.preemptions;
+}
+
+// A high priority command clears low priority commands still waiting on
+// the controller.
+bool PreemptClearsBackground(Sim& sim)
+{
+	unsigned long long preemptions = PreemptBackground(sim);
+	sim.Finish();
+	bool ok = Expect(preemptions == 1, "preemptions", static_cast<long long>(preemptions), 1);
+	return Expect(sim.Model().Tactor(2).activeUntilUs == 0, "tactor 2 ran", 1, 0) && ok;
+}
+
+// But not while a command of another class is still waiting there too.
+bool PreemptSparesNormal(Sim& sim)
+{
+	Pulse(sim.Board(), 1, 50, 300);
+	unsigned long long preemptions = PreemptBackground(sim);
+	sim.Finish();
+	bool ok = Expect(preemptions == 0, "preemptions", static_cast<long long>(preemptions), 0);
+	return Expect(sim.Model().Tactor(1).activeUntilUs != 0, "tactor 1 ran", 0, 1) && ok;
+}
+
+// Replies that piled up between two UpdateTI calls reach the data callback
+// as whole frames.
+bool CallbackWholeFrames(Sim& sim)
+{
+	g_callbacks = 0;
+	g_splitCallbacks = 0;
+	for (int i = 0; i < 200; ++i)
+		ReadFW(sim.Board());
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	sim.Wait(kSettleMs);
+
+	sim.Finish();
+	bool ok = Expect(g_callbacks > 1, "callbacks", g_callbacks, 2);
+	return Expect(g_splitCallbacks == 0, "callbacks with a split frame", g_splitCallbacks, 0) && ok;
+}
+
+struct Check
+{
+	const char* name;
+	bool (*run)(Sim& sim);
+};
+
+const Check kChecks[] = {
+	{ "shadow-after-delay", ShadowAfterDelay },
+	{ "shadow-after-ramp", ShadowAfterRamp },
+	{ "timeline-across-upload", TimelineAcrossUpload },
+	{ "frame-after-delay", FrameAfterDelay },
+	{ "pulse-at-behind-backlog", PulseAtBehindBacklog },
+	{ "timeline-at-behind-backlog", TimelineAtBehindBacklog },
+	{ "preempt-clears-background", PreemptClearsBackground },
+	{ "preempt-spares-normal", PreemptSparesNormal },
+	{ "callback-whole-frames", CallbackWholeFrames },
+};
+
+bool Selected(const char* name, int argc, char** argv)
+{
+	if (argc <= 1)
+		return true;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], name) == 0)
+			return true;
+	}
+	return false;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--list") == 0)
+		{
+			for (const Check& check : kChecks)
+				printf("%s\n", check.name);
+			return 0;
+		}
+		bool known = false;
+		for (const Check& check : kChecks)
+			known = known || strcmp(argv[i], check.name) == 0;
+		if (!known)
+		{
+			Usage();
+			return 2;
+		}
+	}
+
+	InitializeTI();
+	int failed = 0;
+	for (const Check& check : kChecks)
+	{
+		if (!Selected(check.name, argc, argv))
+			continue;
+		Sim sim;
+		bool ok = sim.Start() && check.run(sim);
+		printf("%-28s %s\n", check.name, ok ? "ok" : "FAILED");
+		fflush(stdout);
+		failed += ok ? 0 : 1;
+	}
+	ShutdownTI();
+	return failed != 0 ? 1 : 0;
+}
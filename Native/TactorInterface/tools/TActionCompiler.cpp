@@ -0,0 +1,70 @@
+/************************************************************************
+*                                                                       *
+*   TActionCompiler.cpp -- compiles a TAction database into a bundle    *
+*                                                                       *
+*   usage: tactionc DATABASE BUNDLE                                     *
+*                                                                       *
+*   Reads the SQLite tables described in TActionDatabase.h and writes   *
+*   the mappable format described in TActionBundle.h.                   *
+*                                                                       *
+************************************************************************/
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "TActionDatabase.h"
+
+using namespace tdk;
+
+namespace
+{
+
+// Writes next to the destination and renames, so a bundle that is mapped
+// by a running game is never seen half written.
+bool WriteFile(const char* path, const std::vector<uint8_t>& data)
+{
+	std::string temp = std::string(path) + ".tmp";
+	FILE* file = fopen(temp.c_str(), "wb");
+	if (file == nullptr)
+	{
+		perror("tactionc");
+		return false;
+	}
+
+	bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+	ok = fclose(file) == 0 && ok;
+	if (ok)
+		ok = rename(temp.c_str(), path) == 0;
+	if (!ok)
+	{
+		perror("tactionc");
+		remove(temp.c_str());
+	}
+	return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		fprintf(stderr, "usage: tactionc DATABASE BUNDLE\n");
+		return 2;
+	}
+
+	std::vector<uint8_t> bundle;
+	size_t actions = 0;
+	std::string error;
+	if (!CompileTActionDatabase(argv[1], bundle, actions, error))
+	{
+		fprintf(stderr, "tactionc: %s\n", error.c_str());
+		return 1;
+	}
+	if (!WriteFile(argv[2], bundle))
+		return 1;
+
+	printf("%zu TActions, %zu bytes\n", actions, bundle.size());
+	return 0;
+}
@@ -0,0 +1,134 @@
+/************************************************************************
+*                                                                       *
+*   TactorSim.cpp -- virtual EAI tactor controller on a pseudo-terminal *
+*                                                                       *
+*   usage: tactorsim [--baud N] [--delay-us N] [--tactors N]            *
+*                    [--action-list N] [--ramp-list N] [--bus-slots N]  *
+*                    [--corrupt N] [--link PATH]                        *
+*                                                                       *
+*   Prints the pty path to pass to Connect(name, DEVICE_TYPE_SERIAL, cb)*
+*   and serves until SIGINT/SIGTERM, then prints link statistics.       *
+*   --corrupt N flips a bit in about one reply byte in N, to exercise   *
+*   the host's resynchronisation.                                       *
+*                                                                       *
+************************************************************************/
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "PtyLink.h"
+
+using namespace tdk;
+
+namespace
+{
+
+std::atomic<bool> g_stop(false);
+
+void OnSignal(int)
+{
+	g_stop.store(true);
+}
+
+void Usage()
+{
+	fprintf(stderr,
+		"usage: tactorsim [--baud N] [--delay-us N] [--tactors N] [--action-list N]\n"
+		"                 [--ramp-list N] [--bus-slots N] [--corrupt N] [--link PATH]\n");
+}
+
+void PrintStats(const ControllerStats& stats)
+{
+	printf("frames %llu  actions %llu  acks %llu  naks %llu\n",
+		static_cast<unsigned long long>(stats.framesReceived),
+		static_cast<unsigned long long>(stats.actionsExecuted),
+		static_cast<unsigned long long>(stats.acks),
+		static_cast<unsigned long long>(stats.naks));
+
+	for (int reason = 0; reason < 0x100; ++reason)
+	{
+		if (stats.naksByReason[reason] != 0)
+			printf("  nak 0x%02X: %llu\n", reason, static_cast<unsigned long long>(stats.naksByReason[reason]));
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	ControllerConfig controller;
+	LinkConfig link;
+	const char* linkPath = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (value == nullptr)
+		{
+			Usage();
+			return 2;
+		}
+
+		if (strcmp(arg, "--baud") == 0)
+			link.baudRate = atoi(value);
+		else if (strcmp(arg, "--delay-us") == 0)
+			link.processingDelayUs = atoi(value);
+		else if (strcmp(arg, "--tactors") == 0)
+			controller.tactorCount = atoi(value);
+		else if (strcmp(arg, "--action-list") == 0)
+			controller.actionListCapacity = atoi(value);
+		else if (strcmp(arg, "--ramp-list") == 0)
+			controller.rampListCapacity = atoi(value);
+		else if (strcmp(arg, "--bus-slots") == 0)
+			controller.busSlots = atoi(value);
+		else if (strcmp(arg, "--corrupt") == 0)
+			link.corruptOneIn = atoi(value);
+		else if (strcmp(arg, "--link") == 0)
+			linkPath = value;
+		else
+		{
+			Usage();
+			return 2;
+		}
+		++i;
+	}
+
+	PtyLink pty(controller, link);
+	if (int error = pty.Open())
+	{
+		fprintf(stderr, "tactorsim: cannot open pty: %s\n", strerror(error));
+		return 1;
+	}
+
+	if (linkPath != nullptr)
+	{
+		unlink(linkPath);
+		if (symlink(pty.SlavePath(), linkPath) != 0)
+		{
+			fprintf(stderr, "tactorsim: cannot link %s: %s\n", linkPath, strerror(errno));
+			return 1;
+		}
+	}
+
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+
+	printf("%s\n", pty.SlavePath());
+	fflush(stdout);
+
+	pty.Run(g_stop);
+
+	if (linkPath != nullptr)
+		unlink(linkPath);
+	PrintStats(pty.Model().Stats());
+	if (link.corruptOneIn > 0)
+		printf("corrupted reply bytes %llu\n", static_cast<unsigned long long>(pty.CorruptedBytes()));
+	return 0;
+}
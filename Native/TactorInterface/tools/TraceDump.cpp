@@ -0,0 +1,172 @@
+/************************************************************************
+*                                                                       *
+*   TraceDump.cpp -- prints a wire trace written by StartWireTrace      *
+*                                                                       *
+*   usage: tdktrace [--device N] TRACE                                  *
+*                                                                       *
+*   One line per frame, oldest first: milliseconds since the trace      *
+*   started, device ID, direction and the decoded frame. Action lists   *
+*   list each action as NAME@delay followed by its argument bytes.      *
+*                                                                       *
+************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "WireTrace.h"
+
+using namespace tdk;
+
+namespace
+{
+
+void Usage()
+{
+	fprintf(stderr, "usage: tdktrace [--device N] TRACE\n");
+}
+
+void PrintBytes(const uint8_t* bytes, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+		printf(" %02X", bytes[i]);
+}
+
+void PrintActionList(const uint8_t* payload, size_t length)
+{
+	if (length == 0)
+		return;
+
+	printf("tf=%u", payload[0]);
+	size_t offset = 1;
+	const char* separator = "  ";
+	while (offset + 2 <= length)
+	{
+		uint8_t delay = payload[offset];
+		uint8_t command = payload[offset + 1];
+		int argLength = CommandArgLength(command);
+		const char* name = CommandName(command);
+		if (argLength < 0 || offset + 2 + static_cast<size_t>(argLength) > length)
+		{
+			printf("%s?0x%02X@%u", separator, command, delay);
+			PrintBytes(payload + offset + 2, length - offset - 2);
+			return;
+		}
+
+		printf("%s%s@%u", separator, name, delay);
+		PrintBytes(payload + offset + 2, static_cast<size_t>(argLength));
+		separator = " | ";
+		offset += 2 + static_cast<size_t>(argLength);
+	}
+}
+
+void PrintFrame(const uint8_t* frame, size_t length)
+{
+	if (length < kFrameOverhead || frame[0] != kFrameStx)
+	{
+		printf("raw");
+		PrintBytes(frame, length);
+		return;
+	}
+
+	uint8_t type = frame[1];
+	const uint8_t* payload = frame + 3;
+	size_t payloadLength = frame[2];
+	bool cut = payloadLength + kFrameOverhead > length;
+	if (cut)
+		payloadLength = length - 3;
+
+	switch (type)
+	{
+	case kFrameTypeActionList:
+		PrintActionList(payload, payloadLength);
+		break;
+	case kFrameTypeAck:
+		printf("ACK");
+		break;
+	case kFrameTypeNak:
+		printf("NAK");
+		PrintBytes(payload, payloadLength);
+		break;
+	case kFrameTypeData:
+	{
+		const char* name = payloadLength > 0 ? CommandName(payload[0]) : nullptr;
+		printf("DATA %s", name != nullptr ? name : "?");
+		if (payloadLength > 1)
+			PrintBytes(payload + 1, payloadLength - 1);
+		break;
+	}
+	default:
+		printf("type 0x%02X", type);
+		PrintBytes(payload, payloadLength);
+		break;
+	}
+	if (cut)
+		printf(" ...");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	const char* path = nullptr;
+	bool filter = false;
+	int device = 0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+		{
+			filter = true;
+			device = atoi(argv[++i]);
+		}
+		else if (path == nullptr && argv[i][0] != '-')
+			path = argv[i];
+		else
+		{
+			Usage();
+			return 2;
+		}
+	}
+	if (path == nullptr)
+	{
+		Usage();
+		return 2;
+	}
+
+	TraceReader trace;
+	if (trace.Open(path) != 0)
+	{
+		fprintf(stderr, "tdktrace: %s is not a readable trace\n", path);
+		return 1;
+	}
+
+	int64_t start = trace.Header().startMonotonicNs;
+	uint64_t first = trace.First();
+	uint64_t end = trace.End();
+	uint64_t missing = 0;
+	for (uint64_t n = first; n < end; ++n)
+	{
+		const TraceRecord* record = trace.Get(n);
+		if (record == nullptr)
+		{
+			++missing;
+			continue;
+		}
+		if (filter && record->deviceId != device)
+			continue;
+
+		printf("%12.3f  dev %d  %s  ", (record->timeNs - start) / 1e6, record->deviceId,
+			record->direction == kTraceOut ? ">" : "<");
+		PrintFrame(record->frame, record->length);
+		printf("\n");
+	}
+
+	fprintf(stderr, "tdktrace: %llu frames", static_cast<unsigned long long>(end - first));
+	if (first != 0)
+		fprintf(stderr, ", %llu older overwritten", static_cast<unsigned long long>(first));
+	if (missing != 0)
+		fprintf(stderr, ", %llu incomplete", static_cast<unsigned long long>(missing));
+	fprintf(stderr, "\n");
+	return 0;
+}
@@ -0,0 +1,378 @@
+/************************************************************************
+*                                                                       *
+*   TraceReplay.cpp -- replays a wire trace through the public API      *
+*                                                                       *
+*   usage: tdkreplay --port PATH [--realtime] [--device N]              *
+*                    [--time-factor N] [--no-batch] [--no-shadow]       *
+*                    [--no-credits] TRACE                               *
+*                                                                       *
+*   Decodes the action lists a device was sent in TRACE and submits     *
+*   each action again with the TactorInterface.h call that produces     *
+*   it, to the controller (real or tactorsim) at PATH. Each recorded    *
+*   frame is replayed as one batch unless --no-batch. Frames go out as  *
+*   fast as possible, or at their recorded times with --realtime.       *
+*   Prints submit, enqueue-to-write and write-to-ACK latency            *
+*   distributions and the NAKs the controller sent, so two builds or    *
+*   settings can be compared on the same workload.                      *
+*                                                                       *
+************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <TactorInterface.h>
+
+#include "Clock.h"
+#include "WireTrace.h"
+
+using namespace tdk;
+
+namespace
+{
+
+const int kSubmitBuckets = TDK_STATS_LATENCY_BUCKETS;
+// How long replies may keep arriving after the last command was written.
+const int kDrainQuietMs = 200;
+const int kDrainLimitMs = 5000;
+
+struct Options
+{
+	const char* port;
+	const char* trace;
+	bool realtime;
+	bool filter;
+	int device;
+	int timeFactor;		// 0 = as recorded
+	bool batch;
+	bool shadow;
+	bool credits;
+};
+
+struct Totals
+{
+	uint64_t frames;
+	uint64_t commands;
+	uint64_t rejected;		// the API refused the call
+	uint64_t unknown;		// opcodes with no API call
+	uint32_t submitUs[kSubmitBuckets];
+};
+
+void Usage()
+{
+	fprintf(stderr,
+		"usage: tdkreplay --port PATH [--realtime] [--device N] [--time-factor N]\n"
+		"                 [--no-batch] [--no-shadow] [--no-credits] TRACE\n");
+}
+
+void DataCallback(int, unsigned char*, int)
+{
+}
+
+int Bucket(int64_t ns)
+{
+	uint64_t us = ns > 0 ? static_cast<uint64_t>(ns) / 1000 : 0;
+	int bucket = 0;
+	while (us != 0 && bucket < kSubmitBuckets - 1)
+	{
+		us >>= 1;
+		++bucket;
+	}
+	return bucket;
+}
+
+int U16(const uint8_t* p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+// Calls the API function that encodes action. Times are converted back to
+// milliseconds with the recorded time factor, so they encode to the same
+// bytes unless --time-factor changes the factor.
+int Submit(int board, uint8_t delay, uint8_t command, const uint8_t* args, int tf, bool& known)
+{
+	int delayMs = delay * tf;
+	known = true;
+	switch (command)
+	{
+	case TDK_COMMAND_PULSE:
+		return Pulse(board, args[0], args[1] * tf, delayMs);
+	case TDK_COMMAND_ACTION_WAIT:
+		return SendActionWait(board, args[0] * tf, delayMs);
+	case TDK_COMMAND_GAIN:
+		return ChangeGain(board, args[0], args[1], delayMs);
+	case TDK_COMMAND_FREQ:
+		return ChangeFreq(board, args[0], U16(args + 1), delayMs);
+	case TDK_COMMAND_RAMP:
+		if (args[1] == 0x00)
+			return RampGain(board, args[0], U16(args + 2), U16(args + 4), args[6] * tf, args[7], delayMs);
+		return RampFreq(board, args[0], U16(args + 2), U16(args + 4), args[6] * tf, args[7], delayMs);
+	case TDK_COMMAND_SETSIGSOURCE:
+		return ChangeSigSource(board, args[0], args[1], delayMs);
+	case TDK_COMMAND_SET_TACTORS:
+	{
+		unsigned char states[8];
+		memcpy(states, args, sizeof(states));
+		return SetTactors(board, delayMs, states);
+	}
+	case TDK_COMMAND_SET_TACTOR_TYPE:
+		return SetTactorType(board, delayMs, args[0], args[1]);
+	case TDK_COMMAND_STOP:
+		return Stop(board, delayMs);
+	case TDK_COMMAND_READFW:
+		return ReadFW(board);
+	case TDK_COMMAND_SELFTEST:
+		return TactorSelfTest(board, delayMs);
+	case TDK_COMMAND_GETSEGMENTLIST:
+		return ReadSegmentList(board, delayMs);
+	case TDK_COMMAND_READ_BAT_DATA:
+		return ReadBatteryLevel(board, delayMs);
+	case TDK_COMMAND_TACTION_START:
+		return BeginStoreTAction(board, args[0]);
+	case TDK_COMMAND_TACTION_END:
+		return FinishStoreTAction(board);
+	case TDK_COMMAND_TACTION_PLAY:
+		return PlayStoredTAction(board, delayMs, args[0]);
+	case TDK_COMMAND_SET_FREQ_TIME_DELAY:
+		return SetFreqTimeDelay(board, args[0] != 0);
+	default:
+		known = false;
+		return 0;
+	}
+}
+
+void ReplayFrame(int board, const Options& options, const uint8_t* payload, size_t length, Totals& totals)
+{
+	int tf = payload[0];
+	if (tf == 0)
+		return;
+	SetTimeFactor(options.timeFactor != 0 ? options.timeFactor : tf);
+
+	if (options.batch)
+		BeginBatch(board);
+	size_t offset = 1;
+	while (offset + 2 <= length)
+	{
+		uint8_t delay = payload[offset];
+		uint8_t command = payload[offset + 1];
+		int argLength = CommandArgLength(command);
+		if (argLength < 0 || offset + 2 + static_cast<size_t>(argLength) > length)
+		{
+			++totals.unknown;
+			break;
+		}
+
+		bool known = false;
+		int64_t start = MonotonicNs();
+		int result = Submit(board, delay, command, payload + offset + 2, tf, known);
+		++totals.submitUs[Bucket(MonotonicNs() - start)];
+		if (!known)
+			++totals.unknown;
+		else
+		{
+			++totals.commands;
+			if (result != 0)
+				++totals.rejected;
+		}
+		offset += 2 + static_cast<size_t>(argLength);
+	}
+	if (options.batch)
+		CommitBatch(board);
+	++totals.frames;
+	UpdateTI();
+}
+
+// Upper bound of the bucket holding the given fraction of samples.
+template <typename Count>
+unsigned long long Percentile(const Count* buckets, double fraction)
+{
+	unsigned long long total = 0;
+	for (int i = 0; i < kSubmitBuckets; ++i)
+		total += buckets[i];
+	if (total == 0)
+		return 0;
+
+	unsigned long long rank = static_cast<unsigned long long>(fraction * (total - 1)) + 1;
+	unsigned long long seen = 0;
+	for (int i = 0; i < kSubmitBuckets; ++i)
+	{
+		seen += buckets[i];
+		if (seen >= rank)
+			return 1ull << i;
+	}
+	return 1ull << (kSubmitBuckets - 1);
+}
+
+template <typename Count>
+void PrintDistribution(const char* name, const Count* buckets)
+{
+	printf("%-16s p50 <%lluus  p90 <%lluus  p99 <%lluus  max <%lluus\n", name,
+		Percentile(buckets, 0.5), Percentile(buckets, 0.9), Percentile(buckets, 0.99), Percentile(buckets, 1.0));
+}
+
+// Lets the library write everything and the controller answer it.
+void Drain(int board)
+{
+	int64_t limit = MonotonicNs() + static_cast<int64_t>(kDrainLimitMs) * 1000000;
+	int64_t quietSince = MonotonicNs();
+	unsigned long long replies = 0;
+	TdkStats stats;
+	while (MonotonicNs() < limit)
+	{
+		UpdateTI();
+		TdkQueueStats queue;
+		TdkCredits credits;
+		GetQueueStats(board, &queue);
+		GetAvailableCredits(board, &credits);
+		GetTdkStats(board, &stats);
+
+		int64_t now = MonotonicNs();
+		if (queue.depth != 0 || credits.held != 0 || stats.acks + stats.naks != replies)
+		{
+			replies = stats.acks + stats.naks;
+			quietSince = now;
+		}
+		else if (now - quietSince > static_cast<int64_t>(kDrainQuietMs) * 1000000)
+			return;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+}
+
+bool ParseOptions(int argc, char** argv, Options& options)
+{
+	memset(&options, 0, sizeof(options));
+	options.batch = true;
+	options.shadow = true;
+	options.credits = true;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (strcmp(arg, "--realtime") == 0)
+			options.realtime = true;
+		else if (strcmp(arg, "--no-batch") == 0)
+			options.batch = false;
+		else if (strcmp(arg, "--no-shadow") == 0)
+			options.shadow = false;
+		else if (strcmp(arg, "--no-credits") == 0)
+			options.credits = false;
+		else if (strcmp(arg, "--port") == 0 && value != nullptr)
+			options.port = argv[++i];
+		else if (strcmp(arg, "--device") == 0 && value != nullptr)
+		{
+			options.filter = true;
+			options.device = atoi(argv[++i]);
+		}
+		else if (strcmp(arg, "--time-factor") == 0 && value != nullptr)
+			options.timeFactor = atoi(argv[++i]);
+		else if (arg[0] != '-' && options.trace == nullptr)
+			options.trace = arg;
+		else
+			return false;
+	}
+	return options.port != nullptr && options.trace != nullptr;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		Usage();
+		return 2;
+	}
+
+	TraceReader trace;
+	if (trace.Open(options.trace) != 0)
+	{
+		fprintf(stderr, "tdkreplay: %s is not a readable trace\n", options.trace);
+		return 1;
+	}
+
+	InitializeTI();
+	SetShadowCache(options.shadow);
+	int board = Connect(options.port, DEVICE_TYPE_SERIAL, reinterpret_cast<void*>(&DataCallback));
+	if (board < 0)
+	{
+		fprintf(stderr, "tdkreplay: cannot connect to %s (error %d)\n", options.port, GetLastEAIError());
+		return 1;
+	}
+	if (!options.credits)
+		SetControllerLimits(board, 0, 0, 0);
+
+	Totals totals;
+	memset(&totals, 0, sizeof(totals));
+	int64_t firstNs = -1;
+	int64_t startNs = MonotonicNs();
+	for (uint64_t n = trace.First(); n < trace.End(); ++n)
+	{
+		const TraceRecord* record = trace.Get(n);
+		if (record == nullptr || record->direction != kTraceOut || record->length < kFrameOverhead + 1
+			|| record->frame[0] != kFrameStx || record->frame[1] != kFrameTypeActionList)
+			continue;
+		if (options.filter && record->deviceId != options.device)
+			continue;
+		if (!options.filter)
+		{
+			options.filter = true;
+			options.device = record->deviceId;
+		}
+
+		if (firstNs < 0)
+			firstNs = record->timeNs;
+		if (options.realtime)
+		{
+			int64_t dueNs = startNs + (record->timeNs - firstNs);
+			int64_t waitNs = dueNs - MonotonicNs();
+			if (waitNs > 0)
+				std::this_thread::sleep_for(std::chrono::nanoseconds(waitNs));
+		}
+
+		size_t payloadLength = record->frame[2];
+		if (payloadLength + kFrameOverhead > record->length)
+			payloadLength = record->length - kFrameOverhead;
+		ReplayFrame(board, options, record->frame + 3, payloadLength, totals);
+	}
+	int64_t submittedNs = MonotonicNs() - startNs;
+
+	Drain(board);
+	int64_t drainedNs = MonotonicNs() - startNs;
+	TdkStats stats;
+	GetTdkStats(board, &stats);
+
+	printf("replayed %llu commands in %llu frames from device %d, %s: submitted in %.1f ms, answered in %.1f ms\n",
+		static_cast<unsigned long long>(totals.commands), static_cast<unsigned long long>(totals.frames),
+		options.device, options.realtime ? "real time" : "as fast as possible", submittedNs / 1e6,
+		(drainedNs - static_cast<int64_t>(kDrainQuietMs) * 1000000) / 1e6);
+	if (totals.rejected != 0 || totals.unknown != 0)
+	{
+		printf("rejected by the API %llu, not replayable %llu\n",
+			static_cast<unsigned long long>(totals.rejected), static_cast<unsigned long long>(totals.unknown));
+	}
+	for (int op = 0; op < TDK_STATS_OPCODES; ++op)
+	{
+		if (stats.submittedByOpcode[op] == 0)
+			continue;
+		const char* name = CommandName(static_cast<uint8_t>(op));
+		printf("  %-20s submitted %llu  written %llu\n", name != nullptr ? name : "?", stats.submittedByOpcode[op],
+			stats.writtenByOpcode[op]);
+	}
+	PrintDistribution("submit", totals.submitUs);
+	PrintDistribution("enqueue->write", stats.queueLatencyUs);
+	PrintDistribution("write->ack", stats.ackLatencyUs);
+	printf("writes %llu  bytes %llu  acks %llu  naks %llu  timeouts %llu\n", stats.writes, stats.bytesWritten,
+		stats.acks, stats.naks, stats.timeouts);
+	for (int reason = 0; reason < TDK_STATS_NAK_REASONS; ++reason)
+	{
+		if (stats.naksByReason[reason] != 0)
+			printf("  nak 0x%02X: %llu\n", reason, stats.naksByReason[reason]);
+	}
+
+	ShutdownTI();
+	return 0;
+}